@@ -0,0 +1,202 @@
+#include "harness.hpp"
+
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <cstdlib>
+
+#include <nlohmann/json.hpp>
+
+#include <fmt/format.h>
+#include <fmt/printf.h>
+
+using json = nlohmann::json;
+
+namespace
+{
+
+std::atomic<std::uint64_t> alloc_count = 0;
+std::atomic<std::uint64_t> alloc_bytes = 0;
+
+static void *allocate(std::size_t size, std::size_t alignment = 0)
+{
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    size = size == 0 ? 1 : size;
+    if (alignment > alignof(std::max_align_t))
+    {
+        // aligned_alloc requires a multiple of the alignment
+        return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    }
+    return std::malloc(size);
+}
+
+} // anonymous namespace
+
+// every heap allocation of the process is counted, including those of the core library
+void *operator new(std::size_t size)
+{
+    if (auto p = allocate(size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    if (auto p = allocate(size, static_cast<std::size_t>(alignment)))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+Bench::Allocations Bench::allocations()
+{
+    return {alloc_count.load(std::memory_order_relaxed), alloc_bytes.load(std::memory_order_relaxed)};
+}
+
+Bench::Harness::Harness(int argc, char **argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const auto has_value = i + 1 < argc;
+
+        if (arg == "--filter" && has_value)         this->_filter = argv[++i];
+        else if (arg == "--min-time" && has_value)  this->_min_time = std::chrono::milliseconds(std::atol(argv[++i]));
+        else if (arg == "--json" && has_value)      this->_json = argv[++i];
+        else if (arg == "--baseline" && has_value)  this->_baseline = argv[++i];
+        else if (arg == "--threshold" && has_value) this->_threshold = std::atof(argv[++i]);
+        else                                        this->_arguments.emplace_back(arg);
+    }
+}
+
+bool Bench::Harness::selected(std::string_view name) const
+{
+    return this->_filter.empty() || name.find(this->_filter) != std::string_view::npos;
+}
+
+void Bench::Harness::report(std::string_view name, std::uint64_t ops, std::chrono::steady_clock::duration elapsed,
+                            const Allocations &before, std::size_t input_bytes)
+{
+    const auto after = allocations();
+    const auto seconds = std::chrono::duration<double>(elapsed).count();
+
+    Result result;
+    result.name = name;
+    result.ops = ops;
+    result.ns_per_op = seconds * 1e9 / ops;
+    result.allocs_per_op = static_cast<double>(after.count - before.count) / ops;
+    result.bytes_per_op = static_cast<double>(after.bytes - before.bytes) / ops;
+    result.mb_per_s = input_bytes == 0 ? 0 : input_bytes * ops / seconds / 1e6;
+
+    if (this->_results.empty())
+    {
+        fmt::print("{:<40} {:>12} {:>10} {:>10} {:>10}\n", "benchmark", "ns/op", "allocs/op", "B/op", "MB/s");
+    }
+    fmt::print("{:<40} {:>12.1f} {:>10.2f} {:>10.0f} {:>10}\n", result.name, result.ns_per_op, result.allocs_per_op, result.bytes_per_op,
+        result.mb_per_s == 0 ? std::string("-") : fmt::format("{:.1f}", result.mb_per_s));
+
+    this->_results.emplace_back(std::move(result));
+}
+
+int Bench::Harness::finish()
+{
+    if (!this->_json.empty())
+    {
+        json j;
+        j["version"] = 1;
+        j["benchmarks"] = json::array();
+        for (auto&& result : this->_results)
+        {
+            j["benchmarks"].push_back({
+                {"name", result.name},
+                {"ops", result.ops},
+                {"ns_per_op", result.ns_per_op},
+                {"allocs_per_op", result.allocs_per_op},
+                {"bytes_per_op", result.bytes_per_op},
+                {"mb_per_s", result.mb_per_s},
+            });
+        }
+
+        std::ofstream ofs(this->_json, std::ios::out | std::ios::trunc);
+        ofs << j.dump(2) << '\n';
+        if (!ofs)
+        {
+            fmt::print("failed to write the results to {}\n", this->_json);
+            return 1;
+        }
+    }
+
+    if (this->_baseline.empty())
+    {
+        return 0;
+    }
+
+    std::ifstream ifs(this->_baseline, std::ios::in | std::ios::binary);
+    json baseline;
+    try {
+        baseline = json::parse(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    } catch (json::exception &e) {
+        fmt::print("failed to read the baseline {}: {}\n", this->_baseline, e.what());
+        return 1;
+    }
+
+    // a benchmark regressed when it got slower than the threshold allows or allocates more per operation
+    fmt::print("\n{:<40} {:>12} {:>12} {:>9}\n", "compared to baseline", "ns/op", "allocs/op", "");
+    std::size_t regressions = 0;
+    for (auto&& result : this->_results)
+    {
+        for (auto&& base : baseline.value("benchmarks", json::array()))
+        {
+            if (base.value("name", std::string()) != result.name)
+            {
+                continue;
+            }
+
+            const auto ns = base.value("ns_per_op", 0.0);
+            const auto allocs = base.value("allocs_per_op", 0.0);
+            const auto change = ns > 0 ? (result.ns_per_op / ns - 1) * 100 : 0;
+            const auto regressed = change > this->_threshold || result.allocs_per_op >= allocs + 1;
+            regressions += regressed;
+
+            fmt::print("{:<40} {:>+11.1f}% {:>+12.2f} {:>9}\n",
+                result.name, change, result.allocs_per_op - allocs, regressed ? "REGRESSED" : "");
+        }
+    }
+
+    return regressions == 0 ? 0 : 1;
+}
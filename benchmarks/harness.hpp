@@ -0,0 +1,140 @@
+#ifndef BENCHMARKS_HARNESS_HPP
+#define BENCHMARKS_HARNESS_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+namespace Bench
+{
+    /**
+     * Heap allocations made by all threads since the start of the process.
+     */
+    struct Allocations
+    {
+        std::uint64_t count = 0;
+        std::uint64_t bytes = 0;
+    };
+
+    Allocations allocations();
+
+    /**
+     * Keeps the compiler from optimizing away a computed value.
+     */
+    template<typename T>
+    inline void do_not_optimize(const T &value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    struct Result
+    {
+        std::string name;
+        std::uint64_t ops = 0;
+        double ns_per_op = 0;
+        double allocs_per_op = 0;
+        double bytes_per_op = 0;    // allocated bytes
+        double mb_per_s = 0;        // processed input, 0 when the benchmark has no input size
+    };
+
+    /**
+     * Runs benchmarks and reports ns/op, allocations/op and allocated bytes/op.
+     *
+     * Options:
+     *   --filter STR       only run benchmarks whose name contains STR
+     *   --min-time MS      minimum measurement time per benchmark (default 1000)
+     *   --json FILE        write the results as JSON
+     *   --baseline FILE    compare with the JSON results of a previous run
+     *   --threshold PCT    allowed slowdown against the baseline (default 10)
+     *
+     * Other arguments are left to the caller.
+     */
+    class Harness
+    {
+    public:
+        Harness(int argc, char **argv);
+
+        /**
+         * Remaining arguments which are not harness options.
+         */
+        inline const std::vector<std::string> &arguments() const
+        {
+            return this->_arguments;
+        }
+
+        /**
+         * Measures op(), which performs a single operation. input_bytes is the
+         * size of the data one operation processes, used for the throughput.
+         */
+        template<typename Operation>
+        void run(std::string_view name, Operation &&op, std::size_t input_bytes = 0)
+        {
+            if (!this->selected(name))
+            {
+                return;
+            }
+
+            // warm up caches and lazily initialized state
+            op();
+
+            // grow the batch until it is long enough for the clock resolution
+            std::uint64_t batch = 1;
+            for (;;)
+            {
+                const auto begin = std::chrono::steady_clock::now();
+                for (std::uint64_t i = 0; i < batch; ++i)
+                {
+                    op();
+                }
+                if (std::chrono::steady_clock::now() - begin >= BATCH_TIME || batch >= MAX_BATCH)
+                {
+                    break;
+                }
+                batch *= 2;
+            }
+
+            std::uint64_t ops = 0;
+            const auto allocs = allocations();
+            const auto begin = std::chrono::steady_clock::now();
+            auto now = begin;
+            do
+            {
+                for (std::uint64_t i = 0; i < batch; ++i)
+                {
+                    op();
+                }
+                ops += batch;
+                now = std::chrono::steady_clock::now();
+            } while (now - begin < this->_min_time);
+
+            this->report(name, ops, now - begin, allocs, input_bytes);
+        }
+
+        /**
+         * Writes the JSON results and compares them with the baseline.
+         * Returns the exit code, non-zero when a benchmark regressed.
+         */
+        int finish();
+
+    private:
+        static constexpr auto BATCH_TIME = std::chrono::milliseconds(10);
+        static constexpr std::uint64_t MAX_BATCH = 1ULL << 30;
+
+        std::vector<std::string> _arguments;
+        std::string _filter;
+        std::chrono::milliseconds _min_time{1000};
+        std::string _json;
+        std::string _baseline;
+        double _threshold = 10;
+
+        std::vector<Result> _results;
+
+        bool selected(std::string_view name) const;
+        void report(std::string_view name, std::uint64_t ops, std::chrono::steady_clock::duration elapsed,
+                    const Allocations &before, std::size_t input_bytes);
+    };
+}
+
+#endif // BENCHMARKS_HARNESS_HPP
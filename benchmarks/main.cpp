@@ -0,0 +1,255 @@
+#include <corpus.hpp>
+#include "harness.hpp"
+
+#include <json_decoder.hpp>
+#include <envelope.hpp>
+#include <client.hpp>
+#include <gateway.hpp>
+#include <payload_writer.hpp>
+#include <executor.hpp>
+#include <event.hpp>
+#include <utils/etf.hpp>
+#include <utils/os.hpp>
+
+#include <string>
+#include <string_view>
+#include <array>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+
+#include <fmt/format.h>
+#include <fmt/printf.h>
+
+using namespace Discord;
+using json = nlohmann::json;
+
+namespace
+{
+
+// labelled gateway payloads
+using PayloadCorpus = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * Decodes each payload of the corpus.
+ */
+static void bench_json_decoder(Bench::Harness &harness, Client::JsonBackend backend, const PayloadCorpus &corpus)
+{
+    if (!JsonDecoder::available(backend))
+    {
+        return;
+    }
+
+    auto decoder = JsonDecoder::create(backend);
+    for (auto&& [label, payload] : corpus)
+    {
+        harness.run(fmt::format("decode/{}/{}", decoder->name(), label), [&, &payload = payload]{
+            Bench::do_not_optimize(decoder->decode(payload));
+        }, payload.size());
+    }
+}
+
+/**
+ * The receive path of a shard: the envelope scan and the payload decode, for both encodings.
+ */
+static void bench_parse_payload(Bench::Harness &harness, const PayloadCorpus &corpus)
+{
+    auto decoder = JsonDecoder::create(JsonDecoder::available(Client::JsonBackend::SIMDJSON) ?
+        Client::JsonBackend::SIMDJSON : Client::JsonBackend::NLOHMANN);
+
+    for (auto&& [label, payload] : corpus)
+    {
+        const auto etf = Utils::Etf::encode(json::parse(payload));
+        for (auto&& [encoding, frame] : {std::pair{Client::Encoding::JSON, &payload}, std::pair{Client::Encoding::ETF, &etf}})
+        {
+            const auto name = fmt::format("parse_payload/{}/{}", encoding == Client::Encoding::ETF ? "etf" : "json", label);
+            harness.run(name, [&, encoding = encoding, frame = frame]{
+                const auto envelope = Envelope::scan(*frame, encoding);
+                Bench::do_not_optimize(envelope.payload(*decoder));
+            }, frame->size());
+        }
+    }
+}
+
+/**
+ * Command data of an IDENTIFY, as built by Shard::send_identity.
+ */
+static json identify_data()
+{
+    json id;
+    id["token"] = "NzEyMzgxODk4NDg3MjM0NjEy.XsZ5rA.benchmark-token-benchmark-token";
+    id["properties"]["$os"] = Utils::get_os_name();
+    id["properties"]["$browser"] = "misaka-oneesama";
+    id["properties"]["$device"] = "misaka-oneesama";
+    id["intents"] = 32509;
+    id["shard"] = {3, 16};
+    return id;
+}
+
+static void bench_send(Bench::Harness &harness)
+{
+    static constexpr std::string_view TOKEN = "NzEyMzgxODk4NDg3MjM0NjEy.XsZ5rA.benchmark-token-benchmark-token";
+    static constexpr std::string_view SESSION_ID = "0123456789abcdef0123456789abcdef";
+
+    for (auto encoding : {Client::Encoding::JSON, Client::Encoding::ETF})
+    {
+        const std::string enc = encoding == Client::Encoding::ETF ? "etf" : "json";
+
+        // the writer of a shard, see Shard::send_message
+        PayloadWriter writer(encoding);
+        writer.prepare(identify_data(), TOKEN);
+
+        const json heartbeat = 1234567;
+        harness.run(fmt::format("serialize/{}/heartbeat", enc), [&]{
+            Bench::do_not_optimize(writer.write(Client::GatewayOpcode::HEARTBEAT, heartbeat));
+        });
+
+        const auto identify = identify_data();
+        harness.run(fmt::format("serialize/{}/identify", enc), [&]{
+            Bench::do_not_optimize(writer.write(Client::GatewayOpcode::IDENTIFY, identify));
+        });
+
+        std::int32_t seq = 1234567;
+        harness.run(fmt::format("send_message/{}/heartbeat", enc), [&]{
+            Bench::do_not_optimize(writer.heartbeat(seq));
+        });
+
+        harness.run(fmt::format("send_message/{}/identify", enc), [&]{
+            Bench::do_not_optimize(writer.identify());
+        });
+
+        harness.run(fmt::format("send_message/{}/resume", enc), [&]{
+            Bench::do_not_optimize(writer.resume(SESSION_ID, seq));
+        });
+    }
+}
+
+/**
+ * The request body of Client::sendMessage with an embed.
+ */
+static void bench_rest_body(Bench::Harness &harness)
+{
+    const std::string message = "a message with some text, a <@81384788765712384> mention and unicode ✨";
+    Embed embed;
+    embed.title = "embed title";
+    embed.description = "embed description";
+    embed.url = "https://discord.com";
+
+    harness.run("rest/send_message_body", [&]{
+        Bench::do_not_optimize(Client::messageBody(message, embed));
+    });
+}
+
+using EventCounters = std::array<std::uint64_t, EVENT_COUNT>;
+
+/**
+ * Dispatch through a chain of string compares, the way events were dispatched before the Event enum.
+ */
+static void dispatch_chain(std::string_view name, EventCounters &counters)
+{
+    for (std::size_t i = 1; i < EVENT_COUNT; ++i)
+    {
+        if (name == EVENT_NAMES[i])
+        {
+            ++counters[i];
+            return;
+        }
+    }
+    ++counters[0];
+}
+
+/**
+ * Dispatch through the perfect hash and a table lookup.
+ */
+static void dispatch_table(std::string_view name, EventCounters &counters)
+{
+    ++counters[static_cast<std::size_t>(event_from_name(name))];
+}
+
+/**
+ * Dispatches every event name once per operation.
+ */
+template<typename Dispatch>
+static void bench_event_dispatch(Bench::Harness &harness, const char *name, Dispatch dispatch)
+{
+    // runtime copies of the names, so the compares can't be folded at compile time
+    std::vector<std::string> names(EVENT_NAMES.begin() + 1, EVENT_NAMES.end());
+
+    EventCounters counters{};
+    harness.run(fmt::format("dispatch/{}", name), [&]{
+        for (auto&& event : names)
+        {
+            dispatch(event, counters);
+        }
+    });
+
+    if (counters[0] != 0)
+    {
+        fmt::print("{}: {} events were not recognized\n", name, counters[0]);
+    }
+}
+
+/**
+ * Posting events to the handler executor, keyed by guild like Client::on_dispatch.
+ */
+static void bench_executor(Bench::Harness &harness)
+{
+    Executor executor(2);
+    executor.set_capacity(16384);
+
+    std::uint64_t guild = 0;
+    harness.run("dispatch/executor_post", [&]{
+        executor.post(++guild % 64, []{});
+    });
+
+    executor.stop();
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv)
+{
+    Bench::Harness harness(argc, argv);
+
+    // recorded payloads can be given as arguments, a generated corpus is used otherwise
+    PayloadCorpus corpus;
+    for (auto&& path : harness.arguments())
+    {
+        for (auto&& payload : Corpus::load({path}))
+        {
+            corpus.emplace_back(path.substr(path.find_last_of('/') + 1), std::move(payload));
+        }
+    }
+    if (corpus.empty())
+    {
+        corpus = {
+            {"message_create", Corpus::message_create()},
+            {"presence_update", Corpus::presence_update()},
+            {"guild_create_100", Corpus::guild_create(100)},
+            {"guild_create_1000", Corpus::guild_create(1000)},
+            {"guild_create_10000", Corpus::guild_create(10000)},
+        };
+    }
+
+    std::size_t size = 0;
+    for (auto&& payload : corpus)
+    {
+        size += payload.second.size();
+    }
+    fmt::print("corpus: {} payload(s), {:.2f} MB\n\n", corpus.size(), size / 1e6);
+
+    bench_json_decoder(harness, Client::JsonBackend::NLOHMANN, corpus);
+    bench_json_decoder(harness, Client::JsonBackend::SIMDJSON, corpus);
+    bench_parse_payload(harness, corpus);
+
+    bench_send(harness);
+    bench_rest_body(harness);
+
+    bench_event_dispatch(harness, "string-chain", dispatch_chain);
+    bench_event_dispatch(harness, "table", dispatch_table);
+    bench_executor(harness);
+
+    return harness.finish();
+}
@@ -5,6 +5,7 @@
 #include <csignal>
 
 #include <client.hpp>
+#include <utils/log.hpp>
 
 #include <fmt/printf.h>
 
@@ -48,10 +49,15 @@ int main(int argc, char **argv)
         token = std::string(buffer.data(), buffer.size());
     }
 
+    Utils::Logger::instance().open("./misaka-oneesama.log");
+
     try {
         client = std::make_unique<Discord::Client>(token);
-        return client->exec();
+        const auto ret = client->exec();
+        Utils::Logger::instance().flush();
+        return ret;
     } catch (std::exception &e) {
+        Utils::Logger::instance().flush();
         fmt::print("{}\n", e.what());
         return 50;
     }
@@ -0,0 +1,614 @@
+#include "cache.hpp"
+#include "utils/json.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+DISCORD_NS_BEGIN
+
+namespace
+{
+
+// logging tag
+static constexpr std::string_view TAG("Cache");
+
+// heap memory owned by a string beyond the small string buffer
+static inline std::size_t heap_size(const std::string &str)
+{
+    return str.capacity() > 15 ? str.capacity() + 1 : 0;
+}
+
+static inline std::size_t heap_size(const std::vector<Snowflake> &ids)
+{
+    return ids.capacity() * sizeof(Snowflake);
+}
+
+static inline std::size_t heap_size(const User &user)
+{
+    return heap_size(user.username) + heap_size(user.discriminator) + heap_size(user.avatar) +
+           heap_size(user.locale) + heap_size(user.email);
+}
+
+static inline std::size_t heap_size(const Channel &channel)
+{
+    auto size = heap_size(channel.name) + heap_size(channel.topic) + heap_size(channel.icon) + heap_size(channel.last_pin_timestamp);
+    size += channel.overwrites.capacity() * sizeof(ChannelPermissionOverwrite);
+    for (auto&& overwrite : channel.overwrites)
+    {
+        size += heap_size(overwrite.type);
+    }
+    size += channel.recipients.capacity() * sizeof(User);
+    for (auto&& recipient : channel.recipients)
+    {
+        size += heap_size(recipient);
+    }
+    return size;
+}
+
+static inline std::size_t heap_size(const Role &role)
+{
+    return heap_size(role.name);
+}
+
+static inline std::size_t heap_size(const Member &member)
+{
+    return heap_size(member.nick) + heap_size(member.roles) + heap_size(member.joined_at) + heap_size(member.premium_since);
+}
+
+static inline std::size_t heap_size(const Guild &guild)
+{
+    return heap_size(guild.name) + heap_size(guild.icon) + heap_size(guild.region) + heap_size(guild.roles) + heap_size(guild.channels);
+}
+
+// adds an id to an id list of a guild copy
+template<typename Member>
+static inline std::shared_ptr<const Guild> with_id(const Guild *guild, Member member, Snowflake id)
+{
+    if (!guild)
+    {
+        return nullptr;
+    }
+
+    auto copy = std::make_shared<Guild>(*guild);
+    auto &ids = (*copy).*member;
+    if (std::find(ids.begin(), ids.end(), id) == ids.end())
+    {
+        ids.emplace_back(id);
+    }
+    return copy;
+}
+
+// removes an id from an id list of a guild copy
+template<typename Member>
+static inline std::shared_ptr<const Guild> without_id(const Guild *guild, Member member, Snowflake id)
+{
+    if (!guild)
+    {
+        return nullptr;
+    }
+
+    auto copy = std::make_shared<Guild>(*guild);
+    auto &ids = (*copy).*member;
+    ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+    return copy;
+}
+
+} // anonymous namespace
+
+std::shared_ptr<const Guild> Cache::guild(Snowflake id) const
+{
+    if (auto guild = this->_guilds.get(id))
+    {
+        return guild;
+    }
+    return this->_has_snapshot.load(std::memory_order_relaxed) ? this->warm(this->_guilds, Snapshot::Kind::GUILD, id) : nullptr;
+}
+
+std::shared_ptr<const Channel> Cache::channel(Snowflake id) const
+{
+    if (auto channel = this->_channels.get(id))
+    {
+        return channel;
+    }
+    return this->_has_snapshot.load(std::memory_order_relaxed) ? this->warm(this->_channels, Snapshot::Kind::CHANNEL, id) : nullptr;
+}
+
+std::shared_ptr<const Role> Cache::role(Snowflake id) const
+{
+    if (auto role = this->_roles.get(id))
+    {
+        return role;
+    }
+    return this->_has_snapshot.load(std::memory_order_relaxed) ? this->warm(this->_roles, Snapshot::Kind::ROLE, id) : nullptr;
+}
+
+std::shared_ptr<const Member> Cache::member(Snowflake guild_id, Snowflake user_id) const
+{
+    return this->_members.get({guild_id, user_id});
+}
+
+std::shared_ptr<const User> Cache::user(Snowflake id) const
+{
+    if (auto user = this->_users.get(id))
+    {
+        return user;
+    }
+    return this->_has_snapshot.load(std::memory_order_relaxed) ? this->warm(this->_users, Snapshot::Kind::USER, id) : nullptr;
+}
+
+Cache::Stats Cache::stats() const
+{
+    Stats stats;
+
+    this->_guilds.collect(stats.guilds, stats.memory, stats.hits, stats.misses);
+    this->_channels.collect(stats.channels, stats.memory, stats.hits, stats.misses);
+    this->_roles.collect(stats.roles, stats.memory, stats.hits, stats.misses);
+    this->_members.collect(stats.members, stats.memory, stats.hits, stats.misses);
+    stats.memory += this->_member_index.memory_usage();
+    this->_users.collect(stats.users, stats.memory, stats.hits, stats.misses);
+
+    // entities are allocated together with the shared pointer control block
+    static constexpr std::size_t CONTROL_BLOCK = 16;
+
+    const auto add = [&](const auto&, const auto &entity) {
+        stats.memory += CONTROL_BLOCK + sizeof(entity) + heap_size(entity);
+    };
+    this->_guilds.for_each(add);
+    this->_channels.for_each(add);
+    this->_roles.for_each(add);
+    this->_members.for_each(add);
+    this->_users.for_each(add);
+
+    if (const auto snapshot = this->snapshot())
+    {
+        for (std::size_t i = 0; i < Snapshot::KINDS; ++i)
+        {
+            stats.snapshot += snapshot->size(static_cast<Snapshot::Kind>(i));
+        }
+    }
+    stats.warm_hits = this->_warm_hits.load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+void Cache::update(Event event, const json &data)
+{
+    using Utils::get_json_value;
+
+    if (event == Event::GUILD_CREATE)
+    {
+        auto guild = std::make_shared<Guild>(data.get<Guild>());
+
+        // channels and roles removed while the bot was offline are still known from the snapshot
+        const auto previous = this->current(this->_guilds, Snapshot::Kind::GUILD, guild->id);
+
+        if (const auto channels = data.find("channels"); channels != data.end() && channels->is_array())
+        {
+            for (auto&& j : *channels)
+            {
+                // channels of GUILD_CREATE don't contain the guild id
+                auto channel = std::make_shared<Channel>(j.get<Channel>());
+                channel->guild_id = guild->id;
+                const auto channel_id = channel->id;
+                this->_channels.put(channel_id, std::move(channel));
+            }
+        }
+
+        if (const auto roles = data.find("roles"); roles != data.end() && roles->is_array())
+        {
+            for (auto&& j : *roles)
+            {
+                auto role = std::make_shared<Role>(j.get<Role>());
+                const auto role_id = role->id;
+                this->_roles.put(role_id, std::move(role));
+            }
+        }
+
+        if (const auto members = data.find("members"); members != data.end() && members->is_array())
+        {
+            for (auto&& j : *members)
+            {
+                this->put_member(guild->id, j);
+            }
+        }
+
+        if (previous)
+        {
+            for (auto&& id : previous->channels)
+            {
+                if (std::find(guild->channels.begin(), guild->channels.end(), id) == guild->channels.end())
+                {
+                    this->_channels.erase(id);
+                }
+            }
+            for (auto&& id : previous->roles)
+            {
+                if (std::find(guild->roles.begin(), guild->roles.end(), id) == guild->roles.end())
+                {
+                    this->_roles.erase(id);
+                }
+            }
+        }
+
+        const auto guild_id = guild->id;
+        this->_guilds.put(guild_id, std::move(guild));
+    }
+    else if (event == Event::GUILD_UPDATE)
+    {
+        auto guild = std::make_shared<Guild>(data.get<Guild>());
+
+        if (const auto roles = data.find("roles"); roles != data.end() && roles->is_array())
+        {
+            for (auto&& j : *roles)
+            {
+                auto role = std::make_shared<Role>(j.get<Role>());
+                const auto role_id = role->id;
+                this->_roles.put(role_id, std::move(role));
+            }
+        }
+
+        // GUILD_UPDATE contains neither the channels nor the member count
+        this->current(this->_guilds, Snapshot::Kind::GUILD, guild->id);
+        this->_guilds.update(guild->id, [&](const Guild *current) {
+            if (current)
+            {
+                guild->channels = current->channels;
+                guild->member_count = current->member_count;
+            }
+            return guild;
+        });
+    }
+    else if (event == Event::GUILD_DELETE)
+    {
+        const auto id = get_json_value<Snowflake>(data, "id");
+        const auto guild = this->current(this->_guilds, Snapshot::Kind::GUILD, id);
+
+        // the guild became unavailable due to an outage, the bot is still a member
+        if (get_json_value<bool>(data, "unavailable"))
+        {
+            this->_guilds.update(id, [](const Guild *current) -> std::shared_ptr<const Guild> {
+                if (!current)
+                {
+                    return nullptr;
+                }
+                auto copy = std::make_shared<Guild>(*current);
+                copy->unavailable = true;
+                return copy;
+            });
+            return;
+        }
+
+        if (guild)
+        {
+            for (auto&& channel : guild->channels)
+            {
+                this->_channels.erase(channel);
+            }
+            for (auto&& role : guild->roles)
+            {
+                this->_roles.erase(role);
+            }
+        }
+        for (auto&& user_id : this->_member_index.take(id))
+        {
+            this->_members.erase({id, user_id});
+        }
+        this->_guilds.erase(id);
+    }
+    else if (event == Event::CHANNEL_CREATE || event == Event::CHANNEL_UPDATE)
+    {
+        auto channel = std::make_shared<Channel>(data.get<Channel>());
+
+        if (channel->guild_id)
+        {
+            this->current(this->_guilds, Snapshot::Kind::GUILD, channel->guild_id);
+            this->_guilds.update(channel->guild_id, [&](const Guild *guild) {
+                return with_id(guild, &Guild::channels, channel->id);
+            });
+        }
+
+        const auto channel_id = channel->id;
+        this->_channels.put(channel_id, std::move(channel));
+    }
+    else if (event == Event::CHANNEL_DELETE)
+    {
+        const auto id = get_json_value<Snowflake>(data, "id");
+        const auto guild_id = get_json_value<Snowflake>(data, "guild_id");
+
+        if (guild_id)
+        {
+            this->current(this->_guilds, Snapshot::Kind::GUILD, guild_id);
+            this->_guilds.update(guild_id, [&](const Guild *guild) {
+                return without_id(guild, &Guild::channels, id);
+            });
+        }
+
+        this->_channels.erase(id);
+    }
+    else if (event == Event::GUILD_MEMBER_ADD)
+    {
+        const auto guild_id = get_json_value<Snowflake>(data, "guild_id");
+        this->put_member(guild_id, data);
+
+        this->current(this->_guilds, Snapshot::Kind::GUILD, guild_id);
+        this->_guilds.update(guild_id, [](const Guild *guild) -> std::shared_ptr<const Guild> {
+            if (!guild)
+            {
+                return nullptr;
+            }
+            auto copy = std::make_shared<Guild>(*guild);
+            ++copy->member_count;
+            return copy;
+        });
+    }
+    else if (event == Event::GUILD_MEMBER_UPDATE)
+    {
+        auto member = std::make_shared<Member>(data.get<Member>());
+
+        if (const auto user = data.find("user"); user != data.end())
+        {
+            this->put_user(*user);
+        }
+
+        // the update does not contain the voice state
+        const MemberKey key{member->guild_id, member->user_id};
+        this->_members.update(key, [&](const Member *current) {
+            if (current)
+            {
+                member->deaf = current->deaf;
+                member->mute = current->mute;
+            }
+            return member;
+        });
+        this->_member_index.add(key);
+    }
+    else if (event == Event::GUILD_MEMBER_REMOVE)
+    {
+        const auto guild_id = get_json_value<Snowflake>(data, "guild_id");
+        const auto user = data.find("user");
+        if (user == data.end())
+        {
+            return;
+        }
+
+        const MemberKey key{guild_id, get_json_value<Snowflake>(*user, "id")};
+        this->_members.erase(key);
+        this->_member_index.remove(key);
+
+        this->current(this->_guilds, Snapshot::Kind::GUILD, guild_id);
+        this->_guilds.update(guild_id, [](const Guild *guild) -> std::shared_ptr<const Guild> {
+            if (!guild)
+            {
+                return nullptr;
+            }
+            auto copy = std::make_shared<Guild>(*guild);
+            copy->member_count = std::max(copy->member_count - 1, 0);
+            return copy;
+        });
+    }
+    else if (event == Event::GUILD_MEMBERS_CHUNK)
+    {
+        const auto guild_id = get_json_value<Snowflake>(data, "guild_id");
+
+        if (const auto members = data.find("members"); members != data.end() && members->is_array())
+        {
+            for (auto&& j : *members)
+            {
+                this->put_member(guild_id, j);
+            }
+        }
+    }
+    else if (event == Event::GUILD_ROLE_CREATE || event == Event::GUILD_ROLE_UPDATE)
+    {
+        const auto guild_id = get_json_value<Snowflake>(data, "guild_id");
+        const auto j = data.find("role");
+        if (j == data.end())
+        {
+            return;
+        }
+
+        auto role = std::make_shared<Role>(j->get<Role>());
+
+        this->current(this->_guilds, Snapshot::Kind::GUILD, guild_id);
+        this->_guilds.update(guild_id, [&](const Guild *guild) {
+            return with_id(guild, &Guild::roles, role->id);
+        });
+
+        const auto role_id = role->id;
+        this->_roles.put(role_id, std::move(role));
+    }
+    else if (event == Event::GUILD_ROLE_DELETE)
+    {
+        const auto guild_id = get_json_value<Snowflake>(data, "guild_id");
+        const auto id = get_json_value<Snowflake>(data, "role_id");
+
+        this->current(this->_guilds, Snapshot::Kind::GUILD, guild_id);
+        this->_guilds.update(guild_id, [&](const Guild *guild) {
+            return without_id(guild, &Guild::roles, id);
+        });
+
+        this->_roles.erase(id);
+    }
+    else if (event == Event::USER_UPDATE)
+    {
+        this->put_user(data);
+    }
+}
+
+void Cache::clear()
+{
+    {
+        std::lock_guard lk{this->_snapshot_mutex};
+        this->_snapshot.reset();
+        this->_has_snapshot = false;
+    }
+
+    this->_guilds.clear();
+    this->_channels.clear();
+    this->_roles.clear();
+    this->_members.clear();
+    this->_member_index.clear();
+    this->_users.clear();
+}
+
+bool Cache::load_snapshot(const std::string &path)
+{
+    std::shared_ptr<const Snapshot> snapshot;
+    try {
+        snapshot = std::make_shared<const Snapshot>(path);
+    } catch (const std::exception &e) {
+        Utils::log_warning(TAG, "not loading the snapshot: {}", e.what());
+        return false;
+    }
+
+    // removals are tracked from now on, so they are not undone by the snapshot
+    this->_guilds.start_journal();
+    this->_channels.start_journal();
+    this->_roles.start_journal();
+    this->_users.start_journal();
+
+    Utils::log_info(TAG, "loaded snapshot {}: {} guilds, {} channels, {} roles, {} users", path,
+        snapshot->size(Snapshot::Kind::GUILD), snapshot->size(Snapshot::Kind::CHANNEL),
+        snapshot->size(Snapshot::Kind::ROLE), snapshot->size(Snapshot::Kind::USER));
+
+    std::lock_guard lk{this->_snapshot_mutex};
+    this->_snapshot = std::move(snapshot);
+    this->_has_snapshot = true;
+    return true;
+}
+
+bool Cache::save_snapshot(const std::string &path)
+{
+    // without a previous snapshot all entities are written, changes made meanwhile are journaled for the next one
+    const auto base = this->snapshot();
+    if (!base)
+    {
+        this->_guilds.start_journal();
+        this->_channels.start_journal();
+        this->_roles.start_journal();
+        this->_users.start_journal();
+    }
+
+    std::array<std::vector<Snowflake>, Snapshot::KINDS> changes;
+    if (base)
+    {
+        changes[static_cast<std::size_t>(Snapshot::Kind::GUILD)] = this->_guilds.take_changes();
+        changes[static_cast<std::size_t>(Snapshot::Kind::CHANNEL)] = this->_channels.take_changes();
+        changes[static_cast<std::size_t>(Snapshot::Kind::ROLE)] = this->_roles.take_changes();
+        changes[static_cast<std::size_t>(Snapshot::Kind::USER)] = this->_users.take_changes();
+    }
+
+    bool saved = false;
+    try {
+        Snapshot::Builder builder(path);
+        this->save_store(builder, base.get(), this->_guilds, Snapshot::Kind::GUILD, changes[static_cast<std::size_t>(Snapshot::Kind::GUILD)]);
+        this->save_store(builder, base.get(), this->_channels, Snapshot::Kind::CHANNEL, changes[static_cast<std::size_t>(Snapshot::Kind::CHANNEL)]);
+        this->save_store(builder, base.get(), this->_roles, Snapshot::Kind::ROLE, changes[static_cast<std::size_t>(Snapshot::Kind::ROLE)]);
+        this->save_store(builder, base.get(), this->_users, Snapshot::Kind::USER, changes[static_cast<std::size_t>(Snapshot::Kind::USER)]);
+        saved = builder.commit();
+    } catch (const std::exception &e) {
+        Utils::log_warning(TAG, "failed to write the snapshot: {}", e.what());
+    }
+
+    std::shared_ptr<const Snapshot> snapshot;
+    if (saved)
+    {
+        try {
+            snapshot = std::make_shared<const Snapshot>(path);
+        } catch (const std::exception &e) {
+            Utils::log_warning(TAG, "failed to map the written snapshot: {}", e.what());
+        }
+    }
+
+    // the changes are written with the next snapshot
+    if (!snapshot)
+    {
+        this->_guilds.restore_changes(changes[static_cast<std::size_t>(Snapshot::Kind::GUILD)]);
+        this->_channels.restore_changes(changes[static_cast<std::size_t>(Snapshot::Kind::CHANNEL)]);
+        this->_roles.restore_changes(changes[static_cast<std::size_t>(Snapshot::Kind::ROLE)]);
+        this->_users.restore_changes(changes[static_cast<std::size_t>(Snapshot::Kind::USER)]);
+        return false;
+    }
+
+    // the new snapshot contains everything of the old one, lookups continue from it
+    std::lock_guard lk{this->_snapshot_mutex};
+    this->_snapshot = std::move(snapshot);
+    this->_has_snapshot = true;
+    return true;
+}
+
+std::shared_ptr<const Snapshot> Cache::snapshot() const
+{
+    std::lock_guard lk{this->_snapshot_mutex};
+    return this->_snapshot;
+}
+
+template<typename T>
+void Cache::save_store(Snapshot::Builder &builder, const Snapshot *base, Store<Snowflake, T> &store, Snapshot::Kind kind,
+                       const std::vector<Snowflake> &changes)
+{
+    std::string record;
+
+    if (!base)
+    {
+        store.for_each([&](const Snowflake &id, const T &entity) {
+            record.clear();
+            Snapshot::encode(record, entity);
+            builder.add(kind, id, record);
+        });
+        return;
+    }
+
+    // unchanged entities are copied as they are, they don't need to be cached
+    base->for_each(kind, [&](Snowflake id, std::string_view data) {
+        if (!std::binary_search(changes.begin(), changes.end(), id))
+        {
+            builder.add(kind, id, data);
+        }
+    });
+
+    // changed entities which still exist are encoded again
+    for (auto&& id : changes)
+    {
+        if (const auto entity = store.peek(id))
+        {
+            record.clear();
+            Snapshot::encode(record, *entity);
+            builder.add(kind, id, record);
+        }
+    }
+}
+
+void Cache::put_member(Snowflake guild_id, const json &data)
+{
+    auto member = std::make_shared<Member>(data.get<Member>());
+    member->guild_id = guild_id;
+
+    if (const auto user = data.find("user"); user != data.end())
+    {
+        this->put_user(*user);
+    }
+
+    if (member->user_id)
+    {
+        const MemberKey key{guild_id, member->user_id};
+        this->_members.put(key, std::move(member));
+        this->_member_index.add(key);
+    }
+}
+
+void Cache::put_user(const json &data)
+{
+    auto user = std::make_shared<User>(data.get<User>());
+    if (*user)
+    {
+        const auto user_id = user->id;
+        this->_users.put(user_id, std::move(user));
+    }
+}
+
+DISCORD_NS_END
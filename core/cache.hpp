@@ -0,0 +1,551 @@
+#ifndef DISCORD_CACHE_HPP
+#define DISCORD_CACHE_HPP
+
+#include "config.hpp"
+#include "event.hpp"
+#include "snowflake.hpp"
+#include "channel.hpp"
+#include "user.hpp"
+#include "guild.hpp"
+#include "snapshot.hpp"
+#include "utils/flat_map.hpp"
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+#include <nlohmann/json_fwd.hpp>
+
+DISCORD_NS_BEGIN
+
+/**
+ * Entity cache
+ *
+ * Holds the guilds, channels, roles, members and users the bot can see.
+ * It is populated from GUILD_CREATE and kept current from the CHANNEL_*,
+ * GUILD_MEMBER_* and GUILD_ROLE_* events.
+ *
+ * Entities are immutable once cached, updates replace them. Lookups return
+ * a shared pointer which stays valid even when the entity is replaced or
+ * removed in the meantime. Each entity type is kept in flat hash maps split
+ * into lock stripes, readers only take a shared lock of a single stripe for
+ * the duration of the lookup.
+ *
+ * Guilds, channels, roles and users can be saved to a snapshot. A loaded
+ * snapshot answers lookups of entities the gateway did not send yet, they
+ * are decoded on first access. Entities removed by gateway events are never
+ * taken from the snapshot.
+ */
+class Cache
+{
+public:
+    /**
+     * Cache statistics
+     */
+    struct Stats
+    {
+        std::size_t guilds = 0;
+        std::size_t channels = 0;
+        std::size_t roles = 0;
+        std::size_t members = 0;
+        std::size_t users = 0;
+        std::size_t memory = 0;     // estimated memory usage in bytes
+        std::uint64_t hits = 0;     // lookups which found an entity
+        std::uint64_t misses = 0;   // lookups which found nothing
+        std::size_t snapshot = 0;   // entities in the loaded snapshot
+        std::uint64_t warm_hits = 0;// lookups answered from the snapshot
+    };
+
+    std::shared_ptr<const Guild> guild(Snowflake id) const;
+    std::shared_ptr<const Channel> channel(Snowflake id) const;
+    std::shared_ptr<const Role> role(Snowflake id) const;
+    std::shared_ptr<const Member> member(Snowflake guild_id, Snowflake user_id) const;
+    std::shared_ptr<const User> user(Snowflake id) const;
+
+    /**
+     * Current amount of entities, memory usage and lookup counters.
+     */
+    Stats stats() const;
+
+    /**
+     * Whether the cache consumes the given gateway event.
+     */
+    static constexpr bool handles(Event event)
+    {
+        switch (event)
+        {
+            case Event::GUILD_CREATE:
+            case Event::GUILD_UPDATE:
+            case Event::GUILD_DELETE:
+            case Event::CHANNEL_CREATE:
+            case Event::CHANNEL_UPDATE:
+            case Event::CHANNEL_DELETE:
+            case Event::GUILD_MEMBER_ADD:
+            case Event::GUILD_MEMBER_UPDATE:
+            case Event::GUILD_MEMBER_REMOVE:
+            case Event::GUILD_MEMBERS_CHUNK:
+            case Event::GUILD_ROLE_CREATE:
+            case Event::GUILD_ROLE_UPDATE:
+            case Event::GUILD_ROLE_DELETE:
+            case Event::USER_UPDATE:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * Applies a gateway event to the cache.
+     */
+    void update(Event event, const nlohmann::json &data);
+
+    /**
+     * Clears the cache and drops the loaded snapshot.
+     */
+    void clear();
+
+    /**
+     * Loads a snapshot written by save_snapshot(), lookups of entities which
+     * are not cached are answered from it. Returns false when the file is
+     * missing or not a valid snapshot.
+     */
+    bool load_snapshot(const std::string &path);
+
+    /**
+     * Writes the guilds, channels, roles and users to a snapshot file. Only
+     * entities changed since the previous snapshot are encoded, the others
+     * are copied from it. The file is replaced atomically.
+     */
+    bool save_snapshot(const std::string &path);
+
+private:
+    /**
+     * Striped concurrent map from id to an immutable entity.
+     */
+    template<typename Key, typename T, typename Hash = std::hash<Key>>
+    class Store
+    {
+    public:
+        using Ptr = std::shared_ptr<const T>;
+
+        Ptr get(const Key &key) const
+        {
+            auto &stripe = this->stripe(key);
+            std::shared_lock lk{stripe.mutex};
+
+            if (const auto value = stripe.map.find(key))
+            {
+                stripe.hits.fetch_add(1, std::memory_order_relaxed);
+                return *value;
+            }
+
+            stripe.misses.fetch_add(1, std::memory_order_relaxed);
+            return {};
+        }
+
+        /**
+         * Like get(), without counting the lookup.
+         */
+        Ptr peek(const Key &key) const
+        {
+            auto &stripe = this->stripe(key);
+            std::shared_lock lk{stripe.mutex};
+
+            const auto value = stripe.map.find(key);
+            return value ? *value : nullptr;
+        }
+
+        void put(const Key &key, Ptr value)
+        {
+            this->changed(key, false);
+
+            auto &stripe = this->stripe(key);
+            std::unique_lock lk{stripe.mutex};
+            stripe.map.insert_or_assign(key, std::move(value));
+        }
+
+        /**
+         * Inserts the value unless the key exists or allowed() returns false, returns the cached value.
+         */
+        template<typename Predicate>
+        Ptr insert_if(const Key &key, Ptr value, Predicate &&allowed)
+        {
+            auto &stripe = this->stripe(key);
+            std::unique_lock lk{stripe.mutex};
+
+            if (const auto current = stripe.map.find(key))
+            {
+                return *current;
+            }
+
+            if (!allowed())
+            {
+                return nullptr;
+            }
+
+            stripe.map.insert_or_assign(key, value);
+            return value;
+        }
+
+        void erase(const Key &key)
+        {
+            // recorded first, a concurrent insert_if() sees the removal or is erased here
+            this->changed(key, true);
+
+            auto &stripe = this->stripe(key);
+            std::unique_lock lk{stripe.mutex};
+            stripe.map.erase(key);
+        }
+
+        /**
+         * Replaces the entity with fn(current), current is nullptr when the
+         * key does not exist. Returning nullptr removes the entity.
+         */
+        template<typename Function>
+        void update(const Key &key, Function &&fn)
+        {
+            auto &stripe = this->stripe(key);
+            std::unique_lock lk{stripe.mutex};
+
+            const auto current = stripe.map.find(key);
+            Ptr next = fn(current ? current->get() : nullptr);
+
+            if (next || current)
+            {
+                this->changed(key, !next);
+            }
+
+            if (next)
+            {
+                stripe.map.insert_or_assign(key, std::move(next));
+            }
+            else if (current)
+            {
+                stripe.map.erase(key);
+            }
+        }
+
+        template<typename Function>
+        void for_each(Function &&fn) const
+        {
+            for (auto&& stripe : this->_stripes)
+            {
+                std::shared_lock lk{stripe.mutex};
+                stripe.map.for_each([&](const Key &key, const Ptr &value) {
+                    fn(key, *value);
+                });
+            }
+        }
+
+        void clear()
+        {
+            for (auto&& stripe : this->_stripes)
+            {
+                std::unique_lock lk{stripe.mutex};
+                stripe.map.clear();
+            }
+
+            std::lock_guard lk{this->_journal_mutex};
+            this->_changes.clear();
+            this->_removed.clear();
+        }
+
+        /**
+         * Records changed and removed keys from now on.
+         */
+        void start_journal()
+        {
+            this->_journal.store(true, std::memory_order_relaxed);
+        }
+
+        /**
+         * Keys changed since the last call, sorted and without duplicates.
+         */
+        std::vector<Key> take_changes()
+        {
+            std::vector<Key> changes;
+            {
+                std::lock_guard lk{this->_journal_mutex};
+                changes.swap(this->_changes);
+            }
+
+            std::sort(changes.begin(), changes.end());
+            changes.erase(std::unique(changes.begin(), changes.end()), changes.end());
+            return changes;
+        }
+
+        /**
+         * Records the keys as changed again, for example when they could not be saved.
+         */
+        void restore_changes(const std::vector<Key> &changes)
+        {
+            std::lock_guard lk{this->_journal_mutex};
+            this->_changes.insert(this->_changes.end(), changes.begin(), changes.end());
+        }
+
+        /**
+         * Whether the key was removed since journaling started.
+         */
+        bool removed(const Key &key) const
+        {
+            std::lock_guard lk{this->_journal_mutex};
+            return this->_removed.contains(key);
+        }
+
+        void collect(std::size_t &size, std::size_t &memory, std::uint64_t &hits, std::uint64_t &misses) const
+        {
+            for (auto&& stripe : this->_stripes)
+            {
+                std::shared_lock lk{stripe.mutex};
+                size += stripe.map.size();
+                memory += stripe.map.memory_usage();
+                hits += stripe.hits.load(std::memory_order_relaxed);
+                misses += stripe.misses.load(std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        static constexpr std::size_t STRIPES = 16;
+
+        struct alignas(64) Stripe
+        {
+            mutable std::shared_mutex mutex;
+            Utils::FlatMap<Key, Ptr, Hash> map;
+            mutable std::atomic<std::uint64_t> hits = 0;
+            mutable std::atomic<std::uint64_t> misses = 0;
+        };
+
+        std::array<Stripe, STRIPES> _stripes;
+
+        std::atomic<bool> _journal = false;
+        mutable std::mutex _journal_mutex;
+        std::vector<Key> _changes;
+        Utils::FlatMap<Key, bool, Hash> _removed;
+
+        void changed(const Key &key, bool removed)
+        {
+            if (!this->_journal.load(std::memory_order_relaxed))
+            {
+                return;
+            }
+
+            std::lock_guard lk{this->_journal_mutex};
+            this->_changes.emplace_back(key);
+            if (removed)
+            {
+                this->_removed.insert_or_assign(key, true);
+            }
+            else
+            {
+                this->_removed.erase(key);
+            }
+        }
+
+        inline Stripe &stripe(const Key &key)
+        {
+            return this->_stripes[index(key)];
+        }
+
+        inline const Stripe &stripe(const Key &key) const
+        {
+            return this->_stripes[index(key)];
+        }
+
+        static inline std::size_t index(const Key &key)
+        {
+            // use the upper bits, the maps use the lower ones
+            return static_cast<std::size_t>((static_cast<std::uint64_t>(Hash{}(key)) * 0xC2B2AE3D27D4EB4Full) >> 60) % STRIPES;
+        }
+    };
+
+    // members are cached per guild
+    struct MemberKey
+    {
+        Snowflake guild_id;
+        Snowflake user_id;
+
+        constexpr bool operator== (const MemberKey&) const = default;
+    };
+
+    struct MemberKeyHash
+    {
+        inline std::size_t operator() (const MemberKey &key) const noexcept
+        {
+            return static_cast<std::size_t>(key.guild_id.value() * 31 + key.user_id.value());
+        }
+    };
+
+    /**
+     * User ids of the cached members by guild, removing a guild only touches
+     * its own members instead of scanning all of them. Members of a guild
+     * are only changed by the events of its shard, in order.
+     */
+    class MemberIndex
+    {
+    public:
+        void add(const MemberKey &key)
+        {
+            auto &stripe = this->stripe(key.guild_id);
+            std::lock_guard lk{stripe.mutex};
+
+            if (auto users = stripe.guilds.find(key.guild_id))
+            {
+                users->insert_or_assign(key.user_id, true);
+                return;
+            }
+
+            Utils::FlatMap<Snowflake, bool> users;
+            users.insert_or_assign(key.user_id, true);
+            stripe.guilds.insert_or_assign(key.guild_id, std::move(users));
+        }
+
+        void remove(const MemberKey &key)
+        {
+            auto &stripe = this->stripe(key.guild_id);
+            std::lock_guard lk{stripe.mutex};
+
+            if (auto users = stripe.guilds.find(key.guild_id); users && users->erase(key.user_id) && users->size() == 0)
+            {
+                stripe.guilds.erase(key.guild_id);
+            }
+        }
+
+        /**
+         * Removes the guild from the index and returns the user ids of its members.
+         */
+        std::vector<Snowflake> take(Snowflake guild_id)
+        {
+            std::vector<Snowflake> user_ids;
+
+            auto &stripe = this->stripe(guild_id);
+            std::lock_guard lk{stripe.mutex};
+
+            if (const auto users = stripe.guilds.find(guild_id))
+            {
+                user_ids.reserve(users->size());
+                users->for_each([&](const Snowflake &user_id, bool) {
+                    user_ids.emplace_back(user_id);
+                });
+                stripe.guilds.erase(guild_id);
+            }
+
+            return user_ids;
+        }
+
+        void clear()
+        {
+            for (auto&& stripe : this->_stripes)
+            {
+                std::lock_guard lk{stripe.mutex};
+                stripe.guilds.clear();
+            }
+        }
+
+        std::size_t memory_usage() const
+        {
+            std::size_t memory = 0;
+            for (auto&& stripe : this->_stripes)
+            {
+                std::lock_guard lk{stripe.mutex};
+                memory += stripe.guilds.memory_usage();
+                stripe.guilds.for_each([&](const Snowflake&, const Utils::FlatMap<Snowflake, bool> &users) {
+                    memory += users.memory_usage();
+                });
+            }
+            return memory;
+        }
+
+    private:
+        static constexpr std::size_t STRIPES = 16;
+
+        struct alignas(64) Stripe
+        {
+            mutable std::mutex mutex;
+            Utils::FlatMap<Snowflake, Utils::FlatMap<Snowflake, bool>> guilds;
+        };
+
+        std::array<Stripe, STRIPES> _stripes;
+
+        inline Stripe &stripe(Snowflake guild_id)
+        {
+            return this->_stripes[static_cast<std::size_t>((guild_id.value() * 0xC2B2AE3D27D4EB4Full) >> 60) % STRIPES];
+        }
+    };
+
+    // entities taken from the snapshot are inserted on lookup
+    mutable Store<Snowflake, Guild> _guilds;
+    mutable Store<Snowflake, Channel> _channels;
+    mutable Store<Snowflake, Role> _roles;
+    Store<MemberKey, Member, MemberKeyHash> _members;
+    MemberIndex _member_index;
+    mutable Store<Snowflake, User> _users;
+
+    // the loaded or last saved snapshot
+    mutable std::mutex _snapshot_mutex;
+    std::shared_ptr<const Snapshot> _snapshot;
+    std::atomic<bool> _has_snapshot = false;
+    mutable std::atomic<std::uint64_t> _warm_hits = 0;
+
+    std::shared_ptr<const Snapshot> snapshot() const;
+
+    /**
+     * Decodes the entity from the snapshot and caches it, unless it was removed since.
+     */
+    template<typename T>
+    std::shared_ptr<const T> warm(Store<Snowflake, T> &store, Snapshot::Kind kind, Snowflake id) const
+    {
+        const auto snapshot = this->snapshot();
+        const auto record = snapshot ? snapshot->find(kind, id) : std::string_view{};
+        if (record.empty())
+        {
+            return nullptr;
+        }
+
+        auto entity = std::make_shared<T>();
+        if (!Snapshot::decode(record, *entity))
+        {
+            return nullptr;
+        }
+
+        auto cached = store.insert_if(id, std::move(entity), [&]{
+            return !store.removed(id);
+        });
+        if (cached)
+        {
+            this->_warm_hits.fetch_add(1, std::memory_order_relaxed);
+        }
+        return cached;
+    }
+
+    /**
+     * Cached entity, taken from the snapshot when needed, lookups are not counted.
+     */
+    template<typename T>
+    std::shared_ptr<const T> current(Store<Snowflake, T> &store, Snapshot::Kind kind, Snowflake id) const
+    {
+        if (auto value = store.peek(id))
+        {
+            return value;
+        }
+        return this->_has_snapshot.load(std::memory_order_relaxed) ? this->warm(store, kind, id) : nullptr;
+    }
+
+    template<typename T>
+    void save_store(Snapshot::Builder &builder, const Snapshot *base, Store<Snowflake, T> &store, Snapshot::Kind kind,
+                    const std::vector<Snowflake> &changes);
+
+    void put_member(Snowflake guild_id, const nlohmann::json &data);
+    void put_user(const nlohmann::json &data);
+};
+
+DISCORD_NS_END
+
+#endif // DISCORD_CACHE_HPP
@@ -1 +1,55 @@
 #include "channel.hpp"
+#include "utils/json.hpp"
+
+DISCORD_NS_BEGIN
+
+namespace
+{
+
+// permission bit sets are strings since API v8, numbers before
+static inline int get_permissions(const nlohmann::json &j, const std::string &key)
+{
+    const auto it = j.find(key);
+    if (it != j.end() && it->is_string())
+    {
+        return static_cast<int>(std::strtoll(it->get_ref<const std::string&>().c_str(), nullptr, 10));
+    }
+
+    return Utils::get_json_value<int>(j, key);
+}
+
+} // anonymous namespace
+
+void from_json(const nlohmann::json &j, ChannelPermissionOverwrite &overwrite)
+{
+    overwrite.id = Utils::get_json_value<Snowflake>(j, "id");
+    overwrite.type = Utils::get_json_value<std::string>(j, "type");
+    overwrite.allow = get_permissions(j, "allow");
+    overwrite.deny = get_permissions(j, "deny");
+}
+
+void from_json(const nlohmann::json &j, Channel &channel)
+{
+    using Utils::get_json_value;
+
+    channel.id = get_json_value<Snowflake>(j, "id");
+    channel.type = static_cast<ChannelType>(get_json_value<int>(j, "type"));
+    channel.guild_id = get_json_value<Snowflake>(j, "guild_id");
+    channel.position = j.contains("position") ? get_json_value<int>(j, "position") : -1;
+    channel.overwrites = get_json_value<std::vector<ChannelPermissionOverwrite>>(j, "permission_overwrites");
+    channel.name = get_json_value<std::string>(j, "name");
+    channel.topic = get_json_value<std::string>(j, "topic");
+    channel.nsfw = get_json_value<bool>(j, "nsfw");
+    channel.last_message_id = get_json_value<Snowflake>(j, "last_message_id");
+    channel.bitrate = j.contains("bitrate") ? get_json_value<int>(j, "bitrate") : -1;
+    channel.user_limit = j.contains("user_limit") ? get_json_value<int>(j, "user_limit") : -1;
+    channel.rate_limit = j.contains("rate_limit_per_user") ? get_json_value<int>(j, "rate_limit_per_user") : -1;
+    channel.recipients = get_json_value<std::vector<User>>(j, "recipients");
+    channel.icon = get_json_value<std::string>(j, "icon");
+    channel.owner_id = get_json_value<Snowflake>(j, "owner_id");
+    channel.app_id = get_json_value<Snowflake>(j, "application_id");
+    channel.parent_id = get_json_value<Snowflake>(j, "parent_id");
+    channel.last_pin_timestamp = get_json_value<std::string>(j, "last_pin_timestamp");
+}
+
+DISCORD_NS_END
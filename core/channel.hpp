@@ -2,11 +2,14 @@
 #define DISCORD_CHANNEL_HPP
 
 #include "config.hpp"
+#include "snowflake.hpp"
 #include "user.hpp"
 
 #include <string>
 #include <vector>
 
+#include <nlohmann/json_fwd.hpp>
+
 DISCORD_NS_BEGIN
 
 /**
@@ -32,7 +35,7 @@ struct ChannelPermissionOverwrite
 {
     // TODO: add permission enum with | and & operators
 
-    std::string id;     // role or user id
+    Snowflake id;       // role or user id
     std::string type;   // either "role" or "member"
     int allow;          // permission bit set
     int deny;           // permission bit set
@@ -44,23 +47,23 @@ struct ChannelPermissionOverwrite
  */
 struct Channel
 {
-    std::string id;                     // the id of this channel
-    ChannelType type;                   // the type of channel
-    std::string guild_id;               // the id of the guild
+    Snowflake id;                       // the id of this channel
+    ChannelType type = ChannelType::GUILD_TEXT; // the type of channel
+    Snowflake guild_id;                 // the id of the guild
     int position = -1;                  // sorting position of the channel
     std::vector<ChannelPermissionOverwrite> overwrites; // explicit permission overwrites for members and roles
     std::string name;                   // the name of the channel (2-100 characters)
     std::string topic;                  // the channel topic (0-1024 characters)
     bool nsfw = false;                  // whether the channel is nsfw
-    std::string last_message_id;        // the id of the last message sent in this channel (may not point to an existing or valid message)
+    Snowflake last_message_id;          // the id of the last message sent in this channel (may not point to an existing or valid message)
     int bitrate = -1;                   // the bitrate (in bits) of the voice channel
     int user_limit = -1;                // the user limit of the voice channel
     int rate_limit = -1;                // amount of seconds a user has to wait before sending another message (0-21600); bots, as well as users with the permission manage_messages or manage_channel, are unaffected
     std::vector<User> recipients;       // the recipients of the DM
     std::string icon;                   // icon hash
-    std::string owner_id;               // id of the DM creator
-    std::string app_id;                 // application id of the group DM creator if it is bot-created
-    std::string parent_id;              // id of the parent category for a channel (each parent category can contain up to 50 channels)
+    Snowflake owner_id;                 // id of the DM creator
+    Snowflake app_id;                   // application id of the group DM creator if it is bot-created
+    Snowflake parent_id;                // id of the parent category for a channel (each parent category can contain up to 50 channels)
     std::string last_pin_timestamp;     // when the last pinned message was pinned
 
     /**
@@ -68,10 +71,13 @@ struct Channel
      */
     constexpr inline operator bool() const
     {
-        return !this->id.empty();
+        return static_cast<bool>(this->id);
     }
 };
 
+void from_json(const nlohmann::json &j, ChannelPermissionOverwrite &overwrite);
+void from_json(const nlohmann::json &j, Channel &channel);
+
 DISCORD_NS_END
 
 #endif // DISCORD_CHANNEL_HPP
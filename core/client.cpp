@@ -1,19 +1,19 @@
 #include "client.hpp"
-#include "utils/os.hpp"
+#include "gateway.hpp"
+#include "shard.hpp"
+#include "shard_manager.hpp"
+#include "gateway_cache.hpp"
+#include "utils/log.hpp"
+#include "utils/json.hpp"
 
 #include <stdexcept>
-#include <functional>
-#include <chrono>
-
-#include <ixwebsocket/IXWebSocket.h>
-#include <ixwebsocket/IXHttpClient.h>
+#include <algorithm>
 
 #include <nlohmann/json.hpp>
 
 #include <fmt/format.h>
-#include <fmt/printf.h>
 
-#include <magic_enum.hpp>
+#include <ixwebsocket/IXHttpServer.h>
 
 using json = nlohmann::json;
 
@@ -22,97 +22,149 @@ DISCORD_NS_BEGIN
 namespace
 {
 
-// logging helper
-template<typename... Args>
-static constexpr inline void log(const std::string &fmt, Args&&... args)
-{
-#ifdef DEBUG_BUILD
-    fmt::print("\033[1m[Client]\033[0m " + fmt + "\n", args...);
-#else
-    // TODO: file logging
-    fmt::print("\033[1m[Client]\033[0m " + fmt + "\n", args...);
-#endif
-}
+// logging tag
+static constexpr std::string_view TAG("Client");
 
-// minimal json value parsing helper
-template<typename T>
-static constexpr inline T get_json_value(const json &j, const std::string &key)
-{
-    try {
-        return j[key].get<T>();
-    } catch (...) {
-        if constexpr (std::is_integral<T>::value)
-        {
-            return 0; // ensure on errors the number is 0 on all platforms
-        }
-        else
-        {
-            return T{}; // for non-integral types use the default constructed value
-        }
-    }
-}
+// Discord API base URL
+static const std::string URL("https://discordapp.com/api");
+
+// Discord API Endpoints, relative to the base URL
+static const std::string ENDPOINT_BOT_GATEWAY("/gateway/bot");
+static const std::string ENDPOINT_CHANNELS("/channels");
+
+// path of the Prometheus metrics endpoint
+static constexpr std::string_view METRICS_PATH("/metrics");
+
+// interval in which the gateway sessions are saved
+static constexpr auto SESSION_CHECKPOINT_INTERVAL = std::chrono::seconds(5);
 
-static inline std::int64_t current_time_ms()
+// users per REQUEST_GUILD_MEMBERS with user_ids
+static constexpr std::size_t MEMBER_REQUEST_USERS = 100;
+
+/**
+ * Ordering key of an event: the guild, the channel for events outside of guilds,
+ * events without either (READY, USER_UPDATE, ...) share key 0.
+ */
+static std::uint64_t dispatch_key(Event event, const json &data)
 {
-    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-}
+    using Utils::get_json_value;
 
-// Discord API base URL
-static const std::string URL("https://discordapp.com/api");
+    switch (event)
+    {
+        case Event::GUILD_CREATE:
+        case Event::GUILD_UPDATE:
+        case Event::GUILD_DELETE:
+            return get_json_value<Snowflake>(data, "id").value();
+        default:
+            break;
+    }
 
-// Discord API Endpoints
-static const std::string URL_BOT_GATEWAY(URL + "/gateway/bot");
-static const std::string URL_WSS_SUFFIX("/?v=6&encoding=json");
-static const std::string URL_CHANNELS(URL + "/channels");
+    if (const auto guild_id = get_json_value<Snowflake>(data, "guild_id"))
+    {
+        return guild_id.value();
+    }
 
-} // anonymous namespace
+    switch (event)
+    {
+        case Event::CHANNEL_CREATE:
+        case Event::CHANNEL_UPDATE:
+        case Event::CHANNEL_DELETE:
+            return get_json_value<Snowflake>(data, "id").value();
+        default:
+            return get_json_value<Snowflake>(data, "channel_id").value();
+    }
+}
 
 /**
- * Gateway Response
+ * Coalescing identity of an event: the user, the object for events without a user.
  */
-struct Gateway
+static std::uint64_t coalesce_id(const json &data)
 {
-    std::string url;
-    std::uint32_t shards;
+    using Utils::get_json_value;
+
+    if (const auto user = data.find("user"); user != data.end() && user->is_object())
+    {
+        return get_json_value<Snowflake>(*user, "id").value();
+    }
 
-    struct
+    if (const auto user_id = get_json_value<Snowflake>(data, "user_id"))
     {
-        std::uint32_t total;
-        std::uint32_t remaining;
-        std::uint32_t reset_after;
-        std::uint32_t max_concurrency;
-    } limit;
-};
+        return user_id.value();
+    }
+
+    return get_json_value<Snowflake>(data, "id").value();
+}
 
 /**
- * WebSocket Payload
- * https://discord.com/developers/docs/topics/gateway#payloads
- *
- * s and t are optimal and can be null
+ * Intents under which Discord sends the event, events of both guilds and direct
+ * messages need both intents to be received from both. NONE for events which are
+ * always sent.
  */
-struct Payload
+static constexpr Client::Intent intents_of(Event event)
 {
-    bool valid = false;
-    Client::GatewayOpcode op;   // opcode number [op]
-    json msg;                   // event data [d]
-    std::uint32_t s;            // sequence number, used for resuming sessions and heartbeats [s]
-    std::string t;              // the event name for this payload [t]
+    using Intent = Client::Intent;
 
-    /**
-     * Serialize the payload object for sending.
-     */
-    const std::string serialize() const
+    switch (event)
     {
-        json j;
-        j["op"] = static_cast<std::uint32_t>(this->op);
-        j["d"] = this->msg;
-        return j.dump();
+        case Event::GUILD_CREATE:
+        case Event::GUILD_UPDATE:
+        case Event::GUILD_DELETE:
+        case Event::GUILD_ROLE_CREATE:
+        case Event::GUILD_ROLE_UPDATE:
+        case Event::GUILD_ROLE_DELETE:
+        case Event::CHANNEL_UPDATE:
+        case Event::CHANNEL_DELETE:
+            return Intent::GUILDS;
+        case Event::CHANNEL_CREATE:
+        case Event::CHANNEL_PINS_UPDATE:
+            return Intent::GUILDS | Intent::DIRECT_MESSAGES;
+        case Event::GUILD_MEMBER_ADD:
+        case Event::GUILD_MEMBER_UPDATE:
+        case Event::GUILD_MEMBER_REMOVE:
+            return Intent::GUILD_MEMBERS;
+        case Event::GUILD_BAN_ADD:
+        case Event::GUILD_BAN_REMOVE:
+            return Intent::GUILD_BANS;
+        case Event::GUILD_EMOJIS_UPDATE:
+            return Intent::GUILD_EMOJIS;
+        case Event::GUILD_INTEGRATIONS_UPDATE:
+            return Intent::GUILD_INTEGRATIONS;
+        case Event::WEBHOOKS_UPDATE:
+            return Intent::GUILD_WEBHOOKS;
+        case Event::INVITE_CREATE:
+        case Event::INVITE_DELETE:
+            return Intent::GUILD_INVITES;
+        case Event::VOICE_STATE_UPDATE:
+            return Intent::GUILD_VOICE_STATES;
+        case Event::PRESENCE_UPDATE:
+            return Intent::GUILD_PRESENCES;
+        case Event::MESSAGE_CREATE:
+        case Event::MESSAGE_UPDATE:
+        case Event::MESSAGE_DELETE:
+            return Intent::GUILD_MESSAGES | Intent::DIRECT_MESSAGES;
+        case Event::MESSAGE_DELETE_BULK:
+            return Intent::GUILD_MESSAGES;
+        case Event::MESSAGE_REACTION_ADD:
+        case Event::MESSAGE_REACTION_REMOVE:
+        case Event::MESSAGE_REACTION_REMOVE_ALL:
+        case Event::MESSAGE_REACTION_REMOVE_EMOJI:
+            return Intent::GUILD_MESSAGE_REACTIONS | Intent::DIRECT_MESSAGE_REACTIONS;
+        case Event::TYPING_START:
+            return Intent::GUILD_MESSAGE_TYPING | Intent::DIRECT_MESSAGE_TYPING;
+        default:
+            return Intent::NONE;
     }
-};
+}
+
+} // anonymous namespace
 
 Client::Client(const std::string &token)
     : _token(token)
 {
+    // only the latest state of these events is of interest
+    this->setEventPolicy(Event::PRESENCE_UPDATE, Executor::Policy::COALESCE);
+    this->setEventPolicy(Event::TYPING_START, Executor::Policy::COALESCE);
+
     // check if the token is empty
     if (this->_token.empty())
     {
@@ -120,395 +172,592 @@ Client::Client(const std::string &token)
         return;
     }
 
-    this->_ws = std::make_shared<ix::WebSocket>();
-    auto http = ix::HttpClient();
-
     // Note: on Windows this call is required, but since I don't support Windows
     // this function call is useless, if someone wants to tink with this library on Windows uncomment this line
     //ix::initNetSystem();
 
-    auto args = ix::HttpRequestArgsPtr(new ix::HttpRequestArgs());
-    args->extraHeaders["Authorization"] = "Bot " + this->_token;
+    this->_rest = std::make_unique<RestClient>(this->_scheduler, URL, this->_token, 2, &this->_metrics);
+}
+
+Client::~Client()
+{
+}
 
+Gateway Client::fetch_gateway()
+{
     // request the gateway endpoint for bots
-    const auto res = http.get(URL_BOT_GATEWAY, args);
+    const auto res = this->_rest->request("GET", ENDPOINT_BOT_GATEWAY).get();
 
-    log("request({}) status={}", URL_BOT_GATEWAY, res->statusCode);
+    Utils::log_info(TAG, "request({}) status={}", ENDPOINT_BOT_GATEWAY, res.status);
 
-    if (res->statusCode == 200)
+    if (res.status != 200)
     {
-        try {
-            auto j = json::parse(res->payload);
-            log("response: {}", j.dump());
-            this->_gateway = std::make_shared<Gateway>();
-            this->_gateway->url = j["url"].get<std::string>();
-            this->_gateway->shards = j["shards"].get<std::uint32_t>();
-            this->_gateway->limit = {
-                j["session_start_limit"]["total"].get<std::uint32_t>(),
-                j["session_start_limit"]["remaining"].get<std::uint32_t>(),
-                j["session_start_limit"]["reset_after"].get<std::uint32_t>(),
-                j["session_start_limit"]["max_concurrency"].get<std::uint32_t>(),
-            };
-        } catch (json::exception &e) {
-            throw std::runtime_error(fmt::format("invalid JSON response received: {}", e.what()));
-            return;
-        }
-    }
-    else
-    {
-        log("error({}) status={}", res->errorMsg, res->statusCode);
+        Utils::log_error(TAG, "error({}) status={}", res.error, res.status);
         throw std::runtime_error("request failed");
-        return;
+    }
+
+    try {
+        auto j = json::parse(res.body);
+        Utils::log_debug(TAG, "response: {}", j.dump());
+
+        Gateway gateway;
+        gateway.url = j["url"].get<std::string>();
+        gateway.shards = j["shards"].get<std::uint32_t>();
+        gateway.limit = {
+            j["session_start_limit"]["total"].get<std::uint32_t>(),
+            j["session_start_limit"]["remaining"].get<std::uint32_t>(),
+            j["session_start_limit"]["reset_after"].get<std::uint32_t>(),
+            j["session_start_limit"]["max_concurrency"].get<std::uint32_t>(),
+        };
+        return gateway;
+    } catch (json::exception &e) {
+        throw std::runtime_error(fmt::format("invalid JSON response received: {}", e.what()));
     }
 }
 
-Client::~Client()
+void Client::resolve_intents()
 {
+    if (this->_automatic_intents)
+    {
+        // guild and channel state arrives with GUILD_CREATE
+        auto intents = this->_cache_enabled ? Intent::GUILDS : Intent::NONE;
+        for (std::size_t i = 1; i < EVENT_COUNT; ++i)
+        {
+            const auto event = static_cast<Event>(i);
+            if (!this->_event_handlers[i].empty() || this->_plugins.wants(event))
+            {
+                intents = intents | intents_of(event);
+            }
+        }
+
+        Utils::log_info(TAG, "subscribing to the intents of the registered handlers: {:#x}", static_cast<std::uint32_t>(intents));
+        this->_intents = intents;
+        return;
+    }
+
+    for (std::size_t i = 1; i < EVENT_COUNT; ++i)
+    {
+        const auto event = static_cast<Event>(i);
+        const auto required = intents_of(event);
+        if (required != Intent::NONE && (this->_intents & required) == Intent::NONE &&
+            (!this->_event_handlers[i].empty() || this->_plugins.wants(event)))
+        {
+            Utils::log_warning(TAG, "{} has a handler but is not covered by the intents, it requires {:#x}",
+                event_name(event), static_cast<std::uint32_t>(required));
+        }
+    }
 }
 
-int Client::exec()
+void Client::discover_gateway()
 {
-    // start the ws connection in a new thread
-    this->connect();
+    this->_discovery = std::make_unique<GatewayCache>(this->_discovery_file, this->_discovery_ttl);
 
-    // wait until the bot quits
-    while (this->_running)
+    // without a cached response the shards can't connect before the request completed
+    auto cached = this->_discovery->load();
+    if (!cached)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        this->_gateway = std::make_shared<Gateway>(this->fetch_gateway());
+        this->_discovery->store(*this->_gateway);
+        return;
     }
 
-    this->_ws->stop();
+    this->_gateway = std::make_shared<Gateway>(std::move(cached.value()));
+    Utils::log_info(TAG, "using cached gateway {} with {} shard(s), {} of {} session starts remaining",
+        this->_gateway->url, this->_gateway->shards, this->_gateway->limit.remaining, this->_gateway->limit.total);
 
-    // return with status code
-    return this->_ret;
-}
+    if (this->_discovery->fresh())
+    {
+        return;
+    }
 
-void Client::stop()
-{
-    this->_running = false;
-    this->_terminate = true;
+    // the refreshed response applies to the next start, the running shards keep their gateway
+    this->_discovery_refresh = std::async(std::launch::async, [this, shards = this->_gateway->shards]{
+        try {
+            const auto gateway = this->fetch_gateway();
+            this->_discovery->store(gateway);
 
-    this->stop_threads();
+            if (gateway.shards != shards)
+            {
+                Utils::log_warning(TAG, "recommended shard count changed from {} to {}", shards, gateway.shards);
+            }
+        } catch (std::exception &e) {
+            Utils::log_warning(TAG, "failed to refresh the cached gateway: {}", e.what());
+        }
+    });
 }
 
-void Client::sendMessage(const Channel &channel, const std::string &message, const Embed &embed, bool tts)
+int Client::exec()
 {
-    if (channel && (channel.type == ChannelType::GUILD_TEXT || channel.type == ChannelType::DM))
+    this->resolve_intents();
+    this->discover_gateway();
+
+    // open all gateway connections
+    const auto shards = this->_shard_count == 0 ? this->_gateway->shards : this->_shard_count;
+    const auto dispatch_threads = this->_dispatch_threads == 0 ? std::thread::hardware_concurrency() : this->_dispatch_threads;
+    this->_executor = std::make_unique<Executor>(dispatch_threads);
+    this->_executor->set_capacity(this->_event_queue_capacity);
+    this->_shards = std::make_unique<ShardManager>(this, *this->_gateway, shards, this->_thread_count);
+
+    // lookups are answered from the snapshot until the guilds arrived
+    const auto snapshot = this->_cache_enabled && !this->_snapshot_file.empty();
+    if (snapshot)
     {
-        auto args = ix::HttpRequestArgsPtr(new ix::HttpRequestArgs());
-        args->extraHeaders["Authorization"] = "Bot " + this->_token;
-        args->extraHeaders["Content-Type"] = "application/json";
+        this->_cache.load_snapshot(this->_snapshot_file);
+    }
 
-        json payload;
-        payload["content"] = message;
-        payload["tts"] = tts;
+    // shards with a saved session resume it on connect
+    if (!this->_session_file.empty())
+    {
+        this->_sessions = std::make_unique<SessionStore>(this->_session_file);
+        const auto sessions = this->_sessions->load(static_cast<std::uint32_t>(this->_shards->size()));
 
-        if (embed)
+        std::uint32_t restored = 0;
+        for (auto&& shard : this->_shards->shards())
         {
-            json em;
-            em["title"] = embed.title;
-            em["description"] = embed.description;
-
-            if (!embed.url.empty())
+            if (const auto &session = sessions[shard->id()])
             {
-                em["url"] = embed.url;
+                shard->restore(session);
+                ++restored;
             }
-            if (!embed.type.empty())
+        }
+        Utils::log_info(TAG, "resuming {} of {} sessions from {}", restored, this->_shards->size(), this->_session_file);
+
+        this->_checkpoint_timer = this->_scheduler.schedule_every(SESSION_CHECKPOINT_INTERVAL, [this]{
+            this->save_sessions();
+        });
+    }
+
+    if (this->_metrics_port != 0)
+    {
+        this->start_metrics_endpoint();
+    }
+
+    this->_running = true;
+    this->_shards->start();
+
+    if (snapshot)
+    {
+        this->_snapshot_thread = std::thread([this]{
+            std::unique_lock lk{this->_running_mutex};
+            while (!this->_running_cv.wait_for(lk, this->_snapshot_interval, [this]{ return !this->_running; }))
             {
-                em["type"] = embed.type;
+                lk.unlock();
+                this->_cache.save_snapshot(this->_snapshot_file);
+                lk.lock();
             }
+        });
+    }
 
-            payload["embed"] = em;
-        }
+    // wait until the bot quits
+    {
+        std::unique_lock lk{this->_running_mutex};
+        this->_running_cv.wait(lk, [this]{ return !this->_running; });
+    }
+
+    if (this->_checkpoint_timer != 0)
+    {
+        this->_scheduler.cancel(this->_checkpoint_timer);
+        this->_checkpoint_timer = 0;
+    }
+
+    // saved sessions stay valid on the gateway until the next start
+    this->_shards->stop(this->_sessions != nullptr);
+    this->save_sessions();
+    {
+        std::lock_guard lk{this->_shards_mutex};
+        this->_shards.reset();
+    }
+
+    if (this->_discovery_refresh.valid())
+    {
+        this->_discovery_refresh.wait();
+    }
+
+    // no more chunks can arrive
+    this->fail_member_requests("the client stopped");
+
+    // handle the events which were received before the shards stopped
+    this->_executor->stop();
+
+    if (this->_metrics_server)
+    {
+        this->_metrics_server->stop();
+        this->_metrics_server.reset();
+    }
+
+    if (this->_snapshot_thread.joinable())
+    {
+        this->_snapshot_thread.join();
+        this->_cache.save_snapshot(this->_snapshot_file);
+    }
 
-        auto http = ix::HttpClient();
-        const auto res = http.post(fmt::format("{}/{}/messages", URL_CHANNELS, channel.id), payload.dump(), args);
+    // return with status code
+    return this->_ret;
+}
 
-        if (res->statusCode != 200)
+void Client::stop()
+{
+    {
+        std::lock_guard lk{this->_running_mutex};
+        this->_running = false;
+    }
+    this->_running_cv.notify_all();
+}
+
+void Client::start_metrics_endpoint()
+{
+    this->_metrics_server = std::make_unique<ix::HttpServer>(this->_metrics_port, this->_metrics_address);
+    this->_metrics_server->setOnConnectionCallback([this](ix::HttpRequestPtr request, std::shared_ptr<ix::ConnectionState>) {
+        if (request->uri != METRICS_PATH)
         {
-            // TODO: log error
+            return std::make_shared<ix::HttpResponse>(404, "Not Found", ix::HttpErrorCode::Ok, ix::WebSocketHttpHeaders{}, "not found\n");
         }
+
+        ix::WebSocketHttpHeaders headers;
+        headers["Content-Type"] = "text/plain; version=0.0.4";
+        return std::make_shared<ix::HttpResponse>(200, "OK", ix::HttpErrorCode::Ok, headers, this->_metrics.prometheus());
+    });
+
+    // metrics are optional, the bot runs without the endpoint
+    if (const auto [ok, error] = this->_metrics_server->listen(); !ok)
+    {
+        Utils::log_warning(TAG, "failed to serve metrics on {}:{}: {}", this->_metrics_address, this->_metrics_port, error);
+        this->_metrics_server.reset();
+        return;
     }
+
+    this->_metrics_server->start();
+    Utils::log_info(TAG, "serving metrics on http://{}:{}{}", this->_metrics_address, this->_metrics_port, METRICS_PATH);
 }
 
-void Client::connect()
+Executor::Stats Client::dispatchStats() const
 {
-    // open websocket connection
-    this->_ws->setUrl(this->_gateway->url + URL_WSS_SUFFIX);
-    this->_ws->setOnMessageCallback(std::bind(&Client::on_websocket_event, this, std::placeholders::_1));
-    this->_ws->start();
-    this->_running = true;
-    this->_terminate = false;
+    return this->_executor ? this->_executor->stats() : Executor::Stats{};
+}
+
+Client::StartupStats Client::startupStats() const
+{
+    std::lock_guard lk{this->_startup_mutex};
+    return this->_startup;
 }
 
-void Client::heartbeat()
+Utils::InflateStats Client::transportStats() const
 {
-    while (!this->_terminate)
+    Utils::InflateStats stats;
+
+    std::lock_guard lk{this->_shards_mutex};
+    if (this->_shards)
     {
-        // attempt a reconnect
-        if (!this->_heartbeat_ack_received)
+        for (auto&& shard : this->_shards->shards())
         {
-            this->_ws->stop();
-            this->stop_threads();
-            this->connect();
+            stats += shard->transport_stats();
         }
+    }
 
-        this->send_message(GatewayOpcode::HEARTBEAT, this->_last_seq == -1 ? "" : std::to_string(this->_last_seq));
-        this->_heartbeat_ack_received = false;
+    return stats;
+}
 
-        const auto begin = current_time_ms();
-        while (((current_time_ms() - begin) < this->_heartbeat_interval) && !this->_terminate)
+std::string Client::messageBody(const std::string &message, const Embed &embed, bool tts)
+{
+    json payload;
+    payload["content"] = message;
+    payload["tts"] = tts;
+
+    if (embed)
+    {
+        json em;
+        em["title"] = embed.title;
+        em["description"] = embed.description;
+
+        if (!embed.url.empty())
+        {
+            em["url"] = embed.url;
+        }
+        if (!embed.type.empty())
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            em["type"] = embed.type;
         }
+
+        payload["embed"] = em;
     }
 
-    this->_heartbeat_cv.notify_all();
+    return payload.dump();
 }
 
-void Client::stop_threads()
+std::future<RestClient::Response> Client::sendMessage(const Channel &channel, const std::string &message, const Embed &embed, bool tts)
 {
-    this->_terminate = true;
-
-    // wait for all threads to exit
-    std::unique_lock lk{this->_heartbeat_cv_mutex};
-    this->_heartbeat_cv.wait(lk, [&]{ return this->_terminate; });
-
-    // terminate heartbeat thread
-    if (this->_heartbeat_thr.joinable())
+    if (channel && (channel.type == ChannelType::GUILD_TEXT || channel.type == ChannelType::DM))
     {
-        this->_heartbeat_thr.join();
+        return this->_rest->request("POST", fmt::format("{}/{}/messages", ENDPOINT_CHANNELS, channel.id), messageBody(message, embed, tts));
     }
+
+    std::promise<RestClient::Response> invalid;
+    invalid.set_value({0, {}, {}, "invalid channel"});
+    return invalid.get_future();
 }
 
-void Client::on_websocket_event(const ix::WebSocketMessagePtr &msg)
+std::future<std::size_t> Client::requestGuildMembers(Snowflake guild_id, const std::string &query, std::uint32_t limit, bool presences)
 {
-    switch (msg->type)
+    if (query.empty() && (this->_intents & Intent::GUILD_MEMBERS) != Intent::GUILD_MEMBERS)
     {
-        // handle ws open event
-        case ix::WebSocketMessageType::Open:
-            this->_ret = 0;
-            log("WebSocket connection opened: {} [{}]", this->_gateway->url + URL_WSS_SUFFIX, msg->openInfo.protocol);
-            break;
+        Utils::log_warning(TAG, "requesting all members of guild {} requires the GUILD_MEMBERS intent", guild_id.value());
+    }
 
-        // handle ws error event
-        case ix::WebSocketMessageType::Error:
-            this->_ret = 1;
-            log("WebSocket connection error: {}", msg->errorInfo.reason);
-            break;
+    json data;
+    data["query"] = query;
+    data["limit"] = limit;
+    data["presences"] = presences;
 
-        // handle ws close event
-        case ix::WebSocketMessageType::Close:
-            log("WebSocket connection closed: {} [{}]", msg->closeInfo.reason, msg->closeInfo.code);
+    std::vector<json> requests;
+    requests.emplace_back(std::move(data));
+    return this->request_members(guild_id, std::move(requests));
+}
 
-            // TODO: handle all the gateway errors
+std::future<std::size_t> Client::requestGuildMembers(Snowflake guild_id, const std::vector<Snowflake> &user_ids, bool presences)
+{
+    // no users, nothing to request
+    if (user_ids.empty())
+    {
+        std::promise<std::size_t> none;
+        none.set_value(0);
+        return none.get_future();
+    }
 
-            if (msg->closeInfo.code == static_cast<std::uint16_t>(GatewayCloseEventCode::DISALLOWED_INTENT))
-            {
-                log("Disallowed intents, shutting down bot...");
-                this->_ret = 1;
-                this->stop();
-            }
-            else if (msg->closeInfo.code != ix::WebSocketCloseConstants::kNormalClosureCode)
-            {
-                log("Abnormal closure, attempting reconnect...");
-                this->_ret = 1;
-                this->_ws->stop();
-                this->stop_threads();
-                this->connect();
-            }
-            else
-            {
-                // shutdown bot on normal closure or user shutdown
-                this->_ret = 0;
-                this->stop();
-            }
-            break;
+    // the gateway accepts 100 users per request, larger lists are split
+    std::vector<json> requests;
+    for (std::size_t i = 0; i < user_ids.size(); i += MEMBER_REQUEST_USERS)
+    {
+        const auto end = std::min(user_ids.size(), i + MEMBER_REQUEST_USERS);
 
-        // handle discord messages
-        case ix::WebSocketMessageType::Message:
-            this->_ret = 0;
-            this->on_websocket_message(msg);
-            break;
+        json data;
+        data["user_ids"] = std::vector<Snowflake>(user_ids.begin() + i, user_ids.begin() + end);
+        data["presences"] = presences;
+        requests.emplace_back(std::move(data));
     }
+    return this->request_members(guild_id, std::move(requests));
 }
 
-void Client::on_websocket_message(const ix::WebSocketMessagePtr &msg)
+std::future<std::size_t> Client::request_members(Snowflake guild_id, std::vector<json> &&requests)
 {
-    log("received message: {}", msg->str);
+    std::promise<std::size_t> promise;
+    auto future = promise.get_future();
 
-    auto payload = this->parse_payload(msg->str);
-    log("parsed payload: {}", payload);
-    if (!payload.valid)
+    // exec() resets the shards while handlers may still request members
+    std::lock_guard shards_lk{this->_shards_mutex};
+    if (!this->_running || !this->_shards || !guild_id)
     {
-        return;
+        promise.set_exception(std::make_exception_ptr(std::runtime_error(
+            guild_id ? "the client is not running" : "invalid guild")));
+        return future;
     }
 
-    // initialize or send heartbeat
-    if (payload.op == GatewayOpcode::HELLO)
-    {
-        this->_heartbeat_interval = get_json_value<decltype(this->_heartbeat_interval)>(payload.msg, "heartbeat_interval");
-        if (this->_heartbeat_interval == 0)
-        {
-            log("failed to obtain the heartbeat interval, shutting down bot...");
-            this->stop();
-            return;
-        }
+    // guilds are assigned to shards by their id
+    // https://discord.com/developers/docs/topics/gateway#sharding-sharding-formula
+    auto &shards = this->_shards->shards();
+    auto &shard = *shards[(guild_id.value() >> 22) % shards.size()];
 
-        if (this->_session_id.empty())
-        {
-            this->send_identity();
-        }
-        else
-        {
-            this->send_resume();
-        }
+    // the chunks of all requests are matched by the same nonce, the lock keeps
+    // a new session of the shard from missing the request until it is recorded
+    std::lock_guard lk{this->_member_requests_mutex};
+    const auto nonce = std::to_string(++this->_member_nonce);
+    auto &request = this->_member_requests.emplace(nonce, MemberRequest{std::move(promise)}).first->second;
+    request.pending = requests.size();
+    request.shard = shard.id();
 
-        this->_heartbeat_ack_received = true;
-        this->_terminate = false;
+    for (auto&& data : requests)
+    {
+        data["guild_id"] = guild_id;
+        data["nonce"] = nonce;
+        request.session = shard.send_request(GatewayOpcode::REQUEST_GUILD_MEMBERS, data);
+    }
 
-        // terminate previous heartbeat thread if running
-        if (this->_heartbeat_thr.joinable())
-        {
-            this->_heartbeat_thr.join();
-        }
+    return future;
+}
 
-        // start new heartbeat thread
-        this->_heartbeat_thr = std::thread(&Client::heartbeat, this);
-    }
+void Client::on_members_chunk(const json &data)
+{
+    using Utils::get_json_value;
 
-    // heartbeat acknowledged, keep session active
-    else if (payload.op == GatewayOpcode::HEARTBEAT_ACK)
+    const auto nonce = data.find("nonce");
+    if (nonce == data.end() || !nonce->is_string())
     {
-        this->_heartbeat_ack_received = true;
+        return;
     }
 
-    // dispatch (most of the code goes here and is split up into multiple files and functions)
-    else if (payload.op == GatewayOpcode::DISPATCH)
+    std::lock_guard lk{this->_member_requests_mutex};
+    const auto it = this->_member_requests.find(nonce->get_ref<const std::string&>());
+    if (it == this->_member_requests.end())
     {
-        // store last sequence
-        this->_last_seq = payload.s;
-
-        // bot is ready, obtain some data for session restore
-        if (payload.t == "READY")
-        {
-            this->_session_id = payload.msg["session_id"].get<std::string>();
-        }
-
-        // a guild was created, called for each guild the bot is a member of
-        else if (payload.t == "GUILD_CREATE")
-        {
-
-        }
+        return;
+    }
 
-        // TODO: lets get started with the actual bot functionality
+    if (const auto members = data.find("members"); members != data.end() && members->is_array())
+    {
+        it->second.members += members->size();
     }
 
-    // session is invalid
-    else if (payload.op == GatewayOpcode::INVALID_SESSION)
+    // the last chunk of each request sent with the nonce
+    if (get_json_value<std::uint32_t>(data, "chunk_index") + 1 >= get_json_value<std::uint32_t>(data, "chunk_count") &&
+        --it->second.pending == 0)
     {
-        log("received a invalid session response");
+        it->second.promise.set_value(it->second.members);
+        this->_member_requests.erase(it);
+    }
+}
 
-        if (payload.msg == "true")
+void Client::on_session_replaced(Shard &shard, std::uint64_t session)
+{
+    // requests sent in an earlier session are not answered in the new one
+    std::lock_guard lk{this->_member_requests_mutex};
+    for (auto it = this->_member_requests.begin(); it != this->_member_requests.end();)
+    {
+        if (it->second.shard == shard.id() && it->second.session < session)
         {
-            log("trying to resume session...");
-            this->send_resume();
+            it->second.promise.set_exception(std::make_exception_ptr(std::runtime_error("the shard started a new session")));
+            it = this->_member_requests.erase(it);
         }
         else
         {
-            log("reconnecting with a new session...");
-            this->_ws->stop();
-            this->stop_threads();
-            this->connect();
+            ++it;
         }
     }
 }
 
-const Payload Client::parse_payload(const std::string &payload)
+void Client::fail_member_requests(const std::string &reason)
 {
-    try {
-        auto j = json::parse(payload);
-        Payload payload;
-        payload.op = static_cast<GatewayOpcode>(j["op"].get<std::uint32_t>());
-        payload.msg = j["d"]; // contains event data based on opcode
-        payload.s = j.at("s").is_null() ? 0 : j["s"].get<std::uint32_t>();
-        payload.t = j.at("t").is_null() ? "" : j["t"].get<std::string>();
-        payload.valid = true;
-        return payload;
-    } catch (json::exception &e) {
-        log("parsing the payload failed, ignoring message: {}", e.what());
+    std::lock_guard lk{this->_member_requests_mutex};
+    for (auto&& request : this->_member_requests)
+    {
+        request.second.promise.set_exception(std::make_exception_ptr(std::runtime_error(reason)));
     }
-
-    return {};
+    this->_member_requests.clear();
 }
 
-void Client::send_message(GatewayOpcode op, const std::string &message, bool _log)
+void Client::on(const std::string &event, EventHandler handler)
 {
-    if (_log)
+    if (const auto known = event_from_name(event); known != Event::UNKNOWN)
     {
-        log("sending message ({}): {}", magic_enum::enum_name(op), message);
-    }
-    else
-    {
-        log("sending message ({}): [CONTENTS REDACTED DUE TO SENSITIVE DATA]", magic_enum::enum_name(op));
-    }
-
-    Payload payload;
-    payload.op = op;
-    try {
-        payload.msg = json::parse(message);
-    } catch (json::exception &e) {
-        payload.msg = message;
+        this->on(known, std::move(handler));
+        return;
     }
 
-    this->_ws->send(payload.serialize());
+    this->_handlers[event].emplace_back(std::move(handler));
 }
 
-void Client::send_identity()
+void Client::on(Event event, EventHandler handler)
 {
-    json id;
-    id["token"] = this->_token;
-    id["properties"]["$os"] = Utils::get_os_name();
-    id["properties"]["$browser"] = "misaka-oneesama";
-    id["properties"]["$device"] = "misaka-oneesama";
-    id["intents"] = static_cast<std::uint32_t>(this->_intents);
-
-    this->send_message(GatewayOpcode::IDENTIFY, id.dump(), false);
+    this->_event_handlers[static_cast<std::size_t>(event)].emplace_back(std::move(handler));
 }
 
-void Client::send_resume()
+bool Client::wants(Event event, std::string_view name) const
 {
-    json resume;
-    resume["token"] = this->_token;
-    resume["session_id"] = this->_session_id;
-    resume["seq"] = this->_last_seq;
+    if (event == Event::UNKNOWN)
+    {
+        return this->_handlers.find(name) != this->_handlers.end();
+    }
 
-    this->send_message(GatewayOpcode::RESUME, resume.dump(), false);
+    // chunks only arrive for our own member requests
+    return event == Event::GUILD_MEMBERS_CHUNK ||
+           (this->_cache_enabled && Cache::handles(event)) ||
+           !this->_event_handlers[static_cast<std::size_t>(event)].empty() ||
+           this->_plugins.wants(event);
 }
 
-DISCORD_NS_END
-
-template<>
-struct fmt::formatter<Discord::Payload>
+bool Client::on_dispatch(Payload &payload)
 {
-    constexpr auto parse(format_parse_context &ctx)
+    // keep the cache current before the handlers see the event
+    if (this->_cache_enabled && Cache::handles(payload.event))
     {
-        return ctx.begin();
+        try {
+            this->_cache.update(payload.event, payload.msg);
+        } catch (const std::exception &e) {
+            Utils::log_warning(TAG, "failed to cache {}: {}", payload.t, e.what());
+        }
+    }
+
+    if (payload.event == Event::GUILD_MEMBERS_CHUNK)
+    {
+        this->on_members_chunk(payload.msg);
     }
 
-    template<typename FormatContext>
-    auto format(const Discord::Payload &pl, FormatContext &ctx)
+    const std::vector<EventHandler> *handlers = nullptr;
+    if (payload.event != Event::UNKNOWN)
+    {
+        handlers = &this->_event_handlers[static_cast<std::size_t>(payload.event)];
+    }
+    else if (const auto it = this->_handlers.find(payload.t); it != this->_handlers.end())
     {
-        if (pl.valid)
+        handlers = &it->second;
+    }
+
+    const auto plugins = this->_plugins.wants(payload.event);
+    if ((!handlers || handlers->empty()) && !plugins)
+    {
+        return false;
+    }
+
+    // handlers run on the executor, ordered per guild or channel
+    const auto key = dispatch_key(payload.event, payload.msg);
+    const auto policy = this->_event_policies[static_cast<std::size_t>(payload.event)];
+    const Executor::CoalesceKey coalesce = {
+        static_cast<std::uint32_t>(payload.event),
+        policy == Executor::Policy::COALESCE ? coalesce_id(payload.msg) : 0,
+    };
+
+    auto data = std::make_shared<const json>(std::move(payload.msg));
+    return this->_executor->post(key, [this, handlers, plugins, event = payload.event, data = std::move(data)]{
+        const auto start = std::chrono::steady_clock::now();
+
+        if (handlers)
         {
-            return format_to(
-                ctx.out(),
-                "Payload{{op={} ({}), d={}, s={}, t=\"{}\"}}",
-                magic_enum::enum_name(pl.op), pl.op, pl.msg.dump(), pl.s, pl.t);
+            for (auto&& handler : *handlers)
+            {
+                handler(*data);
+            }
         }
-        else
+
+        // plugins read the same decoded data, they only handle known events
+        if (plugins)
         {
-            return format_to(ctx.out(), "Payload{{invalid}}");
+            this->_plugins.dispatch(event, event_name(event), *data);
         }
+
+        this->_metrics.record_handler(event, std::chrono::steady_clock::now() - start);
+    }, policy, coalesce);
+}
+
+void Client::on_session_started(Shard &shard, bool resumed)
+{
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - this->_start);
+    Utils::log_info(TAG, "shard {} receives events {}ms after start ({})", shard.id(), elapsed.count(), resumed ? "resumed" : "identified");
+
+    std::lock_guard lk{this->_startup_mutex};
+    if (resumed)
+    {
+        ++this->_startup.resumed;
+        this->_startup.resume_time = std::max(this->_startup.resume_time, elapsed);
     }
-};
+    else
+    {
+        ++this->_startup.identified;
+        this->_startup.identify_time = std::max(this->_startup.identify_time, elapsed);
+    }
+}
+
+void Client::save_sessions()
+{
+    if (!this->_sessions || !this->_shards)
+    {
+        return;
+    }
+
+    std::vector<Session> sessions;
+    for (auto&& shard : this->_shards->shards())
+    {
+        sessions.emplace_back(shard->session());
+    }
+
+    this->_sessions->save(static_cast<std::uint32_t>(sessions.size()), sessions);
+}
+
+DISCORD_NS_END
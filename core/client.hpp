@@ -5,27 +5,64 @@
 #include "channel.hpp"
 #include "user.hpp"
 #include "message.hpp"
+#include "guild.hpp"
+#include "event.hpp"
+#include "scheduler.hpp"
+#include "executor.hpp"
+#include "rest_client.hpp"
+#include "cache.hpp"
+#include "plugin_host.hpp"
+#include "session_store.hpp"
+#include "metrics.hpp"
+#include "utils/zlib_stream.hpp"
+
+#include <nlohmann/json_fwd.hpp>
 
 #include <string>
+#include <string_view>
 #include <memory>
+#include <functional>
+#include <future>
+#include <map>
+#include <array>
+#include <vector>
+#include <atomic>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <limits>
+#include <chrono>
+#include <type_traits>
 #include <cstdint>
 
 // IXWebSocket forward declarations
 namespace ix
 {
-    class WebSocket;
-    struct WebSocketMessage;
-    using WebSocketMessagePtr = std::unique_ptr<WebSocketMessage>;
+    class HttpServer;
 }
 
 DISCORD_NS_BEGIN
 
 struct Gateway;
+class GatewayCache;
 struct Payload;
+class Shard;
+class ShardManager;
+
+/**
+ * Data type passed to typed event handlers, events without a dedicated type pass the JSON event data.
+ */
+template<Event E> struct EventData                      { using type = nlohmann::json; };
+template<> struct EventData<Event::CHANNEL_CREATE>      { using type = Channel; };
+template<> struct EventData<Event::CHANNEL_UPDATE>      { using type = Channel; };
+template<> struct EventData<Event::CHANNEL_DELETE>      { using type = Channel; };
+template<> struct EventData<Event::GUILD_CREATE>        { using type = Guild; };
+template<> struct EventData<Event::GUILD_UPDATE>        { using type = Guild; };
+template<> struct EventData<Event::GUILD_MEMBER_ADD>    { using type = Member; };
+template<> struct EventData<Event::GUILD_MEMBER_UPDATE> { using type = Member; };
+template<> struct EventData<Event::MESSAGE_CREATE>      { using type = Message; };
+template<> struct EventData<Event::MESSAGE_UPDATE>      { using type = Message; };
+template<> struct EventData<Event::USER_UPDATE>         { using type = User; };
 
 class Client
 {
@@ -84,6 +121,8 @@ public:
      */
     enum class Intent : std::uint32_t
     {
+        NONE = 0,
+
         GUILDS = (1 << 0),
         //  - GUILD_CREATE
         //  - GUILD_UPDATE
@@ -182,6 +221,25 @@ public:
         DEFAULTS = GUILDS | GUILD_MESSAGES | DIRECT_MESSAGES | GUILD_MEMBERS,
     };
 
+    /**
+     * Gateway Encodings
+     * https://discord.com/developers/docs/topics/gateway#etfjson
+     */
+    enum class Encoding
+    {
+        JSON,   // text JSON
+        ETF,    // Erlang External Term Format, faster to decode, snowflakes arrive as integers
+    };
+
+    /**
+     * JSON Decoding Backends
+     */
+    enum class JsonBackend
+    {
+        NLOHMANN,   // nlohmann::json parser, always available
+        SIMDJSON,   // SIMD accelerated parser, requires a build with ENABLE_SIMDJSON
+    };
+
     /**
      * Sets the required intents for the bot.
      */
@@ -190,6 +248,241 @@ public:
         this->_intents = intents;
     }
 
+    /**
+     * Subscribes only to the intents of the events which have a handler or plugin
+     * when exec() starts, plus GUILDS while the cache is enabled. Discord does not
+     * send the other events at all, PRESENCE_UPDATE and TYPING_START traffic in
+     * particular. Replaces the intents given to setIntents().
+     */
+    constexpr inline void setAutomaticIntents(bool enabled)
+    {
+        this->_automatic_intents = enabled;
+    }
+
+    /**
+     * The intents the shards identify with, computed by exec() in automatic mode.
+     */
+    constexpr inline Intent intents() const
+    {
+        return this->_intents;
+    }
+
+    /**
+     * Sets the amount of gateway connections (shards) to open.
+     * When set to 0 (default) the shard count recommended by Discord is used.
+     */
+    constexpr inline void setShardCount(std::uint32_t shards)
+    {
+        this->_shard_count = shards;
+    }
+
+    /**
+     * Sets the amount of threads the shards are distributed on.
+     * The thread count is limited to the shard count.
+     */
+    constexpr inline void setThreadCount(std::uint32_t threads)
+    {
+        this->_thread_count = threads;
+    }
+
+    /**
+     * Sets the encoding used on all gateway connections.
+     */
+    constexpr inline void setEncoding(Encoding encoding)
+    {
+        this->_encoding = encoding;
+    }
+
+    /**
+     * Sets the backend used to decode JSON event data, defaults to the fastest one.
+     * Unavailable backends fall back to JsonBackend::NLOHMANN.
+     */
+    constexpr inline void setJsonBackend(JsonBackend backend)
+    {
+        this->_json_backend = backend;
+    }
+
+    /**
+     * Enables zlib-stream transport compression for all gateway connections.
+     * Reduces the received bandwidth at the cost of inflate time.
+     */
+    constexpr inline void setTransportCompression(bool enabled)
+    {
+        this->_compression = enabled;
+    }
+
+    /**
+     * Sets the amount of threads event handlers run on.
+     * When set to 0 (default) one thread per hardware thread is used.
+     *
+     * Events of the same guild, or of the same channel outside of guilds, are
+     * handled in the order they were received, other events run in parallel.
+     */
+    constexpr inline void setDispatchThreads(std::uint32_t threads)
+    {
+        this->_dispatch_threads = threads;
+    }
+
+    /**
+     * Limits the amount of events waiting for their handlers, 0 means unbounded.
+     * What happens to events when the limit is reached depends on their policy.
+     */
+    constexpr inline void setEventQueueCapacity(std::size_t capacity)
+    {
+        this->_event_queue_capacity = capacity;
+    }
+
+    /**
+     * Sets the policy of an event when the event queue is full, see Executor::Policy.
+     * Coalescing events are superseded by newer events of the same user, or the same
+     * object for events without a user. All events block by default, except for
+     * PRESENCE_UPDATE and TYPING_START, which coalesce.
+     *
+     * Heartbeats are sent independently of the queue.
+     */
+    constexpr inline void setEventPolicy(Event event, Executor::Policy policy)
+    {
+        this->_event_policies[static_cast<std::size_t>(event)] = policy;
+    }
+
+    /**
+     * Statistics of the event handler threads.
+     */
+    Executor::Stats dispatchStats() const;
+
+    /**
+     * Enables the entity cache (default), it is populated from the guild, channel,
+     * member and role events. A disabled cache does not decode those events unless
+     * a handler is registered.
+     */
+    constexpr inline void setCacheEnabled(bool enabled)
+    {
+        this->_cache_enabled = enabled;
+    }
+
+    /**
+     * Keeps a snapshot of the cached guilds, channels, roles and users in the given file.
+     * It is loaded on start and answers lookups until the gateway sent the current
+     * state, and it is updated in the given interval and on shutdown.
+     */
+    inline void setSnapshotFile(const std::string &path, std::chrono::seconds interval = std::chrono::seconds(60))
+    {
+        this->_snapshot_file = path;
+        this->_snapshot_interval = interval;
+    }
+
+    /**
+     * Cached guilds, channels, roles, members and users.
+     */
+    inline const Cache &cache() const
+    {
+        return this->_cache;
+    }
+
+    /**
+     * Keeps the gateway sessions in the given file, so a restarted bot resumes
+     * them instead of identifying again. Shards whose session can't be resumed
+     * identify as usual.
+     */
+    inline void setSessionFile(const std::string &path)
+    {
+        this->_session_file = path;
+    }
+
+    /**
+     * Keeps the /gateway/bot response in the given file. A cached response lets the
+     * shards connect right away, it is refreshed in the background once it is older
+     * than the TTL. The remaining session starts are tracked across restarts.
+     */
+    inline void setDiscoveryCache(const std::string &path, std::chrono::seconds ttl = std::chrono::hours(1))
+    {
+        this->_discovery_file = path;
+        this->_discovery_ttl = ttl;
+    }
+
+    /**
+     * Time from the start of the client until the shards received their first
+     * event, by shards which resumed a session and shards which identified.
+     */
+    struct StartupStats
+    {
+        std::uint32_t resumed = 0;
+        std::uint32_t identified = 0;
+        std::chrono::milliseconds resume_time{};    // until the last resumed shard
+        std::chrono::milliseconds identify_time{};  // until the last identified shard
+    };
+
+    StartupStats startupStats() const;
+
+    /**
+     * Frame counters and latency histograms of the gateway, the handlers and the REST API.
+     */
+    inline const Metrics &metrics() const
+    {
+        return this->_metrics;
+    }
+
+    /**
+     * Serves the metrics in the Prometheus text format on http://address:port/metrics
+     * while the client runs. The endpoint is disabled by default.
+     */
+    inline void setMetricsEndpoint(std::uint16_t port, const std::string &address = "127.0.0.1")
+    {
+        this->_metrics_port = port;
+        this->_metrics_address = address;
+    }
+
+    /**
+     * Combined transport compression statistics of all shards.
+     */
+    Utils::InflateStats transportStats() const;
+
+    /**
+     * Event handler, receives the event data [d] of a dispatch.
+     * Handlers run on the dispatch threads, see setDispatchThreads().
+     */
+    using EventHandler = std::function<void(const nlohmann::json &data)>;
+
+    /**
+     * Registers a handler for the given gateway event, for example "MESSAGE_CREATE".
+     * The data of events without any handler is never decoded.
+     * Handlers must be registered before calling exec().
+     */
+    void on(const std::string &event, EventHandler handler);
+    void on(Event event, EventHandler handler);
+
+    /**
+     * Registers a typed handler, for example on<Event::MESSAGE_CREATE>([](const Message &message) { ... }).
+     * The event data is converted to the type given by EventData for each handler.
+     */
+    template<Event E>
+    void on(std::function<void(const typename EventData<E>::type&)> handler)
+    {
+        using T = typename EventData<E>::type;
+
+        if constexpr (std::is_same_v<T, nlohmann::json>)
+        {
+            this->on(E, std::move(handler));
+        }
+        else
+        {
+            this->on(E, [handler = std::move(handler)](const nlohmann::json &data) {
+                T value;
+                from_json(data, value);
+                handler(value);
+            });
+        }
+    }
+
+    /**
+     * Plugins receiving the events next to the handlers.
+     * Plugins can be loaded, unloaded and reloaded while the client is running.
+     */
+    inline PluginHost &plugins()
+    {
+        return this->_plugins;
+    }
+
     /**
      * Starts the Discord event loop.
      * This function is blocking and only returns on errors or on user shutdown.
@@ -201,43 +494,134 @@ public:
      */
     void stop();
 
+    /**
+     * Timer scheduler of the client, can be used for periodic or delayed tasks.
+     * Tasks run on the scheduler thread and should not block.
+     */
+    inline Scheduler &scheduler()
+    {
+        return this->_scheduler;
+    }
+
     /**
      * Sends a text message to the given channel.
+     * The request is sent asynchronously, the returned future can be ignored.
+     */
+    std::future<RestClient::Response> sendMessage(const Channel &channel, const std::string &message, const Embed &embed = {}, bool tts = false);
+
+    /**
+     * JSON body of a message sent by sendMessage().
+     */
+    static std::string messageBody(const std::string &message, const Embed &embed = {}, bool tts = false);
+
+    /**
+     * Requests the members of a guild from the gateway, all members when the query
+     * is empty (requires the GUILD_MEMBERS intent) or those whose username starts
+     * with it. A limit of 0 returns all matching members.
+     *
+     * The members arrive in GUILD_MEMBERS_CHUNK events, each chunk is added to the
+     * member cache and passed to the handlers as it arrives. The returned future is
+     * set to the amount of received members once the last chunk arrived, it fails
+     * when the client stops before or the shard has to start a new session.
+     *
+     * Requests wait until the shard of the guild has a session and are sent
+     * within the gateway send limit.
+     */
+    std::future<std::size_t> requestGuildMembers(Snowflake guild_id, const std::string &query = "", std::uint32_t limit = 0, bool presences = false);
+
+    /**
+     * Requests the given members of a guild. The gateway accepts 100 users per
+     * request, longer lists are sent as several requests and the future is set
+     * once all of them were answered. An empty list sends nothing and the
+     * future is set to 0 right away.
      */
-    void sendMessage(const Channel &channel, const std::string &message, const Embed &embed = {}, bool tts = false);
+    std::future<std::size_t> requestGuildMembers(Snowflake guild_id, const std::vector<Snowflake> &user_ids, bool presences = false);
 
 private:
-    int _ret = 0;
+    friend class Shard;
+    friend class ShardManager;
+
+    const std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+
+    std::atomic<int> _ret = 0;
 
-    bool _running = false;
-    bool _terminate = false;
+    std::atomic<bool> _running = false;
+    std::mutex _running_mutex;
+    std::condition_variable _running_cv;
 
     std::string _token;
-    std::shared_ptr<ix::WebSocket> _ws;
+    Metrics _metrics;     // must outlive the REST client, the executor and the shards
+    Scheduler _scheduler; // must outlive the REST client and the shards
+    PluginHost _plugins;  // must outlive the executor
+    std::unique_ptr<Executor> _executor;
+    std::unique_ptr<RestClient> _rest;
     std::shared_ptr<Gateway> _gateway;
-
-    std::uint32_t _heartbeat_interval = 0;
-    std::int32_t _last_seq = -1;
-    bool _heartbeat_ack_received = false;
-    std::thread _heartbeat_thr;
-    std::condition_variable _heartbeat_cv;
-    std::mutex _heartbeat_cv_mutex;
+    std::unique_ptr<GatewayCache> _discovery;
+    std::future<void> _discovery_refresh;
+    std::unique_ptr<ShardManager> _shards;
+    mutable std::mutex _shards_mutex;   // guards _shards against other threads while exec() resets it
+
+    std::uint32_t _shard_count = 0;
+    std::uint32_t _thread_count = 1;
+    std::uint32_t _dispatch_threads = 0;
+    std::size_t _event_queue_capacity = 16384;
+    std::array<Executor::Policy, EVENT_COUNT> _event_policies{};
+    bool _compression = false;
+    bool _cache_enabled = true;
+    Encoding _encoding = Encoding::JSON;
+    JsonBackend _json_backend = JsonBackend::SIMDJSON;
 
     Intent _intents = Intent::DEFAULTS;
-    std::string _session_id;
+    bool _automatic_intents = false;
+
+    Cache _cache;
 
-    void connect();
-    void heartbeat();
-    void stop_threads();
+    std::string _snapshot_file;
+    std::chrono::seconds _snapshot_interval{60};
+    std::thread _snapshot_thread;
 
-    void on_websocket_event(const ix::WebSocketMessagePtr &msg);
-    void on_websocket_message(const ix::WebSocketMessagePtr &msg);
+    std::string _discovery_file;
+    std::chrono::seconds _discovery_ttl{3600};
 
-    const Payload parse_payload(const std::string &payload);
+    std::uint16_t _metrics_port = 0;
+    std::string _metrics_address;
+    std::unique_ptr<ix::HttpServer> _metrics_server;
 
-    void send_message(GatewayOpcode op, const std::string &message, bool log = true);
-    void send_identity();
-    void send_resume();
+    std::string _session_file;
+    std::unique_ptr<SessionStore> _sessions;
+    Scheduler::TimerId _checkpoint_timer = 0;
+
+    mutable std::mutex _startup_mutex;
+    StartupStats _startup;
+
+    // pending REQUEST_GUILD_MEMBERS, by nonce
+    struct MemberRequest
+    {
+        std::promise<std::size_t> promise;
+        std::size_t members = 0;
+        std::size_t pending = 0;    // requests sent with the nonce which have chunks left
+        std::uint32_t shard = 0;
+        std::uint64_t session = 0;  // session of the shard which answers the requests
+    };
+    std::mutex _member_requests_mutex;
+    std::map<std::string, MemberRequest, std::less<>> _member_requests;
+    std::uint64_t _member_nonce = 0;
+
+    std::array<std::vector<EventHandler>, EVENT_COUNT> _event_handlers;  // by event
+    std::map<std::string, std::vector<EventHandler>, std::less<>> _handlers; // events unknown to Event, by name
+
+    Gateway fetch_gateway();
+    void resolve_intents();
+    void discover_gateway();
+    bool wants(Event event, std::string_view name) const;
+    bool on_dispatch(Payload &payload);
+    void on_session_started(Shard &shard, bool resumed);
+    std::future<std::size_t> request_members(Snowflake guild_id, std::vector<nlohmann::json> &&requests);
+    void on_members_chunk(const nlohmann::json &data);
+    void on_session_replaced(Shard &shard, std::uint64_t session);
+    void fail_member_requests(const std::string &reason);
+    void save_sessions();
+    void start_metrics_endpoint();
 };
 
 DISCORD_NS_END
@@ -0,0 +1,120 @@
+#include "command_queue.hpp"
+
+DISCORD_NS_BEGIN
+
+namespace
+{
+
+/**
+ * Whether the queued command is superseded by the newer one.
+ */
+static bool supersedes(const CommandQueue::Command &newer, const CommandQueue::Command &queued)
+{
+    if (newer.op != queued.op)
+    {
+        return false;
+    }
+
+    switch (newer.op)
+    {
+        // the client has a single presence
+        case Client::GatewayOpcode::PRESENCE_UPDATE:
+            return true;
+
+        // and one voice state per guild
+        case Client::GatewayOpcode::VOICE_STATE_UPDATE: {
+            const auto newer_guild = newer.data.find("guild_id");
+            const auto queued_guild = queued.data.find("guild_id");
+            return newer_guild != newer.data.end() && queued_guild != queued.data.end() && *newer_guild == *queued_guild;
+        }
+
+        default:
+            return false;
+    }
+}
+
+} // anonymous namespace
+
+void CommandQueue::reset()
+{
+    this->_head = 0;
+    this->_count = 0;
+}
+
+bool CommandQueue::acquire_priority(clock::time_point now)
+{
+    this->expire(now);
+    const auto ok = this->_count < LIMIT;
+    this->record(now);
+    return ok;
+}
+
+bool CommandQueue::push(Command &&command)
+{
+    for (auto&& queued : this->_commands)
+    {
+        if (supersedes(command, queued))
+        {
+            queued = std::move(command);
+            return false;
+        }
+    }
+
+    this->_commands.emplace_back(std::move(command));
+    return true;
+}
+
+std::optional<CommandQueue::Command> CommandQueue::pop(clock::time_point now)
+{
+    if (this->_commands.empty())
+    {
+        return std::nullopt;
+    }
+
+    this->expire(now);
+    if (this->_count >= LIMIT - RESERVED)
+    {
+        return std::nullopt;
+    }
+
+    this->record(now);
+    auto command = std::move(this->_commands.front());
+    this->_commands.pop_front();
+    return command;
+}
+
+CommandQueue::clock::time_point CommandQueue::next() const
+{
+    if (this->_count < LIMIT - RESERVED)
+    {
+        return clock::time_point();
+    }
+
+    // the send which has to leave the window to get below the queue limit
+    const auto index = (this->_head + this->_count - (LIMIT - RESERVED)) % LIMIT;
+    return this->_sent[index] + WINDOW;
+}
+
+void CommandQueue::expire(clock::time_point now)
+{
+    while (this->_count > 0 && this->_sent[this->_head] + WINDOW <= now)
+    {
+        this->_head = (this->_head + 1) % LIMIT;
+        --this->_count;
+    }
+}
+
+void CommandQueue::record(clock::time_point now)
+{
+    // beyond the limit the oldest send is forgotten, only priority commands get here
+    if (this->_count == LIMIT)
+    {
+        this->_head = (this->_head + 1) % LIMIT;
+        --this->_count;
+    }
+
+    this->_sent[(this->_head + this->_count) % LIMIT] = now;
+    ++this->_count;
+}
+
+DISCORD_NS_END
@@ -0,0 +1,100 @@
+#ifndef DISCORD_COMMAND_QUEUE_HPP
+#define DISCORD_COMMAND_QUEUE_HPP
+
+#include "config.hpp"
+#include "client.hpp"
+
+#include <array>
+#include <deque>
+#include <optional>
+#include <chrono>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+
+DISCORD_NS_BEGIN
+
+/**
+ * Outbound gateway commands of a connection.
+ * https://discord.com/developers/docs/topics/gateway#rate-limiting
+ *
+ * Discord closes connections which send more than 120 commands within 60
+ * seconds. The send times of the current window are kept in a ring buffer
+ * and commands beyond the limit wait in a queue until the oldest send
+ * leaves the window.
+ *
+ * Heartbeats, IDENTIFY and RESUME bypass the queue and may use a few slots
+ * which queued commands leave free, so a burst of commands can't delay them.
+ * A queued PRESENCE_UPDATE is replaced by a newer one, as is a queued
+ * VOICE_STATE_UPDATE of the same guild.
+ *
+ * The queue is not thread-safe.
+ */
+class CommandQueue
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    static constexpr std::size_t LIMIT = 120;
+    static constexpr auto WINDOW = std::chrono::seconds(60);
+
+    // slots only heartbeats, IDENTIFY and RESUME may use
+    static constexpr std::size_t RESERVED = 5;
+
+    struct Command
+    {
+        Client::GatewayOpcode op;
+        nlohmann::json data;
+        bool log = true;
+    };
+
+    /**
+     * Starts the window of a new connection, queued commands are kept.
+     */
+    void reset();
+
+    /**
+     * Takes a slot for a heartbeat, IDENTIFY or RESUME, which are sent right away.
+     * Returns false when it exceeds the limit.
+     */
+    bool acquire_priority(clock::time_point now);
+
+    /**
+     * Queues a command, returns false when it replaced a queued command.
+     */
+    bool push(Command &&command);
+
+    /**
+     * Takes the next queued command if it can be sent now.
+     */
+    std::optional<Command> pop(clock::time_point now);
+
+    /**
+     * Time at which the next queued command can be sent.
+     */
+    clock::time_point next() const;
+
+    inline bool empty() const
+    {
+        return this->_commands.empty();
+    }
+
+    inline std::size_t size() const
+    {
+        return this->_commands.size();
+    }
+
+private:
+    std::array<clock::time_point, LIMIT> _sent{};  // send times in the window, oldest at _head
+    std::size_t _head = 0;
+    std::size_t _count = 0;
+
+    std::deque<Command> _commands;
+
+    void expire(clock::time_point now);
+    void record(clock::time_point now);
+};
+
+DISCORD_NS_END
+
+#endif // DISCORD_COMMAND_QUEUE_HPP
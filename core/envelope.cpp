@@ -0,0 +1,328 @@
+#include "envelope.hpp"
+#include "gateway.hpp"
+#include "json_decoder.hpp"
+#include "utils/etf.hpp"
+
+#include <charconv>
+#include <cstring>
+
+using json = nlohmann::json;
+
+DISCORD_NS_BEGIN
+
+namespace
+{
+
+/**
+ * Minimal JSON scanner which only understands enough of the grammar
+ * to locate the top-level members of an object without building a DOM.
+ */
+class JsonScanner
+{
+public:
+    JsonScanner(std::string_view data)
+        : _p(data.data()),
+          _end(data.data() + data.size())
+    {
+    }
+
+    inline void ws()
+    {
+        while (this->_p < this->_end && (*this->_p == ' ' || *this->_p == '\n' || *this->_p == '\r' || *this->_p == '\t'))
+        {
+            ++this->_p;
+        }
+    }
+
+    inline bool consume(char c)
+    {
+        this->ws();
+        if (this->_p < this->_end && *this->_p == c)
+        {
+            ++this->_p;
+            return true;
+        }
+        return false;
+    }
+
+    inline bool peek(char c)
+    {
+        this->ws();
+        return this->_p < this->_end && *this->_p == c;
+    }
+
+    // reads a string and returns its raw (still escaped) contents
+    bool string(std::string_view &out)
+    {
+        if (!this->consume('"'))
+        {
+            return false;
+        }
+
+        const auto begin = this->_p;
+        if (!this->skip_string_body())
+        {
+            return false;
+        }
+
+        out = std::string_view(begin, this->_p - begin - 1);
+        return true;
+    }
+
+    // skips any value and returns its raw text
+    bool value(std::string_view &out)
+    {
+        this->ws();
+        const auto begin = this->_p;
+        if (!this->skip_value())
+        {
+            return false;
+        }
+
+        out = std::string_view(begin, this->_p - begin);
+        return true;
+    }
+
+private:
+    const char *_p;
+    const char *_end;
+
+    // skips until after the closing quote, the opening quote is already consumed
+    bool skip_string_body()
+    {
+        while (this->_p < this->_end)
+        {
+            const auto quote = static_cast<const char*>(std::memchr(this->_p, '"', this->_end - this->_p));
+            if (!quote)
+            {
+                return false;
+            }
+
+            // count preceding backslashes, an odd count escapes the quote
+            auto backslash = quote;
+            while (backslash > this->_p && backslash[-1] == '\\')
+            {
+                --backslash;
+            }
+
+            this->_p = quote + 1;
+            if (((quote - backslash) & 1) == 0)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool skip_value()
+    {
+        if (this->_p >= this->_end)
+        {
+            return false;
+        }
+
+        switch (*this->_p)
+        {
+            case '"':
+                ++this->_p;
+                return this->skip_string_body();
+
+            case '{':
+            case '[': {
+                // skip nested containers by counting the depth, strings may contain brackets
+                std::size_t depth = 0;
+                while (this->_p < this->_end)
+                {
+                    const char c = *this->_p++;
+                    if (c == '"')
+                    {
+                        if (!this->skip_string_body())
+                        {
+                            return false;
+                        }
+                    }
+                    else if (c == '{' || c == '[')
+                    {
+                        ++depth;
+                    }
+                    else if (c == '}' || c == ']')
+                    {
+                        if (--depth == 0)
+                        {
+                            return true;
+                        }
+                    }
+                }
+                return false;
+            }
+
+            default: {
+                // literals and numbers, an empty one is invalid
+                const auto begin = this->_p;
+                while (this->_p < this->_end && *this->_p != ',' && *this->_p != '}' && *this->_p != ']' &&
+                       *this->_p != ' ' && *this->_p != '\n' && *this->_p != '\r' && *this->_p != '\t')
+                {
+                    ++this->_p;
+                }
+                return this->_p != begin;
+            }
+        }
+    }
+};
+
+template<typename T>
+static inline bool parse_number(std::string_view text, T &out)
+{
+    const auto res = std::from_chars(text.data(), text.data() + text.size(), out);
+    return res.ec == std::errc() && res.ptr == text.data() + text.size();
+}
+
+static Envelope scan_json(std::string_view frame)
+{
+    Envelope envelope;
+    envelope.encoding = Client::Encoding::JSON;
+
+    JsonScanner scanner(frame);
+    if (!scanner.consume('{'))
+    {
+        return {};
+    }
+
+    bool has_op = false;
+    if (!scanner.peek('}'))
+    {
+        do
+        {
+            std::string_view key, value;
+            if (!scanner.string(key) || !scanner.consume(':') || !scanner.value(value))
+            {
+                return {};
+            }
+
+            if (key == "op")
+            {
+                std::uint32_t op;
+                if (!parse_number(value, op))
+                {
+                    return {};
+                }
+                envelope.op = static_cast<Client::GatewayOpcode>(op);
+                has_op = true;
+            }
+            else if (key == "s")
+            {
+                if (value != "null" && !parse_number(value, envelope.s))
+                {
+                    return {};
+                }
+            }
+            else if (key == "t")
+            {
+                if (value != "null")
+                {
+                    // event names never contain escape sequences, strip the quotes
+                    if (value.size() < 2 || value.front() != '"')
+                    {
+                        return {};
+                    }
+                    envelope.t = value.substr(1, value.size() - 2);
+                }
+            }
+            else if (key == "d")
+            {
+                envelope.d = value;
+            }
+        } while (scanner.consume(','));
+    }
+
+    if (!scanner.consume('}') || !has_op)
+    {
+        return {};
+    }
+
+    envelope.valid = true;
+    return envelope;
+}
+
+static Envelope scan_etf(std::string_view frame)
+{
+    Envelope envelope;
+    envelope.encoding = Client::Encoding::ETF;
+
+    bool has_op = false;
+    try {
+        const auto ok = Utils::Etf::for_each_field(frame, [&](std::string_view key, std::string_view term) {
+            if (key == "op")
+            {
+                const auto op = Utils::Etf::decode_term(term);
+                if (op.is_number_integer())
+                {
+                    envelope.op = static_cast<Client::GatewayOpcode>(op.get<std::uint32_t>());
+                    has_op = true;
+                }
+            }
+            else if (key == "s")
+            {
+                const auto s = Utils::Etf::decode_term(term);
+                envelope.s = s.is_number_integer() ? s.get<std::uint32_t>() : 0;
+            }
+            else if (key == "t")
+            {
+                // atom or binary, the nil atom means no event name
+                envelope.t = Utils::Etf::text(term);
+                if (envelope.t == "nil")
+                {
+                    envelope.t = {};
+                }
+            }
+            else if (key == "d")
+            {
+                envelope.d = term;
+            }
+        });
+
+        if (!ok || !has_op)
+        {
+            return {};
+        }
+    } catch (Utils::Etf::error &) {
+        return {};
+    }
+
+    envelope.valid = true;
+    return envelope;
+}
+
+} // anonymous namespace
+
+Envelope Envelope::scan(std::string_view frame, Client::Encoding encoding)
+{
+    return encoding == Client::Encoding::ETF ? scan_etf(frame) : scan_json(frame);
+}
+
+json Envelope::data(JsonDecoder &decoder) const
+{
+    if (this->d.empty())
+    {
+        return nullptr;
+    }
+
+    return this->encoding == Client::Encoding::ETF ?
+        Utils::Etf::decode_term(this->d) :
+        decoder.decode(this->d);
+}
+
+Payload Envelope::payload(JsonDecoder &decoder) const
+{
+    Payload payload;
+    payload.op = this->op;
+    payload.msg = this->data(decoder); // move assigned, the event data is never copied
+    payload.s = this->s;
+    payload.t = std::string(this->t);
+    payload.event = event_from_name(this->t);
+    payload.valid = true;
+    return payload;
+}
+
+DISCORD_NS_END
@@ -0,0 +1,53 @@
+#ifndef DISCORD_ENVELOPE_HPP
+#define DISCORD_ENVELOPE_HPP
+
+#include "config.hpp"
+#include "client.hpp"
+
+#include <string_view>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+
+DISCORD_NS_BEGIN
+
+struct Payload;
+class JsonDecoder;
+
+/**
+ * Gateway Payload Envelope
+ *
+ * The envelope fields (op, s, t) obtained by a cheap scan of the received frame.
+ * The event data [d] is kept encoded as a view into the frame, so events
+ * nobody is interested in are never materialized.
+ *
+ * The views are only valid as long as the frame they were scanned from.
+ */
+struct Envelope
+{
+    bool valid = false;
+    Client::Encoding encoding = Client::Encoding::JSON;
+    Client::GatewayOpcode op = Client::GatewayOpcode::INVALID;  // opcode number [op]
+    std::uint32_t s = 0;                                        // sequence number [s], 0 when null
+    std::string_view t;                                         // event name [t], empty when null
+    std::string_view d;                                         // encoded event data [d]
+
+    /**
+     * Scans the envelope of a received frame.
+     */
+    static Envelope scan(std::string_view frame, Client::Encoding encoding);
+
+    /**
+     * Decodes the event data [d], JSON data is decoded with the given decoder.
+     */
+    nlohmann::json data(JsonDecoder &decoder) const;
+
+    /**
+     * Materializes the full payload, the event data is decoded directly into it.
+     */
+    Payload payload(JsonDecoder &decoder) const;
+};
+
+DISCORD_NS_END
+
+#endif // DISCORD_ENVELOPE_HPP
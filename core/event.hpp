@@ -0,0 +1,218 @@
+#ifndef DISCORD_EVENT_HPP
+#define DISCORD_EVENT_HPP
+
+#include "config.hpp"
+
+#include <string_view>
+#include <array>
+#include <bit>
+#include <type_traits>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+DISCORD_NS_BEGIN
+
+/**
+ * Gateway Events
+ * https://discord.com/developers/docs/topics/gateway#commands-and-events-gateway-events
+ */
+enum class Event : std::uint8_t
+{
+    UNKNOWN = 0,    // event name is not known to this library
+
+    READY,
+    RESUMED,
+    APPLICATION_COMMAND_CREATE,
+    APPLICATION_COMMAND_UPDATE,
+    APPLICATION_COMMAND_DELETE,
+    CHANNEL_CREATE,
+    CHANNEL_UPDATE,
+    CHANNEL_DELETE,
+    CHANNEL_PINS_UPDATE,
+    GUILD_CREATE,
+    GUILD_UPDATE,
+    GUILD_DELETE,
+    GUILD_BAN_ADD,
+    GUILD_BAN_REMOVE,
+    GUILD_EMOJIS_UPDATE,
+    GUILD_INTEGRATIONS_UPDATE,
+    GUILD_MEMBER_ADD,
+    GUILD_MEMBER_REMOVE,
+    GUILD_MEMBER_UPDATE,
+    GUILD_MEMBERS_CHUNK,
+    GUILD_ROLE_CREATE,
+    GUILD_ROLE_UPDATE,
+    GUILD_ROLE_DELETE,
+    INTEGRATION_CREATE,
+    INTEGRATION_UPDATE,
+    INTEGRATION_DELETE,
+    INTERACTION_CREATE,
+    INVITE_CREATE,
+    INVITE_DELETE,
+    MESSAGE_CREATE,
+    MESSAGE_UPDATE,
+    MESSAGE_DELETE,
+    MESSAGE_DELETE_BULK,
+    MESSAGE_REACTION_ADD,
+    MESSAGE_REACTION_REMOVE,
+    MESSAGE_REACTION_REMOVE_ALL,
+    MESSAGE_REACTION_REMOVE_EMOJI,
+    PRESENCE_UPDATE,
+    TYPING_START,
+    USER_UPDATE,
+    VOICE_STATE_UPDATE,
+    VOICE_SERVER_UPDATE,
+    WEBHOOKS_UPDATE,
+};
+
+// names of all events, indexed by the enum value
+static constexpr std::array<std::string_view, 44> EVENT_NAMES = {
+    "UNKNOWN",
+    "READY",
+    "RESUMED",
+    "APPLICATION_COMMAND_CREATE",
+    "APPLICATION_COMMAND_UPDATE",
+    "APPLICATION_COMMAND_DELETE",
+    "CHANNEL_CREATE",
+    "CHANNEL_UPDATE",
+    "CHANNEL_DELETE",
+    "CHANNEL_PINS_UPDATE",
+    "GUILD_CREATE",
+    "GUILD_UPDATE",
+    "GUILD_DELETE",
+    "GUILD_BAN_ADD",
+    "GUILD_BAN_REMOVE",
+    "GUILD_EMOJIS_UPDATE",
+    "GUILD_INTEGRATIONS_UPDATE",
+    "GUILD_MEMBER_ADD",
+    "GUILD_MEMBER_REMOVE",
+    "GUILD_MEMBER_UPDATE",
+    "GUILD_MEMBERS_CHUNK",
+    "GUILD_ROLE_CREATE",
+    "GUILD_ROLE_UPDATE",
+    "GUILD_ROLE_DELETE",
+    "INTEGRATION_CREATE",
+    "INTEGRATION_UPDATE",
+    "INTEGRATION_DELETE",
+    "INTERACTION_CREATE",
+    "INVITE_CREATE",
+    "INVITE_DELETE",
+    "MESSAGE_CREATE",
+    "MESSAGE_UPDATE",
+    "MESSAGE_DELETE",
+    "MESSAGE_DELETE_BULK",
+    "MESSAGE_REACTION_ADD",
+    "MESSAGE_REACTION_REMOVE",
+    "MESSAGE_REACTION_REMOVE_ALL",
+    "MESSAGE_REACTION_REMOVE_EMOJI",
+    "PRESENCE_UPDATE",
+    "TYPING_START",
+    "USER_UPDATE",
+    "VOICE_STATE_UPDATE",
+    "VOICE_SERVER_UPDATE",
+    "WEBHOOKS_UPDATE",
+};
+
+static constexpr std::size_t EVENT_COUNT = EVENT_NAMES.size();
+static_assert(static_cast<std::size_t>(Event::WEBHOOKS_UPDATE) + 1 == EVENT_COUNT, "EVENT_NAMES does not match Event");
+
+constexpr inline std::string_view event_name(Event event)
+{
+    return EVENT_NAMES[static_cast<std::size_t>(event)];
+}
+
+/**
+ * Perfect hash of the event names.
+ *
+ * The seed of the hash function is searched at compile time so that every
+ * known name lands in its own table slot. A lookup costs two word loads, a
+ * few multiplications and a single compare against the name in the slot.
+ */
+namespace EventHash
+{
+    static constexpr std::size_t BITS = 8;
+    static constexpr std::size_t SIZE = std::size_t(1) << BITS;
+
+    // up to 8 bytes of the name starting at pos, little endian
+    constexpr inline std::uint64_t load(std::string_view name, std::size_t pos)
+    {
+        // a single unaligned load at runtime, the byte order must match the compile time result
+        if (std::endian::native == std::endian::little && !std::is_constant_evaluated() && pos + 8 <= name.size())
+        {
+            std::uint64_t value;
+            std::memcpy(&value, name.data() + pos, sizeof(value));
+            return value;
+        }
+
+        std::uint64_t value = 0;
+        for (std::size_t i = 0; i < 8 && pos + i < name.size(); ++i)
+        {
+            value |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(name[pos + i])) << (8 * i);
+        }
+        return value;
+    }
+
+    // hashes the length and the first and last 8 bytes, which tell all event names apart
+    constexpr inline std::size_t slot(std::string_view name, std::uint32_t seed)
+    {
+        const auto first = load(name, 0);
+        const auto last = name.size() > 8 ? load(name, name.size() - 8) : 0;
+
+        auto hash = (first ^ seed) * 0x9E3779B97F4A7C15ull;
+        hash ^= (last + name.size()) * 0xC2B2AE3D27D4EB4Full;
+        hash ^= hash >> 29;
+        return static_cast<std::size_t>((hash * 0x94D049BB133111EBull) >> (64 - BITS));
+    }
+
+    constexpr std::uint32_t find_seed()
+    {
+        for (std::uint32_t seed = 0; seed < 100000; ++seed)
+        {
+            std::array<bool, SIZE> used{};
+            bool collision = false;
+
+            for (std::size_t i = 1; i < EVENT_COUNT && !collision; ++i)
+            {
+                const auto index = slot(EVENT_NAMES[i], seed);
+                collision = used[index];
+                used[index] = true;
+            }
+
+            if (!collision)
+            {
+                return seed;
+            }
+        }
+
+        return 0xFFFFFFFF;
+    }
+
+    static constexpr std::uint32_t SEED = find_seed();
+    static_assert(SEED != 0xFFFFFFFF, "no perfect hash seed for the event names");
+
+    constexpr std::array<Event, SIZE> build_table()
+    {
+        std::array<Event, SIZE> table{};
+        for (std::size_t i = 1; i < EVENT_COUNT; ++i)
+        {
+            table[slot(EVENT_NAMES[i], SEED)] = static_cast<Event>(i);
+        }
+        return table;
+    }
+
+    static constexpr std::array<Event, SIZE> TABLE = build_table();
+}
+
+/**
+ * Maps a gateway event name to its enum value, unknown names result in Event::UNKNOWN.
+ */
+constexpr inline Event event_from_name(std::string_view name)
+{
+    const auto event = EventHash::TABLE[EventHash::slot(name, EventHash::SEED)];
+    return event_name(event) == name ? event : Event::UNKNOWN;
+}
+
+DISCORD_NS_END
+
+#endif // DISCORD_EVENT_HPP
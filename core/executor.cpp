@@ -0,0 +1,424 @@
+#include "executor.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <exception>
+
+DISCORD_NS_BEGIN
+
+namespace
+{
+
+// logging tag
+static constexpr std::string_view TAG("Executor");
+
+} // anonymous namespace
+
+Executor::Executor(std::size_t threads)
+{
+    threads = std::max<std::size_t>(threads, 1);
+
+    for (std::size_t i = 0; i < threads; ++i)
+    {
+        this->_workers.emplace_back(std::make_unique<Worker>());
+    }
+
+    // start the threads after all queues exist, they are stolen from right away
+    for (std::size_t i = 0; i < threads; ++i)
+    {
+        this->_workers[i]->thr = std::thread([this, i]{
+            this->run(i);
+        });
+    }
+}
+
+Executor::~Executor()
+{
+    this->stop();
+}
+
+bool Executor::post(std::uint64_t key, Task task, Policy policy, CoalesceKey coalesce)
+{
+    if (!this->_running.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    // a post which supersedes a pending task does not add to the depth, it is not limited by the capacity
+    const auto replaces = policy == Policy::COALESCE && this->has_pending(key, coalesce);
+
+    bool waited = false;
+    const auto capacity = this->_capacity.load(std::memory_order_relaxed);
+    if (capacity != 0 && !replaces && this->_depth.load() >= capacity)
+    {
+        if (policy == Policy::BLOCK)
+        {
+            waited = true;
+            this->_blocked.fetch_add(1, std::memory_order_relaxed);
+
+            // pairs with release(), either the poster sees the space or the worker sees the poster
+            std::unique_lock lk{this->_space_mutex};
+            this->_waiting.fetch_add(1);
+            this->_space_cv.wait(lk, [&]{
+                return this->_depth.load() < capacity || !this->_running;
+            });
+            this->_waiting.fetch_sub(1);
+
+            if (!this->_running)
+            {
+                return waited;
+            }
+        }
+        else if (!this->drop_oldest())
+        {
+            // all pending tasks must be kept, the new one is the oldest droppable
+            this->_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    // counted before the task is visible to the workers, so the depth never drops below 0
+    const auto depth = this->_depth.fetch_add(1) + 1;
+    auto max_depth = this->_max_depth.load(std::memory_order_relaxed);
+    while (depth > max_depth && !this->_max_depth.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed));
+
+    Strand *runnable = nullptr;
+    std::uint64_t sequence;
+    bool superseded = false;
+    {
+        auto &stripe = this->stripe_of(key);
+        std::lock_guard lk{stripe.mutex};
+
+        // a new strand is queued, an existing one is already queued or running and picks the task up
+        auto [it, inserted] = stripe.strands.try_emplace(key);
+        auto &strand = it->second;
+        if (inserted)
+        {
+            // sequence numbers stay unique when a strand is removed and created again
+            strand.key = key;
+            strand.front = this->_generation.fetch_add(1, std::memory_order_relaxed) << 32;
+            runnable = &strand;
+        }
+
+        sequence = strand.front + strand.tasks.size();
+        if (policy == Policy::COALESCE)
+        {
+            // superseded under the same lock as the insert, so concurrent posts with the same key never both run
+            if (const auto previous = strand.pending.find(coalesce))
+            {
+                // the strand skips the empty entry, the new task is queued in order
+                strand.tasks[*previous - strand.front].task = nullptr;
+                superseded = true;
+            }
+            strand.pending.insert_or_assign(coalesce, sequence);
+        }
+        strand.tasks.emplace_back(Entry{std::move(task), policy == Policy::COALESCE, coalesce});
+    }
+
+    if (superseded)
+    {
+        this->_coalesced.fetch_add(1, std::memory_order_relaxed);
+        this->release(1);
+    }
+
+    // only a bounded executor drops tasks
+    if (capacity != 0 && policy != Policy::BLOCK)
+    {
+        bool compact;
+        {
+            std::lock_guard lk{this->_droppable_mutex};
+            this->_droppable.emplace_back(key, sequence);
+            compact = this->_droppable.size() > 2 * capacity + 1024;
+        }
+
+        if (compact)
+        {
+            this->compact_droppable();
+        }
+    }
+
+    if (runnable)
+    {
+        this->enqueue(mix(key) % this->_workers.size(), runnable);
+    }
+
+    return waited;
+}
+
+void Executor::stop()
+{
+    {
+        std::lock_guard lk{this->_mutex};
+        if (!this->_running)
+        {
+            return;
+        }
+        this->_running = false;
+    }
+    this->_cv.notify_all();
+
+    // posters waiting for space give up
+    {
+        std::lock_guard lk{this->_space_mutex};
+    }
+    this->_space_cv.notify_all();
+
+    // the workers drain all queues before they exit
+    for (auto&& worker : this->_workers)
+    {
+        if (worker->thr.joinable())
+        {
+            worker->thr.join();
+        }
+    }
+}
+
+Executor::Stats Executor::stats() const
+{
+    Stats stats;
+    stats.threads = this->_workers.size();
+    stats.depth = this->_depth.load(std::memory_order_relaxed);
+    stats.max_depth = this->_max_depth.load(std::memory_order_relaxed);
+    stats.executed = this->_executed.load(std::memory_order_relaxed);
+    stats.steals = this->_steals.load(std::memory_order_relaxed);
+    stats.blocked = this->_blocked.load(std::memory_order_relaxed);
+    stats.dropped = this->_dropped.load(std::memory_order_relaxed);
+    stats.coalesced = this->_coalesced.load(std::memory_order_relaxed);
+    return stats;
+}
+
+bool Executor::has_pending(std::uint64_t key, const CoalesceKey &coalesce)
+{
+    auto &stripe = this->stripe_of(key);
+    std::lock_guard lk{stripe.mutex};
+
+    const auto it = stripe.strands.find(key);
+    return it != stripe.strands.end() && it->second.pending.find(coalesce);
+}
+
+bool Executor::drop_oldest()
+{
+    for (;;)
+    {
+        std::pair<std::uint64_t, std::uint64_t> record;
+        {
+            std::lock_guard lk{this->_droppable_mutex};
+            if (this->_droppable.empty())
+            {
+                return false;
+            }
+            record = this->_droppable.front();
+            this->_droppable.pop_front();
+        }
+
+        const auto [key, sequence] = record;
+        {
+            auto &stripe = this->stripe_of(key);
+            std::lock_guard lk{stripe.mutex};
+
+            // the task may have run already
+            const auto it = stripe.strands.find(key);
+            if (it == stripe.strands.end())
+            {
+                continue;
+            }
+
+            auto &strand = it->second;
+            if (sequence < strand.front || sequence >= strand.front + strand.tasks.size())
+            {
+                continue;
+            }
+
+            auto &entry = strand.tasks[sequence - strand.front];
+            if (!entry.task)
+            {
+                continue;
+            }
+
+            if (entry.coalescing)
+            {
+                strand.pending.erase(entry.coalesce);
+            }
+
+            // the strand skips the empty entry
+            entry.task = nullptr;
+        }
+
+        this->_dropped.fetch_add(1, std::memory_order_relaxed);
+        this->release(1);
+        return true;
+    }
+}
+
+void Executor::compact_droppable()
+{
+    std::deque<std::pair<std::uint64_t, std::uint64_t>> records;
+    {
+        std::lock_guard lk{this->_droppable_mutex};
+        records.swap(this->_droppable);
+    }
+
+    std::deque<std::pair<std::uint64_t, std::uint64_t>> pending;
+    for (auto&& [key, sequence] : records)
+    {
+        auto &stripe = this->stripe_of(key);
+        std::lock_guard lk{stripe.mutex};
+
+        const auto it = stripe.strands.find(key);
+        if (it != stripe.strands.end() && sequence >= it->second.front && sequence < it->second.front + it->second.tasks.size())
+        {
+            pending.emplace_back(key, sequence);
+        }
+    }
+
+    // records added in the meantime are newer
+    std::lock_guard lk{this->_droppable_mutex};
+    this->_droppable.insert(this->_droppable.begin(), pending.begin(), pending.end());
+}
+
+void Executor::release(std::size_t count)
+{
+    this->_depth.fetch_sub(count);
+    if (this->_waiting.load() > 0)
+    {
+        { std::lock_guard lk{this->_space_mutex}; }
+        this->_space_cv.notify_all();
+    }
+}
+
+void Executor::enqueue(std::size_t worker, Strand *strand)
+{
+    {
+        auto &w = *this->_workers[worker];
+        std::lock_guard lk{w.mutex};
+        w.queue.emplace_back(strand);
+    }
+
+    // pairs with the sleeping counter in run(), either the sleeper sees the strand or we see the sleeper
+    this->_runnable.fetch_add(1);
+    if (this->_sleeping.load() > 0)
+    {
+        { std::lock_guard lk{this->_mutex}; }
+        this->_cv.notify_one();
+    }
+}
+
+Executor::Strand *Executor::dequeue(std::size_t worker)
+{
+    // own queue first, in order
+    {
+        auto &w = *this->_workers[worker];
+        std::lock_guard lk{w.mutex};
+        if (!w.queue.empty())
+        {
+            const auto strand = w.queue.front();
+            w.queue.pop_front();
+            this->_runnable.fetch_sub(1);
+            return strand;
+        }
+    }
+
+    // steal from the back of the other queues
+    for (std::size_t i = 1; i < this->_workers.size(); ++i)
+    {
+        auto &w = *this->_workers[(worker + i) % this->_workers.size()];
+        std::lock_guard lk{w.mutex};
+        if (!w.queue.empty())
+        {
+            const auto strand = w.queue.back();
+            w.queue.pop_back();
+            this->_runnable.fetch_sub(1);
+            this->_steals.fetch_add(1, std::memory_order_relaxed);
+            return strand;
+        }
+    }
+
+    return nullptr;
+}
+
+void Executor::run(std::size_t worker)
+{
+    for (;;)
+    {
+        const auto strand = this->dequeue(worker);
+        if (!strand)
+        {
+            std::unique_lock lk{this->_mutex};
+            this->_sleeping.fetch_add(1);
+            this->_cv.wait(lk, [this]{
+                return this->_runnable.load() > 0 || !this->_running;
+            });
+            this->_sleeping.fetch_sub(1);
+
+            if (!this->_running && this->_runnable.load() == 0)
+            {
+                return;
+            }
+            continue;
+        }
+
+        // queue the strand again behind the others when it has more tasks
+        if (this->run_strand(strand))
+        {
+            this->enqueue(worker, strand);
+        }
+    }
+}
+
+bool Executor::run_strand(Strand *strand)
+{
+    auto &stripe = this->stripe_of(strand->key);
+
+    for (std::size_t i = 0; i < BATCH; ++i)
+    {
+        Entry entry;
+        {
+            std::lock_guard lk{stripe.mutex};
+            if (strand->tasks.empty())
+            {
+                stripe.strands.erase(strand->key);
+                return false;
+            }
+
+            entry = std::move(strand->tasks.front());
+            strand->tasks.pop_front();
+
+            if (entry.coalescing)
+            {
+                const auto pending = strand->pending.find(entry.coalesce);
+                if (pending && *pending == strand->front)
+                {
+                    strand->pending.erase(entry.coalesce);
+                }
+            }
+            ++strand->front;
+        }
+
+        // dropped tasks were released already
+        if (!entry.task)
+        {
+            continue;
+        }
+
+        this->release(1);
+
+        try {
+            entry.task();
+        } catch (const std::exception &e) {
+            Utils::log_warning(TAG, "task of strand {} failed: {}", strand->key, e.what());
+        }
+
+        this->_executed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::lock_guard lk{stripe.mutex};
+    if (strand->tasks.empty())
+    {
+        stripe.strands.erase(strand->key);
+        return false;
+    }
+
+    return true;
+}
+
+DISCORD_NS_END
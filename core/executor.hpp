@@ -0,0 +1,205 @@
+#ifndef DISCORD_EXECUTOR_HPP
+#define DISCORD_EXECUTOR_HPP
+
+#include "config.hpp"
+#include "utils/flat_map.hpp"
+
+#include <functional>
+#include <vector>
+#include <deque>
+#include <array>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+DISCORD_NS_BEGIN
+
+/**
+ * Work-stealing event executor
+ *
+ * Tasks are posted with an ordering key, for example a guild id. Tasks with
+ * the same key form a strand and run one after another in posting order,
+ * tasks with different keys run in parallel.
+ *
+ * Each worker thread has its own queue of runnable strands. A strand is
+ * queued on the worker its key maps to, workers without work steal strands
+ * from the other queues. A strand runs a limited batch of tasks at a time
+ * and is queued again when more are pending, so a busy guild can not starve
+ * the others.
+ *
+ * The amount of pending tasks can be bounded, the policy of a task decides
+ * what happens when the executor is full.
+ */
+class Executor
+{
+public:
+    using Task = std::function<void()>;
+
+    /**
+     * Queueing policy of a task.
+     */
+    enum class Policy
+    {
+        BLOCK,          // the poster waits until there is space
+        DROP_OLDEST,    // the oldest pending droppable task is discarded, or this one when there is none
+        COALESCE,       // discards a pending task with the same coalescing key, dropped like DROP_OLDEST when full
+    };
+
+    /**
+     * Identity of a coalescing task, for example an event type and a user id.
+     */
+    struct CoalesceKey
+    {
+        std::uint32_t kind = 0;
+        std::uint64_t id = 0;
+
+        constexpr bool operator== (const CoalesceKey&) const = default;
+    };
+
+    /**
+     * Executor statistics
+     */
+    struct Stats
+    {
+        std::size_t threads = 0;
+        std::uint64_t depth = 0;        // tasks waiting to run
+        std::uint64_t max_depth = 0;    // highest depth seen
+        std::uint64_t executed = 0;     // tasks run so far
+        std::uint64_t steals = 0;       // strands taken from another worker's queue
+        std::uint64_t blocked = 0;      // posts which waited for space
+        std::uint64_t dropped = 0;      // tasks discarded because the executor was full
+        std::uint64_t coalesced = 0;    // tasks superseded by a newer one
+    };
+
+    explicit Executor(std::size_t threads);
+    ~Executor();
+
+    Executor(const Executor&) = delete;
+    Executor &operator= (const Executor&) = delete;
+
+    /**
+     * Limits the amount of pending tasks, 0 (default) means unbounded.
+     */
+    inline void set_capacity(std::size_t capacity)
+    {
+        this->_capacity.store(capacity, std::memory_order_relaxed);
+    }
+
+    /**
+     * Queues a task behind all tasks posted with the same key.
+     * Returns true when the caller had to wait for space.
+     */
+    bool post(std::uint64_t key, Task task, Policy policy, CoalesceKey coalesce);
+
+    inline bool post(std::uint64_t key, Task task, Policy policy = Policy::BLOCK)
+    {
+        return this->post(key, std::move(task), policy, CoalesceKey{});
+    }
+
+    /**
+     * Runs the remaining tasks and stops the worker threads.
+     * Tasks posted afterwards are discarded.
+     */
+    void stop();
+
+    Stats stats() const;
+
+private:
+    // tasks run by a strand before it yields its worker
+    static constexpr std::size_t BATCH = 16;
+    static constexpr std::size_t STRIPES = 16;
+
+    struct CoalesceKeyHash
+    {
+        inline std::size_t operator() (const CoalesceKey &key) const noexcept
+        {
+            return static_cast<std::size_t>(key.id * 31 + key.kind);
+        }
+    };
+
+    struct Entry
+    {
+        Task task;                  // empty when the task was dropped
+        bool coalescing = false;
+        CoalesceKey coalesce;
+    };
+
+    struct Strand
+    {
+        std::uint64_t key = 0;
+        std::deque<Entry> tasks;
+        std::uint64_t front = 0;    // sequence number of tasks.front()
+        Utils::FlatMap<CoalesceKey, std::uint64_t, CoalesceKeyHash> pending; // sequence number of pending coalescing tasks
+    };
+
+    // strands by key, a strand exists while it has tasks and is queued or running
+    struct alignas(64) Stripe
+    {
+        std::mutex mutex;
+        std::unordered_map<std::uint64_t, Strand> strands;
+    };
+
+    struct alignas(64) Worker
+    {
+        std::thread thr;
+        std::mutex mutex;
+        std::deque<Strand*> queue;  // runnable strands
+    };
+
+    std::array<Stripe, STRIPES> _stripes;
+    std::vector<std::unique_ptr<Worker>> _workers;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::atomic<std::size_t> _runnable = 0; // queued strands over all workers
+    std::atomic<std::size_t> _sleeping = 0; // workers waiting for strands
+    std::atomic<bool> _running = true;
+
+    std::atomic<std::size_t> _capacity = 0;
+    std::mutex _space_mutex;
+    std::condition_variable _space_cv;
+    std::atomic<std::size_t> _waiting = 0;  // posters waiting for space
+
+    // droppable tasks in posting order as strand key and sequence number, tasks which ran already are skipped
+    std::mutex _droppable_mutex;
+    std::deque<std::pair<std::uint64_t, std::uint64_t>> _droppable;
+
+    std::atomic<std::uint64_t> _generation = 0; // strands created so far
+
+    std::atomic<std::uint64_t> _depth = 0;
+    std::atomic<std::uint64_t> _max_depth = 0;
+    std::atomic<std::uint64_t> _executed = 0;
+    std::atomic<std::uint64_t> _steals = 0;
+    std::atomic<std::uint64_t> _blocked = 0;
+    std::atomic<std::uint64_t> _dropped = 0;
+    std::atomic<std::uint64_t> _coalesced = 0;
+
+    static inline std::size_t mix(std::uint64_t key)
+    {
+        return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> 32);
+    }
+
+    inline Stripe &stripe_of(std::uint64_t key)
+    {
+        return this->_stripes[mix(key) % STRIPES];
+    }
+
+    // whether a task with the coalescing key is pending, only a hint since the task may start any time
+    bool has_pending(std::uint64_t key, const CoalesceKey &coalesce);
+    bool drop_oldest();
+    void compact_droppable();
+    void release(std::size_t count);
+
+    void enqueue(std::size_t worker, Strand *strand);
+    Strand *dequeue(std::size_t worker);
+    void run(std::size_t worker);
+    bool run_strand(Strand *strand);
+};
+
+DISCORD_NS_END
+
+#endif // DISCORD_EXECUTOR_HPP
@@ -0,0 +1,78 @@
+#ifndef DISCORD_GATEWAY_HPP
+#define DISCORD_GATEWAY_HPP
+
+#include "config.hpp"
+#include "client.hpp"
+
+#include <string>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+
+#include <fmt/format.h>
+
+#include <magic_enum.hpp>
+
+DISCORD_NS_BEGIN
+
+/**
+ * Gateway Response
+ */
+struct Gateway
+{
+    std::string url;
+    std::uint32_t shards;
+
+    struct
+    {
+        std::uint32_t total;
+        std::uint32_t remaining;
+        std::uint32_t reset_after;
+        std::uint32_t max_concurrency;
+    } limit;
+};
+
+/**
+ * WebSocket Payload
+ * https://discord.com/developers/docs/topics/gateway#payloads
+ *
+ * s and t are optimal and can be null
+ */
+struct Payload
+{
+    bool valid = false;
+    Client::GatewayOpcode op;   // opcode number [op]
+    nlohmann::json msg;         // event data [d]
+    std::uint32_t s;            // sequence number, used for resuming sessions and heartbeats [s]
+    std::string t;              // the event name for this payload [t]
+    Event event = Event::UNKNOWN; // the event of the name [t]
+};
+
+DISCORD_NS_END
+
+template<>
+struct fmt::formatter<Discord::Payload>
+{
+    constexpr auto parse(format_parse_context &ctx)
+    {
+        return ctx.begin();
+    }
+
+    template<typename FormatContext>
+    auto format(const Discord::Payload &pl, FormatContext &ctx)
+    {
+        if (pl.valid)
+        {
+            return format_to(
+                ctx.out(),
+                "Payload{{op={} ({}), d={}, s={}, t=\"{}\"}}",
+                magic_enum::enum_name(pl.op), static_cast<std::uint32_t>(pl.op), pl.msg.dump(), pl.s, pl.t);
+        }
+        else
+        {
+            return format_to(ctx.out(), "Payload{{invalid}}");
+        }
+    }
+};
+
+#endif // DISCORD_GATEWAY_HPP
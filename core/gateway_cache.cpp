@@ -0,0 +1,202 @@
+#include "gateway_cache.hpp"
+#include "utils/log.hpp"
+#include "utils/file.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+DISCORD_NS_BEGIN
+
+namespace
+{
+
+// logging tag
+static constexpr std::string_view TAG("GatewayCache");
+
+// file format version, files of other versions are ignored
+static constexpr std::uint32_t VERSION = 1;
+
+// length of a session start limit window
+static constexpr auto LIMIT_WINDOW = std::chrono::hours(24);
+
+static std::int64_t to_unix_ms(std::chrono::system_clock::time_point tp)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count();
+}
+
+static std::chrono::system_clock::time_point from_unix_ms(std::int64_t ms)
+{
+    return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::milliseconds(ms)));
+}
+
+} // anonymous namespace
+
+GatewayCache::GatewayCache(const std::string &path, std::chrono::seconds ttl)
+    : _path(path),
+      _ttl(ttl)
+{
+}
+
+std::optional<Gateway> GatewayCache::load()
+{
+    std::lock_guard lk{this->_mutex};
+
+    if (!this->_gateway && !this->_path.empty())
+    {
+        std::ifstream ifs(this->_path, std::ios::in | std::ios::binary);
+        if (!ifs.is_open())
+        {
+            return std::nullopt;
+        }
+
+        try {
+            const auto j = json::parse(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+            if (j.at("version").get<std::uint32_t>() != VERSION)
+            {
+                Utils::log_warning(TAG, "ignoring gateway of file version {}", j.at("version").get<std::uint32_t>());
+                return std::nullopt;
+            }
+
+            const auto &limit = j.at("session_start_limit");
+            Gateway gateway;
+            gateway.url = j.at("url").get<std::string>();
+            gateway.shards = j.at("shards").get<std::uint32_t>();
+            gateway.limit = {
+                limit.at("total").get<std::uint32_t>(),
+                limit.at("remaining").get<std::uint32_t>(),
+                0,
+                limit.at("max_concurrency").get<std::uint32_t>(),
+            };
+
+            this->_gateway = std::move(gateway);
+            this->_fetched = from_unix_ms(j.at("fetched").get<std::int64_t>());
+            this->_reset_at = from_unix_ms(limit.at("reset_at").get<std::int64_t>());
+            this->_borrowed = limit.at("borrowed").get<std::uint32_t>();
+        } catch (json::exception &e) {
+            Utils::log_warning(TAG, "ignoring invalid gateway file {}: {}", this->_path, e.what());
+            return std::nullopt;
+        }
+    }
+
+    if (!this->_gateway)
+    {
+        return std::nullopt;
+    }
+
+    const auto now = clock::now();
+    this->roll_over(now);
+
+    auto gateway = *this->_gateway;
+    gateway.limit.reset_after = static_cast<std::uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(this->_reset_at - now).count());
+    return gateway;
+}
+
+bool GatewayCache::fresh() const
+{
+    std::lock_guard lk{this->_mutex};
+    const auto age = clock::now() - this->_fetched;
+    return this->_gateway && age >= clock::duration::zero() && age < this->_ttl;
+}
+
+void GatewayCache::store(const Gateway &gateway)
+{
+    std::lock_guard lk{this->_mutex};
+
+    // the response is authoritative, it already accounts for all identifies
+    this->_gateway = gateway;
+    this->_fetched = clock::now();
+    this->_reset_at = this->_fetched + std::chrono::milliseconds(gateway.limit.reset_after);
+    this->_borrowed = 0;
+
+    this->save();
+}
+
+std::chrono::milliseconds GatewayCache::consume_identify()
+{
+    std::lock_guard lk{this->_mutex};
+
+    if (!this->_gateway)
+    {
+        return std::chrono::milliseconds::zero();
+    }
+
+    const auto now = clock::now();
+    this->roll_over(now);
+
+    auto &limit = this->_gateway->limit;
+    auto wait = std::chrono::milliseconds::zero();
+    if (limit.remaining > 0)
+    {
+        --limit.remaining;
+    }
+    else
+    {
+        // the identify takes one of the next window, which may itself be used up already
+        const auto windows = limit.total == 0 ? 0 : this->_borrowed / limit.total;
+        ++this->_borrowed;
+        wait = std::chrono::ceil<std::chrono::milliseconds>(this->_reset_at - now) + windows * LIMIT_WINDOW;
+
+        Utils::log_warning(TAG, "session start limit of {} exhausted, identify delayed by {}s",
+            limit.total, std::chrono::duration_cast<std::chrono::seconds>(wait).count());
+    }
+
+    this->save();
+    return wait;
+}
+
+void GatewayCache::roll_over(clock::time_point now)
+{
+    if (now < this->_reset_at)
+    {
+        return;
+    }
+
+    auto &limit = this->_gateway->limit;
+    const auto windows = (now - this->_reset_at) / LIMIT_WINDOW + 1;
+    this->_reset_at += windows * LIMIT_WINDOW;
+
+    // identifies borrowed from windows which passed meanwhile are gone, the rest reduce the budget of the new window
+    const auto passed = static_cast<std::uint64_t>(windows - 1) * limit.total;
+    const auto borrowed = static_cast<std::uint32_t>(this->_borrowed - std::min<std::uint64_t>(this->_borrowed, passed));
+    const auto used = std::min(borrowed, limit.total);
+    limit.remaining = limit.total - used;
+    this->_borrowed = borrowed - used;
+}
+
+void GatewayCache::save() const
+{
+    if (this->_path.empty())
+    {
+        return;
+    }
+
+    const auto &gateway = *this->_gateway;
+    const json j = {
+        {"version", VERSION},
+        {"url", gateway.url},
+        {"shards", gateway.shards},
+        {"session_start_limit", {
+            {"total", gateway.limit.total},
+            {"remaining", gateway.limit.remaining},
+            {"max_concurrency", gateway.limit.max_concurrency},
+            {"reset_at", to_unix_ms(this->_reset_at)},
+            {"borrowed", this->_borrowed},
+        }},
+        {"fetched", to_unix_ms(this->_fetched)},
+    };
+
+    if (!Utils::write_file_atomic(this->_path, j.dump()))
+    {
+        Utils::log_warning(TAG, "failed to save the gateway to {}: {}", this->_path, std::strerror(errno));
+    }
+}
+
+DISCORD_NS_END
@@ -0,0 +1,70 @@
+#ifndef DISCORD_GATEWAY_CACHE_HPP
+#define DISCORD_GATEWAY_CACHE_HPP
+
+#include "config.hpp"
+#include "gateway.hpp"
+
+#include <string>
+#include <optional>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+DISCORD_NS_BEGIN
+
+/**
+ * Keeps the last /gateway/bot response in a small file, so a restarted client
+ * connects right away and refreshes the response in the background.
+ *
+ * The session start limit is tracked locally between responses: every IDENTIFY
+ * takes one from the remaining budget and is persisted, restarts within the
+ * reset window continue with the budget left by the previous run.
+ *
+ * An empty path keeps the response in memory only.
+ */
+class GatewayCache
+{
+public:
+    GatewayCache(const std::string &path, std::chrono::seconds ttl);
+
+    /**
+     * Cached response, empty when the file is missing, invalid or of another version.
+     * The limit is the locally tracked budget with reset_after relative to now.
+     */
+    std::optional<Gateway> load();
+
+    /**
+     * True when the cached response is younger than the TTL.
+     */
+    bool fresh() const;
+
+    /**
+     * Replaces the cached response and the identify budget with a fresh response.
+     */
+    void store(const Gateway &gateway);
+
+    /**
+     * Takes one IDENTIFY from the budget. Returns how long the IDENTIFY must wait,
+     * zero unless the budget is exhausted, then it is delayed until the reset.
+     */
+    std::chrono::milliseconds consume_identify();
+
+private:
+    using clock = std::chrono::system_clock;
+
+    const std::string _path;
+    const std::chrono::seconds _ttl;
+
+    mutable std::mutex _mutex;
+    std::optional<Gateway> _gateway;
+    clock::time_point _fetched;     // time of the response
+    clock::time_point _reset_at;    // end of the current session start limit window
+    std::uint32_t _borrowed = 0;    // identifies taken from the next window
+
+    void roll_over(clock::time_point now);
+    void save() const;
+};
+
+DISCORD_NS_END
+
+#endif // DISCORD_GATEWAY_CACHE_HPP
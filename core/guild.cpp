@@ -0,0 +1,92 @@
+#include "guild.hpp"
+#include "utils/json.hpp"
+
+DISCORD_NS_BEGIN
+
+void from_json(const nlohmann::json &j, Role &role)
+{
+    using Utils::get_json_value;
+
+    role.id = get_json_value<Snowflake>(j, "id");
+    role.name = get_json_value<std::string>(j, "name");
+    role.color = get_json_value<std::uint32_t>(j, "color");
+    role.hoist = get_json_value<bool>(j, "hoist");
+    role.position = get_json_value<int>(j, "position");
+    role.managed = get_json_value<bool>(j, "managed");
+    role.mentionable = get_json_value<bool>(j, "mentionable");
+
+    // permission bit sets are strings since API v8, numbers before
+    const auto permissions = j.find("permissions");
+    if (permissions != j.end() && permissions->is_string())
+    {
+        role.permissions = std::strtoull(permissions->get_ref<const std::string&>().c_str(), nullptr, 10);
+    }
+    else
+    {
+        role.permissions = get_json_value<std::uint64_t>(j, "permissions");
+    }
+}
+
+void from_json(const nlohmann::json &j, Member &member)
+{
+    using Utils::get_json_value;
+
+    member.guild_id = get_json_value<Snowflake>(j, "guild_id");
+    if (const auto user = j.find("user"); user != j.end())
+    {
+        member.user_id = get_json_value<Snowflake>(*user, "id");
+    }
+    member.nick = get_json_value<std::string>(j, "nick");
+    member.joined_at = get_json_value<std::string>(j, "joined_at");
+    member.premium_since = get_json_value<std::string>(j, "premium_since");
+    member.deaf = get_json_value<bool>(j, "deaf");
+    member.mute = get_json_value<bool>(j, "mute");
+
+    member.roles.clear();
+    if (const auto roles = j.find("roles"); roles != j.end() && roles->is_array())
+    {
+        member.roles.reserve(roles->size());
+        for (auto&& role : *roles)
+        {
+            member.roles.emplace_back(role.get<Snowflake>());
+        }
+    }
+}
+
+void from_json(const nlohmann::json &j, Guild &guild)
+{
+    using Utils::get_json_value;
+
+    guild.id = get_json_value<Snowflake>(j, "id");
+    guild.name = get_json_value<std::string>(j, "name");
+    guild.icon = get_json_value<std::string>(j, "icon");
+    guild.owner_id = get_json_value<Snowflake>(j, "owner_id");
+    guild.region = get_json_value<std::string>(j, "region");
+    guild.system_channel_id = get_json_value<Snowflake>(j, "system_channel_id");
+    guild.member_count = get_json_value<int>(j, "member_count");
+    guild.large = get_json_value<bool>(j, "large");
+    guild.unavailable = get_json_value<bool>(j, "unavailable");
+
+    // roles and channels are stored separately, only their ids are kept here
+    guild.roles.clear();
+    if (const auto roles = j.find("roles"); roles != j.end() && roles->is_array())
+    {
+        guild.roles.reserve(roles->size());
+        for (auto&& role : *roles)
+        {
+            guild.roles.emplace_back(get_json_value<Snowflake>(role, "id"));
+        }
+    }
+
+    guild.channels.clear();
+    if (const auto channels = j.find("channels"); channels != j.end() && channels->is_array())
+    {
+        guild.channels.reserve(channels->size());
+        for (auto&& channel : *channels)
+        {
+            guild.channels.emplace_back(get_json_value<Snowflake>(channel, "id"));
+        }
+    }
+}
+
+DISCORD_NS_END
@@ -0,0 +1,97 @@
+#ifndef DISCORD_GUILD_HPP
+#define DISCORD_GUILD_HPP
+
+#include "config.hpp"
+#include "snowflake.hpp"
+#include "user.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <nlohmann/json_fwd.hpp>
+
+DISCORD_NS_BEGIN
+
+/**
+ * Discord Role
+ * https://discord.com/developers/docs/topics/permissions#role-object
+ */
+struct Role
+{
+    Snowflake id;                   // role id
+    std::string name;               // role name
+    std::uint32_t color = 0;        // integer representation of hexadecimal color code
+    bool hoist = false;             // if this role is pinned in the user listing
+    int position = 0;               // position of this role
+    std::uint64_t permissions = 0;  // permission bit set
+    bool managed = false;           // whether this role is managed by an integration
+    bool mentionable = false;       // whether this role is mentionable
+
+    /**
+     * Check if role has an id.
+     */
+    inline operator bool() const
+    {
+        return static_cast<bool>(this->id);
+    }
+};
+
+/**
+ * Discord Guild Member
+ * https://discord.com/developers/docs/resources/guild#guild-member-object
+ */
+struct Member
+{
+    Snowflake guild_id;             // the guild this member belongs to
+    Snowflake user_id;              // the user this guild member represents
+    std::string nick;               // this users guild nickname
+    std::vector<Snowflake> roles;   // array of role ids
+    std::string joined_at;          // when the user joined the guild
+    std::string premium_since;      // when the user started boosting the guild
+    bool deaf = false;              // whether the user is deafened in voice channels
+    bool mute = false;              // whether the user is muted in voice channels
+
+    /**
+     * Check if member has a user.
+     */
+    inline operator bool() const
+    {
+        return static_cast<bool>(this->user_id);
+    }
+};
+
+/**
+ * Discord Guild
+ * https://discord.com/developers/docs/resources/guild#guild-object
+ */
+struct Guild
+{
+    Snowflake id;                       // guild id
+    std::string name;                   // guild name (2-100 characters, excluding trailing and leading whitespace)
+    std::string icon;                   // icon hash
+    Snowflake owner_id;                 // id of owner
+    std::string region;                 // voice region id for the guild
+    Snowflake system_channel_id;        // the id of the channel where guild notices such as welcome messages and boost events are posted
+    int member_count = 0;               // total number of members in this guild
+    bool large = false;                 // true if this is considered a large guild
+    bool unavailable = false;           // true if this guild is unavailable due to an outage
+    std::vector<Snowflake> roles;       // ids of the roles in the guild
+    std::vector<Snowflake> channels;    // ids of the channels in the guild
+
+    /**
+     * Check if guild has an id.
+     */
+    inline operator bool() const
+    {
+        return static_cast<bool>(this->id);
+    }
+};
+
+void from_json(const nlohmann::json &j, Role &role);
+void from_json(const nlohmann::json &j, Member &member);
+void from_json(const nlohmann::json &j, Guild &guild);
+
+DISCORD_NS_END
+
+#endif // DISCORD_GUILD_HPP
@@ -0,0 +1,300 @@
+#include "http_connection.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+#include <ixwebsocket/IXSocket.h>
+#include <ixwebsocket/IXSocketFactory.h>
+#include <ixwebsocket/IXSocketTLSOptions.h>
+
+DISCORD_NS_BEGIN
+
+namespace
+{
+
+static inline std::string_view trim(std::string_view str)
+{
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+    {
+        str.remove_prefix(1);
+    }
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t'))
+    {
+        str.remove_suffix(1);
+    }
+    return str;
+}
+
+static inline std::string lowercase(std::string_view str)
+{
+    std::string res(str);
+    std::transform(res.begin(), res.end(), res.begin(), [](unsigned char c){ return std::tolower(c); });
+    return res;
+}
+
+} // anonymous namespace
+
+HttpConnection::HttpConnection(const std::string &host, int port, bool tls)
+    : _host(host),
+      _port(port),
+      _tls(tls)
+{
+}
+
+HttpConnection::~HttpConnection()
+{
+    this->close();
+}
+
+bool HttpConnection::connect(std::string &error)
+{
+    this->close();
+
+    ix::SocketTLSOptions tls_options;
+    tls_options.tls = this->_tls;
+
+    auto socket = ix::createSocket(this->_tls, -1, error, tls_options);
+    if (!socket)
+    {
+        return false;
+    }
+
+    if (!socket->connect(this->_host, this->_port, error, []{ return false; }))
+    {
+        return false;
+    }
+
+    this->_socket = std::move(socket);
+    return true;
+}
+
+bool HttpConnection::alive()
+{
+    if (!this->_socket)
+    {
+        return false;
+    }
+
+    // an idle connection only becomes readable when the server closed it,
+    // for TLS it may also be a handshake record which is consumed silently
+    if (this->_socket->isReadyToRead(0) == ix::PollResultType::ReadyForRead)
+    {
+        char tmp[512];
+        const auto size = this->_socket->recv(tmp, sizeof(tmp));
+        if (size == 0 || (size < 0 && !ix::Socket::isWaitNeeded()))
+        {
+            this->close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void HttpConnection::close()
+{
+    if (this->_socket)
+    {
+        this->_socket->close();
+        this->_socket.reset();
+    }
+
+    this->_buffer.clear();
+}
+
+HttpConnection::Result HttpConnection::perform(const std::string &request, RestClient::Response &response)
+{
+    if (!this->_socket)
+    {
+        response.error = "not connected";
+        return Result::FAILED;
+    }
+
+    this->_buffer.clear();
+
+    if (!this->_socket->writeBytes(request, []{ return false; }))
+    {
+        response.error = "failed to send request";
+        this->close();
+        return Result::STALE;
+    }
+
+    // response head
+    std::size_t head_end;
+    while ((head_end = this->_buffer.find("\r\n\r\n")) == std::string::npos)
+    {
+        if (!this->fill())
+        {
+            const auto stale = this->_buffer.empty();
+            response.error = "connection closed while receiving the response";
+            this->close();
+            return stale ? Result::STALE : Result::FAILED;
+        }
+    }
+
+    // status line: HTTP/1.1 200 OK
+    const std::string_view head(this->_buffer.data(), head_end);
+    auto line_end = head.find("\r\n");
+    const auto status_line = head.substr(0, line_end);
+    const auto status_pos = status_line.find(' ');
+    if (status_pos == std::string_view::npos || status_line.substr(0, 5) != "HTTP/")
+    {
+        response.error = "invalid status line";
+        this->close();
+        return Result::FAILED;
+    }
+    response.status = std::atoi(std::string(status_line.substr(status_pos + 1, 3)).c_str());
+
+    // headers
+    while (line_end != std::string_view::npos)
+    {
+        const auto start = line_end + 2;
+        line_end = head.find("\r\n", start);
+        const auto line = head.substr(start, line_end == std::string_view::npos ? std::string_view::npos : line_end - start);
+
+        const auto colon = line.find(':');
+        if (colon != std::string_view::npos)
+        {
+            response.headers.insert_or_assign(lowercase(trim(line.substr(0, colon))), std::string(trim(line.substr(colon + 1))));
+        }
+    }
+
+    auto keep_alive = lowercase(response.header("connection")) != "close";
+    std::size_t pos = head_end + 4;
+
+    // body
+    if (lowercase(response.header("transfer-encoding")).find("chunked") != std::string::npos)
+    {
+        if (!this->read_chunked(pos, response.body))
+        {
+            response.error = "failed to receive the chunked response body";
+            this->close();
+            return Result::FAILED;
+        }
+    }
+    else if (const auto length = response.header("content-length"); !length.empty())
+    {
+        const auto size = std::strtoull(std::string(length).c_str(), nullptr, 10);
+        if (!this->read_until(pos + size))
+        {
+            response.error = "failed to receive the response body";
+            this->close();
+            return Result::FAILED;
+        }
+        response.body.assign(this->_buffer, pos, size);
+        pos += size;
+    }
+    else if (response.status >= 200 && response.status != 204 && response.status != 304)
+    {
+        // body is delimited by the end of the connection
+        while (this->fill());
+        response.body.assign(this->_buffer, pos);
+        pos = this->_buffer.size();
+        keep_alive = false;
+    }
+
+    if (keep_alive)
+    {
+        this->_buffer.erase(0, pos);
+    }
+    else
+    {
+        this->close();
+    }
+
+    return Result::OK;
+}
+
+bool HttpConnection::fill()
+{
+    char tmp[16384];
+
+    for (;;)
+    {
+        const auto size = this->_socket->recv(tmp, sizeof(tmp));
+        if (size > 0)
+        {
+            this->_buffer.append(tmp, static_cast<std::size_t>(size));
+            return true;
+        }
+
+        if (size == 0 || !ix::Socket::isWaitNeeded())
+        {
+            return false;
+        }
+
+        if (this->_socket->isReadyToRead(TIMEOUT_MS) != ix::PollResultType::ReadyForRead)
+        {
+            return false;
+        }
+    }
+}
+
+bool HttpConnection::read_until(std::size_t size)
+{
+    while (this->_buffer.size() < size)
+    {
+        if (!this->fill())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool HttpConnection::read_line(std::size_t &pos, std::string &line)
+{
+    std::size_t end;
+    while ((end = this->_buffer.find("\r\n", pos)) == std::string::npos)
+    {
+        if (!this->fill())
+        {
+            return false;
+        }
+    }
+
+    line.assign(this->_buffer, pos, end - pos);
+    pos = end + 2;
+    return true;
+}
+
+bool HttpConnection::read_chunked(std::size_t &pos, std::string &body)
+{
+    std::string line;
+
+    for (;;)
+    {
+        // chunk size in hex, optionally followed by extensions
+        if (!this->read_line(pos, line))
+        {
+            return false;
+        }
+
+        const auto size = std::strtoull(line.c_str(), nullptr, 16);
+        if (size == 0)
+        {
+            // skip trailers until the final empty line
+            do
+            {
+                if (!this->read_line(pos, line))
+                {
+                    return false;
+                }
+            } while (!line.empty());
+
+            return true;
+        }
+
+        if (!this->read_until(pos + size + 2))
+        {
+            return false;
+        }
+
+        body.append(this->_buffer, pos, size);
+        pos += size + 2;
+    }
+}
+
+DISCORD_NS_END
@@ -0,0 +1,74 @@
+#ifndef DISCORD_HTTP_CONNECTION_HPP
+#define DISCORD_HTTP_CONNECTION_HPP
+
+#include "config.hpp"
+#include "rest_client.hpp"
+
+#include <string>
+#include <memory>
+
+// IXWebSocket forward declarations
+namespace ix
+{
+    class Socket;
+}
+
+DISCORD_NS_BEGIN
+
+/**
+ * A persistent HTTP/1.1 connection.
+ *
+ * Requests are written as is, responses are parsed with support for
+ * Content-Length and chunked bodies. The connection stays open after a
+ * response unless the server asked to close it.
+ */
+class HttpConnection
+{
+public:
+    enum class Result
+    {
+        OK,         // response received
+        STALE,      // the connection was closed before any response byte arrived, the request may be retried
+        FAILED,     // the request failed
+    };
+
+    HttpConnection(const std::string &host, int port, bool tls);
+    ~HttpConnection();
+
+    /**
+     * Opens the connection, performs the TLS handshake when enabled.
+     */
+    bool connect(std::string &error);
+
+    /**
+     * Whether the connection is open and was not closed by the peer while idle.
+     */
+    bool alive();
+
+    void close();
+
+    /**
+     * Sends a serialized request and receives the response.
+     */
+    Result perform(const std::string &request, RestClient::Response &response);
+
+private:
+    // receive timeout of a response
+    static constexpr int TIMEOUT_MS = 15000;
+
+    std::string _host;
+    int _port;
+    bool _tls;
+
+    std::unique_ptr<ix::Socket> _socket;
+    std::string _buffer;    // received bytes which are not consumed yet
+
+    bool fill();
+    bool read_until(std::size_t size);
+    bool read_line(std::size_t &pos, std::string &line);
+    bool read_chunked(std::size_t &pos, std::string &body);
+};
+
+DISCORD_NS_END
+
+#endif // DISCORD_HTTP_CONNECTION_HPP
@@ -0,0 +1,177 @@
+#include "json_decoder.hpp"
+
+#ifdef DISCORD_WITH_SIMDJSON
+#include <vector>
+#include <cstring>
+
+#include <simdjson.h>
+#endif
+
+using json = nlohmann::json;
+
+DISCORD_NS_BEGIN
+
+namespace
+{
+
+/**
+ * Reference decoder, parses byte-at-a-time.
+ */
+class NlohmannDecoder : public JsonDecoder
+{
+public:
+    json decode(std::string_view data) override
+    {
+        try {
+            return json::parse(data.begin(), data.end());
+        } catch (json::exception &e) {
+            throw error(e.what());
+        }
+    }
+
+    std::string_view name() const override
+    {
+        return "nlohmann";
+    }
+};
+
+#ifdef DISCORD_WITH_SIMDJSON
+
+/**
+ * simdjson On Demand decoder.
+ * https://github.com/simdjson/simdjson/blob/master/doc/ondemand.md
+ *
+ * The structural index is built with the best SIMD kernel supported by the
+ * running CPU (AVX2, SSE4.2, ...) with a scalar fallback, selected at runtime
+ * by simdjson. The json tree is then built in a single pass over the index
+ * without an intermediate DOM.
+ */
+class SimdjsonDecoder : public JsonDecoder
+{
+public:
+    SimdjsonDecoder()
+        : _name(std::string("simdjson/") + simdjson::get_active_implementation()->name())
+    {
+    }
+
+    json decode(std::string_view data) override
+    {
+        // simdjson reads up to SIMDJSON_PADDING bytes past the end, copy into the reused padded buffer
+        if (this->_buffer.size() < data.size() + simdjson::SIMDJSON_PADDING)
+        {
+            this->_buffer.resize(data.size() + simdjson::SIMDJSON_PADDING);
+        }
+        std::memcpy(this->_buffer.data(), data.data(), data.size());
+        std::memset(this->_buffer.data() + data.size(), 0, simdjson::SIMDJSON_PADDING);
+
+        try {
+            simdjson::ondemand::document doc = this->_parser.iterate(this->_buffer.data(), data.size(), this->_buffer.size());
+            return convert(doc);
+        } catch (simdjson::simdjson_error &e) {
+            throw error(e.what());
+        }
+    }
+
+    std::string_view name() const override
+    {
+        return this->_name;
+    }
+
+private:
+    simdjson::ondemand::parser _parser;
+    std::vector<char> _buffer;
+    const std::string _name;
+
+    // works on documents and values, both provide the same accessors
+    template<typename T>
+    static json convert(T &&value)
+    {
+        switch (value.type())
+        {
+            case simdjson::ondemand::json_type::object: {
+                json object = json::object();
+                for (auto field : value.get_object())
+                {
+                    // the last of duplicate keys wins like with nlohmann
+                    std::string_view key = field.unescaped_key();
+                    object[std::string(key)] = convert(field.value());
+                }
+                return object;
+            }
+
+            case simdjson::ondemand::json_type::array: {
+                json array = json::array();
+                for (auto element : value.get_array())
+                {
+                    array.emplace_back(convert(element.value()));
+                }
+                return array;
+            }
+
+            case simdjson::ondemand::json_type::string:
+                return std::string(std::string_view(value.get_string()));
+
+            case simdjson::ondemand::json_type::number:
+                switch (value.get_number_type())
+                {
+                    // simdjson reports every integer which fits into int64 as signed, nlohmann
+                    // keeps non-negative integers unsigned and callers rely on the same tree
+                    case simdjson::ondemand::number_type::signed_integer: {
+                        const std::int64_t v = value.get_int64();
+                        if (v >= 0)
+                        {
+                            return std::uint64_t(v);
+                        }
+                        return v;
+                    }
+                    case simdjson::ondemand::number_type::unsigned_integer:
+                        return std::uint64_t(value.get_uint64());
+                    default:
+                        return double(value.get_double());
+                }
+
+            case simdjson::ondemand::json_type::boolean:
+                return bool(value.get_bool());
+
+            case simdjson::ondemand::json_type::null:
+            default:
+                return nullptr;
+        }
+    }
+};
+
+#endif // DISCORD_WITH_SIMDJSON
+
+} // anonymous namespace
+
+bool JsonDecoder::available(Client::JsonBackend backend)
+{
+    switch (backend)
+    {
+        case Client::JsonBackend::NLOHMANN:
+            return true;
+
+        case Client::JsonBackend::SIMDJSON:
+        #ifdef DISCORD_WITH_SIMDJSON
+            return true;
+        #else
+            return false;
+        #endif
+    }
+
+    return false;
+}
+
+std::unique_ptr<JsonDecoder> JsonDecoder::create(Client::JsonBackend backend)
+{
+#ifdef DISCORD_WITH_SIMDJSON
+    if (backend == Client::JsonBackend::SIMDJSON)
+    {
+        return std::make_unique<SimdjsonDecoder>();
+    }
+#endif
+
+    return std::make_unique<NlohmannDecoder>();
+}
+
+DISCORD_NS_END
@@ -0,0 +1,60 @@
+#ifndef DISCORD_JSON_DECODER_HPP
+#define DISCORD_JSON_DECODER_HPP
+
+#include "config.hpp"
+#include "client.hpp"
+
+#include <string_view>
+#include <memory>
+#include <stdexcept>
+
+#include <nlohmann/json.hpp>
+
+DISCORD_NS_BEGIN
+
+/**
+ * Pluggable JSON decoding backend for the event data.
+ *
+ * Every backend produces the same nlohmann::json tree, so handlers don't
+ * depend on the backend in use. Decoder instances keep reusable buffers
+ * and are not thread-safe, use one instance per connection.
+ */
+class JsonDecoder
+{
+public:
+    /**
+     * Thrown when the data is not valid JSON.
+     */
+    class error : public std::runtime_error
+    {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    virtual ~JsonDecoder() = default;
+
+    /**
+     * Decodes the given JSON text.
+     */
+    virtual nlohmann::json decode(std::string_view data) = 0;
+
+    /**
+     * Name of the backend, for logging.
+     */
+    virtual std::string_view name() const = 0;
+
+    /**
+     * Whether the given backend was compiled in.
+     */
+    static bool available(Client::JsonBackend backend);
+
+    /**
+     * Creates a decoder for the given backend.
+     * Falls back to the nlohmann backend when the requested one is not available.
+     */
+    static std::unique_ptr<JsonDecoder> create(Client::JsonBackend backend);
+};
+
+DISCORD_NS_END
+
+#endif // DISCORD_JSON_DECODER_HPP
@@ -1 +1,21 @@
 #include "message.hpp"
+#include "utils/json.hpp"
+
+DISCORD_NS_BEGIN
+
+void from_json(const nlohmann::json &j, Message &message)
+{
+    using Utils::get_json_value;
+
+    message.id = get_json_value<Snowflake>(j, "id");
+    message.channel_id = get_json_value<Snowflake>(j, "channel_id");
+    message.guild_id = get_json_value<Snowflake>(j, "guild_id");
+    message.author = get_json_value<User>(j, "author");
+    message.content = get_json_value<std::string>(j, "content");
+    message.timestamp = get_json_value<std::string>(j, "timestamp");
+    message.edited_timestamp = get_json_value<std::string>(j, "edited_timestamp");
+    message.tts = get_json_value<bool>(j, "tts");
+    message.mention_everyone = get_json_value<bool>(j, "mention_everyone");
+}
+
+DISCORD_NS_END
@@ -2,10 +2,13 @@
 #define DISCORD_MESSAGE_HPP
 
 #include "config.hpp"
+#include "snowflake.hpp"
 #include "user.hpp"
 
 #include <string>
 
+#include <nlohmann/json_fwd.hpp>
+
 DISCORD_NS_BEGIN
 
 /**
@@ -36,9 +39,9 @@ struct Embed
  */
 struct Message
 {
-    std::string id;                 // id of the message
-    std::string channel_id;         // id of the channel the message was sent in
-    std::string guild_id;           // id of the guild the message was sent in
+    Snowflake id;                   // id of the message
+    Snowflake channel_id;           // id of the channel the message was sent in
+    Snowflake guild_id;             // id of the guild the message was sent in
     User author;                    // the author of this message (not guaranteed to be a valid user)
     // member                       // member properties for this message's author
     std::string content;            // contents of the message
@@ -50,6 +53,8 @@ struct Message
     // TODO: incomplete
 };
 
+void from_json(const nlohmann::json &j, Message &message);
+
 DISCORD_NS_END
 
 #endif // DISCORD_MESSAGE_HPP
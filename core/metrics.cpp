@@ -0,0 +1,283 @@
+#include "metrics.hpp"
+#include "client.hpp"
+
+#include <bit>
+#include <cmath>
+#include <mutex>
+
+#include <fmt/format.h>
+
+#include <magic_enum.hpp>
+
+DISCORD_NS_BEGIN
+
+namespace
+{
+
+// quantiles exported by the Prometheus summaries
+static constexpr std::array<double, 4> QUANTILES = {0.5, 0.9, 0.99, 0.999};
+
+/**
+ * Escapes a Prometheus label value.
+ */
+static std::string escape(std::string_view value)
+{
+    std::string out;
+    out.reserve(value.size());
+    for (auto c : value)
+    {
+        switch (c)
+        {
+            case '\\': out += "\\\\"; break;
+            case '"':  out += "\\\""; break;
+            case '\n': out += "\\n"; break;
+            default:   out += c; break;
+        }
+    }
+    return out;
+}
+
+static void write_header(std::string &out, std::string_view name, std::string_view type, std::string_view help)
+{
+    fmt::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+}
+
+/**
+ * Writes a histogram as summary in seconds, labels is empty or a list like `event="READY"`.
+ */
+static void write_summary(std::string &out, std::string_view name, const std::string &labels, const Metrics::Histogram::Snapshot &snapshot)
+{
+    const auto sep = labels.empty() ? "" : ",";
+    for (auto quantile : QUANTILES)
+    {
+        fmt::format_to(std::back_inserter(out), "{}{{{}{}quantile=\"{}\"}} {:.9g}\n",
+            name, labels, sep, quantile, snapshot.percentile(quantile) / 1e9);
+    }
+
+    const auto braces = labels.empty() ? std::string() : "{" + labels + "}";
+    fmt::format_to(std::back_inserter(out), "{}_sum{} {:.9g}\n", name, braces, snapshot.sum / 1e9);
+    fmt::format_to(std::back_inserter(out), "{}_count{} {}\n", name, braces, snapshot.count);
+}
+
+} // anonymous namespace
+
+std::uint64_t Metrics::Counter::value() const
+{
+    std::uint64_t value = 0;
+    for (auto&& stripe : this->_stripes)
+    {
+        value += stripe.value.load(std::memory_order_relaxed);
+    }
+    return value;
+}
+
+std::size_t Metrics::Histogram::bucket_of(std::uint64_t ns)
+{
+    if (ns < SUB_BUCKETS)
+    {
+        return static_cast<std::size_t>(ns);
+    }
+
+    // the three bits after the highest set bit select the sub-bucket
+    const auto exponent = static_cast<std::size_t>(63 - std::countl_zero(ns));
+    const auto sub = static_cast<std::size_t>(ns >> (exponent - 3)) - SUB_BUCKETS;
+    return SUB_BUCKETS + (exponent - 3) * SUB_BUCKETS + sub;
+}
+
+std::uint64_t Metrics::Histogram::upper_bound(std::size_t bucket)
+{
+    if (bucket < SUB_BUCKETS)
+    {
+        return bucket;
+    }
+
+    const auto exponent = (bucket - SUB_BUCKETS) / SUB_BUCKETS + 3;
+    const auto sub = (bucket - SUB_BUCKETS) % SUB_BUCKETS;
+    const auto width = std::uint64_t(1) << (exponent - 3);
+    return (SUB_BUCKETS + sub) * width + (width - 1);
+}
+
+void Metrics::Histogram::record(std::uint64_t ns)
+{
+    auto &stripe = this->_stripes[Metrics::stripe()];
+    stripe.buckets[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+    stripe.count.fetch_add(1, std::memory_order_relaxed);
+    stripe.sum.fetch_add(ns, std::memory_order_relaxed);
+
+    auto max = stripe.max.load(std::memory_order_relaxed);
+    while (ns > max && !stripe.max.compare_exchange_weak(max, ns, std::memory_order_relaxed));
+}
+
+Metrics::Histogram::Snapshot Metrics::Histogram::snapshot() const
+{
+    Snapshot snapshot;
+    for (auto&& stripe : this->_stripes)
+    {
+        for (std::size_t i = 0; i < BUCKETS; ++i)
+        {
+            snapshot.buckets[i] += stripe.buckets[i].load(std::memory_order_relaxed);
+        }
+        snapshot.count += stripe.count.load(std::memory_order_relaxed);
+        snapshot.sum += stripe.sum.load(std::memory_order_relaxed);
+        snapshot.max = std::max(snapshot.max, stripe.max.load(std::memory_order_relaxed));
+    }
+    return snapshot;
+}
+
+std::uint64_t Metrics::Histogram::Snapshot::percentile(double fraction) const
+{
+    if (this->count == 0)
+    {
+        return 0;
+    }
+
+    const auto target = std::max<std::uint64_t>(static_cast<std::uint64_t>(std::ceil(fraction * this->count)), 1);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < BUCKETS; ++i)
+    {
+        seen += this->buckets[i];
+        if (seen >= target)
+        {
+            return std::min(upper_bound(i), this->max);
+        }
+    }
+    return this->max;
+}
+
+Metrics::~Metrics()
+{
+    for (auto&& histogram : this->_handler_time)
+    {
+        delete histogram.load();
+    }
+}
+
+void Metrics::record_handler(Event event, std::chrono::nanoseconds duration)
+{
+    auto &slot = this->_handler_time[static_cast<std::size_t>(event)];
+    auto histogram = slot.load(std::memory_order_acquire);
+    if (!histogram)
+    {
+        auto created = new Histogram();
+        if (slot.compare_exchange_strong(histogram, created, std::memory_order_acq_rel))
+        {
+            histogram = created;
+        }
+        else
+        {
+            delete created;
+        }
+    }
+
+    histogram->record(duration);
+}
+
+void Metrics::record_rest(std::string_view route, std::chrono::nanoseconds duration)
+{
+    {
+        std::shared_lock lk{this->_routes_mutex};
+        if (const auto it = this->_rest_latency.find(route); it != this->_rest_latency.end())
+        {
+            it->second->record(duration);
+            return;
+        }
+    }
+
+    std::unique_lock lk{this->_routes_mutex};
+    auto &histogram = this->_rest_latency[std::string(route)];
+    if (!histogram)
+    {
+        histogram = std::make_unique<Histogram>();
+    }
+    histogram->record(duration);
+}
+
+std::uint64_t Metrics::frames(std::uint32_t opcode) const
+{
+    return this->_frames[std::min<std::size_t>(opcode, OPCODES)].value();
+}
+
+std::uint64_t Metrics::events(Event event) const
+{
+    return this->_events[static_cast<std::size_t>(event)].value();
+}
+
+Metrics::Histogram::Snapshot Metrics::parse_time() const
+{
+    return this->_parse_time.snapshot();
+}
+
+Metrics::Histogram::Snapshot Metrics::handler_time(Event event) const
+{
+    const auto histogram = this->_handler_time[static_cast<std::size_t>(event)].load(std::memory_order_acquire);
+    return histogram ? histogram->snapshot() : Histogram::Snapshot{};
+}
+
+Metrics::Histogram::Snapshot Metrics::heartbeat_rtt() const
+{
+    return this->_heartbeat_rtt.snapshot();
+}
+
+std::map<std::string, Metrics::Histogram::Snapshot> Metrics::rest_latency() const
+{
+    std::map<std::string, Histogram::Snapshot> latency;
+
+    std::shared_lock lk{this->_routes_mutex};
+    for (auto&& route : this->_rest_latency)
+    {
+        latency.emplace(route.first, route.second->snapshot());
+    }
+    return latency;
+}
+
+std::string Metrics::prometheus() const
+{
+    std::string out;
+    out.reserve(8192);
+
+    write_header(out, "discord_gateway_frames_total", "counter", "Gateway frames received by opcode.");
+    for (std::uint32_t opcode = 0; opcode <= OPCODES; ++opcode)
+    {
+        const auto name = opcode < OPCODES ? magic_enum::enum_name(static_cast<Client::GatewayOpcode>(opcode)) : "INVALID";
+        if (!name.empty())
+        {
+            fmt::format_to(std::back_inserter(out), "discord_gateway_frames_total{{opcode=\"{}\"}} {}\n", name, this->frames(opcode));
+        }
+    }
+
+    write_header(out, "discord_gateway_events_total", "counter", "Dispatch events received by event name.");
+    for (std::size_t i = 0; i < EVENT_COUNT; ++i)
+    {
+        if (const auto count = this->_events[i].value(); count != 0)
+        {
+            fmt::format_to(std::back_inserter(out), "discord_gateway_events_total{{event=\"{}\"}} {}\n",
+                EVENT_NAMES[i], count);
+        }
+    }
+
+    write_header(out, "discord_gateway_parse_seconds", "summary", "Time to decode a received payload.");
+    write_summary(out, "discord_gateway_parse_seconds", {}, this->parse_time());
+
+    write_header(out, "discord_gateway_heartbeat_rtt_seconds", "summary", "Time from sending a heartbeat until it was acknowledged.");
+    write_summary(out, "discord_gateway_heartbeat_rtt_seconds", {}, this->heartbeat_rtt());
+
+    write_header(out, "discord_handler_seconds", "summary", "Time of the event handlers of an event.");
+    for (std::size_t i = 0; i < EVENT_COUNT; ++i)
+    {
+        if (this->_handler_time[i].load(std::memory_order_acquire))
+        {
+            write_summary(out, "discord_handler_seconds", fmt::format("event=\"{}\"", EVENT_NAMES[i]),
+                this->handler_time(static_cast<Event>(i)));
+        }
+    }
+
+    write_header(out, "discord_rest_request_seconds", "summary", "Time of a REST request on the connection by route.");
+    for (auto&& [route, snapshot] : this->rest_latency())
+    {
+        write_summary(out, "discord_rest_request_seconds", fmt::format("route=\"{}\"", escape(route)), snapshot);
+    }
+
+    return out;
+}
+
+DISCORD_NS_END
@@ -0,0 +1,204 @@
+#ifndef DISCORD_METRICS_HPP
+#define DISCORD_METRICS_HPP
+
+#include "config.hpp"
+#include "event.hpp"
+
+#include <string>
+#include <string_view>
+#include <array>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+DISCORD_NS_BEGIN
+
+/**
+ * Runtime instrumentation of the client.
+ *
+ * Counts received gateway frames by opcode and event, and keeps latency
+ * histograms of the payload decoding, the event handlers, the REST requests
+ * by route and the heartbeat round trip.
+ *
+ * Counters and histograms are split into STRIPES stripes of relaxed atomics
+ * which readers sum up. A thread is assigned a stripe round robin when it
+ * records the first time, so with more threads than stripes several threads
+ * share one. Recording takes no lock, except record_rest which looks the route
+ * up under a shared lock and takes it exclusively to add a route not seen before.
+ */
+class Metrics
+{
+public:
+    // stripes per counter and histogram, threads are assigned one round robin and share it beyond that
+    static constexpr std::size_t STRIPES = 4;
+
+    // opcodes are counted up to this value, others as INVALID
+    static constexpr std::size_t OPCODES = 12;
+
+    /**
+     * Striped event counter.
+     */
+    class Counter
+    {
+    public:
+        inline void add(std::uint64_t n = 1)
+        {
+            this->_stripes[stripe()].value.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        std::uint64_t value() const;
+
+    private:
+        struct alignas(64) Stripe
+        {
+            std::atomic<std::uint64_t> value = 0;
+        };
+
+        std::array<Stripe, STRIPES> _stripes;
+    };
+
+    /**
+     * Striped latency histogram in nanoseconds.
+     *
+     * Buckets are logarithmic with 8 linear sub-buckets per power of two
+     * (HDR-style), every recorded value is accurate to 12.5%.
+     */
+    class Histogram
+    {
+    public:
+        static constexpr std::size_t SUB_BUCKETS = 8;
+        static constexpr std::size_t BUCKETS = SUB_BUCKETS + (64 - 3) * SUB_BUCKETS;
+
+        struct Snapshot
+        {
+            std::uint64_t count = 0;
+            std::uint64_t sum = 0;  // nanoseconds
+            std::uint64_t max = 0;  // nanoseconds
+            std::array<std::uint64_t, BUCKETS> buckets{};
+
+            /**
+             * Value below which the given fraction (0..1) of the samples are, in nanoseconds.
+             */
+            std::uint64_t percentile(double fraction) const;
+
+            inline double mean() const
+            {
+                return this->count == 0 ? 0 : static_cast<double>(this->sum) / this->count;
+            }
+        };
+
+        void record(std::uint64_t ns);
+
+        inline void record(std::chrono::nanoseconds duration)
+        {
+            this->record(static_cast<std::uint64_t>(std::max<std::int64_t>(duration.count(), 0)));
+        }
+
+        Snapshot snapshot() const;
+
+        static std::size_t bucket_of(std::uint64_t ns);
+
+        /**
+         * Highest value which falls into the given bucket.
+         */
+        static std::uint64_t upper_bound(std::size_t bucket);
+
+    private:
+        struct alignas(64) Stripe
+        {
+            std::array<std::atomic<std::uint64_t>, BUCKETS> buckets{};
+            std::atomic<std::uint64_t> count = 0;
+            std::atomic<std::uint64_t> sum = 0;
+            std::atomic<std::uint64_t> max = 0;
+        };
+
+        std::array<Stripe, STRIPES> _stripes;
+    };
+
+    Metrics() = default;
+    ~Metrics();
+
+    Metrics(const Metrics&) = delete;
+    Metrics &operator= (const Metrics&) = delete;
+
+    // recording
+
+    inline void record_frame(std::uint32_t opcode, Event event)
+    {
+        this->_frames[opcode < OPCODES ? opcode : OPCODES].add();
+        if (opcode == 0)
+        {
+            this->_events[static_cast<std::size_t>(event)].add();
+        }
+    }
+
+    inline void record_parse(std::chrono::nanoseconds duration)
+    {
+        this->_parse_time.record(duration);
+    }
+
+    void record_handler(Event event, std::chrono::nanoseconds duration);
+    void record_rest(std::string_view route, std::chrono::nanoseconds duration);
+
+    inline void record_heartbeat(std::chrono::nanoseconds duration)
+    {
+        this->_heartbeat_rtt.record(duration);
+    }
+
+    // pull API
+
+    /**
+     * Frames received with the given opcode, values of OPCODES and above count all unknown opcodes.
+     */
+    std::uint64_t frames(std::uint32_t opcode) const;
+
+    /**
+     * DISPATCH frames received of the given event, UNKNOWN for names unknown to Event.
+     */
+    std::uint64_t events(Event event) const;
+
+    Histogram::Snapshot parse_time() const;
+    Histogram::Snapshot handler_time(Event event) const;
+
+    /**
+     * Time from sending a HEARTBEAT until its HEARTBEAT_ACK arrived.
+     */
+    Histogram::Snapshot heartbeat_rtt() const;
+
+    /**
+     * REST request latency by route template, for example "POST /channels/:major/messages".
+     */
+    std::map<std::string, Histogram::Snapshot> rest_latency() const;
+
+    /**
+     * All metrics in the Prometheus text exposition format.
+     */
+    std::string prometheus() const;
+
+private:
+    std::array<Counter, OPCODES + 1> _frames;
+    std::array<Counter, EVENT_COUNT> _events;
+    Histogram _parse_time;
+    Histogram _heartbeat_rtt;
+
+    // created on the first handler run of an event
+    std::array<std::atomic<Histogram*>, EVENT_COUNT> _handler_time{};
+
+    mutable std::shared_mutex _routes_mutex;
+    std::map<std::string, std::unique_ptr<Histogram>, std::less<>> _rest_latency;
+
+    static inline std::size_t stripe()
+    {
+        static std::atomic<std::size_t> next = 0;
+        static thread_local const std::size_t index = next.fetch_add(1, std::memory_order_relaxed) % STRIPES;
+        return index;
+    }
+};
+
+DISCORD_NS_END
+
+#endif // DISCORD_METRICS_HPP
@@ -0,0 +1,228 @@
+#include "payload_writer.hpp"
+#include "utils/etf.hpp"
+
+#include <charconv>
+
+#include <nlohmann/json.hpp>
+
+DISCORD_NS_BEGIN
+
+namespace
+{
+
+// External Term Format tags of the written terms, see Utils::Etf
+static constexpr std::uint8_t ETF_VERSION = 131;
+static constexpr std::uint8_t ETF_SMALL_INTEGER = 97;
+static constexpr std::uint8_t ETF_INTEGER = 98;
+static constexpr std::uint8_t ETF_BINARY = 109;
+static constexpr std::uint8_t ETF_MAP = 116;
+static constexpr std::uint8_t ETF_SMALL_ATOM_UTF8 = 119;
+
+static inline void u8(std::string &out, std::uint8_t v)
+{
+    out.push_back(static_cast<char>(v));
+}
+
+static inline void u32(std::string &out, std::uint32_t v)
+{
+    u8(out, static_cast<std::uint8_t>(v >> 24));
+    u8(out, static_cast<std::uint8_t>(v >> 16));
+    u8(out, static_cast<std::uint8_t>(v >> 8));
+    u8(out, static_cast<std::uint8_t>(v));
+}
+
+static inline void number(std::string &out, std::int64_t v)
+{
+    char digits[24];
+    const auto res = std::to_chars(digits, digits + sizeof(digits), v);
+    out.append(digits, res.ptr);
+}
+
+/**
+ * Opens an object or map with the given amount of entries.
+ */
+static inline void open(std::string &out, Client::Encoding encoding, std::uint32_t size)
+{
+    if (encoding == Client::Encoding::ETF)
+    {
+        u8(out, ETF_MAP);
+        u32(out, size);
+    }
+    else
+    {
+        out += '{';
+    }
+}
+
+static inline void close(std::string &out, Client::Encoding encoding)
+{
+    if (encoding == Client::Encoding::JSON)
+    {
+        out += '}';
+    }
+}
+
+} // anonymous namespace
+
+PayloadWriter::PayloadWriter(Client::Encoding encoding)
+    : _encoding(encoding)
+{
+    this->_buffer.reserve(256);
+}
+
+void PayloadWriter::prepare(const nlohmann::json &identify, std::string_view token)
+{
+    this->_identify = this->write(Client::GatewayOpcode::IDENTIFY, identify);
+
+    this->_resume.clear();
+    this->begin(this->_resume, Client::GatewayOpcode::RESUME);
+    open(this->_resume, this->_encoding, 3);
+    this->key(this->_resume, "token", true);
+    this->string(this->_resume, token);
+    this->key(this->_resume, "session_id", false);
+}
+
+const std::string &PayloadWriter::heartbeat(std::int32_t seq)
+{
+    this->_buffer.clear();
+    this->begin(this->_buffer, Client::GatewayOpcode::HEARTBEAT);
+
+    if (seq >= 0)
+    {
+        this->integer(this->_buffer, seq);
+    }
+    else if (this->_encoding == Client::Encoding::ETF)
+    {
+        u8(this->_buffer, ETF_SMALL_ATOM_UTF8);
+        u8(this->_buffer, 3);
+        this->_buffer += "nil";
+    }
+    else
+    {
+        this->_buffer += "null";
+    }
+
+    this->end(this->_buffer);
+    return this->_buffer;
+}
+
+const std::string &PayloadWriter::resume(std::string_view session_id, std::int32_t seq)
+{
+    this->_buffer.assign(this->_resume);
+    this->string(this->_buffer, session_id);
+    this->key(this->_buffer, "seq", false);
+    this->integer(this->_buffer, seq);
+    close(this->_buffer, this->_encoding);
+    this->end(this->_buffer);
+    return this->_buffer;
+}
+
+const std::string &PayloadWriter::write(Client::GatewayOpcode op, const nlohmann::json &data)
+{
+    this->_buffer.clear();
+    this->begin(this->_buffer, op);
+
+    if (this->_encoding == Client::Encoding::ETF)
+    {
+        Utils::Etf::encode_term(this->_buffer, data);
+    }
+    else
+    {
+        this->_buffer += data.dump();
+    }
+
+    this->end(this->_buffer);
+    return this->_buffer;
+}
+
+void PayloadWriter::begin(std::string &out, Client::GatewayOpcode op) const
+{
+    if (this->_encoding == Client::Encoding::ETF)
+    {
+        u8(out, ETF_VERSION);
+        open(out, this->_encoding, 2);
+        this->key(out, "op", true);
+        this->integer(out, static_cast<std::int32_t>(op));
+        this->key(out, "d", false);
+    }
+    else
+    {
+        out += "{\"op\":";
+        number(out, static_cast<std::int64_t>(op));
+        out += ",\"d\":";
+    }
+}
+
+void PayloadWriter::end(std::string &out) const
+{
+    close(out, this->_encoding);
+}
+
+void PayloadWriter::key(std::string &out, std::string_view name, bool first) const
+{
+    if (this->_encoding == Client::Encoding::JSON && !first)
+    {
+        out += ',';
+    }
+
+    this->string(out, name);
+
+    if (this->_encoding == Client::Encoding::JSON)
+    {
+        out += ':';
+    }
+}
+
+void PayloadWriter::string(std::string &out, std::string_view value) const
+{
+    if (this->_encoding == Client::Encoding::ETF)
+    {
+        u8(out, ETF_BINARY);
+        u32(out, static_cast<std::uint32_t>(value.size()));
+        out.append(value);
+        return;
+    }
+
+    static constexpr char HEX[] = "0123456789abcdef";
+
+    out += '"';
+    for (const char c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            out += "\\u00";
+            out += HEX[(c >> 4) & 0xF];
+            out += HEX[c & 0xF];
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+void PayloadWriter::integer(std::string &out, std::int32_t value) const
+{
+    if (this->_encoding == Client::Encoding::JSON)
+    {
+        number(out, value);
+    }
+    else if (value >= 0 && value <= 0xFF)
+    {
+        u8(out, ETF_SMALL_INTEGER);
+        u8(out, static_cast<std::uint8_t>(value));
+    }
+    else
+    {
+        u8(out, ETF_INTEGER);
+        u32(out, static_cast<std::uint32_t>(value));
+    }
+}
+
+DISCORD_NS_END
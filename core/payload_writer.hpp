@@ -0,0 +1,86 @@
+#ifndef DISCORD_PAYLOAD_WRITER_HPP
+#define DISCORD_PAYLOAD_WRITER_HPP
+
+#include "config.hpp"
+#include "client.hpp"
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+#include <nlohmann/json_fwd.hpp>
+
+DISCORD_NS_BEGIN
+
+/**
+ * Gateway Payload Writer
+ *
+ * Writes outgoing payloads {"op": op, "d": data} in the encoding of the
+ * connection straight into a buffer which is reused for every frame.
+ *
+ * The IDENTIFY frame does not change during the lifetime of a shard and is
+ * written once, RESUME frames are completed from a prepared prefix and
+ * heartbeats only write their sequence number, so they don't allocate once
+ * the buffer has grown.
+ *
+ * Returned frames are valid until the next call, the writer is not thread-safe.
+ */
+class PayloadWriter
+{
+public:
+    explicit PayloadWriter(Client::Encoding encoding);
+
+    /**
+     * Prepares the IDENTIFY frame and the RESUME prefix of a shard.
+     */
+    void prepare(const nlohmann::json &identify, std::string_view token);
+
+    /**
+     * HEARTBEAT with the last sequence number, -1 if none was received yet.
+     */
+    const std::string &heartbeat(std::int32_t seq);
+
+    inline const std::string &identify() const
+    {
+        return this->_identify;
+    }
+
+    const std::string &resume(std::string_view session_id, std::int32_t seq);
+
+    /**
+     * Any other gateway command.
+     */
+    const std::string &write(Client::GatewayOpcode op, const nlohmann::json &data);
+
+    inline Client::Encoding encoding() const
+    {
+        return this->_encoding;
+    }
+
+    /**
+     * Capacity of the reused frame buffer, it only grows for frames larger than any before.
+     */
+    inline std::size_t capacity() const
+    {
+        return this->_buffer.capacity();
+    }
+
+private:
+    Client::Encoding _encoding;
+    std::string _buffer;
+    std::string _identify;
+    std::string _resume;    // up to the session id
+
+    // payload envelope up to the value of [d] and after it
+    void begin(std::string &out, Client::GatewayOpcode op) const;
+    void end(std::string &out) const;
+
+    // scalar values in the encoding of the connection
+    void key(std::string &out, std::string_view name, bool first) const;
+    void string(std::string &out, std::string_view value) const;
+    void integer(std::string &out, std::int32_t value) const;
+};
+
+DISCORD_NS_END
+
+#endif // DISCORD_PAYLOAD_WRITER_HPP
@@ -0,0 +1,122 @@
+#ifndef DISCORD_PLUGIN_API_H
+#define DISCORD_PLUGIN_API_H
+
+/**
+ * Plugin ABI
+ *
+ * Plugins are shared objects which export DISCORD_PLUGIN_ENTRY. Only C types
+ * cross the boundary, so plugins do not depend on the compiler, the standard
+ * library or the JSON library the bot was built with.
+ *
+ * Event data is handed out as a read-only view into the JSON tree the bot
+ * decoded already. Values are read through the host functions, strings point
+ * into the tree and are not copied. Views are only valid during the callback
+ * they were passed to.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* incremented on incompatible changes, plugins built against another version are rejected */
+#define DISCORD_PLUGIN_API_VERSION 1
+
+/* name of the symbol every plugin exports */
+#define DISCORD_PLUGIN_ENTRY discord_plugin_entry
+#define DISCORD_PLUGIN_ENTRY_NAME "discord_plugin_entry"
+
+/* opaque read-only JSON value owned by the host */
+typedef struct discord_value discord_value;
+
+typedef enum discord_value_type
+{
+    DISCORD_VALUE_NULL = 0,
+    DISCORD_VALUE_BOOL,
+    DISCORD_VALUE_INT,
+    DISCORD_VALUE_UINT,
+    DISCORD_VALUE_DOUBLE,
+    DISCORD_VALUE_STRING,
+    DISCORD_VALUE_ARRAY,
+    DISCORD_VALUE_OBJECT,
+} discord_value_type;
+
+typedef enum discord_log_level
+{
+    DISCORD_LOG_DEBUG = 0,
+    DISCORD_LOG_INFO,
+    DISCORD_LOG_WARNING,
+    DISCORD_LOG_ERROR,
+} discord_log_level;
+
+/**
+ * Functions provided by the host, valid until the plugin is unloaded.
+ * Accessors return NULL or 0 on a type mismatch or a missing value.
+ */
+typedef struct discord_host
+{
+    uint32_t api_version;
+
+    discord_value_type (*type)(const discord_value *value);
+
+    /* object member by key, NULL when missing */
+    const discord_value *(*member)(const discord_value *object, const char *key, size_t key_size);
+
+    /* elements of an array, members of an object */
+    size_t (*size)(const discord_value *value);
+
+    /* array element by index, NULL when out of range */
+    const discord_value *(*at)(const discord_value *array, size_t index);
+
+    /* calls fn for each element of an array (key is NULL) or member of an object, a non-zero result stops the iteration */
+    void (*for_each)(const discord_value *value, int (*fn)(void *user, const char *key, size_t key_size, const discord_value *element), void *user);
+
+    /* points into the host value, not null-terminated */
+    int (*get_string)(const discord_value *value, const char **data, size_t *size);
+
+    int (*get_bool)(const discord_value *value, int *out);
+
+    /* negative integers are DISCORD_VALUE_INT and others DISCORD_VALUE_UINT, both accept any integer in their range */
+    int (*get_int)(const discord_value *value, int64_t *out);
+    int (*get_uint)(const discord_value *value, uint64_t *out);
+    int (*get_double)(const discord_value *value, double *out);
+
+    /* snowflake ids are strings in JSON and integers in ETF, both are accepted */
+    int (*get_snowflake)(const discord_value *value, uint64_t *out);
+
+    /* writes to the bot log, tagged with the plugin name */
+    void (*log)(void *context, discord_log_level level, const char *message, size_t size);
+    void *context;
+} discord_host;
+
+/**
+ * Plugin descriptor returned by DISCORD_PLUGIN_ENTRY.
+ */
+typedef struct discord_plugin
+{
+    uint32_t api_version;   /* DISCORD_PLUGIN_API_VERSION */
+    const char *name;       /* unique name of the plugin */
+    const char *version;
+
+    /* NULL terminated list of gateway event names the plugin handles */
+    const char *const *events;
+
+    /* called once after loading, a non-zero result rejects the plugin, the state is passed to all callbacks */
+    int (*load)(const discord_host *host, void **state);
+
+    /* called once before unloading, after all event callbacks returned */
+    void (*unload)(void *state);
+
+    /* may be called concurrently for events of different guilds */
+    void (*on_event)(void *state, const char *event, size_t event_size, const discord_value *data);
+} discord_plugin;
+
+typedef const discord_plugin *(*discord_plugin_entry_fn)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DISCORD_PLUGIN_API_H */
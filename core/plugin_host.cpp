@@ -0,0 +1,569 @@
+#include "plugin_host.hpp"
+#include "snowflake.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <string_view>
+
+#include <dlfcn.h>
+#include <time.h>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+DISCORD_NS_BEGIN
+
+namespace
+{
+
+// logging tag
+static constexpr std::string_view TAG("PluginHost");
+
+inline const json &value_of(const discord_value *value)
+{
+    return *reinterpret_cast<const json*>(value);
+}
+
+inline const discord_value *view_of(const json &value)
+{
+    return reinterpret_cast<const discord_value*>(&value);
+}
+
+/**
+ * Host functions, the views are pointers to the decoded nlohmann::json values.
+ */
+
+discord_value_type host_type(const discord_value *value)
+{
+    if (!value)
+    {
+        return DISCORD_VALUE_NULL;
+    }
+
+    const auto &j = value_of(value);
+    switch (j.type())
+    {
+        case json::value_t::boolean:            return DISCORD_VALUE_BOOL;
+
+        // decoders differ in how they store non-negative integers, the sign decides
+        case json::value_t::number_integer:     return j.get<std::int64_t>() < 0 ? DISCORD_VALUE_INT : DISCORD_VALUE_UINT;
+        case json::value_t::number_unsigned:    return DISCORD_VALUE_UINT;
+        case json::value_t::number_float:       return DISCORD_VALUE_DOUBLE;
+        case json::value_t::string:             return DISCORD_VALUE_STRING;
+        case json::value_t::array:              return DISCORD_VALUE_ARRAY;
+        case json::value_t::object:             return DISCORD_VALUE_OBJECT;
+        default:                                return DISCORD_VALUE_NULL;
+    }
+}
+
+const discord_value *host_member(const discord_value *object, const char *key, std::size_t key_size)
+{
+    if (!object || !value_of(object).is_object())
+    {
+        return nullptr;
+    }
+
+    const auto &members = *value_of(object).get_ptr<const json::object_t*>();
+    const std::string_view name(key, key_size);
+
+    // compares the keys in place when the object map supports heterogeneous lookup
+    if constexpr (requires { typename json::object_comparator_t::is_transparent; })
+    {
+        const auto it = members.find(name);
+        return it != members.end() ? view_of(it->second) : nullptr;
+    }
+    else
+    {
+        for (auto&& [k, v] : members)
+        {
+            if (k == name)
+            {
+                return view_of(v);
+            }
+        }
+        return nullptr;
+    }
+}
+
+std::size_t host_size(const discord_value *value)
+{
+    if (!value)
+    {
+        return 0;
+    }
+
+    const auto &j = value_of(value);
+    return j.is_array() || j.is_object() ? j.size() : 0;
+}
+
+const discord_value *host_at(const discord_value *array, std::size_t index)
+{
+    if (!array || !value_of(array).is_array() || index >= value_of(array).size())
+    {
+        return nullptr;
+    }
+
+    return view_of(value_of(array)[index]);
+}
+
+void host_for_each(const discord_value *value, int (*fn)(void *user, const char *key, std::size_t key_size, const discord_value *element), void *user)
+{
+    if (!value || !fn)
+    {
+        return;
+    }
+
+    const auto &j = value_of(value);
+    if (j.is_array())
+    {
+        for (auto&& element : j)
+        {
+            if (fn(user, nullptr, 0, view_of(element)) != 0)
+            {
+                return;
+            }
+        }
+    }
+    else if (j.is_object())
+    {
+        for (auto it = j.begin(); it != j.end(); ++it)
+        {
+            const auto &key = it.key();
+            if (fn(user, key.data(), key.size(), view_of(it.value())) != 0)
+            {
+                return;
+            }
+        }
+    }
+}
+
+int host_get_string(const discord_value *value, const char **data, std::size_t *size)
+{
+    const auto str = value ? value_of(value).get_ptr<const json::string_t*>() : nullptr;
+    if (!str)
+    {
+        return 0;
+    }
+
+    *data = str->data();
+    *size = str->size();
+    return 1;
+}
+
+int host_get_bool(const discord_value *value, int *out)
+{
+    if (!value || !value_of(value).is_boolean())
+    {
+        return 0;
+    }
+
+    *out = value_of(value).get<bool>() ? 1 : 0;
+    return 1;
+}
+
+int host_get_int(const discord_value *value, std::int64_t *out)
+{
+    if (!value || !value_of(value).is_number_integer())
+    {
+        return 0;
+    }
+
+    const auto &j = value_of(value);
+    if (j.is_number_unsigned() && j.get<std::uint64_t>() > std::uint64_t(std::numeric_limits<std::int64_t>::max()))
+    {
+        return 0;
+    }
+
+    *out = j.get<std::int64_t>();
+    return 1;
+}
+
+int host_get_uint(const discord_value *value, std::uint64_t *out)
+{
+    if (!value || !value_of(value).is_number_integer())
+    {
+        return 0;
+    }
+
+    const auto &j = value_of(value);
+    if (!j.is_number_unsigned() && j.get<std::int64_t>() < 0)
+    {
+        return 0;
+    }
+
+    *out = j.get<std::uint64_t>();
+    return 1;
+}
+
+int host_get_double(const discord_value *value, double *out)
+{
+    if (!value || !value_of(value).is_number())
+    {
+        return 0;
+    }
+
+    *out = value_of(value).get<double>();
+    return 1;
+}
+
+int host_get_snowflake(const discord_value *value, std::uint64_t *out)
+{
+    if (!value)
+    {
+        return 0;
+    }
+
+    Snowflake id;
+    from_json(value_of(value), id);
+    if (!id)
+    {
+        return 0;
+    }
+
+    *out = id.value();
+    return 1;
+}
+
+inline std::chrono::nanoseconds thread_cpu_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+} // anonymous namespace
+
+/**
+ * A loaded shared object, it is unloaded when the last reference is released.
+ */
+class PluginHost::Plugin
+{
+public:
+    std::string path;
+    std::string name;
+    std::string version;
+    std::array<bool, EVENT_COUNT> events{};
+
+    Plugin(const std::string &path, void *handle, const discord_plugin *descriptor)
+        : path(path), name(descriptor->name), version(descriptor->version ? descriptor->version : ""),
+          _handle(handle), _descriptor(descriptor)
+    {
+        this->_host = {
+            DISCORD_PLUGIN_API_VERSION,
+            &host_type,
+            &host_member,
+            &host_size,
+            &host_at,
+            &host_for_each,
+            &host_get_string,
+            &host_get_bool,
+            &host_get_int,
+            &host_get_uint,
+            &host_get_double,
+            &host_get_snowflake,
+            &Plugin::log,
+            this,
+        };
+    }
+
+    ~Plugin()
+    {
+        if (this->_loaded && this->_descriptor->unload)
+        {
+            this->_descriptor->unload(this->_state);
+        }
+
+        dlclose(this->_handle);
+        this->_closed.set_value();
+    }
+
+    Plugin(const Plugin&) = delete;
+    Plugin &operator= (const Plugin&) = delete;
+
+    bool init()
+    {
+        this->_loaded = !this->_descriptor->load || this->_descriptor->load(&this->_host, &this->_state) == 0;
+        return this->_loaded;
+    }
+
+    /**
+     * Completes after the plugin was unloaded and its shared object was closed.
+     */
+    inline std::future<void> closed()
+    {
+        return this->_closed.get_future();
+    }
+
+    void call(std::string_view event, const json &data)
+    {
+        if (!this->_descriptor->on_event)
+        {
+            return;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const auto cpu_start = thread_cpu_time();
+
+        this->_descriptor->on_event(this->_state, event.data(), event.size(), view_of(data));
+
+        const auto cpu_time = thread_cpu_time() - cpu_start;
+        const auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+        this->_calls.fetch_add(1, std::memory_order_relaxed);
+        this->_time.fetch_add(time.count(), std::memory_order_relaxed);
+        this->_cpu_time.fetch_add(cpu_time.count(), std::memory_order_relaxed);
+
+        auto max_time = this->_max_time.load(std::memory_order_relaxed);
+        while (time.count() > max_time && !this->_max_time.compare_exchange_weak(max_time, time.count(), std::memory_order_relaxed));
+    }
+
+    Stats stats() const
+    {
+        Stats stats;
+        stats.name = this->name;
+        stats.version = this->version;
+        stats.path = this->path;
+        stats.calls = this->_calls.load(std::memory_order_relaxed);
+        stats.time = std::chrono::nanoseconds(this->_time.load(std::memory_order_relaxed));
+        stats.max_time = std::chrono::nanoseconds(this->_max_time.load(std::memory_order_relaxed));
+        stats.cpu_time = std::chrono::nanoseconds(this->_cpu_time.load(std::memory_order_relaxed));
+        return stats;
+    }
+
+private:
+    void *_handle;
+    const discord_plugin *_descriptor;
+    void *_state = nullptr;
+    bool _loaded = false;
+    discord_host _host;
+    std::promise<void> _closed;
+
+    std::atomic<std::uint64_t> _calls = 0;
+    std::atomic<std::int64_t> _time = 0;
+    std::atomic<std::int64_t> _max_time = 0;
+    std::atomic<std::int64_t> _cpu_time = 0;
+
+    static void log(void *context, discord_log_level level, const char *message, std::size_t size)
+    {
+        const auto &tag = static_cast<const Plugin*>(context)->name;
+        const auto msg = std::string_view(message, size);
+
+        switch (level)
+        {
+            case DISCORD_LOG_DEBUG:     Utils::log_debug(tag, "{}", msg); break;
+            case DISCORD_LOG_INFO:      Utils::log_info(tag, "{}", msg); break;
+            case DISCORD_LOG_WARNING:   Utils::log_warning(tag, "{}", msg); break;
+            default:                    Utils::log_error(tag, "{}", msg); break;
+        }
+    }
+};
+
+PluginHost::~PluginHost()
+{
+    this->clear();
+}
+
+bool PluginHost::load(const std::string &path)
+{
+    const auto handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle)
+    {
+        Utils::log_error(TAG, "failed to load plugin {}: {}", path, dlerror());
+        return false;
+    }
+
+    const auto entry = reinterpret_cast<discord_plugin_entry_fn>(dlsym(handle, DISCORD_PLUGIN_ENTRY_NAME));
+    const auto descriptor = entry ? entry() : nullptr;
+    if (!descriptor || !descriptor->name)
+    {
+        Utils::log_error(TAG, "{} is not a plugin", path);
+        dlclose(handle);
+        return false;
+    }
+
+    if (descriptor->api_version != DISCORD_PLUGIN_API_VERSION)
+    {
+        Utils::log_error(TAG, "plugin {} was built for API version {}, expected {}", path, descriptor->api_version, DISCORD_PLUGIN_API_VERSION);
+        dlclose(handle);
+        return false;
+    }
+
+    // the shared object is closed with the plugin from here on
+    auto plugin = std::make_shared<Plugin>(path, handle, descriptor);
+
+    for (auto event = descriptor->events; event && *event; ++event)
+    {
+        if (const auto known = event_from_name(*event); known != Event::UNKNOWN)
+        {
+            plugin->events[static_cast<std::size_t>(known)] = true;
+        }
+        else
+        {
+            Utils::log_warning(TAG, "plugin {} handles unknown event {}", plugin->name, *event);
+        }
+    }
+
+    {
+        const auto list = this->plugins();
+        const auto it = std::find_if(list->begin(), list->end(), [&](const auto &p) { return p->name == plugin->name; });
+        if (it != list->end())
+        {
+            Utils::log_error(TAG, "plugin {} is loaded already", plugin->name);
+            return false;
+        }
+    }
+
+    if (!plugin->init())
+    {
+        Utils::log_error(TAG, "plugin {} failed to initialize", plugin->name);
+        return false;
+    }
+
+    {
+        std::lock_guard lk{this->_mutex};
+
+        // another plugin with the same name may have been loaded in the meantime
+        const auto it = std::find_if(this->_plugins->begin(), this->_plugins->end(), [&](const auto &p) { return p->name == plugin->name; });
+        if (it != this->_plugins->end())
+        {
+            Utils::log_error(TAG, "plugin {} is loaded already", plugin->name);
+            return false;
+        }
+
+        auto list = std::make_shared<PluginList>(*this->_plugins);
+        list->emplace_back(plugin);
+        this->_plugins = std::move(list);
+    }
+
+    for (std::size_t i = 0; i < EVENT_COUNT; ++i)
+    {
+        if (plugin->events[i])
+        {
+            this->_subscribers[i].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    Utils::log_info(TAG, "loaded plugin {} {} from {}", plugin->name, plugin->version, path);
+    return true;
+}
+
+bool PluginHost::unload(std::string_view name)
+{
+    auto plugin = this->remove(name);
+    if (!plugin)
+    {
+        return false;
+    }
+
+    // running dispatches hold references, the last one unloads the plugin
+    auto closed = plugin->closed();
+    plugin.reset();
+    closed.wait();
+
+    Utils::log_info(TAG, "unloaded plugin {}", name);
+    return true;
+}
+
+bool PluginHost::reload(std::string_view name)
+{
+    auto plugin = this->remove(name);
+    if (!plugin)
+    {
+        return false;
+    }
+
+    // the shared object must be closed before it is opened again, dlopen would return the old one otherwise
+    const auto path = plugin->path;
+    auto closed = plugin->closed();
+    plugin.reset();
+    closed.wait();
+
+    return this->load(path);
+}
+
+void PluginHost::clear()
+{
+    // the list must be released before unloading, it keeps the plugins loaded
+    std::vector<std::string> names;
+    {
+        const auto plugins = this->plugins();
+        for (auto&& plugin : *plugins)
+        {
+            names.emplace_back(plugin->name);
+        }
+    }
+
+    for (auto&& name : names)
+    {
+        this->unload(name);
+    }
+}
+
+std::vector<PluginHost::Stats> PluginHost::stats() const
+{
+    std::vector<Stats> stats;
+    const auto plugins = this->plugins();
+    for (auto&& plugin : *plugins)
+    {
+        stats.emplace_back(plugin->stats());
+    }
+    return stats;
+}
+
+void PluginHost::dispatch(Event event, std::string_view name, const json &data) const
+{
+    if (!this->wants(event))
+    {
+        return;
+    }
+
+    // the list must outlive the loop, it keeps the plugins loaded while they are called
+    const auto plugins = this->plugins();
+    const auto index = static_cast<std::size_t>(event);
+    for (auto&& plugin : *plugins)
+    {
+        if (plugin->events[index])
+        {
+            plugin->call(name, data);
+        }
+    }
+}
+
+std::shared_ptr<const PluginHost::PluginList> PluginHost::plugins() const
+{
+    std::lock_guard lk{this->_mutex};
+    return this->_plugins;
+}
+
+std::shared_ptr<PluginHost::Plugin> PluginHost::remove(std::string_view name)
+{
+    std::shared_ptr<Plugin> plugin;
+    {
+        std::lock_guard lk{this->_mutex};
+
+        const auto it = std::find_if(this->_plugins->begin(), this->_plugins->end(), [&](const auto &p) { return p->name == name; });
+        if (it == this->_plugins->end())
+        {
+            return {};
+        }
+
+        plugin = *it;
+        auto list = std::make_shared<PluginList>();
+        std::copy_if(this->_plugins->begin(), this->_plugins->end(), std::back_inserter(*list), [&](const auto &p) { return p != plugin; });
+        this->_plugins = std::move(list);
+    }
+
+    for (std::size_t i = 0; i < EVENT_COUNT; ++i)
+    {
+        if (plugin->events[i])
+        {
+            this->_subscribers[i].fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    return plugin;
+}
+
+DISCORD_NS_END
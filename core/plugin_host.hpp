@@ -0,0 +1,110 @@
+#ifndef DISCORD_PLUGIN_HOST_HPP
+#define DISCORD_PLUGIN_HOST_HPP
+
+#include "config.hpp"
+#include "event.hpp"
+#include "plugin_api.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <chrono>
+#include <cstdint>
+
+#include <nlohmann/json_fwd.hpp>
+
+DISCORD_NS_BEGIN
+
+/**
+ * Plugin host
+ *
+ * Loads plugins from shared objects through the C ABI in plugin_api.h and
+ * passes gateway events to them. Plugins receive a view into the decoded
+ * event data which is shared with the other plugins and handlers, nothing
+ * is serialized or copied per plugin.
+ *
+ * Plugins can be unloaded and reloaded at any time, the gateway connections
+ * are not affected. Events which arrive while a plugin is reloaded are not
+ * passed to it.
+ */
+class PluginHost
+{
+public:
+    /**
+     * Plugin statistics
+     */
+    struct Stats
+    {
+        std::string name;
+        std::string version;
+        std::string path;
+        std::uint64_t calls = 0;            // events passed to the plugin
+        std::chrono::nanoseconds time{};    // wall time spent in the plugin
+        std::chrono::nanoseconds max_time{};// longest single call
+        std::chrono::nanoseconds cpu_time{};// CPU time spent in the plugin
+    };
+
+    PluginHost() = default;
+    ~PluginHost();
+
+    PluginHost(const PluginHost&) = delete;
+    PluginHost &operator= (const PluginHost&) = delete;
+
+    /**
+     * Loads the plugin at the given path, returns false when it could not be loaded.
+     */
+    bool load(const std::string &path);
+
+    /**
+     * Unloads the plugin with the given name. Blocks until running event
+     * callbacks of the plugin returned, must not be called from within one.
+     */
+    bool unload(std::string_view name);
+
+    /**
+     * Unloads the plugin with the given name and loads it again from the same path.
+     */
+    bool reload(std::string_view name);
+
+    /**
+     * Unloads all plugins.
+     */
+    void clear();
+
+    std::vector<Stats> stats() const;
+
+    /**
+     * Whether any plugin handles the given event.
+     */
+    inline bool wants(Event event) const
+    {
+        return this->_subscribers[static_cast<std::size_t>(event)].load(std::memory_order_relaxed) > 0;
+    }
+
+    /**
+     * Passes the event to all plugins handling it, on the calling thread.
+     */
+    void dispatch(Event event, std::string_view name, const nlohmann::json &data) const;
+
+private:
+    class Plugin;
+    using PluginList = std::vector<std::shared_ptr<Plugin>>;
+
+    // replaced as a whole on changes, dispatches keep the list they started with
+    mutable std::mutex _mutex;
+    std::shared_ptr<const PluginList> _plugins = std::make_shared<const PluginList>();
+
+    std::array<std::atomic<std::uint32_t>, EVENT_COUNT> _subscribers{};
+
+    std::shared_ptr<const PluginList> plugins() const;
+    std::shared_ptr<Plugin> remove(std::string_view name);
+};
+
+DISCORD_NS_END
+
+#endif // DISCORD_PLUGIN_HOST_HPP
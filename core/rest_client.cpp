@@ -0,0 +1,512 @@
+#include "rest_client.hpp"
+#include "http_connection.hpp"
+#include "metrics.hpp"
+#include "utils/log.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+DISCORD_NS_BEGIN
+
+namespace
+{
+
+// logging tag
+static constexpr std::string_view TAG("Rest");
+
+// https://discord.com/developers/docs/reference#user-agent
+static const std::string USER_AGENT("DiscordBot (https://github.com/misaka-oneesama/misaka-oneesama-reborn, 0.1)");
+
+// retry delay when the state of a bucket is not known yet
+static constexpr auto RETRY_DELAY = std::chrono::milliseconds(250);
+
+// amount of requests between sweeps of idle routes
+static constexpr std::uint32_t SWEEP_INTERVAL = 1024;
+
+static inline bool is_snowflake(std::string_view str)
+{
+    return !str.empty() && std::all_of(str.begin(), str.end(), [](unsigned char c){ return std::isdigit(c); });
+}
+
+static inline RestClient::Response error_response(std::string error)
+{
+    RestClient::Response response;
+    response.error = std::move(error);
+    return response;
+}
+
+static inline double header_seconds(const RestClient::Response &response, std::string_view name)
+{
+    const auto value = response.header(name);
+    return value.empty() ? -1.0 : std::strtod(std::string(value).c_str(), nullptr);
+}
+
+/**
+ * Splits a request path into its rate limit route template and major parameter.
+ * For example `POST /channels/1234/messages/5678` becomes
+ * `POST /channels/:major/messages/:id` and `channels/1234`.
+ */
+static void parse_route(std::string_view method, std::string_view path, std::string &route, std::string &major)
+{
+    path = path.substr(0, path.find('?'));
+
+    route.assign(method).append(" ");
+
+    std::string_view prev, prev2;
+    while (!path.empty())
+    {
+        if (path.front() == '/')
+        {
+            path.remove_prefix(1);
+            continue;
+        }
+
+        const auto end = path.find('/');
+        const auto segment = path.substr(0, end);
+        path = end == std::string_view::npos ? std::string_view() : path.substr(end);
+
+        route.append("/");
+
+        if (major.empty() && (prev == "channels" || prev == "guilds" || prev == "webhooks"))
+        {
+            major.assign(prev).append("/").append(segment);
+            route.append(":major");
+        }
+        else if (prev2 == "webhooks" && major.find('/', 9) == std::string::npos)
+        {
+            // the webhook token belongs to the major parameter
+            major.append("/").append(segment);
+            route.append(":token");
+        }
+        else if (is_snowflake(segment))
+        {
+            route.append(":id");
+        }
+        else if (prev == "reactions")
+        {
+            route.append(":emoji");
+        }
+        else
+        {
+            route.append(segment);
+        }
+
+        prev2 = prev;
+        prev = segment;
+    }
+}
+
+} // anonymous namespace
+
+std::string_view RestClient::Response::header(std::string_view name) const
+{
+    const auto it = this->headers.find(name);
+    return it != this->headers.end() ? std::string_view(it->second) : std::string_view();
+}
+
+RestClient::RestClient(Scheduler &scheduler, const std::string &base_url, const std::string &token, std::size_t connections, Metrics *metrics)
+    : _scheduler(scheduler), _metrics(metrics)
+{
+    // scheme://host[:port][/prefix]
+    const auto scheme_end = base_url.find("://");
+    if (scheme_end == std::string::npos)
+    {
+        throw std::invalid_argument("invalid REST base URL: " + base_url);
+    }
+
+    const auto scheme = base_url.substr(0, scheme_end);
+    if (scheme == "https")
+    {
+        this->_tls = true;
+        this->_port = 443;
+    }
+    else if (scheme == "http")
+    {
+        this->_tls = false;
+        this->_port = 80;
+    }
+    else
+    {
+        throw std::invalid_argument("unsupported REST URL scheme: " + scheme);
+    }
+
+    const auto host_start = scheme_end + 3;
+    const auto path_start = base_url.find('/', host_start);
+    auto host = base_url.substr(host_start, path_start == std::string::npos ? std::string::npos : path_start - host_start);
+    this->_prefix = path_start == std::string::npos ? "" : base_url.substr(path_start);
+
+    if (const auto colon = host.find(':'); colon != std::string::npos)
+    {
+        this->_port = std::stoi(host.substr(colon + 1));
+        host.resize(colon);
+    }
+
+    if (host.empty())
+    {
+        throw std::invalid_argument("invalid REST base URL: " + base_url);
+    }
+
+    this->_host = host;
+
+    // shared by all requests
+    this->_headers =
+        "Host: " + host + "\r\n"
+        "Authorization: Bot " + token + "\r\n"
+        "User-Agent: " + USER_AGENT + "\r\n"
+        "Connection: keep-alive\r\n";
+
+    for (std::size_t i = 0; i < std::max<std::size_t>(connections, 1); ++i)
+    {
+        this->_workers.emplace_back(&RestClient::run, this);
+    }
+}
+
+RestClient::~RestClient()
+{
+    std::vector<Scheduler::TimerId> timers;
+
+    {
+        std::lock_guard lk{this->_mutex};
+        this->_running = false;
+
+        for (auto&& route : this->_routes)
+        {
+            if (route.second.timer != 0)
+            {
+                timers.emplace_back(route.second.timer);
+            }
+        }
+    }
+    this->_cv.notify_all();
+
+    // cancel() waits for running wake ups, which need the mutex
+    for (auto&& timer : timers)
+    {
+        this->_scheduler.cancel(timer);
+    }
+
+    for (auto&& worker : this->_workers)
+    {
+        worker.join();
+    }
+
+    // fail requests which were never sent
+    for (auto&& job : this->_jobs)
+    {
+        job.promise.set_value(error_response("client stopped"));
+    }
+    for (auto&& route : this->_routes)
+    {
+        for (auto&& job : route.second.jobs)
+        {
+            job.promise.set_value(error_response("client stopped"));
+        }
+    }
+}
+
+void RestClient::setGlobalLimit(std::uint32_t requests_per_second)
+{
+    std::lock_guard lk{this->_mutex};
+    this->_global_limit = std::max<std::uint32_t>(requests_per_second, 1);
+}
+
+std::future<RestClient::Response> RestClient::request(std::string_view method, std::string_view path, std::string_view body)
+{
+    Job job;
+
+    std::string route_path, major;
+    parse_route(method, path, route_path, major);
+    job.route = route_path + " " + major;
+
+    auto &req = job.request;
+    req.reserve(method.size() + this->_prefix.size() + path.size() + this->_headers.size() + body.size() + 64);
+    req.append(method).append(" ").append(this->_prefix).append(path).append(" HTTP/1.1\r\n");
+    req.append(this->_headers);
+    if (!body.empty())
+    {
+        req.append("Content-Type: application/json\r\n");
+    }
+    req.append("Content-Length: ").append(std::to_string(body.size())).append("\r\n\r\n");
+    req.append(body);
+
+    auto future = job.promise.get_future();
+
+    std::lock_guard lk{this->_mutex};
+
+    if (!this->_running)
+    {
+        job.promise.set_value(error_response("client stopped"));
+        return future;
+    }
+
+    if (++this->_sweep >= SWEEP_INTERVAL)
+    {
+        this->sweep();
+    }
+
+    const auto key = job.route;
+    auto &route = this->_routes[key];
+    if (!route.bucket)
+    {
+        route.major = std::move(major);
+        route.path = std::move(route_path);
+
+        // routes of a known bucket share its state
+        if (const auto hash = this->_hashes.find(route.path); hash != this->_hashes.end())
+        {
+            route.bucket = this->_buckets[hash->second + ":" + route.major].lock();
+        }
+        if (!route.bucket)
+        {
+            route.bucket = std::make_shared<Bucket>();
+        }
+    }
+
+    route.jobs.emplace_back(std::move(job));
+    this->dispatch(key, route);
+
+    return future;
+}
+
+void RestClient::run()
+{
+    HttpConnection connection(this->_host, this->_port, this->_tls);
+
+    // open the connection ahead of the first request
+    {
+        Response response;
+        this->open(connection, response);
+    }
+
+    std::unique_lock lk{this->_mutex};
+
+    for (;;)
+    {
+        this->_cv.wait(lk, [this]{ return !this->_running || !this->_jobs.empty(); });
+        if (!this->_running)
+        {
+            return;
+        }
+
+        auto job = std::move(this->_jobs.front());
+        this->_jobs.pop_front();
+
+        lk.unlock();
+        const auto start = clock::now();
+        auto response = this->perform(connection, job.request);
+        if (this->_metrics)
+        {
+            // the route key ends with the major parameter, latency is kept per route template
+            const std::string_view route = job.route;
+            this->_metrics->record_rest(route.substr(0, route.rfind(' ')), clock::now() - start);
+        }
+        lk.lock();
+
+        this->complete(std::move(job), std::move(response));
+    }
+}
+
+bool RestClient::open(HttpConnection &connection, Response &response)
+{
+    if (!connection.connect(response.error))
+    {
+        Utils::log_warning(TAG, "failed to connect to {}:{}: {}", this->_host, this->_port, response.error);
+        return false;
+    }
+
+    this->_connects.fetch_add(1, std::memory_order_relaxed);
+    Utils::log_debug(TAG, "connected to {}:{}", this->_host, this->_port);
+    return true;
+}
+
+RestClient::Response RestClient::perform(HttpConnection &connection, const std::string &request)
+{
+    Response response;
+
+    // a reused connection may have been closed by the server in the meantime,
+    // retry once on a fresh connection when nothing was received yet
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        response = {};
+
+        const auto reused = connection.alive();
+        if (!reused && !this->open(connection, response))
+        {
+            break;
+        }
+
+        const auto result = connection.perform(request, response);
+        if (result != HttpConnection::Result::STALE || !reused)
+        {
+            break;
+        }
+    }
+
+    if (!response.ok() && response.status != 429)
+    {
+        Utils::log_warning(TAG, "request failed: status={} error={} body={}",
+            response.status, response.error, response.body);
+    }
+
+    return response;
+}
+
+void RestClient::dispatch(const std::string &key, Route &route)
+{
+    if (!this->_running || route.busy || route.timer != 0 || route.jobs.empty())
+    {
+        return;
+    }
+
+    const auto now = clock::now();
+    auto &bucket = *route.bucket;
+
+    // bucket window
+    if (bucket.reset != clock::time_point() && now >= bucket.reset)
+    {
+        bucket.remaining = bucket.limit;
+        bucket.reset = {};
+    }
+    if (bucket.remaining <= 0)
+    {
+        this->wake_up(key, route, bucket.reset != clock::time_point() ? bucket.reset : now + RETRY_DELAY);
+        return;
+    }
+
+    // global limit
+    if (now < this->_global_reset)
+    {
+        this->wake_up(key, route, this->_global_reset);
+        return;
+    }
+    while (!this->_global_sent.empty() && now - this->_global_sent.front() >= std::chrono::seconds(1))
+    {
+        this->_global_sent.pop_front();
+    }
+    if (this->_global_sent.size() >= this->_global_limit)
+    {
+        this->wake_up(key, route, this->_global_sent.front() + std::chrono::seconds(1));
+        return;
+    }
+
+    this->_global_sent.emplace_back(now);
+    --bucket.remaining;
+    route.busy = true;
+
+    this->_jobs.emplace_back(std::move(route.jobs.front()));
+    route.jobs.pop_front();
+    this->_cv.notify_one();
+}
+
+void RestClient::complete(Job &&job, Response &&response)
+{
+    const auto key = job.route;
+    auto &route = this->_routes[key];
+    const auto now = clock::now();
+
+    // join the bucket Discord put this route into
+    if (const auto hash = response.header("x-ratelimit-bucket"); !hash.empty())
+    {
+        this->_hashes.insert_or_assign(route.path, std::string(hash));
+
+        auto &shared = this->_buckets[std::string(hash) + ":" + route.major];
+        if (auto bucket = shared.lock(); bucket && bucket != route.bucket)
+        {
+            route.bucket = bucket;
+        }
+        else
+        {
+            shared = route.bucket;
+        }
+    }
+
+    auto &bucket = *route.bucket;
+    if (const auto remaining = response.header("x-ratelimit-remaining"); !remaining.empty())
+    {
+        const auto limit = response.header("x-ratelimit-limit");
+        if (!limit.empty())
+        {
+            bucket.limit = std::max<std::int64_t>(std::atoll(std::string(limit).c_str()), 1);
+        }
+        bucket.remaining = std::atoll(std::string(remaining).c_str());
+
+        const auto reset_after = header_seconds(response, "x-ratelimit-reset-after");
+        if (reset_after >= 0.0)
+        {
+            bucket.reset = now + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(reset_after));
+        }
+    }
+    else
+    {
+        // no rate limit on this route
+        bucket.remaining = bucket.limit;
+        bucket.reset = {};
+    }
+
+    if (response.status == 429)
+    {
+        this->_rate_limited.fetch_add(1, std::memory_order_relaxed);
+
+        auto retry_after = header_seconds(response, "retry-after");
+        if (retry_after < 0.0)
+        {
+            retry_after = std::max(header_seconds(response, "x-ratelimit-reset-after"), 0.0);
+        }
+        const auto retry = now + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(retry_after));
+
+        if (response.header("x-ratelimit-global") == "true")
+        {
+            this->_global_reset = retry;
+        }
+        else
+        {
+            bucket.remaining = 0;
+            bucket.reset = retry;
+        }
+
+        Utils::log_warning(TAG, "rate limited on {}, retrying in {}s", key, retry_after);
+
+        // retry in order
+        route.jobs.emplace_front(std::move(job));
+    }
+    else
+    {
+        job.promise.set_value(std::move(response));
+    }
+
+    route.busy = false;
+    this->dispatch(key, route);
+}
+
+void RestClient::wake_up(const std::string &key, Route &route, clock::time_point when)
+{
+    route.timer = this->_scheduler.schedule_at(when, [this, key]{
+        std::lock_guard lk{this->_mutex};
+
+        const auto it = this->_routes.find(key);
+        if (it != this->_routes.end())
+        {
+            it->second.timer = 0;
+            this->dispatch(key, it->second);
+        }
+    });
+}
+
+void RestClient::sweep()
+{
+    this->_sweep = 0;
+
+    // drop idle routes whose bucket window passed, their state is not needed anymore
+    const auto now = clock::now();
+    std::erase_if(this->_routes, [&](const auto &route) {
+        const auto &r = route.second;
+        return !r.busy && r.timer == 0 && r.jobs.empty() && r.bucket->reset <= now;
+    });
+    std::erase_if(this->_buckets, [](const auto &bucket) {
+        return bucket.second.expired();
+    });
+}
+
+DISCORD_NS_END
@@ -0,0 +1,178 @@
+#ifndef DISCORD_REST_CLIENT_HPP
+#define DISCORD_REST_CLIENT_HPP
+
+#include "config.hpp"
+#include "scheduler.hpp"
+
+#include <string>
+#include <string_view>
+#include <map>
+#include <unordered_map>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+DISCORD_NS_BEGIN
+
+class HttpConnection;
+class Metrics;
+
+/**
+ * Discord REST API client
+ * https://discord.com/developers/docs/reference#http-api
+ *
+ * Requests are executed asynchronously on a small pool of worker threads,
+ * each owning a persistent keep-alive connection to the API host. The
+ * TCP and TLS handshake is only paid when a connection is opened or was
+ * closed by the server, not for every request.
+ *
+ * The header block which is shared by all requests (host, authorization,
+ * user agent) is built once.
+ *
+ * Requests are rate limited before they are sent. Each route (method and path
+ * template plus its major parameter) has its own queue which is processed in
+ * order, one request at a time. The limits are learned from the X-RateLimit-*
+ * response headers and shared between all routes which Discord puts into the
+ * same bucket. A queue whose bucket is exhausted waits for the bucket reset on
+ * the scheduler instead of blocking a connection. The global request limit
+ * is enforced over all queues.
+ * https://discord.com/developers/docs/topics/rate-limits
+ */
+class RestClient
+{
+public:
+    /**
+     * HTTP response
+     */
+    struct Response
+    {
+        int status = 0;                                             // HTTP status code, 0 on transport errors
+        std::map<std::string, std::string, std::less<>> headers;    // header names are lowercase
+        std::string body;
+        std::string error;                                          // transport error message
+
+        inline bool ok() const
+        {
+            return this->status >= 200 && this->status < 300;
+        }
+
+        /**
+         * Returns the value of the given header or an empty string, the name must be lowercase.
+         */
+        std::string_view header(std::string_view name) const;
+    };
+
+    /**
+     * Creates a client for the given API base URL, for example https://discord.com/api/v8.
+     * The connections are opened in the background right away.
+     * The latency of each request is recorded to metrics if given.
+     */
+    RestClient(Scheduler &scheduler, const std::string &base_url, const std::string &token, std::size_t connections = 2, Metrics *metrics = nullptr);
+    ~RestClient();
+
+    RestClient(const RestClient&) = delete;
+    RestClient &operator= (const RestClient&) = delete;
+
+    /**
+     * Queues a request, the path is relative to the base URL.
+     * A non-empty body is sent as JSON.
+     */
+    std::future<Response> request(std::string_view method, std::string_view path, std::string_view body = {});
+
+    /**
+     * Amount of connections opened so far, each one costs a TCP and TLS handshake.
+     */
+    inline std::uint64_t connects() const
+    {
+        return this->_connects.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Amount of 429 responses received, requests are retried after the given delay.
+     */
+    inline std::uint64_t rateLimited() const
+    {
+        return this->_rate_limited.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Sets the global request limit per second, Discord allows 50 requests per second by default.
+     */
+    void setGlobalLimit(std::uint32_t requests_per_second);
+
+private:
+    using clock = Scheduler::clock;
+
+    struct Job
+    {
+        std::string route;      // rate limit route key
+        std::string request;    // serialized HTTP request
+        std::promise<Response> promise;
+    };
+
+    // rate limit state of a bucket, shared by all routes in it
+    struct Bucket
+    {
+        std::int64_t limit = 1;     // requests per window, 1 until known
+        std::int64_t remaining = 1;
+        clock::time_point reset;    // remaining is restored to limit after this point
+    };
+
+    // requests of a single route, sent one at a time
+    struct Route
+    {
+        std::string major;                  // major parameter, for example channels/1234
+        std::string path;                   // route template, maps to the bucket hash
+        std::shared_ptr<Bucket> bucket;
+        std::deque<Job> jobs;
+        bool busy = false;                  // a request is in flight
+        Scheduler::TimerId timer = 0;       // pending wake up
+    };
+
+    std::string _host;
+    int _port = 443;
+    bool _tls = true;
+    std::string _prefix;        // path of the base URL
+    std::string _headers;       // prebuilt common header block
+
+    Scheduler &_scheduler;
+    Metrics *_metrics;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<Job> _jobs;      // requests cleared by the rate limiter
+    bool _running = true;
+    std::vector<std::thread> _workers;
+
+    std::unordered_map<std::string, Route> _routes;                     // by route key
+    std::unordered_map<std::string, std::string> _hashes;               // route template -> bucket hash
+    std::unordered_map<std::string, std::weak_ptr<Bucket>> _buckets;    // bucket hash + major parameter -> bucket
+
+    std::uint32_t _global_limit = 50;
+    std::deque<clock::time_point> _global_sent; // send times within the last second
+    clock::time_point _global_reset;            // set by a global 429
+    std::uint32_t _sweep = 0;                   // requests until idle routes are swept
+
+    std::atomic<std::uint64_t> _connects = 0;
+    std::atomic<std::uint64_t> _rate_limited = 0;
+
+    void run();
+    bool open(HttpConnection &connection, Response &response);
+    Response perform(HttpConnection &connection, const std::string &request);
+
+    // rate limiter, called with _mutex held
+    void dispatch(const std::string &key, Route &route);
+    void complete(Job &&job, Response &&response);
+    void wake_up(const std::string &key, Route &route, clock::time_point when);
+    void sweep();
+};
+
+DISCORD_NS_END
+
+#endif // DISCORD_REST_CLIENT_HPP
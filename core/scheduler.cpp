@@ -0,0 +1,153 @@
+#include "scheduler.hpp"
+
+#include <algorithm>
+
+DISCORD_NS_BEGIN
+
+Scheduler::Scheduler()
+{
+    this->_thr = std::thread(&Scheduler::run, this);
+}
+
+Scheduler::~Scheduler()
+{
+    this->stop();
+}
+
+Scheduler::TimerId Scheduler::schedule(clock::duration delay, Task task)
+{
+    return this->schedule_at(clock::now() + delay, std::move(task));
+}
+
+Scheduler::TimerId Scheduler::schedule_at(clock::time_point when, Task task)
+{
+    std::lock_guard lk{this->_mutex};
+
+    const auto id = this->_next_id++;
+    this->_timers.emplace(id, Timer{std::move(task), clock::duration::zero()});
+    this->_heap.emplace_back(Entry{when, id});
+    std::push_heap(this->_heap.begin(), this->_heap.end(), std::greater<>{});
+
+    // only wake up when the new timer is the earliest one
+    if (this->_heap.front().id == id)
+    {
+        this->_cv.notify_one();
+    }
+
+    return id;
+}
+
+Scheduler::TimerId Scheduler::schedule_every(clock::duration interval, Task task, clock::duration first_delay)
+{
+    std::lock_guard lk{this->_mutex};
+
+    const auto id = this->_next_id++;
+    this->_timers.emplace(id, Timer{std::move(task), interval});
+    this->_heap.emplace_back(Entry{clock::now() + first_delay, id});
+    std::push_heap(this->_heap.begin(), this->_heap.end(), std::greater<>{});
+
+    if (this->_heap.front().id == id)
+    {
+        this->_cv.notify_one();
+    }
+
+    return id;
+}
+
+bool Scheduler::cancel(TimerId id)
+{
+    std::unique_lock lk{this->_mutex};
+
+    // heap entries of cancelled timers are skipped lazily
+    const auto erased = this->_timers.erase(id) > 0;
+
+    // wait for a running task to finish, unless we are called from the task itself
+    if (std::this_thread::get_id() != this->_thr.get_id())
+    {
+        this->_done_cv.wait(lk, [&]{ return this->_current != id; });
+    }
+
+    return erased;
+}
+
+void Scheduler::stop()
+{
+    {
+        std::lock_guard lk{this->_mutex};
+        if (!this->_running)
+        {
+            return;
+        }
+        this->_running = false;
+    }
+
+    this->_cv.notify_all();
+
+    if (this->_thr.joinable())
+    {
+        this->_thr.join();
+    }
+
+    this->_heap.clear();
+    this->_timers.clear();
+}
+
+void Scheduler::run()
+{
+    std::unique_lock lk{this->_mutex};
+
+    while (this->_running)
+    {
+        if (this->_heap.empty())
+        {
+            this->_cv.wait(lk);
+            continue;
+        }
+
+        const auto entry = this->_heap.front();
+        if (clock::now() < entry.when)
+        {
+            this->_cv.wait_until(lk, entry.when);
+            continue;
+        }
+
+        std::pop_heap(this->_heap.begin(), this->_heap.end(), std::greater<>{});
+        this->_heap.pop_back();
+
+        auto it = this->_timers.find(entry.id);
+        if (it == this->_timers.end())
+        {
+            // cancelled
+            continue;
+        }
+
+        // the task is moved out while running, so it can be cancelled from within itself
+        const auto interval = it->second.interval;
+        auto task = std::move(it->second.task);
+        if (interval == clock::duration::zero())
+        {
+            this->_timers.erase(it);
+        }
+
+        this->_current = entry.id;
+        lk.unlock();
+        task();
+        lk.lock();
+        this->_current = 0;
+        this->_done_cv.notify_all();
+
+        // periodic timers are rescheduled relative to their due time to avoid drift
+        if (interval != clock::duration::zero())
+        {
+            it = this->_timers.find(entry.id);
+            if (it != this->_timers.end())
+            {
+                it->second.task = std::move(task);
+                this->_heap.emplace_back(Entry{std::max(entry.when + interval, clock::now()), entry.id});
+                std::push_heap(this->_heap.begin(), this->_heap.end(), std::greater<>{});
+            }
+        }
+    }
+}
+
+DISCORD_NS_END
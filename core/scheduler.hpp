@@ -0,0 +1,105 @@
+#ifndef DISCORD_SCHEDULER_HPP
+#define DISCORD_SCHEDULER_HPP
+
+#include "config.hpp"
+
+#include <functional>
+#include <chrono>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+DISCORD_NS_BEGIN
+
+/**
+ * Timer scheduler
+ *
+ * Runs one-shot and periodic tasks on a single thread. Timers are kept in a
+ * min-heap ordered by their due time and the thread sleeps on a condition
+ * variable until the earliest timer is due, so an idle scheduler does not wake up.
+ *
+ * Tasks run on the scheduler thread and should not block, hand longer
+ * work over to another thread.
+ */
+class Scheduler
+{
+public:
+    using clock = std::chrono::steady_clock;
+    using TimerId = std::uint64_t;
+    using Task = std::function<void()>;
+
+    Scheduler();
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler &operator= (const Scheduler&) = delete;
+
+    /**
+     * Runs the task once after the given delay.
+     */
+    TimerId schedule(clock::duration delay, Task task);
+
+    /**
+     * Runs the task once at the given time.
+     */
+    TimerId schedule_at(clock::time_point when, Task task);
+
+    /**
+     * Runs the task periodically, the first run happens after first_delay.
+     */
+    TimerId schedule_every(clock::duration interval, Task task, clock::duration first_delay);
+
+    inline TimerId schedule_every(clock::duration interval, Task task)
+    {
+        return this->schedule_every(interval, std::move(task), interval);
+    }
+
+    /**
+     * Cancels a timer. When the task is currently running on another thread
+     * this call blocks until it finished. Returns false for unknown timers.
+     */
+    bool cancel(TimerId id);
+
+    /**
+     * Stops the scheduler thread, pending timers are discarded.
+     */
+    void stop();
+
+private:
+    struct Timer
+    {
+        Task task;
+        clock::duration interval; // zero for one-shot timers
+    };
+
+    struct Entry
+    {
+        clock::time_point when;
+        TimerId id;
+
+        inline bool operator> (const Entry &other) const
+        {
+            return this->when > other.when;
+        }
+    };
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::condition_variable _done_cv;
+    std::thread _thr;
+    bool _running = true;
+
+    TimerId _next_id = 1;
+    TimerId _current = 0; // timer which is currently running
+    std::vector<Entry> _heap;
+    std::unordered_map<TimerId, Timer> _timers;
+
+    void run();
+};
+
+DISCORD_NS_END
+
+#endif // DISCORD_SCHEDULER_HPP
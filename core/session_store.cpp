@@ -0,0 +1,110 @@
+#include "session_store.hpp"
+#include "utils/log.hpp"
+#include "utils/file.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <cerrno>
+#include <cstring>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+DISCORD_NS_BEGIN
+
+namespace
+{
+
+// logging tag
+static constexpr std::string_view TAG("SessionStore");
+
+// file format version, files of other versions are ignored
+static constexpr std::uint32_t VERSION = 1;
+
+} // anonymous namespace
+
+SessionStore::SessionStore(const std::string &path)
+    : _path(path)
+{
+}
+
+std::vector<Session> SessionStore::load(std::uint32_t shard_count) const
+{
+    std::vector<Session> sessions(shard_count);
+
+    std::ifstream ifs(this->_path, std::ios::in | std::ios::binary);
+    if (!ifs.is_open())
+    {
+        return sessions;
+    }
+
+    try {
+        const auto j = json::parse(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        if (j.at("version").get<std::uint32_t>() != VERSION)
+        {
+            Utils::log_warning(TAG, "ignoring sessions of file version {}", j.at("version").get<std::uint32_t>());
+            return sessions;
+        }
+
+        if (j.at("shard_count").get<std::uint32_t>() != shard_count)
+        {
+            Utils::log_info(TAG, "shard count changed from {} to {}, sessions can't be resumed", j.at("shard_count").get<std::uint32_t>(), shard_count);
+            return sessions;
+        }
+
+        for (auto&& session : j.at("sessions"))
+        {
+            const auto shard = session.at("shard").get<std::uint32_t>();
+            if (shard < shard_count)
+            {
+                sessions[shard].id = session.at("session_id").get<std::string>();
+                sessions[shard].seq = session.at("seq").get<std::int32_t>();
+            }
+        }
+    } catch (json::exception &e) {
+        Utils::log_warning(TAG, "ignoring invalid session file {}: {}", this->_path, e.what());
+        return std::vector<Session>(shard_count);
+    }
+
+    return sessions;
+}
+
+bool SessionStore::save(std::uint32_t shard_count, const std::vector<Session> &sessions)
+{
+    json j;
+    j["version"] = VERSION;
+    j["shard_count"] = shard_count;
+    j["sessions"] = json::array();
+    for (std::uint32_t shard = 0; shard < sessions.size(); ++shard)
+    {
+        if (sessions[shard])
+        {
+            j["sessions"].push_back({
+                {"shard", shard},
+                {"session_id", sessions[shard].id},
+                {"seq", sessions[shard].seq},
+            });
+        }
+    }
+
+    const auto data = j.dump();
+
+    std::lock_guard lk{this->_mutex};
+    if (data == this->_saved)
+    {
+        return true;
+    }
+
+    // the old file is replaced in a single step, readers see either the old or the new sessions
+    if (!Utils::write_file_atomic(this->_path, data, 0600))
+    {
+        Utils::log_warning(TAG, "failed to save the sessions to {}: {}", this->_path, std::strerror(errno));
+        return false;
+    }
+
+    this->_saved = data;
+    return true;
+}
+
+DISCORD_NS_END
@@ -0,0 +1,61 @@
+#ifndef DISCORD_SESSION_STORE_HPP
+#define DISCORD_SESSION_STORE_HPP
+
+#include "config.hpp"
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+DISCORD_NS_BEGIN
+
+/**
+ * Gateway session of a shard, everything needed to RESUME it.
+ */
+struct Session
+{
+    std::string id;             // session_id of the READY event
+    std::int32_t seq = -1;      // last received sequence number
+
+    inline explicit operator bool() const
+    {
+        return !this->id.empty() && this->seq >= 0;
+    }
+
+    bool operator== (const Session&) const = default;
+};
+
+/**
+ * Keeps the sessions of all shards in a small file, so a restarted process
+ * can resume them instead of identifying again.
+ *
+ * The file is replaced atomically, a crash while saving leaves the previous
+ * checkpoint intact.
+ */
+class SessionStore
+{
+public:
+    explicit SessionStore(const std::string &path);
+
+    /**
+     * Sessions by shard id. Sessions of another shard count can't be resumed,
+     * all sessions are empty then, as well as when the file is missing or invalid.
+     */
+    std::vector<Session> load(std::uint32_t shard_count) const;
+
+    /**
+     * Writes the sessions by shard id, skipped when nothing changed since the last save.
+     */
+    bool save(std::uint32_t shard_count, const std::vector<Session> &sessions);
+
+private:
+    const std::string _path;
+
+    std::mutex _mutex;
+    std::string _saved;     // contents of the last save
+};
+
+DISCORD_NS_END
+
+#endif // DISCORD_SESSION_STORE_HPP
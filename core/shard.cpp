@@ -0,0 +1,624 @@
+#include "shard.hpp"
+#include "shard_manager.hpp"
+#include "gateway.hpp"
+#include "envelope.hpp"
+#include "json_decoder.hpp"
+#include "payload_writer.hpp"
+#include "command_queue.hpp"
+#include "utils/os.hpp"
+#include "utils/log.hpp"
+#include "utils/json.hpp"
+#include "utils/etf.hpp"
+
+#include <functional>
+#include <chrono>
+#include <random>
+#include <utility>
+
+#include <ixwebsocket/IXWebSocket.h>
+
+#include <nlohmann/json.hpp>
+
+#include <fmt/format.h>
+
+#include <magic_enum.hpp>
+
+using json = nlohmann::json;
+
+DISCORD_NS_BEGIN
+
+namespace
+{
+
+// random factor in [0, 1) for the first heartbeat
+static inline double heartbeat_jitter()
+{
+    thread_local std::mt19937 rng{std::random_device{}()};
+    return std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+}
+
+// Discord Gateway version and encoding
+static const std::string URL_WSS_SUFFIX("/?v=6&encoding=json");
+static const std::string URL_WSS_ETF_SUFFIX("/?v=6&encoding=etf");
+static const std::string URL_WSS_COMPRESS_SUFFIX("&compress=zlib-stream");
+
+// close code which keeps the session valid, the gateway invalidates it on 1000 and 1001
+static constexpr std::uint16_t CLOSE_RESUMABLE = 4000;
+
+} // anonymous namespace
+
+Shard::Shard(Client *client, ShardManager *manager, std::uint32_t id, std::uint32_t count)
+    : _client(client),
+      _manager(manager),
+      _id(id),
+      _count(count),
+      _tag(fmt::format("Shard {}/{}", id, count)),
+      _decoder(JsonDecoder::create(client->_json_backend)),
+      _writer(std::make_unique<PayloadWriter>(client->_encoding)),
+      _commands(std::make_unique<CommandQueue>())
+{
+    // the identify payload does not change while the client runs
+    json identify;
+    identify["token"] = this->_client->_token;
+    identify["properties"]["$os"] = Utils::get_os_name();
+    identify["properties"]["$browser"] = "misaka-oneesama";
+    identify["properties"]["$device"] = "misaka-oneesama";
+    identify["intents"] = static_cast<std::uint32_t>(this->_client->_intents);
+    identify["shard"] = {this->_id, this->_count};
+
+    this->_writer->prepare(identify, this->_client->_token);
+}
+
+Shard::~Shard()
+{
+    this->disconnect();
+}
+
+void Shard::connect()
+{
+    this->_closing = false;
+
+    // the send limit applies per connection
+    {
+        std::lock_guard lk{this->_send_mutex};
+        this->_commands->reset();
+    }
+
+    this->_url = this->_client->_gateway->url +
+        (this->_client->_encoding == Client::Encoding::ETF ? URL_WSS_ETF_SUFFIX : URL_WSS_SUFFIX);
+    if (this->_client->_compression)
+    {
+        // every connection starts with a fresh inflate context
+        this->_url += URL_WSS_COMPRESS_SUFFIX;
+        this->_inflate.reset();
+    }
+
+    // open websocket connection
+    this->_ws = std::make_unique<ix::WebSocket>();
+    this->_ws->setUrl(this->_url);
+    this->_ws->disableAutomaticReconnection(); // reconnects are handled by the shard manager
+    this->_ws->setOnMessageCallback(std::bind(&Shard::on_websocket_event, this, std::placeholders::_1));
+    this->_ws->start();
+}
+
+void Shard::disconnect(bool resumable)
+{
+    this->_closing = true;
+
+    // stop the connection first, so no new heartbeat timer can be started afterwards
+    if (this->_ws)
+    {
+        if (resumable)
+        {
+            this->_ws->stop(CLOSE_RESUMABLE, "resume");
+        }
+        else
+        {
+            this->_ws->stop();
+        }
+    }
+
+    this->stop_heartbeat();
+
+    // queued commands are kept for the next session
+    Scheduler::TimerId flush_timer;
+    {
+        std::lock_guard lk{this->_send_mutex};
+        this->_session_ready = false;
+        flush_timer = std::exchange(this->_flush_timer, 0);
+    }
+    if (flush_timer != 0)
+    {
+        this->_client->_scheduler.cancel(flush_timer);
+    }
+
+    if (this->_ws && this->_client->_compression)
+    {
+        const auto stats = this->_inflate.stats();
+        Utils::log_info(this->_tag, "transport compression: {} -> {} bytes (ratio {:.2f}), {} messages, inflate time {:.3f}ms",
+            stats.compressed_bytes, stats.inflated_bytes, stats.ratio(), stats.messages, stats.inflate_time_ns / 1e6);
+    }
+
+    this->_ws.reset();
+}
+
+void Shard::restore(const Session &session)
+{
+    {
+        std::lock_guard lk{this->_session_mutex};
+        this->_session_id = session.id;
+    }
+    this->_last_seq = session.seq;
+}
+
+Session Shard::session() const
+{
+    std::lock_guard lk{this->_session_mutex};
+    return {this->_session_id, this->_last_seq.load()};
+}
+
+void Shard::heartbeat()
+{
+    // the ACK can't be read while the receive thread waits for space in the event queue
+    const auto stalled = this->_stalled.exchange(false) || this->_dispatching;
+
+    // zombied connection, let the shard manager reconnect us
+    if (!this->_heartbeat_ack_received && !stalled)
+    {
+        Utils::log_warning(this->_tag, "heartbeat was not acknowledged, reconnecting...");
+        this->_manager->request_reconnect(this);
+        return;
+    }
+
+    this->send_heartbeat();
+    this->_heartbeat_ack_received = false;
+}
+
+void Shard::start_heartbeat()
+{
+    this->stop_heartbeat();
+
+    // the first heartbeat is sent after heartbeat_interval * jitter
+    // https://discord.com/developers/docs/topics/gateway#heartbeating
+    const auto interval = std::chrono::milliseconds(this->_heartbeat_interval.load());
+    const auto first = std::chrono::duration_cast<Scheduler::clock::duration>(interval * heartbeat_jitter());
+
+    this->_heartbeat_ack_received = true;
+
+    std::lock_guard lk{this->_heartbeat_mutex};
+    this->_heartbeat_timer = this->_client->_scheduler.schedule_every(interval, [this]{
+        this->heartbeat();
+    }, first);
+}
+
+void Shard::stop_heartbeat()
+{
+    std::lock_guard lk{this->_heartbeat_mutex};
+
+    if (this->_heartbeat_timer != 0)
+    {
+        this->_client->_scheduler.cancel(this->_heartbeat_timer);
+        this->_heartbeat_timer = 0;
+    }
+}
+
+void Shard::on_websocket_event(const ix::WebSocketMessagePtr &msg)
+{
+    switch (msg->type)
+    {
+        // handle ws open event
+        case ix::WebSocketMessageType::Open:
+            Utils::log_info(this->_tag, "WebSocket connection opened: {} [{}]", this->_url, msg->openInfo.protocol);
+            break;
+
+        // handle ws error event
+        case ix::WebSocketMessageType::Error:
+            this->_client->_ret = 1;
+            Utils::log_error(this->_tag, "WebSocket connection error: {}", msg->errorInfo.reason);
+            break;
+
+        // handle ws close event
+        case ix::WebSocketMessageType::Close:
+            Utils::log_info(this->_tag, "WebSocket connection closed: {} [{}]", msg->closeInfo.reason, msg->closeInfo.code);
+
+            // closed by ourself
+            if (this->_closing)
+            {
+                break;
+            }
+
+            // TODO: handle all the gateway errors
+
+            if (msg->closeInfo.code == static_cast<std::uint16_t>(Client::GatewayCloseEventCode::DISALLOWED_INTENT))
+            {
+                Utils::log_error(this->_tag, "Disallowed intents, shutting down bot...");
+                this->_client->_ret = 1;
+                this->_client->stop();
+            }
+            else if (msg->closeInfo.code == static_cast<std::uint16_t>(Client::GatewayCloseEventCode::SHARDING_REQUIRED) ||
+                     msg->closeInfo.code == static_cast<std::uint16_t>(Client::GatewayCloseEventCode::INVALID_SHARD))
+            {
+                Utils::log_error(this->_tag, "Invalid shard configuration, shutting down bot...");
+                this->_client->_ret = 1;
+                this->_client->stop();
+            }
+            else
+            {
+                Utils::log_warning(this->_tag, "Remote closure, attempting reconnect...");
+                this->_manager->request_reconnect(this);
+            }
+            break;
+
+        // handle discord messages
+        case ix::WebSocketMessageType::Message:
+            this->on_websocket_message(msg);
+            break;
+    }
+}
+
+void Shard::on_websocket_message(const ix::WebSocketMessagePtr &msg)
+{
+    std::string_view data = msg->str;
+
+    // inflate compressed frames, incomplete messages are buffered until the next frame
+    if (this->_client->_compression && msg->binary)
+    {
+        if (!this->_inflate.feed(data))
+        {
+            if (this->_inflate.error())
+            {
+                Utils::log_warning(this->_tag, "inflating the transport stream failed, reconnecting...");
+                this->_manager->request_reconnect(this);
+            }
+            return;
+        }
+
+        data = this->_inflate.output();
+    }
+
+    if (this->_client->_encoding == Client::Encoding::ETF)
+    {
+        Utils::log_trace(this->_tag, "received message: [{} bytes ETF]", data.size());
+    }
+    else
+    {
+        Utils::log_trace(this->_tag, "received message: {}", data);
+    }
+
+    auto &metrics = this->_client->_metrics;
+
+    Payload payload;
+    const auto envelope = Envelope::scan(data, this->_client->_encoding);
+    if (envelope.valid)
+    {
+        const auto event = envelope.op == Client::GatewayOpcode::DISPATCH ? event_from_name(envelope.t) : Event::UNKNOWN;
+        metrics.record_frame(static_cast<std::uint32_t>(envelope.op), event);
+
+        // events nobody subscribed to are dropped before their data is decoded
+        if (envelope.op == Client::GatewayOpcode::DISPATCH && !this->wants(envelope.t))
+        {
+            this->_last_seq = envelope.s;
+            return;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        payload = this->parse_payload(envelope);
+        metrics.record_parse(std::chrono::steady_clock::now() - start);
+    }
+    else
+    {
+        // fall back to a full decode, for example for compressed ETF terms
+        const auto start = std::chrono::steady_clock::now();
+        payload = this->parse_payload(data);
+        metrics.record_parse(std::chrono::steady_clock::now() - start);
+        if (payload.valid)
+        {
+            metrics.record_frame(static_cast<std::uint32_t>(payload.op), payload.event);
+        }
+    }
+
+    Utils::log_trace(this->_tag, "parsed payload: {}", payload);
+    if (!payload.valid)
+    {
+        return;
+    }
+
+    // initialize or send heartbeat
+    if (payload.op == Client::GatewayOpcode::HELLO)
+    {
+        this->_heartbeat_interval = Utils::get_json_value<std::uint32_t>(payload.msg, "heartbeat_interval");
+        if (this->_heartbeat_interval == 0)
+        {
+            Utils::log_error(this->_tag, "failed to obtain the heartbeat interval, shutting down bot...");
+            this->_client->stop();
+            return;
+        }
+
+        bool resume;
+        {
+            std::lock_guard lk{this->_session_mutex};
+            resume = !this->_session_id.empty();
+        }
+
+        // identifies are rate limited per bucket, the shard manager sends it when allowed
+        this->_resuming = resume;
+        if (resume)
+        {
+            this->send_resume();
+        }
+        else
+        {
+            this->_manager->request_identify(this);
+        }
+
+        // (re)start heartbeating
+        this->start_heartbeat();
+    }
+
+    // heartbeat acknowledged, keep session active
+    else if (payload.op == Client::GatewayOpcode::HEARTBEAT_ACK)
+    {
+        this->_heartbeat_ack_received = true;
+
+        if (const auto sent = this->_heartbeat_sent.exchange(0); sent != 0)
+        {
+            metrics.record_heartbeat(std::chrono::steady_clock::now().time_since_epoch() - std::chrono::nanoseconds(sent));
+        }
+    }
+
+    // heartbeat requested by the gateway, reply immediately
+    else if (payload.op == Client::GatewayOpcode::HEARTBEAT)
+    {
+        this->send_heartbeat();
+    }
+
+    // gateway asks us to reconnect and resume
+    else if (payload.op == Client::GatewayOpcode::RECONNECT)
+    {
+        this->_manager->request_reconnect(this);
+    }
+
+    // dispatch
+    else if (payload.op == Client::GatewayOpcode::DISPATCH)
+    {
+        // store last sequence
+        this->_last_seq = payload.s;
+
+        // bot is ready, obtain some data for session restore
+        if (payload.event == Event::READY)
+        {
+            std::lock_guard lk{this->_session_mutex};
+            this->_session_id = Utils::get_json_value<std::string>(payload.msg, "session_id");
+        }
+
+        // commands can be sent once the session is established
+        if (payload.event == Event::READY || payload.event == Event::RESUMED)
+        {
+            std::uint64_t session = 0;
+            {
+                std::lock_guard lk{this->_send_mutex};
+                if (payload.event == Event::READY)
+                {
+                    session = ++this->_sessions;
+                }
+                this->_session_ready = true;
+                this->flush_commands();
+            }
+
+            // the new session doesn't answer requests sent before
+            if (session != 0)
+            {
+                this->_client->on_session_replaced(*this, session);
+            }
+        }
+
+        // first event since the client started, either resumed or of a new session
+        if (!this->_started)
+        {
+            this->_started = true;
+            this->_client->on_session_started(*this, this->_resuming);
+        }
+
+        // the dispatch waits when the event queue is full, see heartbeat()
+        this->_dispatching = true;
+        if (this->_client->on_dispatch(payload))
+        {
+            this->_stalled = true;
+        }
+        this->_dispatching = false;
+    }
+
+    // session is invalid
+    else if (payload.op == Client::GatewayOpcode::INVALID_SESSION)
+    {
+        Utils::log_warning(this->_tag, "received a invalid session response");
+
+        if (payload.msg.is_boolean() && payload.msg.get<bool>())
+        {
+            Utils::log_info(this->_tag, "trying to resume session...");
+            this->send_resume();
+        }
+        else
+        {
+            Utils::log_info(this->_tag, "starting a new session...");
+            {
+                std::lock_guard lk{this->_session_mutex};
+                this->_session_id.clear();
+            }
+            this->_last_seq = -1;
+            this->_resuming = false;
+            this->_manager->request_identify(this);
+        }
+    }
+}
+
+const Payload Shard::parse_payload(std::string_view payload)
+{
+    try {
+        auto j = this->_client->_encoding == Client::Encoding::ETF ?
+            Utils::Etf::decode(payload) :
+            json::parse(payload.begin(), payload.end());
+        Payload payload;
+        payload.op = static_cast<Client::GatewayOpcode>(j["op"].get<std::uint32_t>());
+        payload.msg = j["d"]; // contains event data based on opcode
+        payload.s = j.at("s").is_null() ? 0 : j["s"].get<std::uint32_t>();
+        payload.t = j.at("t").is_null() ? "" : j["t"].get<std::string>();
+        payload.event = event_from_name(payload.t);
+        payload.valid = true;
+        return payload;
+    } catch (json::exception &e) {
+        Utils::log_warning(this->_tag, "parsing the payload failed, ignoring message: {}", e.what());
+    } catch (Utils::Etf::error &e) {
+        Utils::log_warning(this->_tag, "decoding the payload failed, ignoring message: {}", e.what());
+    }
+
+    return {};
+}
+
+const Payload Shard::parse_payload(const Envelope &envelope)
+{
+    try {
+        return envelope.payload(*this->_decoder);
+    } catch (JsonDecoder::error &e) {
+        Utils::log_warning(this->_tag, "parsing the payload failed, ignoring message: {}", e.what());
+    } catch (json::exception &e) {
+        Utils::log_warning(this->_tag, "parsing the payload failed, ignoring message: {}", e.what());
+    } catch (Utils::Etf::error &e) {
+        Utils::log_warning(this->_tag, "decoding the payload failed, ignoring message: {}", e.what());
+    }
+
+    return {};
+}
+
+bool Shard::wants(std::string_view name) const
+{
+    // READY and RESUMED carry the session state
+    const auto event = event_from_name(name);
+    return event == Event::READY || event == Event::RESUMED || this->_client->wants(event, name);
+}
+
+void Shard::send_message(Client::GatewayOpcode op, const json &data, bool log)
+{
+    std::lock_guard lk{this->_send_mutex};
+    if (!this->_commands->push({op, data, log}))
+    {
+        Utils::log_debug(this->_tag, "queued {} command replaced", magic_enum::enum_name(op));
+    }
+
+    this->flush_commands();
+}
+
+std::uint64_t Shard::send_request(Client::GatewayOpcode op, const json &data)
+{
+    std::lock_guard lk{this->_send_mutex};
+    this->_commands->push({op, data, true});
+
+    // queued until the next session starts
+    const auto session = this->_session_ready ? this->_sessions : this->_sessions + 1;
+    this->flush_commands();
+    return session;
+}
+
+void Shard::flush_commands()
+{
+    if (!this->_session_ready)
+    {
+        return;
+    }
+
+    while (auto command = this->_commands->pop(std::chrono::steady_clock::now()))
+    {
+        const auto &frame = this->_writer->write(command->op, command->data);
+
+        if (!command->log)
+        {
+            Utils::log_debug(this->_tag, "sending message ({}): [CONTENTS REDACTED DUE TO SENSITIVE DATA]", magic_enum::enum_name(command->op));
+        }
+        else if (this->_writer->encoding() == Client::Encoding::ETF)
+        {
+            Utils::log_debug(this->_tag, "sending message ({}): [{} bytes ETF]", magic_enum::enum_name(command->op), frame.size());
+        }
+        else
+        {
+            Utils::log_debug(this->_tag, "sending message ({}): {}", magic_enum::enum_name(command->op), frame);
+        }
+
+        this->send_frame(frame);
+    }
+
+    if (this->_commands->empty() || this->_flush_timer != 0)
+    {
+        return;
+    }
+
+    Utils::log_debug(this->_tag, "gateway send limit reached, {} command(s) queued", this->_commands->size());
+    this->_flush_timer = this->_client->_scheduler.schedule_at(this->_commands->next(), [this]{
+        std::lock_guard lk{this->_send_mutex};
+        this->_flush_timer = 0;
+        this->flush_commands();
+    });
+}
+
+void Shard::send_identity()
+{
+    Utils::log_debug(this->_tag, "sending message (IDENTIFY): [CONTENTS REDACTED DUE TO SENSITIVE DATA]");
+
+    std::lock_guard lk{this->_send_mutex};
+    this->acquire_priority(Client::GatewayOpcode::IDENTIFY);
+    this->send_frame(this->_writer->identify());
+}
+
+void Shard::send_resume()
+{
+    Utils::log_debug(this->_tag, "sending message (RESUME): [CONTENTS REDACTED DUE TO SENSITIVE DATA]");
+
+    std::string session_id;
+    {
+        std::lock_guard lk{this->_session_mutex};
+        session_id = this->_session_id;
+    }
+
+    std::lock_guard lk{this->_send_mutex};
+    this->acquire_priority(Client::GatewayOpcode::RESUME);
+    this->send_frame(this->_writer->resume(session_id, this->_last_seq.load()));
+}
+
+void Shard::send_heartbeat()
+{
+    const auto seq = this->_last_seq.load();
+    Utils::log_debug(this->_tag, "sending message (HEARTBEAT): {}", seq);
+
+    std::lock_guard lk{this->_send_mutex};
+    this->acquire_priority(Client::GatewayOpcode::HEARTBEAT);
+    const auto &frame = this->_writer->heartbeat(seq);
+    this->_heartbeat_sent = std::chrono::steady_clock::now().time_since_epoch().count();
+    this->send_frame(frame);
+}
+
+void Shard::acquire_priority(Client::GatewayOpcode op)
+{
+    // queued commands leave slots free for these, the limit is only exceeded by a gateway flooding us with heartbeat requests
+    if (!this->_commands->acquire_priority(std::chrono::steady_clock::now()))
+    {
+        Utils::log_warning(this->_tag, "sending {} exceeds the gateway send limit", magic_enum::enum_name(op));
+    }
+}
+
+void Shard::send_frame(const std::string &frame)
+{
+    if (!this->_ws)
+    {
+        return;
+    }
+
+    if (this->_writer->encoding() == Client::Encoding::ETF)
+    {
+        this->_ws->sendBinary(frame);
+    }
+    else
+    {
+        this->_ws->send(frame);
+    }
+}
+
+DISCORD_NS_END
@@ -0,0 +1,173 @@
+#ifndef DISCORD_SHARD_HPP
+#define DISCORD_SHARD_HPP
+
+#include "config.hpp"
+#include "client.hpp"
+#include "scheduler.hpp"
+#include "session_store.hpp"
+#include "utils/zlib_stream.hpp"
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+// IXWebSocket forward declarations
+namespace ix
+{
+    class WebSocket;
+    struct WebSocketMessage;
+    using WebSocketMessagePtr = std::unique_ptr<WebSocketMessage>;
+}
+
+DISCORD_NS_BEGIN
+
+struct Payload;
+struct Envelope;
+class JsonDecoder;
+class PayloadWriter;
+class CommandQueue;
+class ShardManager;
+
+/**
+ * A single gateway connection.
+ * https://discord.com/developers/docs/topics/gateway#sharding
+ *
+ * Each shard owns its own WebSocket, heartbeat and session state.
+ * Connection lifecycle changes (identify, reconnect) are requested from
+ * the ShardManager which runs them on one of its worker threads.
+ */
+class Shard
+{
+public:
+    Shard(Client *client, ShardManager *manager, std::uint32_t id, std::uint32_t count);
+    ~Shard();
+
+    /**
+     * The shard id of this connection.
+     */
+    constexpr inline std::uint32_t id() const
+    {
+        return this->_id;
+    }
+
+    /**
+     * Opens the WebSocket connection.
+     */
+    void connect();
+
+    /**
+     * Closes the WebSocket connection and stops the heartbeat.
+     * A resumable close keeps the session valid on the gateway.
+     */
+    void disconnect(bool resumable = false);
+
+    /**
+     * Sets the session to resume on the next connect.
+     */
+    void restore(const Session &session);
+
+    /**
+     * Current session of this shard.
+     */
+    Session session() const;
+
+    /**
+     * Sends the IDENTIFY payload for this shard.
+     * Called by the ShardManager once the identify rate limit bucket allows it.
+     */
+    void send_identity();
+
+    /**
+     * Sends a gateway command on this shard, the data is logged unless log is false.
+     * Commands are queued until the session is established and when they would
+     * exceed the gateway send limit, see CommandQueue.
+     */
+    void send_message(Client::GatewayOpcode op, const nlohmann::json &data, bool log = true);
+
+    /**
+     * Sends a command like send_message() whose answer belongs to a session,
+     * returns the session in which it is sent. Sessions are counted by READY,
+     * a command held back by the send limit counts to the current session.
+     */
+    std::uint64_t send_request(Client::GatewayOpcode op, const nlohmann::json &data);
+
+    /**
+     * Transport compression statistics of this shard.
+     */
+    inline Utils::InflateStats transport_stats() const
+    {
+        return this->_inflate.stats();
+    }
+
+private:
+    Client *_client;
+    ShardManager *_manager;
+
+    const std::uint32_t _id;
+    const std::uint32_t _count;
+    const std::string _tag;
+
+    std::unique_ptr<ix::WebSocket> _ws;
+    std::string _url;
+
+    // zlib-stream inflate context, one per connection
+    Utils::ZlibStream _inflate;
+
+    // decoder for JSON event data
+    std::unique_ptr<JsonDecoder> _decoder;
+
+    // outgoing frames, _send_mutex serializes the writer and the sends of all threads
+    std::unique_ptr<PayloadWriter> _writer;
+    std::mutex _send_mutex;
+
+    // commands wait for the session and the gateway send limit, guarded by _send_mutex
+    std::unique_ptr<CommandQueue> _commands;
+    bool _session_ready = false;
+    std::uint64_t _sessions = 0;    // sessions started with READY
+    Scheduler::TimerId _flush_timer = 0;
+
+    // set while the shard closes its own connection, close events are ignored then
+    std::atomic<bool> _closing = false;
+
+    std::atomic<std::uint32_t> _heartbeat_interval = 0;
+    std::atomic<std::int32_t> _last_seq = -1;
+    std::atomic<bool> _heartbeat_ack_received = false;
+    std::atomic<std::int64_t> _heartbeat_sent = 0;  // steady clock time of the unacknowledged heartbeat in ns
+    std::atomic<bool> _dispatching = false;     // the receive thread is in a dispatch
+    std::atomic<bool> _stalled = false;         // a dispatch waited for the event queue since the last heartbeat
+    std::mutex _heartbeat_mutex;
+    Scheduler::TimerId _heartbeat_timer = 0;
+
+    mutable std::mutex _session_mutex;
+    std::string _session_id;
+
+    bool _resuming = false;     // the current connection resumed its session
+    bool _started = false;      // events were received since the client started
+
+    void heartbeat();
+    void start_heartbeat();
+    void stop_heartbeat();
+
+    void on_websocket_event(const ix::WebSocketMessagePtr &msg);
+    void on_websocket_message(const ix::WebSocketMessagePtr &msg);
+
+    bool wants(std::string_view name) const;
+
+    const Payload parse_payload(std::string_view payload);
+    const Payload parse_payload(const Envelope &envelope);
+
+    void send_resume();
+    void send_heartbeat();
+    void send_frame(const std::string &frame);
+    void acquire_priority(Client::GatewayOpcode op);
+
+    // sends the queued commands which are allowed now, called with _send_mutex held
+    void flush_commands();
+};
+
+DISCORD_NS_END
+
+#endif // DISCORD_SHARD_HPP
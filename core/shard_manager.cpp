@@ -0,0 +1,186 @@
+#include "shard_manager.hpp"
+#include "shard.hpp"
+#include "scheduler.hpp"
+#include "gateway.hpp"
+#include "gateway_cache.hpp"
+#include "json_decoder.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+
+DISCORD_NS_BEGIN
+
+ShardManager::ShardManager(Client *client, const Gateway &gateway, std::uint32_t shard_count, std::uint32_t thread_count)
+    : _client(client)
+{
+    shard_count = std::max<std::uint32_t>(shard_count, 1);
+    thread_count = std::clamp<std::uint32_t>(thread_count, 1, shard_count);
+
+    for (std::uint32_t i = 0; i < shard_count; ++i)
+    {
+        this->_shards.emplace_back(std::make_unique<Shard>(client, this, i, shard_count));
+    }
+
+    for (std::uint32_t i = 0; i < thread_count; ++i)
+    {
+        this->_workers.emplace_back(std::make_unique<Worker>());
+    }
+
+    this->_identify_buckets.resize(std::max<std::uint32_t>(gateway.limit.max_concurrency, 1), clock::time_point::min());
+
+    Utils::log_info("ShardManager", "using {} shard(s) on {} thread(s), max_concurrency={}, json decoder: {}",
+        shard_count, thread_count, this->_identify_buckets.size(), JsonDecoder::create(client->_json_backend)->name());
+}
+
+ShardManager::~ShardManager()
+{
+    this->stop();
+}
+
+void ShardManager::start()
+{
+    this->_running = true;
+
+    for (auto&& worker : this->_workers)
+    {
+        worker->thr = std::thread(&ShardManager::run, this, std::ref(*worker));
+    }
+
+    for (auto&& shard : this->_shards)
+    {
+        this->post(this->worker_of(shard.get()), [shard = shard.get()]{
+            shard->connect();
+        });
+    }
+}
+
+void ShardManager::stop(bool resumable)
+{
+    if (!this->_running.exchange(false))
+    {
+        return;
+    }
+
+    // drop identifies which are not due yet, a running timer blocks cancel() until it posted its task
+    decltype(this->_timers) timers;
+    {
+        std::lock_guard lk{this->_timers_mutex};
+        timers.swap(this->_timers);
+    }
+    for (auto&& timer : timers)
+    {
+        this->_client->_scheduler.cancel(timer.second);
+    }
+
+    for (auto&& worker : this->_workers)
+    {
+        {
+            std::lock_guard lk{worker->mutex};
+            worker->tasks.clear();
+        }
+        worker->cv.notify_all();
+
+        if (worker->thr.joinable())
+        {
+            worker->thr.join();
+        }
+    }
+
+    for (auto&& shard : this->_shards)
+    {
+        shard->disconnect(resumable);
+    }
+}
+
+void ShardManager::request_identify(Shard *shard)
+{
+    // an exhausted session start limit delays the identify until the limit resets
+    const auto earliest = clock::now() + this->_client->_discovery->consume_identify();
+    clock::time_point slot;
+
+    {
+        std::lock_guard lk{this->_identify_mutex};
+        auto &next = this->_identify_buckets[shard->id() % this->_identify_buckets.size()];
+        slot = std::max(earliest, next);
+        next = slot + IDENTIFY_INTERVAL;
+    }
+
+    auto identify = [shard]{
+        shard->send_identity();
+    };
+
+    if (slot <= clock::now())
+    {
+        this->post(this->worker_of(shard), std::move(identify));
+        return;
+    }
+
+    // the worker stays free for other shards until the slot is due
+    std::lock_guard lk{this->_timers_mutex};
+    if (!this->_running)
+    {
+        return;
+    }
+
+    // forget timers which already fired
+    const auto now = clock::now();
+    std::erase_if(this->_timers, [&](const auto &timer){ return timer.first < now; });
+
+    const auto id = this->_client->_scheduler.schedule_at(slot, [this, shard, identify = std::move(identify)]() mutable {
+        this->post(this->worker_of(shard), std::move(identify));
+    });
+    this->_timers.emplace_back(slot, id);
+}
+
+void ShardManager::request_reconnect(Shard *shard)
+{
+    this->post(this->worker_of(shard), [shard]{
+        // keep the session, it is resumed after the connect
+        shard->disconnect(true);
+        shard->connect();
+    });
+}
+
+ShardManager::Worker &ShardManager::worker_of(const Shard *shard)
+{
+    return *this->_workers[shard->id() % this->_workers.size()];
+}
+
+void ShardManager::post(Worker &worker, std::function<void()> fn)
+{
+    if (!this->_running)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard lk{worker.mutex};
+        worker.tasks.emplace_back(std::move(fn));
+    }
+
+    worker.cv.notify_one();
+}
+
+void ShardManager::run(Worker &worker)
+{
+    std::unique_lock lk{worker.mutex};
+
+    while (this->_running)
+    {
+        if (worker.tasks.empty())
+        {
+            worker.cv.wait(lk);
+            continue;
+        }
+
+        auto task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+
+        // run the task without holding the lock, it may post new tasks
+        lk.unlock();
+        task();
+        lk.lock();
+    }
+}
+
+DISCORD_NS_END
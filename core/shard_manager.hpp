@@ -0,0 +1,113 @@
+#ifndef DISCORD_SHARD_MANAGER_HPP
+#define DISCORD_SHARD_MANAGER_HPP
+
+#include "config.hpp"
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <utility>
+#include <atomic>
+#include <cstdint>
+
+DISCORD_NS_BEGIN
+
+class Client;
+class Shard;
+struct Gateway;
+
+/**
+ * Owns all gateway connections of a client.
+ * https://discord.com/developers/docs/topics/gateway#sharding
+ *
+ * The shards are distributed over a configurable number of worker threads,
+ * which perform the connection lifecycle of their shards (connect, identify, reconnect).
+ *
+ * IDENTIFY calls are rate limited per bucket, the bucket of a shard is
+ * `shard_id % max_concurrency` and each bucket may identify once every 5 seconds.
+ * Delayed identifies are timed by the client scheduler and handed to the worker when due.
+ * https://discord.com/developers/docs/topics/gateway#sharding-max-concurrency
+ */
+class ShardManager
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    ShardManager(Client *client, const Gateway &gateway, std::uint32_t shard_count, std::uint32_t thread_count);
+    ~ShardManager();
+
+    /**
+     * Opens the connections of all shards.
+     */
+    void start();
+
+    /**
+     * Closes the connections of all shards and stops the worker threads.
+     * Resumable closes keep the sessions valid for a later RESUME.
+     */
+    void stop(bool resumable = false);
+
+    /**
+     * Queues an IDENTIFY for the given shard into its rate limit bucket.
+     */
+    void request_identify(Shard *shard);
+
+    /**
+     * Reconnects the given shard on its worker thread.
+     */
+    void request_reconnect(Shard *shard);
+
+    /**
+     * Amount of shards managed by this instance.
+     */
+    inline std::size_t size() const
+    {
+        return this->_shards.size();
+    }
+
+    /**
+     * All shards managed by this instance.
+     */
+    inline const std::vector<std::unique_ptr<Shard>> &shards() const
+    {
+        return this->_shards;
+    }
+
+private:
+    struct Worker
+    {
+        std::thread thr;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    // identify interval of a single rate limit bucket
+    static constexpr auto IDENTIFY_INTERVAL = std::chrono::seconds(5);
+
+    Client *_client;
+
+    std::vector<std::unique_ptr<Shard>> _shards;
+    std::vector<std::unique_ptr<Worker>> _workers;
+
+    std::mutex _identify_mutex;
+    std::vector<clock::time_point> _identify_buckets; // next allowed identify per bucket
+
+    std::mutex _timers_mutex;
+    std::vector<std::pair<clock::time_point, std::uint64_t>> _timers; // pending identify timers
+
+    std::atomic<bool> _running = false;
+
+    Worker &worker_of(const Shard *shard);
+    void post(Worker &worker, std::function<void()> fn);
+    void run(Worker &worker);
+};
+
+DISCORD_NS_END
+
+#endif // DISCORD_SHARD_MANAGER_HPP
@@ -0,0 +1,453 @@
+#include "snapshot.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fmt/format.h>
+
+DISCORD_NS_BEGIN
+
+namespace
+{
+
+static constexpr char MAGIC[8] = {'D', 'S', 'N', 'A', 'P', 'S', 'H', 'T'};
+static constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct Header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t created;  // milliseconds since the unix epoch
+    struct
+    {
+        std::uint64_t offset;
+        std::uint64_t count;
+    } sections[Snapshot::KINDS];
+};
+
+static_assert(std::is_trivially_copyable_v<Header> && sizeof(Header) % 8 == 0);
+
+/**
+ * Appends fixed size values and length prefixed strings to a record.
+ */
+class Encoder
+{
+public:
+    explicit Encoder(std::string &out)
+        : _out(out)
+    {
+    }
+
+    template<typename T>
+    inline Encoder &operator<< (const T &value)
+    {
+        if constexpr (std::is_same_v<T, std::string>)
+        {
+            *this << static_cast<std::uint32_t>(value.size());
+            this->_out.append(value);
+        }
+        else if constexpr (std::is_same_v<T, Snowflake>)
+        {
+            *this << value.value();
+        }
+        else if constexpr (std::is_enum_v<T>)
+        {
+            *this << static_cast<std::underlying_type_t<T>>(value);
+        }
+        else
+        {
+            static_assert(std::is_arithmetic_v<T>);
+            this->_out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+        return *this;
+    }
+
+    inline Encoder &operator<< (const std::vector<Snowflake> &ids)
+    {
+        *this << static_cast<std::uint32_t>(ids.size());
+        for (auto&& id : ids)
+        {
+            *this << id;
+        }
+        return *this;
+    }
+
+private:
+    std::string &_out;
+};
+
+/**
+ * Reads values in the order they were encoded, fails on truncated records.
+ */
+class Decoder
+{
+public:
+    explicit Decoder(std::string_view in)
+        : _in(in)
+    {
+    }
+
+    inline bool ok() const
+    {
+        return !this->_failed;
+    }
+
+    template<typename T>
+    inline Decoder &operator>> (T &value)
+    {
+        if constexpr (std::is_same_v<T, std::string>)
+        {
+            std::uint32_t size = 0;
+            *this >> size;
+            if (this->take(size))
+            {
+                value.assign(this->_in.data() + this->_pos - size, size);
+            }
+        }
+        else if constexpr (std::is_same_v<T, Snowflake>)
+        {
+            std::uint64_t id = 0;
+            *this >> id;
+            value = Snowflake(id);
+        }
+        else if constexpr (std::is_enum_v<T>)
+        {
+            std::underlying_type_t<T> raw{};
+            *this >> raw;
+            value = static_cast<T>(raw);
+        }
+        else
+        {
+            static_assert(std::is_arithmetic_v<T>);
+            if (this->take(sizeof(value)))
+            {
+                std::memcpy(&value, this->_in.data() + this->_pos - sizeof(value), sizeof(value));
+            }
+        }
+        return *this;
+    }
+
+    inline Decoder &operator>> (std::vector<Snowflake> &ids)
+    {
+        const auto count = this->count(sizeof(std::uint64_t));
+        ids.resize(count);
+        for (auto&& id : ids)
+        {
+            *this >> id;
+        }
+        return *this;
+    }
+
+    // element count of an array, limited by the remaining bytes
+    inline std::uint32_t count(std::size_t min_element_size)
+    {
+        std::uint32_t count = 0;
+        *this >> count;
+        if (static_cast<std::uint64_t>(count) * min_element_size > this->_in.size() - this->_pos)
+        {
+            this->_failed = true;
+            return 0;
+        }
+        return count;
+    }
+
+private:
+    std::string_view _in;
+    std::size_t _pos = 0;
+    bool _failed = false;
+
+    inline bool take(std::size_t size)
+    {
+        if (this->_failed || size > this->_in.size() - this->_pos)
+        {
+            this->_failed = true;
+            return false;
+        }
+        this->_pos += size;
+        return true;
+    }
+};
+
+static void encode_user(Encoder &e, const User &user)
+{
+    e << user.id << user.username << user.discriminator << user.avatar << user.bot << user.system << user.mfa_enabled
+      << user.locale << user.verified << user.email << user.flags << user.premium_type << user.public_flags;
+}
+
+static void decode_user(Decoder &d, User &user)
+{
+    d >> user.id >> user.username >> user.discriminator >> user.avatar >> user.bot >> user.system >> user.mfa_enabled
+      >> user.locale >> user.verified >> user.email >> user.flags >> user.premium_type >> user.public_flags;
+}
+
+} // anonymous namespace
+
+Snapshot::Snapshot(const std::string &path)
+{
+    const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        throw std::runtime_error(fmt::format("failed to open {}: {}", path, std::strerror(errno)));
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(Header))
+    {
+        ::close(fd);
+        throw std::runtime_error(fmt::format("{} is not a snapshot", path));
+    }
+
+    this->_size = static_cast<std::size_t>(st.st_size);
+    const auto data = ::mmap(nullptr, this->_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        throw std::runtime_error(fmt::format("failed to map {}: {}", path, std::strerror(errno)));
+    }
+
+    // lookups touch single records, read ahead would only fault in unused pages
+    ::madvise(data, this->_size, MADV_RANDOM);
+    this->_data = static_cast<const char*>(data);
+
+    Header header;
+    std::memcpy(&header, this->_data, sizeof(header));
+
+    const auto invalid = [&](const std::string &reason) {
+        ::munmap(const_cast<char*>(this->_data), this->_size);
+        return std::runtime_error(fmt::format("{}: {}", path, reason));
+    };
+
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+    {
+        throw invalid("not a snapshot");
+    }
+    if (header.version != VERSION)
+    {
+        throw invalid(fmt::format("unsupported snapshot version {}", header.version));
+    }
+    if (header.byte_order != BYTE_ORDER_MARK)
+    {
+        throw invalid("snapshot was written on a host with another byte order");
+    }
+
+    // records are bounds checked on lookup, the indexes once here
+    for (std::size_t i = 0; i < KINDS; ++i)
+    {
+        const auto &section = header.sections[i];
+        if (section.offset % alignof(IndexEntry) != 0 || section.offset > this->_size ||
+            section.count > (this->_size - section.offset) / sizeof(IndexEntry))
+        {
+            throw invalid("index out of bounds");
+        }
+
+        this->_sections[i].index = reinterpret_cast<const IndexEntry*>(this->_data + section.offset);
+        this->_sections[i].count = static_cast<std::size_t>(section.count);
+    }
+
+    this->_created = std::chrono::system_clock::time_point(std::chrono::milliseconds(header.created));
+}
+
+Snapshot::~Snapshot()
+{
+    ::munmap(const_cast<char*>(this->_data), this->_size);
+}
+
+std::string_view Snapshot::find(Kind kind, Snowflake id) const
+{
+    const auto &section = this->_sections[static_cast<std::size_t>(kind)];
+    const auto end = section.index + section.count;
+    const auto it = std::lower_bound(section.index, end, id.value(), [](const IndexEntry &entry, std::uint64_t id) {
+        return entry.id < id;
+    });
+
+    if (it == end || it->id != id.value() || it->offset > this->_size || it->size > this->_size - it->offset)
+    {
+        return {};
+    }
+
+    return std::string_view(this->_data + it->offset, it->size);
+}
+
+void Snapshot::encode(std::string &out, const Guild &guild)
+{
+    Encoder e(out);
+    e << guild.id << guild.name << guild.icon << guild.owner_id << guild.region << guild.system_channel_id
+      << guild.member_count << guild.large << guild.unavailable << guild.roles << guild.channels;
+}
+
+void Snapshot::encode(std::string &out, const Channel &channel)
+{
+    Encoder e(out);
+    e << channel.id << channel.type << channel.guild_id << channel.position;
+
+    e << static_cast<std::uint32_t>(channel.overwrites.size());
+    for (auto&& overwrite : channel.overwrites)
+    {
+        e << overwrite.id << overwrite.type << overwrite.allow << overwrite.deny;
+    }
+
+    e << channel.name << channel.topic << channel.nsfw << channel.last_message_id << channel.bitrate
+      << channel.user_limit << channel.rate_limit;
+
+    e << static_cast<std::uint32_t>(channel.recipients.size());
+    for (auto&& recipient : channel.recipients)
+    {
+        encode_user(e, recipient);
+    }
+
+    e << channel.icon << channel.owner_id << channel.app_id << channel.parent_id << channel.last_pin_timestamp;
+}
+
+void Snapshot::encode(std::string &out, const Role &role)
+{
+    Encoder e(out);
+    e << role.id << role.name << role.color << role.hoist << role.position << role.permissions << role.managed << role.mentionable;
+}
+
+void Snapshot::encode(std::string &out, const User &user)
+{
+    Encoder e(out);
+    encode_user(e, user);
+}
+
+bool Snapshot::decode(std::string_view record, Guild &guild)
+{
+    Decoder d(record);
+    d >> guild.id >> guild.name >> guild.icon >> guild.owner_id >> guild.region >> guild.system_channel_id
+      >> guild.member_count >> guild.large >> guild.unavailable >> guild.roles >> guild.channels;
+    return d.ok();
+}
+
+bool Snapshot::decode(std::string_view record, Channel &channel)
+{
+    Decoder d(record);
+    d >> channel.id >> channel.type >> channel.guild_id >> channel.position;
+
+    // id, type length, allow and deny
+    channel.overwrites.resize(d.count(20));
+    for (auto&& overwrite : channel.overwrites)
+    {
+        d >> overwrite.id >> overwrite.type >> overwrite.allow >> overwrite.deny;
+    }
+
+    d >> channel.name >> channel.topic >> channel.nsfw >> channel.last_message_id >> channel.bitrate
+      >> channel.user_limit >> channel.rate_limit;
+
+    channel.recipients.resize(d.count(sizeof(std::uint64_t)));
+    for (auto&& recipient : channel.recipients)
+    {
+        decode_user(d, recipient);
+    }
+
+    d >> channel.icon >> channel.owner_id >> channel.app_id >> channel.parent_id >> channel.last_pin_timestamp;
+    return d.ok();
+}
+
+bool Snapshot::decode(std::string_view record, Role &role)
+{
+    Decoder d(record);
+    d >> role.id >> role.name >> role.color >> role.hoist >> role.position >> role.permissions >> role.managed >> role.mentionable;
+    return d.ok();
+}
+
+bool Snapshot::decode(std::string_view record, User &user)
+{
+    Decoder d(record);
+    decode_user(d, user);
+    return d.ok();
+}
+
+Snapshot::Builder::Builder(const std::string &path)
+    : _path(path), _tmp(path + ".tmp")
+{
+    this->_file = std::fopen(this->_tmp.c_str(), "wb");
+    if (!this->_file)
+    {
+        throw std::runtime_error(fmt::format("failed to create {}: {}", this->_tmp, std::strerror(errno)));
+    }
+
+    // the header is written last, it is only valid once all indexes are complete
+    const Header header{};
+    this->write(&header, sizeof(header));
+}
+
+Snapshot::Builder::~Builder()
+{
+    if (this->_file)
+    {
+        std::fclose(this->_file);
+        std::remove(this->_tmp.c_str());
+    }
+}
+
+void Snapshot::Builder::add(Kind kind, Snowflake id, std::string_view record)
+{
+    this->_indexes[static_cast<std::size_t>(kind)].push_back({id.value(), this->_offset, record.size()});
+    this->write(record.data(), record.size());
+}
+
+bool Snapshot::Builder::commit()
+{
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.created = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+
+    // indexes are 8 byte aligned, so they can be used in place when mapped
+    static constexpr char padding[8] = {};
+    this->write(padding, (8 - this->_offset % 8) % 8);
+
+    for (std::size_t i = 0; i < KINDS; ++i)
+    {
+        auto &index = this->_indexes[i];
+        std::sort(index.begin(), index.end());
+
+        header.sections[i].offset = this->_offset;
+        header.sections[i].count = index.size();
+        for (auto&& entry : index)
+        {
+            const IndexEntry e{entry[0], entry[1], entry[2]};
+            this->write(&e, sizeof(e));
+        }
+    }
+
+    if (this->_failed || std::fseek(this->_file, 0, SEEK_SET) != 0 ||
+        std::fwrite(&header, sizeof(header), 1, this->_file) != 1 || std::fflush(this->_file) != 0 ||
+        ::fsync(::fileno(this->_file)) != 0)
+    {
+        return false;
+    }
+
+    const auto closed = std::fclose(this->_file) == 0;
+    this->_file = nullptr;
+
+    if (!closed || std::rename(this->_tmp.c_str(), this->_path.c_str()) != 0)
+    {
+        std::remove(this->_tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void Snapshot::Builder::write(const void *data, std::size_t size)
+{
+    if (size != 0 && !this->_failed && std::fwrite(data, 1, size, this->_file) != size)
+    {
+        this->_failed = true;
+    }
+    this->_offset += size;
+}
+
+DISCORD_NS_END
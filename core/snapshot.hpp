@@ -0,0 +1,161 @@
+#ifndef DISCORD_SNAPSHOT_HPP
+#define DISCORD_SNAPSHOT_HPP
+
+#include "config.hpp"
+#include "snowflake.hpp"
+#include "channel.hpp"
+#include "user.hpp"
+#include "guild.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+DISCORD_NS_BEGIN
+
+/**
+ * Binary snapshot of the cached guilds, channels, roles and users.
+ *
+ * A snapshot is mapped into memory as a whole, nothing is decoded on load.
+ * Each entity type has an index sorted by id, a lookup is a binary search
+ * and decodes only the record it found. This allows answering lookups right
+ * after startup while the gateway still sends the current state.
+ *
+ * File layout, all values in host byte order:
+ *   header     magic, version, byte order mark, creation time and the
+ *              index offset and record count of each entity type
+ *   records    encoded entities, referenced by the indexes
+ *   indexes    per entity type an array of (id, offset, size) sorted by id
+ */
+class Snapshot
+{
+public:
+    // incremented on incompatible changes of the file layout or the record encoding
+    static constexpr std::uint32_t VERSION = 1;
+
+    enum class Kind : std::uint32_t
+    {
+        GUILD = 0,
+        CHANNEL,
+        ROLE,
+        USER,
+    };
+
+    static constexpr std::size_t KINDS = 4;
+
+    /**
+     * Maps the snapshot at the given path, throws std::runtime_error when the
+     * file can't be mapped or is not a snapshot of this version.
+     */
+    explicit Snapshot(const std::string &path);
+    ~Snapshot();
+
+    Snapshot(const Snapshot&) = delete;
+    Snapshot &operator= (const Snapshot&) = delete;
+
+    /**
+     * Encoded record of an entity, empty when the snapshot does not contain it.
+     */
+    std::string_view find(Kind kind, Snowflake id) const;
+
+    inline std::size_t size(Kind kind) const
+    {
+        return this->_sections[static_cast<std::size_t>(kind)].count;
+    }
+
+    /**
+     * Calls fn(id, record) for all entities of the given type in id order.
+     */
+    template<typename Function>
+    void for_each(Kind kind, Function &&fn) const
+    {
+        const auto &section = this->_sections[static_cast<std::size_t>(kind)];
+        for (std::size_t i = 0; i < section.count; ++i)
+        {
+            const auto &entry = section.index[i];
+            // checked like in find(), offset + size may overflow
+            if (entry.offset <= this->_size && entry.size <= this->_size - entry.offset)
+            {
+                fn(Snowflake(entry.id), std::string_view(this->_data + entry.offset, entry.size));
+            }
+        }
+    }
+
+    inline std::chrono::system_clock::time_point created() const
+    {
+        return this->_created;
+    }
+
+    // record encoding
+    static void encode(std::string &out, const Guild &guild);
+    static void encode(std::string &out, const Channel &channel);
+    static void encode(std::string &out, const Role &role);
+    static void encode(std::string &out, const User &user);
+
+    // record decoding, returns false on truncated or invalid records
+    static bool decode(std::string_view record, Guild &guild);
+    static bool decode(std::string_view record, Channel &channel);
+    static bool decode(std::string_view record, Role &role);
+    static bool decode(std::string_view record, User &user);
+
+    /**
+     * Writes a snapshot file. Records are streamed to a temporary file which
+     * replaces the snapshot at the path on commit().
+     */
+    class Builder
+    {
+    public:
+        explicit Builder(const std::string &path);
+        ~Builder();
+
+        Builder(const Builder&) = delete;
+        Builder &operator= (const Builder&) = delete;
+
+        /**
+         * Adds an encoded record, every id must be added at most once per type.
+         */
+        void add(Kind kind, Snowflake id, std::string_view record);
+
+        /**
+         * Writes the indexes and replaces the snapshot, returns false on write errors.
+         */
+        bool commit();
+
+    private:
+        const std::string _path;
+        const std::string _tmp;
+        std::FILE *_file = nullptr;
+        std::uint64_t _offset = 0;
+        bool _failed = false;
+        std::array<std::vector<std::array<std::uint64_t, 3>>, KINDS> _indexes;
+
+        void write(const void *data, std::size_t size);
+    };
+
+private:
+    struct IndexEntry
+    {
+        std::uint64_t id;
+        std::uint64_t offset;
+        std::uint64_t size;
+    };
+
+    struct Section
+    {
+        const IndexEntry *index = nullptr;
+        std::size_t count = 0;
+    };
+
+    const char *_data = nullptr;
+    std::size_t _size = 0;
+    std::array<Section, KINDS> _sections;
+    std::chrono::system_clock::time_point _created;
+};
+
+DISCORD_NS_END
+
+#endif // DISCORD_SNAPSHOT_HPP
@@ -0,0 +1,29 @@
+#include "snowflake.hpp"
+
+#include <nlohmann/json.hpp>
+
+DISCORD_NS_BEGIN
+
+void from_json(const nlohmann::json &j, Snowflake &snowflake)
+{
+    if (j.is_string())
+    {
+        // reference to the stored string, no copy
+        snowflake = Snowflake::parse(j.get_ref<const std::string&>());
+    }
+    else if (j.is_number_unsigned() || j.is_number_integer())
+    {
+        snowflake = Snowflake(j.get<std::uint64_t>());
+    }
+    else
+    {
+        snowflake = Snowflake();
+    }
+}
+
+void to_json(nlohmann::json &j, const Snowflake &snowflake)
+{
+    j = snowflake.str();
+}
+
+DISCORD_NS_END
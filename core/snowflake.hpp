@@ -0,0 +1,181 @@
+#ifndef DISCORD_SNOWFLAKE_HPP
+#define DISCORD_SNOWFLAKE_HPP
+
+#include "config.hpp"
+
+#include <string>
+#include <string_view>
+#include <array>
+#include <algorithm>
+#include <limits>
+#include <chrono>
+#include <functional>
+#include <compare>
+#include <cstdint>
+
+#include <nlohmann/json_fwd.hpp>
+
+#include <fmt/format.h>
+
+DISCORD_NS_BEGIN
+
+/**
+ * Discord Snowflake
+ * https://discord.com/developers/docs/reference#snowflakes
+ *
+ * Unique 64-bit id used for all Discord objects. Ids are sent as decimal
+ * strings in JSON and as integers in ETF, both are parsed without allocating.
+ * A value of 0 is treated as "no id".
+ */
+class Snowflake
+{
+public:
+    // first second of 2015 in milliseconds since the unix epoch
+    static constexpr std::uint64_t DISCORD_EPOCH = 1420070400000;
+
+    // enough for the 20 digits of the largest 64-bit value
+    using Buffer = std::array<char, 20>;
+
+    constexpr Snowflake() = default;
+    constexpr Snowflake(std::uint64_t value)
+        : _value(value)
+    {
+    }
+
+    /**
+     * Parses a decimal id, returns an empty snowflake on invalid input or overflow.
+     */
+    static constexpr Snowflake parse(std::string_view str)
+    {
+        if (str.empty() || str.size() > 20)
+        {
+            return {};
+        }
+
+        std::uint64_t value = 0;
+        for (const auto c : str)
+        {
+            if (c < '0' || c > '9')
+            {
+                return {};
+            }
+
+            const auto digit = static_cast<std::uint64_t>(c - '0');
+            if (value > (std::numeric_limits<std::uint64_t>::max() - digit) / 10)
+            {
+                return {};
+            }
+            value = value * 10 + digit;
+        }
+
+        return Snowflake(value);
+    }
+
+    constexpr inline std::uint64_t value() const
+    {
+        return this->_value;
+    }
+
+    /**
+     * Milliseconds since the unix epoch at which the id was created.
+     */
+    constexpr inline std::uint64_t timestamp() const
+    {
+        return (this->_value >> 22) + DISCORD_EPOCH;
+    }
+
+    inline std::chrono::system_clock::time_point time() const
+    {
+        return std::chrono::system_clock::time_point(std::chrono::milliseconds(this->timestamp()));
+    }
+
+    // internal worker id
+    constexpr inline std::uint32_t worker() const
+    {
+        return static_cast<std::uint32_t>((this->_value >> 17) & 0x1F);
+    }
+
+    // internal process id
+    constexpr inline std::uint32_t process() const
+    {
+        return static_cast<std::uint32_t>((this->_value >> 12) & 0x1F);
+    }
+
+    // incremented for every id generated on the process
+    constexpr inline std::uint32_t sequence() const
+    {
+        return static_cast<std::uint32_t>(this->_value & 0xFFF);
+    }
+
+    /**
+     * Check if the snowflake holds an id.
+     */
+    constexpr inline explicit operator bool() const
+    {
+        return this->_value != 0;
+    }
+
+    constexpr bool operator== (const Snowflake&) const = default;
+    constexpr auto operator<=> (const Snowflake&) const = default;
+
+    /**
+     * Writes the decimal representation into the buffer, the returned view points into it.
+     */
+    constexpr std::string_view to_chars(Buffer &buffer) const
+    {
+        auto pos = buffer.size();
+        auto value = this->_value;
+        do {
+            buffer[--pos] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+
+        return std::string_view(buffer.data() + pos, buffer.size() - pos);
+    }
+
+    inline std::string str() const
+    {
+        Buffer buffer;
+        return std::string(this->to_chars(buffer));
+    }
+
+private:
+    std::uint64_t _value = 0;
+};
+
+// ids are strings in JSON and integers in ETF, an invalid or missing id results in an empty snowflake
+void from_json(const nlohmann::json &j, Snowflake &snowflake);
+void to_json(nlohmann::json &j, const Snowflake &snowflake);
+
+DISCORD_NS_END
+
+template<>
+struct std::hash<Discord::Snowflake>
+{
+    inline std::size_t operator() (const Discord::Snowflake &snowflake) const noexcept
+    {
+        return std::hash<std::uint64_t>{}(snowflake.value());
+    }
+};
+
+/**
+ * Formats the id without creating an intermediate string.
+ */
+template<>
+struct fmt::formatter<Discord::Snowflake>
+{
+    constexpr auto parse(fmt::format_parse_context &ctx)
+    {
+        return ctx.begin();
+    }
+
+    template<typename FormatContext>
+    auto format(const Discord::Snowflake &snowflake, FormatContext &ctx) const
+    {
+        Discord::Snowflake::Buffer buffer;
+        const auto str = snowflake.to_chars(buffer);
+        return std::copy(str.begin(), str.end(), ctx.out());
+    }
+};
+
+#endif // DISCORD_SNOWFLAKE_HPP
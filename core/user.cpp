@@ -1 +1,25 @@
 #include "user.hpp"
+#include "utils/json.hpp"
+
+DISCORD_NS_BEGIN
+
+void from_json(const nlohmann::json &j, User &user)
+{
+    using Utils::get_json_value;
+
+    user.id = get_json_value<Snowflake>(j, "id");
+    user.username = get_json_value<std::string>(j, "username");
+    user.discriminator = get_json_value<std::string>(j, "discriminator");
+    user.avatar = get_json_value<std::string>(j, "avatar");
+    user.bot = get_json_value<bool>(j, "bot");
+    user.system = get_json_value<bool>(j, "system");
+    user.mfa_enabled = get_json_value<bool>(j, "mfa_enabled");
+    user.locale = get_json_value<std::string>(j, "locale");
+    user.verified = get_json_value<bool>(j, "verified");
+    user.email = get_json_value<std::string>(j, "email");
+    user.flags = static_cast<UserFlag>(get_json_value<std::uint32_t>(j, "flags"));
+    user.premium_type = static_cast<PremiumType>(get_json_value<int>(j, "premium_type"));
+    user.public_flags = static_cast<UserFlag>(get_json_value<std::uint32_t>(j, "public_flags"));
+}
+
+DISCORD_NS_END
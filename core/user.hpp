@@ -2,11 +2,14 @@
 #define DISCORD_USER_HPP
 
 #include "config.hpp"
+#include "snowflake.hpp"
 
 #include <string>
 #include <vector>
 #include <cstdint>
 
+#include <nlohmann/json_fwd.hpp>
+
 DISCORD_NS_BEGIN
 
 /**
@@ -48,7 +51,7 @@ enum class PremiumType
  */
 struct User
 {
-    std::string id;                 // the user's id
+    Snowflake id;                   // the user's id
     std::string username;           // the user's username, not unique across the platform
     std::string discriminator;      // the user's 4-digit discord-tag
     std::string avatar;             // the user's avatar hash
@@ -58,11 +61,21 @@ struct User
     std::string locale;             // the user's chosen language option
     bool verified = false;          // whether the email on this account has been verified
     std::string email;              // the user's email
-    UserFlag flags;                 // the flags on a user's account
-    PremiumType premium_type;       // the type of Nitro subscription on a user's account
-    UserFlag public_flags;          // the public flags on a user's account
+    UserFlag flags = UserFlag::NONE;            // the flags on a user's account
+    PremiumType premium_type = PremiumType::NONE; // the type of Nitro subscription on a user's account
+    UserFlag public_flags = UserFlag::NONE;     // the public flags on a user's account
+
+    /**
+     * Check if user has an id.
+     */
+    inline operator bool() const
+    {
+        return static_cast<bool>(this->id);
+    }
 };
 
+void from_json(const nlohmann::json &j, User &user);
+
 DISCORD_NS_END
 
 constexpr inline Discord::UserFlag operator| (Discord::UserFlag lhs, Discord::UserFlag rhs)
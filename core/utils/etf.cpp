@@ -0,0 +1,574 @@
+#include "etf.hpp"
+
+#include <cstring>
+#include <cstdint>
+#include <limits>
+
+#include <zlib.h>
+
+using json = nlohmann::json;
+
+namespace
+{
+
+// term tags
+enum Tag : std::uint8_t
+{
+    VERSION             = 131,
+    COMPRESSED          = 80,
+    NEW_FLOAT_EXT       = 70,
+    SMALL_INTEGER_EXT   = 97,
+    INTEGER_EXT         = 98,
+    FLOAT_EXT           = 99,
+    ATOM_EXT            = 100,
+    SMALL_TUPLE_EXT     = 104,
+    LARGE_TUPLE_EXT     = 105,
+    NIL_EXT             = 106,
+    STRING_EXT          = 107,
+    LIST_EXT            = 108,
+    BINARY_EXT          = 109,
+    SMALL_BIG_EXT       = 110,
+    LARGE_BIG_EXT       = 111,
+    MAP_EXT             = 116,
+    SMALL_ATOM_EXT      = 115,
+    ATOM_UTF8_EXT       = 118,
+    SMALL_ATOM_UTF8_EXT = 119,
+};
+
+// protect against stack exhaustion on malicious input
+static constexpr unsigned MAX_DEPTH = 256;
+
+// the declared size of a compressed term is untrusted, it is bounded by the largest
+// frame we accept and by the best ratio deflate can achieve (about 1032:1)
+static constexpr std::size_t MAX_INFLATED_SIZE = 64 * 1024 * 1024;
+static constexpr std::size_t MAX_DEFLATE_RATIO = 1032;
+
+class Decoder
+{
+public:
+    Decoder(const char *data, std::size_t size)
+        : _p(reinterpret_cast<const std::uint8_t*>(data)),
+          _end(reinterpret_cast<const std::uint8_t*>(data) + size)
+    {
+    }
+
+    json term(unsigned depth = 0)
+    {
+        if (depth > MAX_DEPTH)
+        {
+            throw Utils::Etf::error("term nesting too deep");
+        }
+
+        switch (this->u8())
+        {
+            case SMALL_INTEGER_EXT:
+                return this->u8();
+
+            case INTEGER_EXT:
+                return static_cast<std::int32_t>(this->u32());
+
+            case NEW_FLOAT_EXT: {
+                const auto bits = this->u64();
+                double value;
+                std::memcpy(&value, &bits, sizeof(value));
+                return value;
+            }
+
+            case FLOAT_EXT: {
+                const auto str = this->bytes(31);
+                return std::strtod(std::string(str).c_str(), nullptr);
+            }
+
+            case ATOM_EXT:
+            case ATOM_UTF8_EXT:
+                return this->atom(this->u16());
+
+            case SMALL_ATOM_EXT:
+            case SMALL_ATOM_UTF8_EXT:
+                return this->atom(this->u8());
+
+            case SMALL_TUPLE_EXT:
+                return this->array(this->u8(), depth);
+
+            case LARGE_TUPLE_EXT:
+                return this->array(this->u32(), depth);
+
+            case NIL_EXT:
+                return json::array();
+
+            case STRING_EXT:
+                return std::string(this->bytes(this->u16()));
+
+            case LIST_EXT: {
+                auto list = this->array(this->u32(), depth);
+                // proper lists end with NIL_EXT as tail
+                auto tail = this->term(depth + 1);
+                if (!(tail.is_array() && tail.empty()))
+                {
+                    list.emplace_back(std::move(tail));
+                }
+                return list;
+            }
+
+            case BINARY_EXT:
+                return std::string(this->bytes(this->u32()));
+
+            case SMALL_BIG_EXT:
+                return this->big(this->u8());
+
+            case LARGE_BIG_EXT:
+                return this->big(this->u32());
+
+            case MAP_EXT: {
+                const auto arity = this->u32();
+                json map = json::object();
+                for (std::uint32_t i = 0; i < arity; ++i)
+                {
+                    auto key = this->term(depth + 1);
+                    auto value = this->term(depth + 1);
+                    map[key.is_string() ? key.get<std::string>() : key.dump()] = std::move(value);
+                }
+                return map;
+            }
+
+            default:
+                throw Utils::Etf::error("unsupported term");
+        }
+    }
+
+    void skip(unsigned depth = 0)
+    {
+        if (depth > MAX_DEPTH)
+        {
+            throw Utils::Etf::error("term nesting too deep");
+        }
+
+        const auto tag = this->u8();
+        switch (tag)
+        {
+            case SMALL_INTEGER_EXT: this->bytes(1); break;
+            case INTEGER_EXT: this->bytes(4); break;
+            case NEW_FLOAT_EXT: this->bytes(8); break;
+            case FLOAT_EXT: this->bytes(31); break;
+            case ATOM_EXT: case ATOM_UTF8_EXT: this->bytes(this->u16()); break;
+            case SMALL_ATOM_EXT: case SMALL_ATOM_UTF8_EXT: this->bytes(this->u8()); break;
+            case NIL_EXT: break;
+            case STRING_EXT: this->bytes(this->u16()); break;
+            case BINARY_EXT: this->bytes(this->u32()); break;
+            case SMALL_BIG_EXT: this->bytes(std::size_t(this->u8()) + 1); break;
+            case LARGE_BIG_EXT: this->bytes(std::size_t(this->u32()) + 1); break;
+
+            case SMALL_TUPLE_EXT:
+            case LARGE_TUPLE_EXT: {
+                const auto arity = tag == SMALL_TUPLE_EXT ? this->u8() : this->u32();
+                for (std::uint32_t i = 0; i < arity; ++i)
+                {
+                    this->skip(depth + 1);
+                }
+                break;
+            }
+
+            case LIST_EXT: {
+                // elements followed by the tail
+                const auto size = this->u32();
+                for (std::uint32_t i = 0; i <= size; ++i)
+                {
+                    this->skip(depth + 1);
+                }
+                break;
+            }
+
+            case MAP_EXT: {
+                const auto arity = this->u32();
+                for (std::uint32_t i = 0; i < arity; ++i)
+                {
+                    this->skip(depth + 1);
+                    this->skip(depth + 1);
+                }
+                break;
+            }
+
+            default:
+                throw Utils::Etf::error("unsupported term");
+        }
+    }
+
+    inline bool done() const
+    {
+        return this->_p == this->_end;
+    }
+
+    inline const char *position() const
+    {
+        return reinterpret_cast<const char*>(this->_p);
+    }
+
+    inline std::uint8_t u8()
+    {
+        this->require(1);
+        return *this->_p++;
+    }
+
+    inline std::uint16_t u16()
+    {
+        this->require(2);
+        const std::uint16_t v = (this->_p[0] << 8) | this->_p[1];
+        this->_p += 2;
+        return v;
+    }
+
+    inline std::uint32_t u32()
+    {
+        this->require(4);
+        const std::uint32_t v = (std::uint32_t(this->_p[0]) << 24) | (std::uint32_t(this->_p[1]) << 16) |
+                                (std::uint32_t(this->_p[2]) << 8) | std::uint32_t(this->_p[3]);
+        this->_p += 4;
+        return v;
+    }
+
+    inline std::uint64_t u64()
+    {
+        const std::uint64_t hi = this->u32();
+        return (hi << 32) | this->u32();
+    }
+
+    inline std::string_view bytes(std::size_t size)
+    {
+        this->require(size);
+        const auto view = std::string_view(reinterpret_cast<const char*>(this->_p), size);
+        this->_p += size;
+        return view;
+    }
+
+private:
+    const std::uint8_t *_p;
+    const std::uint8_t *_end;
+
+    inline void require(std::size_t size) const
+    {
+        if (static_cast<std::size_t>(this->_end - this->_p) < size)
+        {
+            throw Utils::Etf::error("unexpected end of data");
+        }
+    }
+
+    json atom(std::size_t size)
+    {
+        const auto name = this->bytes(size);
+
+        if (name == "nil")
+        {
+            return nullptr;
+        }
+        else if (name == "true")
+        {
+            return true;
+        }
+        else if (name == "false")
+        {
+            return false;
+        }
+
+        return std::string(name);
+    }
+
+    json array(std::size_t size, unsigned depth)
+    {
+        json array = json::array();
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            array.emplace_back(this->term(depth + 1));
+        }
+        return array;
+    }
+
+    json big(std::size_t size)
+    {
+        const auto sign = this->u8();
+        const auto digits = this->bytes(size);
+
+        if (size > sizeof(std::uint64_t))
+        {
+            throw Utils::Etf::error("big integer exceeds 64 bits");
+        }
+
+        // little endian magnitude
+        std::uint64_t value = 0;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            value |= std::uint64_t(static_cast<std::uint8_t>(digits[i])) << (8 * i);
+        }
+
+        if (sign == 0)
+        {
+            return value;
+        }
+
+        if (value > std::uint64_t(std::numeric_limits<std::int64_t>::max()) + 1)
+        {
+            throw Utils::Etf::error("negative big integer exceeds 64 bits");
+        }
+
+        return static_cast<std::int64_t>(0 - value);
+    }
+};
+
+class Encoder
+{
+public:
+    std::string &buffer;
+
+    explicit Encoder(std::string &out)
+        : buffer(out)
+    {
+    }
+
+    void term(const json &value)
+    {
+        switch (value.type())
+        {
+            case json::value_t::null:
+                this->atom("nil");
+                break;
+
+            case json::value_t::boolean:
+                this->atom(value.get<bool>() ? "true" : "false");
+                break;
+
+            case json::value_t::number_integer: {
+                const auto v = value.get<std::int64_t>();
+                if (v >= 0 && v <= 0xFF)
+                {
+                    this->u8(SMALL_INTEGER_EXT);
+                    this->u8(static_cast<std::uint8_t>(v));
+                }
+                else if (v >= std::numeric_limits<std::int32_t>::min() && v <= std::numeric_limits<std::int32_t>::max())
+                {
+                    this->u8(INTEGER_EXT);
+                    this->u32(static_cast<std::uint32_t>(v));
+                }
+                else
+                {
+                    this->big(v < 0 ? 0 - static_cast<std::uint64_t>(v) : static_cast<std::uint64_t>(v), v < 0);
+                }
+                break;
+            }
+
+            case json::value_t::number_unsigned: {
+                const auto v = value.get<std::uint64_t>();
+                if (v <= 0xFF)
+                {
+                    this->u8(SMALL_INTEGER_EXT);
+                    this->u8(static_cast<std::uint8_t>(v));
+                }
+                else if (v <= std::uint64_t(std::numeric_limits<std::int32_t>::max()))
+                {
+                    this->u8(INTEGER_EXT);
+                    this->u32(static_cast<std::uint32_t>(v));
+                }
+                else
+                {
+                    this->big(v, false);
+                }
+                break;
+            }
+
+            case json::value_t::number_float: {
+                const auto v = value.get<double>();
+                std::uint64_t bits;
+                std::memcpy(&bits, &v, sizeof(bits));
+                this->u8(NEW_FLOAT_EXT);
+                this->u32(static_cast<std::uint32_t>(bits >> 32));
+                this->u32(static_cast<std::uint32_t>(bits));
+                break;
+            }
+
+            case json::value_t::string:
+                this->binary(value.get_ref<const std::string&>());
+                break;
+
+            case json::value_t::array:
+                if (value.empty())
+                {
+                    this->u8(NIL_EXT);
+                    break;
+                }
+
+                this->u8(LIST_EXT);
+                this->u32(static_cast<std::uint32_t>(value.size()));
+                for (auto&& element : value)
+                {
+                    this->term(element);
+                }
+                this->u8(NIL_EXT);
+                break;
+
+            case json::value_t::object:
+                this->u8(MAP_EXT);
+                this->u32(static_cast<std::uint32_t>(value.size()));
+                for (auto&& [key, element] : value.items())
+                {
+                    this->binary(key);
+                    this->term(element);
+                }
+                break;
+
+            default:
+                throw Utils::Etf::error("unsupported json value");
+        }
+    }
+
+    inline void u8(std::uint8_t v)
+    {
+        this->buffer.push_back(static_cast<char>(v));
+    }
+
+    inline void u16(std::uint16_t v)
+    {
+        this->u8(static_cast<std::uint8_t>(v >> 8));
+        this->u8(static_cast<std::uint8_t>(v));
+    }
+
+    inline void u32(std::uint32_t v)
+    {
+        this->u16(static_cast<std::uint16_t>(v >> 16));
+        this->u16(static_cast<std::uint16_t>(v));
+    }
+
+private:
+    void atom(std::string_view name)
+    {
+        this->u8(SMALL_ATOM_UTF8_EXT);
+        this->u8(static_cast<std::uint8_t>(name.size()));
+        this->buffer.append(name);
+    }
+
+    void binary(std::string_view data)
+    {
+        this->u8(BINARY_EXT);
+        this->u32(static_cast<std::uint32_t>(data.size()));
+        this->buffer.append(data);
+    }
+
+    void big(std::uint64_t magnitude, bool negative)
+    {
+        std::uint8_t digits[8];
+        std::uint8_t size = 0;
+        while (magnitude > 0)
+        {
+            digits[size++] = static_cast<std::uint8_t>(magnitude & 0xFF);
+            magnitude >>= 8;
+        }
+
+        this->u8(SMALL_BIG_EXT);
+        this->u8(size);
+        this->u8(negative ? 1 : 0);
+        this->buffer.append(reinterpret_cast<const char*>(digits), size);
+    }
+};
+
+} // anonymous namespace
+
+json Utils::Etf::decode(std::string_view data)
+{
+    Decoder decoder(data.data(), data.size());
+
+    if (decoder.u8() != VERSION)
+    {
+        throw error("invalid term version");
+    }
+
+    // zlib compressed term: uncompressed size followed by the deflated term
+    std::string inflated;
+    if (!decoder.done() && static_cast<std::uint8_t>(data[1]) == COMPRESSED)
+    {
+        decoder.u8();
+        uLongf size = decoder.u32();
+        const auto compressed = data.substr(6);
+
+        if (size > MAX_INFLATED_SIZE || size > compressed.size() * MAX_DEFLATE_RATIO + 64)
+        {
+            throw error("compressed term is too large");
+        }
+
+        inflated.resize(size);
+        if (uncompress(reinterpret_cast<Bytef*>(inflated.data()), &size,
+                       reinterpret_cast<const Bytef*>(compressed.data()), static_cast<uLong>(compressed.size())) != Z_OK)
+        {
+            throw error("inflating compressed term failed");
+        }
+        inflated.resize(size);
+
+        Decoder term(inflated.data(), inflated.size());
+        return term.term();
+    }
+
+    return decoder.term();
+}
+
+json Utils::Etf::decode_term(std::string_view term)
+{
+    Decoder decoder(term.data(), term.size());
+    return decoder.term();
+}
+
+std::string_view Utils::Etf::text(std::string_view term)
+{
+    Decoder decoder(term.data(), term.size());
+
+    try {
+        switch (decoder.u8())
+        {
+            case ATOM_EXT: case ATOM_UTF8_EXT: case STRING_EXT: return decoder.bytes(decoder.u16());
+            case SMALL_ATOM_EXT: case SMALL_ATOM_UTF8_EXT: return decoder.bytes(decoder.u8());
+            case BINARY_EXT: return decoder.bytes(decoder.u32());
+        }
+    } catch (error &) {
+    }
+
+    return {};
+}
+
+bool Utils::Etf::for_each_field(std::string_view data, const std::function<void(std::string_view key, std::string_view term)> &callback)
+{
+    Decoder decoder(data.data(), data.size());
+
+    if (decoder.u8() != VERSION || decoder.u8() != MAP_EXT)
+    {
+        return false;
+    }
+
+    const auto arity = decoder.u32();
+    for (std::uint32_t i = 0; i < arity; ++i)
+    {
+        std::string_view key;
+        switch (decoder.u8())
+        {
+            case ATOM_EXT: case ATOM_UTF8_EXT: key = decoder.bytes(decoder.u16()); break;
+            case SMALL_ATOM_EXT: case SMALL_ATOM_UTF8_EXT: key = decoder.bytes(decoder.u8()); break;
+            case BINARY_EXT: key = decoder.bytes(decoder.u32()); break;
+            default: throw error("unsupported map key");
+        }
+
+        const auto begin = decoder.position();
+        decoder.skip();
+        callback(key, std::string_view(begin, decoder.position() - begin));
+    }
+
+    return true;
+}
+
+std::string Utils::Etf::encode(const json &value)
+{
+    std::string out;
+    Encoder encoder(out);
+    encoder.u8(VERSION);
+    encoder.term(value);
+    return out;
+}
+
+void Utils::Etf::encode_term(std::string &out, const json &value)
+{
+    Encoder encoder(out);
+    encoder.term(value);
+}
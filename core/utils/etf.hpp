@@ -0,0 +1,72 @@
+#ifndef UTILS_ETF_HPP
+#define UTILS_ETF_HPP
+
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <functional>
+
+#include <nlohmann/json.hpp>
+
+namespace Utils
+{
+    /**
+     * Erlang External Term Format
+     * https://erlang.org/doc/apps/erts/erl_ext_dist.html
+     * https://discord.com/developers/docs/topics/gateway#etfjson
+     *
+     * Terms are mapped to the same json structure the JSON encoding produces,
+     * with the following conversions:
+     *  - atoms nil, true and false become null, true and false; other atoms become strings
+     *  - binaries and strings become strings
+     *  - lists and tuples become arrays
+     *  - maps become objects, keys are converted to strings
+     *  - bigs (snowflakes) become native 64-bit integers
+     */
+    namespace Etf
+    {
+        /**
+         * Thrown on malformed or unsupported terms.
+         */
+        class error : public std::runtime_error
+        {
+        public:
+            using std::runtime_error::runtime_error;
+        };
+
+        /**
+         * Decodes a single versioned term.
+         */
+        nlohmann::json decode(std::string_view data);
+
+        /**
+         * Decodes a single unversioned term, for example a value returned by for_each_field().
+         */
+        nlohmann::json decode_term(std::string_view term);
+
+        /**
+         * Returns the contents of an atom, binary or string term without copying.
+         * Returns an empty view for other terms.
+         */
+        std::string_view text(std::string_view term);
+
+        /**
+         * Iterates over the entries of a versioned top-level map without decoding the values.
+         * The callback receives the key (atom or binary) and the still encoded value term.
+         * Returns false when the data is not an uncompressed map.
+         */
+        bool for_each_field(std::string_view data, const std::function<void(std::string_view key, std::string_view term)> &callback);
+
+        /**
+         * Encodes the given value into a versioned term.
+         */
+        std::string encode(const nlohmann::json &value);
+
+        /**
+         * Appends the given value as unversioned term to out.
+         */
+        void encode_term(std::string &out, const nlohmann::json &value);
+    }
+}
+
+#endif // UTILS_ETF_HPP
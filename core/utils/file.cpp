@@ -0,0 +1,45 @@
+#include "file.hpp"
+
+#include <cstdio>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+bool Utils::write_file_atomic(const std::string &path, std::string_view data, int mode)
+{
+    const auto tmp = path + ".tmp";
+    const auto fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    std::size_t written = 0;
+    while (written < data.size())
+    {
+        const auto res = ::write(fd, data.data() + written, data.size() - written);
+        if (res == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (res <= 0)
+        {
+            ::close(fd);
+            ::unlink(tmp.c_str());
+            return false;
+        }
+        written += static_cast<std::size_t>(res);
+    }
+
+    const auto synced = ::fsync(fd) == 0;
+    if (::close(fd) != 0 || !synced || std::rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        const auto error = errno;
+        ::unlink(tmp.c_str());
+        errno = error;
+        return false;
+    }
+
+    return true;
+}
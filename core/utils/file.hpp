@@ -0,0 +1,17 @@
+#ifndef UTILS_FILE_HPP
+#define UTILS_FILE_HPP
+
+#include <string>
+#include <string_view>
+
+namespace Utils
+{
+    /**
+     * Replaces the file with the given data. The data is written to a temporary
+     * file next to it, flushed to the disk and renamed over the old file, so
+     * readers see either the old or the new contents.
+     */
+    bool write_file_atomic(const std::string &path, std::string_view data, int mode = 0644);
+}
+
+#endif // UTILS_FILE_HPP
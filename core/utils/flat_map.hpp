@@ -0,0 +1,247 @@
+#ifndef UTILS_FLAT_MAP_HPP
+#define UTILS_FLAT_MAP_HPP
+
+#include <vector>
+#include <functional>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+namespace Utils
+{
+    /**
+     * Open addressing hash map with linear probing (robin hood ordering).
+     *
+     * All entries live in a single contiguous slot array, lookups touch
+     * neighbouring slots only. Erasing uses backward shifting so no
+     * tombstones are left behind. Keys and values must be default constructible.
+     *
+     * Pointers to values are invalidated by any insert or erase.
+     */
+    template<typename Key, typename Value, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+    class FlatMap
+    {
+    public:
+        FlatMap() = default;
+
+        /**
+         * Returns the value of the given key or nullptr.
+         */
+        Value *find(const Key &key)
+        {
+            const auto index = this->lookup(key);
+            return index == NPOS ? nullptr : &this->_slots[index].value;
+        }
+
+        const Value *find(const Key &key) const
+        {
+            const auto index = this->lookup(key);
+            return index == NPOS ? nullptr : &this->_slots[index].value;
+        }
+
+        bool contains(const Key &key) const
+        {
+            return this->lookup(key) != NPOS;
+        }
+
+        /**
+         * Inserts the value or replaces the value of an existing key.
+         * Returns true when the key was inserted.
+         */
+        bool insert_or_assign(const Key &key, Value value)
+        {
+            if (this->_slots.empty() || (this->_size + 1) * 8 > this->_slots.size() * 7)
+            {
+                this->rehash(this->_slots.empty() ? 16 : this->_slots.size() * 2);
+            }
+
+            if (const auto index = this->lookup(key); index != NPOS)
+            {
+                this->_slots[index].value = std::move(value);
+                return false;
+            }
+
+            this->emplace(Slot{key, std::move(value), 1});
+            ++this->_size;
+            return true;
+        }
+
+        /**
+         * Removes the given key, returns false when it does not exist.
+         */
+        bool erase(const Key &key)
+        {
+            auto index = this->lookup(key);
+            if (index == NPOS)
+            {
+                return false;
+            }
+
+            // shift the following displaced entries back by one slot
+            const auto mask = this->_slots.size() - 1;
+            auto next = (index + 1) & mask;
+            while (this->_slots[next].distance > 1)
+            {
+                this->_slots[index] = std::move(this->_slots[next]);
+                --this->_slots[index].distance;
+                index = next;
+                next = (next + 1) & mask;
+            }
+
+            this->_slots[index] = Slot{};
+            --this->_size;
+            return true;
+        }
+
+        /**
+         * Removes all entries for which the predicate returns true.
+         */
+        template<typename Predicate>
+        std::size_t erase_if(Predicate &&predicate)
+        {
+            std::vector<Key> keys;
+            this->for_each([&](const Key &key, const Value &value) {
+                if (predicate(key, value))
+                {
+                    keys.emplace_back(key);
+                }
+            });
+
+            for (auto&& key : keys)
+            {
+                this->erase(key);
+            }
+
+            return keys.size();
+        }
+
+        /**
+         * Calls fn(key, value) for each entry.
+         */
+        template<typename Function>
+        void for_each(Function &&fn) const
+        {
+            for (auto&& slot : this->_slots)
+            {
+                if (slot.distance != 0)
+                {
+                    fn(slot.key, slot.value);
+                }
+            }
+        }
+
+        void clear()
+        {
+            this->_slots.clear();
+            this->_size = 0;
+        }
+
+        inline std::size_t size() const
+        {
+            return this->_size;
+        }
+
+        inline bool empty() const
+        {
+            return this->_size == 0;
+        }
+
+        inline std::size_t capacity() const
+        {
+            return this->_slots.size();
+        }
+
+        /**
+         * Memory used by the slot array, memory owned by the keys and values is not included.
+         */
+        inline std::size_t memory_usage() const
+        {
+            return this->_slots.capacity() * sizeof(Slot);
+        }
+
+    private:
+        static constexpr std::size_t NPOS = static_cast<std::size_t>(-1);
+
+        struct Slot
+        {
+            Key key{};
+            Value value{};
+            std::uint32_t distance = 0; // probe distance + 1, 0 for empty slots
+        };
+
+        std::vector<Slot> _slots;   // size is always a power of 2
+        std::size_t _size = 0;
+
+        inline std::size_t home(const Key &key) const
+        {
+            // fibonacci hashing, spreads sequential keys over the table
+            const auto hash = static_cast<std::uint64_t>(Hash{}(key)) * 0x9E3779B97F4A7C15ull;
+            return static_cast<std::size_t>(hash >> 32) & (this->_slots.size() - 1);
+        }
+
+        std::size_t lookup(const Key &key) const
+        {
+            if (this->_size == 0)
+            {
+                return NPOS;
+            }
+
+            const auto mask = this->_slots.size() - 1;
+            auto index = this->home(key);
+
+            // robin hood ordering: the key can't be behind a slot which is closer to its home
+            for (std::uint32_t distance = 1; this->_slots[index].distance >= distance; ++distance)
+            {
+                if (KeyEqual{}(this->_slots[index].key, key))
+                {
+                    return index;
+                }
+                index = (index + 1) & mask;
+            }
+
+            return NPOS;
+        }
+
+        void emplace(Slot &&slot)
+        {
+            const auto mask = this->_slots.size() - 1;
+            auto index = this->home(slot.key);
+
+            for (;;)
+            {
+                auto &current = this->_slots[index];
+                if (current.distance == 0)
+                {
+                    current = std::move(slot);
+                    return;
+                }
+
+                // take the slot from entries which are closer to their home
+                if (current.distance < slot.distance)
+                {
+                    std::swap(current, slot);
+                }
+
+                index = (index + 1) & mask;
+                ++slot.distance;
+            }
+        }
+
+        void rehash(std::size_t capacity)
+        {
+            auto slots = std::move(this->_slots);
+            this->_slots = std::vector<Slot>(capacity);
+
+            for (auto&& slot : slots)
+            {
+                if (slot.distance != 0)
+                {
+                    slot.distance = 1;
+                    this->emplace(std::move(slot));
+                }
+            }
+        }
+    };
+}
+
+#endif // UTILS_FLAT_MAP_HPP
@@ -0,0 +1,40 @@
+#ifndef UTILS_JSON_HPP
+#define UTILS_JSON_HPP
+
+#include <string>
+#include <type_traits>
+
+#include <nlohmann/json.hpp>
+
+namespace Utils
+{
+    /**
+     * Minimal json value parsing helper.
+     * Missing keys, null values and type mismatches result in a default constructed value.
+     */
+    template<typename T>
+    static constexpr inline T get_json_value(const nlohmann::json &j, const std::string &key)
+    {
+        // avoid the exception path for missing and null values, which are common in Discord objects
+        const auto it = j.find(key);
+        if (it == j.end() || it->is_null())
+        {
+            return T{};
+        }
+
+        try {
+            return it->get<T>();
+        } catch (...) {
+            if constexpr (std::is_integral<T>::value)
+            {
+                return 0; // ensure on errors the number is 0 on all platforms
+            }
+            else
+            {
+                return T{}; // for non-integral types use the default constructed value
+            }
+        }
+    }
+}
+
+#endif // UTILS_JSON_HPP
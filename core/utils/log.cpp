@@ -0,0 +1,218 @@
+#include "log.hpp"
+
+#include <ctime>
+
+namespace
+{
+
+static constexpr std::size_t MASK = Utils::Logger::CAPACITY - 1;
+static_assert((Utils::Logger::CAPACITY & MASK) == 0, "capacity must be a power of 2");
+
+// backstop for missed wakeups and periodic file flushing
+static constexpr auto DRAIN_INTERVAL = std::chrono::milliseconds(100);
+
+static constexpr std::string_view level_name(Utils::LogLevel level)
+{
+    switch (level)
+    {
+        case Utils::LogLevel::TRACE:   return "TRACE";
+        case Utils::LogLevel::DEBUG:   return "DEBUG";
+        case Utils::LogLevel::INFO:    return "INFO";
+        case Utils::LogLevel::WARNING: return "WARN";
+        case Utils::LogLevel::ERROR:   return "ERROR";
+        default:                       return "";
+    }
+}
+
+} // anonymous namespace
+
+Utils::Logger &Utils::Logger::instance()
+{
+    static Logger logger;
+    return logger;
+}
+
+Utils::Logger::Logger()
+    : _ring(new Record[CAPACITY])
+{
+    for (std::size_t i = 0; i < CAPACITY; ++i)
+    {
+        this->_ring[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    this->_thr = std::thread(&Logger::run, this);
+}
+
+Utils::Logger::~Logger()
+{
+    this->_running = false;
+    {
+        std::lock_guard lk{this->_mutex};
+        this->_cv.notify_all();
+    }
+
+    if (this->_thr.joinable())
+    {
+        this->_thr.join();
+    }
+
+    if (this->_file)
+    {
+        std::fclose(this->_file);
+    }
+
+    delete[] this->_ring;
+}
+
+bool Utils::Logger::open(const std::string &path)
+{
+    const auto file = std::fopen(path.c_str(), "a");
+    if (!file)
+    {
+        return false;
+    }
+
+    std::lock_guard lk{this->_file_mutex};
+    if (this->_file)
+    {
+        std::fclose(this->_file);
+    }
+    this->_file = file;
+    return true;
+}
+
+void Utils::Logger::setConsole(bool enabled)
+{
+    this->_console = enabled;
+}
+
+void Utils::Logger::flush()
+{
+    const auto target = this->_head.load(std::memory_order_acquire);
+
+    std::unique_lock lk{this->_mutex};
+    this->_cv.notify_all();
+    this->_flushed_cv.wait_for(lk, std::chrono::seconds(5), [&]{
+        return this->_written.load(std::memory_order_acquire) >= target || !this->_running;
+    });
+}
+
+Utils::Logger::Record *Utils::Logger::acquire()
+{
+    // bounded MPMC queue by Dmitry Vyukov, used with a single consumer
+    auto pos = this->_head.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+        auto &record = this->_ring[pos & MASK];
+        const auto seq = record.seq.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+
+        if (diff == 0)
+        {
+            if (this->_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                record.pos = pos;
+                return &record;
+            }
+        }
+        else if (diff < 0)
+        {
+            // full, never block the caller
+            this->_dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        else
+        {
+            pos = this->_head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void Utils::Logger::commit(Record *record)
+{
+    record->seq.store(record->pos + 1, std::memory_order_seq_cst);
+
+    // only wake up the drain thread when it is sleeping
+    if (this->_sleeping.load(std::memory_order_seq_cst))
+    {
+        std::lock_guard lk{this->_mutex};
+        this->_cv.notify_one();
+    }
+}
+
+void Utils::Logger::run()
+{
+    const auto available = [&]{
+        const auto &record = this->_ring[this->_tail & MASK];
+        return record.seq.load(std::memory_order_seq_cst) == this->_tail + 1;
+    };
+
+    for (;;)
+    {
+        std::size_t count = 0;
+        while (available())
+        {
+            auto &record = this->_ring[this->_tail & MASK];
+            this->write(record);
+            record.destroy(record.args);
+            record.seq.store(this->_tail + CAPACITY, std::memory_order_release);
+            this->_written.store(++this->_tail, std::memory_order_release);
+            ++count;
+        }
+
+        if (count > 0)
+        {
+            std::lock_guard lk{this->_file_mutex};
+            if (this->_file)
+            {
+                std::fflush(this->_file);
+            }
+            std::fflush(stdout);
+        }
+
+        std::unique_lock lk{this->_mutex};
+        this->_flushed_cv.notify_all();
+
+        if (!this->_running && !available())
+        {
+            break;
+        }
+
+        this->_sleeping.store(true, std::memory_order_seq_cst);
+        if (!available())
+        {
+            this->_cv.wait_for(lk, DRAIN_INTERVAL);
+        }
+        this->_sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+void Utils::Logger::write(Record &record)
+{
+    std::string message;
+    try {
+        message = record.format(record.fmt, record.args);
+    } catch (fmt::format_error &e) {
+        message = fmt::format("{} [format error: {}]", record.fmt, e.what());
+    }
+
+    if (this->_console)
+    {
+        fmt::print("\033[1m[{}]\033[0m {}\n", record.tag, message);
+    }
+
+    std::lock_guard lk{this->_file_mutex};
+    if (this->_file)
+    {
+        const auto time = std::chrono::system_clock::to_time_t(record.time);
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(record.time.time_since_epoch()).count() % 1000;
+
+        std::tm tm;
+        localtime_r(&time, &tm);
+        char timestamp[32];
+        std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &tm);
+
+        fmt::print(this->_file, "{}.{:03} {:<5} [{}] {}\n", timestamp, ms, level_name(record.level), record.tag, message);
+    }
+}
@@ -0,0 +1,259 @@
+#ifndef UTILS_LOG_HPP
+#define UTILS_LOG_HPP
+
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+#include <new>
+
+#include <fmt/format.h>
+
+// minimum compiled in log level, calls below this level are compiled out entirely
+// 0=trace, 1=debug, 2=info, 3=warning, 4=error, 5=none
+#ifndef DISCORD_LOG_LEVEL
+    #ifdef DEBUG_BUILD
+        #define DISCORD_LOG_LEVEL 0
+    #else
+        #define DISCORD_LOG_LEVEL 2
+    #endif
+#endif
+
+namespace Utils
+{
+    /**
+     * Log levels
+     */
+    enum class LogLevel : int
+    {
+        TRACE   = 0,    // per frame diagnostics, very noisy
+        DEBUG   = 1,    // development diagnostics
+        INFO    = 2,    // connection state changes
+        WARNING = 3,    // recoverable errors
+        ERROR   = 4,    // unrecoverable errors
+        NONE    = 5,    // disables logging
+    };
+
+    static constexpr LogLevel COMPILED_LOG_LEVEL = static_cast<LogLevel>(DISCORD_LOG_LEVEL);
+
+    /**
+     * Asynchronous logger.
+     *
+     * Log calls only capture their arguments into a slot of a lock-free
+     * bounded MPSC ring buffer. Formatting and writing to the console and
+     * log file happens on a background drain thread. When the ring buffer
+     * is full new records are dropped instead of blocking the caller.
+     */
+    class Logger
+    {
+    public:
+        static constexpr std::size_t CAPACITY = 4096;   // ring buffer slots, power of 2
+        static constexpr std::size_t TAG_SIZE = 32;     // inline storage for the tag
+        static constexpr std::size_t ARGS_SIZE = 192;   // inline storage for the captured arguments
+
+        /**
+         * The global logger instance.
+         */
+        static Logger &instance();
+
+        /**
+         * Opens the given file for logging, records are appended.
+         */
+        bool open(const std::string &path);
+
+        /**
+         * Enables or disables logging to stdout.
+         */
+        void setConsole(bool enabled);
+
+        /**
+         * Sets the minimum runtime log level, can't be lower than the compiled in level.
+         */
+        inline void setLevel(LogLevel level)
+        {
+            this->_level.store(level, std::memory_order_relaxed);
+        }
+
+        inline bool enabled(LogLevel level) const
+        {
+            return level >= this->_level.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Blocks until all records pushed so far are written.
+         */
+        void flush();
+
+        /**
+         * Amount of records dropped because the ring buffer was full.
+         */
+        inline std::uint64_t dropped() const
+        {
+            return this->_dropped.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Captures a record, the format string must outlive the logger (string literal).
+         */
+        template<typename... Args>
+        void push(LogLevel level, std::string_view tag, std::string_view fmt, Args&&... args);
+
+    private:
+        Logger();
+        ~Logger();
+
+        // strings are captured by value, everything else is copied as is
+        template<typename T>
+        using capture_t = std::conditional_t<std::is_convertible_v<const std::decay_t<T>&, std::string_view>,
+                                             std::string, std::decay_t<T>>;
+
+        using format_fn = std::string (*)(std::string_view fmt, const void *args);
+        using destroy_fn = void (*)(void *args);
+
+        struct Record
+        {
+            std::atomic<std::size_t> seq;   // slot state, see acquire() and commit()
+            std::size_t pos;                // ring position claimed by the producer
+            LogLevel level;
+            std::chrono::system_clock::time_point time;
+            char tag[TAG_SIZE];
+            std::string_view fmt;
+            format_fn format;
+            destroy_fn destroy;
+            alignas(std::max_align_t) unsigned char args[ARGS_SIZE];
+        };
+
+        template<typename Tuple>
+        static std::string format_tuple(std::string_view fmt, const void *args)
+        {
+            return std::apply([&](const auto&... a) {
+                return fmt::vformat(fmt, fmt::make_format_args(a...));
+            }, *static_cast<const Tuple*>(args));
+        }
+
+        template<typename Tuple>
+        static void destroy_tuple(void *args)
+        {
+            static_cast<Tuple*>(args)->~Tuple();
+        }
+
+        Record *acquire();
+        void commit(Record *record);
+        void run();
+        void write(Record &record);
+
+        Record *_ring;
+        alignas(64) std::atomic<std::size_t> _head = 0;   // producers
+        alignas(64) std::size_t _tail = 0;                // consumer
+        alignas(64) std::atomic<std::uint64_t> _dropped = 0;
+        std::atomic<LogLevel> _level = COMPILED_LOG_LEVEL;
+
+        std::atomic<bool> _console = true;
+        std::FILE *_file = nullptr;
+        std::mutex _file_mutex;
+
+        std::atomic<bool> _running = true;
+        std::atomic<bool> _sleeping = false;
+        std::atomic<std::size_t> _written = 0;
+        std::mutex _mutex;
+        std::condition_variable _cv;
+        std::condition_variable _flushed_cv;
+        std::thread _thr;
+    };
+
+    template<typename... Args>
+    void Logger::push(LogLevel level, std::string_view tag, std::string_view fmt, Args&&... args)
+    {
+        if (!this->enabled(level))
+        {
+            return;
+        }
+
+        auto record = this->acquire();
+        if (!record)
+        {
+            return;
+        }
+
+        record->level = level;
+        record->time = std::chrono::system_clock::now();
+        const auto tag_size = std::min(tag.size(), TAG_SIZE - 1);
+        std::memcpy(record->tag, tag.data(), tag_size);
+        record->tag[tag_size] = '\0';
+
+        using Tuple = std::tuple<capture_t<Args>...>;
+        if constexpr (sizeof(Tuple) <= ARGS_SIZE && alignof(Tuple) <= alignof(std::max_align_t))
+        {
+            record->fmt = fmt;
+            new (record->args) Tuple(std::forward<Args>(args)...);
+            record->format = &Logger::format_tuple<Tuple>;
+            record->destroy = &Logger::destroy_tuple<Tuple>;
+        }
+        else
+        {
+            // too large to be captured inline, format on the calling thread instead
+            using Fallback = std::tuple<std::string>;
+            record->fmt = "{}";
+            new (record->args) Fallback(fmt::vformat(fmt, fmt::make_format_args(args...)));
+            record->format = &Logger::format_tuple<Fallback>;
+            record->destroy = &Logger::destroy_tuple<Fallback>;
+        }
+
+        this->commit(record);
+    }
+
+    /**
+     * Logging helper, prefixes the message with the given tag.
+     * Calls below DISCORD_LOG_LEVEL are compiled out.
+     */
+    template<LogLevel Level, std::size_t N, typename... Args>
+    inline void log(std::string_view tag, const char (&fmt)[N], Args&&... args)
+    {
+        if constexpr (Level >= COMPILED_LOG_LEVEL && Level != LogLevel::NONE)
+        {
+            Logger::instance().push(Level, tag, std::string_view(fmt, N - 1), std::forward<Args>(args)...);
+        }
+    }
+
+    template<std::size_t N, typename... Args>
+    inline void log_trace(std::string_view tag, const char (&fmt)[N], Args&&... args)
+    {
+        log<LogLevel::TRACE>(tag, fmt, std::forward<Args>(args)...);
+    }
+
+    template<std::size_t N, typename... Args>
+    inline void log_debug(std::string_view tag, const char (&fmt)[N], Args&&... args)
+    {
+        log<LogLevel::DEBUG>(tag, fmt, std::forward<Args>(args)...);
+    }
+
+    template<std::size_t N, typename... Args>
+    inline void log_info(std::string_view tag, const char (&fmt)[N], Args&&... args)
+    {
+        log<LogLevel::INFO>(tag, fmt, std::forward<Args>(args)...);
+    }
+
+    template<std::size_t N, typename... Args>
+    inline void log_warning(std::string_view tag, const char (&fmt)[N], Args&&... args)
+    {
+        log<LogLevel::WARNING>(tag, fmt, std::forward<Args>(args)...);
+    }
+
+    template<std::size_t N, typename... Args>
+    inline void log_error(std::string_view tag, const char (&fmt)[N], Args&&... args)
+    {
+        log<LogLevel::ERROR>(tag, fmt, std::forward<Args>(args)...);
+    }
+}
+
+#endif // UTILS_LOG_HPP
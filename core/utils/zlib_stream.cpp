@@ -0,0 +1,120 @@
+#include "zlib_stream.hpp"
+
+#include <chrono>
+#include <cstring>
+
+#include <zlib.h>
+
+namespace
+{
+
+// every complete message ends with the Z_SYNC_FLUSH suffix
+static constexpr unsigned char ZLIB_SUFFIX[] = {0x00, 0x00, 0xFF, 0xFF};
+
+// initial size of the output buffer, grows as needed
+static constexpr std::size_t OUTPUT_CHUNK_SIZE = 64 * 1024;
+
+static inline bool has_suffix(std::string_view data)
+{
+    return data.size() >= sizeof(ZLIB_SUFFIX) &&
+           std::memcmp(data.data() + data.size() - sizeof(ZLIB_SUFFIX), ZLIB_SUFFIX, sizeof(ZLIB_SUFFIX)) == 0;
+}
+
+} // anonymous namespace
+
+Utils::ZlibStream::ZlibStream()
+    : _zs(std::make_unique<z_stream>())
+{
+    this->_output.resize(OUTPUT_CHUNK_SIZE);
+    std::memset(this->_zs.get(), 0, sizeof(z_stream));
+    this->_error = inflateInit(this->_zs.get()) != Z_OK;
+}
+
+Utils::ZlibStream::~ZlibStream()
+{
+    inflateEnd(this->_zs.get());
+}
+
+bool Utils::ZlibStream::feed(std::string_view frame)
+{
+    if (this->_error)
+    {
+        return false;
+    }
+
+    this->_compressed_bytes.fetch_add(frame.size(), std::memory_order_relaxed);
+
+    // buffer incomplete messages
+    std::string_view input = frame;
+    if (!this->_input.empty() || !has_suffix(frame))
+    {
+        this->_input.insert(this->_input.end(), frame.begin(), frame.end());
+        input = std::string_view(this->_input.data(), this->_input.size());
+
+        if (!has_suffix(input))
+        {
+            return false;
+        }
+    }
+
+    const auto begin = std::chrono::steady_clock::now();
+
+    auto zs = this->_zs.get();
+    zs->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    zs->avail_in = static_cast<uInt>(input.size());
+    this->_output_size = 0;
+
+    do
+    {
+        // grow the output buffer when it is full, it is never shrunk again
+        if (this->_output_size == this->_output.size())
+        {
+            this->_output.resize(this->_output.size() * 2);
+        }
+
+        zs->next_out = reinterpret_cast<Bytef*>(this->_output.data() + this->_output_size);
+        zs->avail_out = static_cast<uInt>(this->_output.size() - this->_output_size);
+
+        const auto ret = inflate(zs, Z_SYNC_FLUSH);
+        this->_output_size = this->_output.size() - zs->avail_out;
+
+        if (ret != Z_OK && ret != Z_BUF_ERROR)
+        {
+            this->_error = true;
+            break;
+        }
+    } while (zs->avail_in > 0 || zs->avail_out == 0);
+
+    const auto end = std::chrono::steady_clock::now();
+
+    this->_input.clear();
+
+    if (this->_error)
+    {
+        this->_output_size = 0;
+        return false;
+    }
+
+    this->_inflated_bytes.fetch_add(this->_output_size, std::memory_order_relaxed);
+    this->_messages.fetch_add(1, std::memory_order_relaxed);
+    this->_inflate_time_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count(), std::memory_order_relaxed);
+
+    return true;
+}
+
+void Utils::ZlibStream::reset()
+{
+    this->_input.clear();
+    this->_output_size = 0;
+    this->_error = inflateReset(this->_zs.get()) != Z_OK;
+}
+
+Utils::InflateStats Utils::ZlibStream::stats() const
+{
+    return {
+        this->_compressed_bytes.load(std::memory_order_relaxed),
+        this->_inflated_bytes.load(std::memory_order_relaxed),
+        this->_messages.load(std::memory_order_relaxed),
+        this->_inflate_time_ns.load(std::memory_order_relaxed),
+    };
+}
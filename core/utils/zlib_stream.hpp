@@ -0,0 +1,109 @@
+#ifndef UTILS_ZLIB_STREAM_HPP
+#define UTILS_ZLIB_STREAM_HPP
+
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+// zlib forward declarations
+struct z_stream_s;
+
+namespace Utils
+{
+    /**
+     * Transport compression statistics.
+     */
+    struct InflateStats
+    {
+        std::uint64_t compressed_bytes = 0; // bytes received over the wire
+        std::uint64_t inflated_bytes = 0;   // bytes after decompression
+        std::uint64_t messages = 0;         // amount of complete messages inflated
+        std::uint64_t inflate_time_ns = 0;  // total time spent in inflate()
+
+        /**
+         * Compression ratio (inflated / compressed), 0 if nothing was received yet.
+         */
+        inline double ratio() const
+        {
+            return this->compressed_bytes == 0 ? 0.0 : static_cast<double>(this->inflated_bytes) / this->compressed_bytes;
+        }
+
+        inline InflateStats &operator+= (const InflateStats &other)
+        {
+            this->compressed_bytes += other.compressed_bytes;
+            this->inflated_bytes += other.inflated_bytes;
+            this->messages += other.messages;
+            this->inflate_time_ns += other.inflate_time_ns;
+            return *this;
+        }
+    };
+
+    /**
+     * zlib-stream transport decompression.
+     * https://discord.com/developers/docs/topics/gateway#transport-compression
+     *
+     * A single inflate context is shared by all frames of a connection and keeps its
+     * state across frames. Frames are buffered until the Z_SYNC_FLUSH suffix is received.
+     * The output buffer is reused for all messages.
+     */
+    class ZlibStream
+    {
+    public:
+        ZlibStream();
+        ~ZlibStream();
+
+        ZlibStream(const ZlibStream&) = delete;
+        ZlibStream &operator= (const ZlibStream&) = delete;
+
+        /**
+         * Feeds a received frame into the stream.
+         * Returns true when a complete message was inflated and is available in output().
+         * On errors the stream must be reset.
+         */
+        bool feed(std::string_view frame);
+
+        /**
+         * The last complete inflated message, valid until the next call to feed().
+         */
+        inline std::string_view output() const
+        {
+            return {this->_output.data(), this->_output_size};
+        }
+
+        /**
+         * Whether the stream is in an error state.
+         */
+        inline bool error() const
+        {
+            return this->_error;
+        }
+
+        /**
+         * Resets the inflate context, must be called for every new connection.
+         * Statistics are kept.
+         */
+        void reset();
+
+        /**
+         * Snapshot of the statistics of this stream.
+         */
+        InflateStats stats() const;
+
+    private:
+        std::unique_ptr<z_stream_s> _zs;
+        bool _error = false;
+
+        std::vector<char> _input;   // buffered frames until Z_SYNC_FLUSH
+        std::vector<char> _output;  // reused inflate output buffer
+        std::size_t _output_size = 0;
+
+        std::atomic<std::uint64_t> _compressed_bytes = 0;
+        std::atomic<std::uint64_t> _inflated_bytes = 0;
+        std::atomic<std::uint64_t> _messages = 0;
+        std::atomic<std::uint64_t> _inflate_time_ns = 0;
+    };
+}
+
+#endif // UTILS_ZLIB_STREAM_HPP
@@ -0,0 +1,261 @@
+#include "mock_gateway.hpp"
+
+#include <client.hpp>
+#include <gateway.hpp>
+#include <gateway_cache.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <set>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include <filesystem>
+#include <csignal>
+#include <cstdlib>
+
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <fmt/printf.h>
+
+using namespace Discord;
+
+namespace
+{
+
+std::atomic<bool> interrupted = false;
+
+/**
+ * Latencies in microseconds, 1us buckets up to 100ms.
+ */
+class Histogram
+{
+public:
+    void record(std::chrono::nanoseconds latency)
+    {
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+        const auto bucket = static_cast<std::size_t>(std::clamp<std::int64_t>(us, 0, BUCKETS - 1));
+        this->_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        this->_count.fetch_add(1, std::memory_order_relaxed);
+
+        auto max = this->_max.load(std::memory_order_relaxed);
+        while (us > max && !this->_max.compare_exchange_weak(max, us, std::memory_order_relaxed));
+    }
+
+    std::uint64_t count() const
+    {
+        return this->_count;
+    }
+
+    std::int64_t max() const
+    {
+        return this->_max;
+    }
+
+    /**
+     * Latency in microseconds below which the given fraction of the samples is.
+     */
+    std::size_t percentile(double fraction) const
+    {
+        const auto target = static_cast<std::uint64_t>(fraction * this->_count);
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < BUCKETS; ++i)
+        {
+            seen += this->_buckets[i].load(std::memory_order_relaxed);
+            if (seen > target)
+            {
+                return i;
+            }
+        }
+        return BUCKETS - 1;
+    }
+
+private:
+    static constexpr std::int64_t BUCKETS = 100000;
+
+    std::array<std::atomic<std::uint64_t>, BUCKETS> _buckets{};
+    std::atomic<std::uint64_t> _count = 0;
+    std::atomic<std::int64_t> _max = 0;
+};
+
+struct Arguments
+{
+    std::string recording;
+    std::uint32_t rate = 2000;
+    std::chrono::seconds duration{30};
+    std::uint32_t shards = 1;
+    Client::Encoding encoding = Client::Encoding::JSON;
+    bool compress = false;
+    bool server = false;
+    MockGateway::Options gateway;
+};
+
+static void usage(const char *name)
+{
+    fmt::print(
+        "usage: {} [options]\n"
+        "  --recording FILE      replay the events of FILE, one JSON object per line\n"
+        "  --rate N              events per second of the generated traffic (default 2000)\n"
+        "  --duration S          length of the run in seconds (default 30)\n"
+        "  --speed X             replay speed as multiple of real time, 0 as fast as possible (default 1)\n"
+        "  --loops N             replays of the recording per session, 0 forever (default 1)\n"
+        "  --shards N            gateway connections of the client (default 1)\n"
+        "  --encoding json|etf   gateway encoding of the client (default json)\n"
+        "  --compress            enable zlib-stream transport compression\n"
+        "  --reconnect-every N   request a reconnect after N dispatches per connection\n"
+        "  --port P              port of the mock gateway (default: a free port)\n"
+        "  --server              only run the mock gateway until interrupted\n",
+        name);
+}
+
+static bool parse(int argc, char **argv, Arguments &args)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        const auto value = [&]() -> std::string {
+            return i + 1 < argc ? argv[++i] : "";
+        };
+
+        if (arg == "--recording")            args.recording = value();
+        else if (arg == "--rate")            args.rate = std::stoul(value());
+        else if (arg == "--duration")        args.duration = std::chrono::seconds(std::stoul(value()));
+        else if (arg == "--speed")           args.gateway.speed = std::stod(value());
+        else if (arg == "--loops")           args.gateway.loops = std::stoul(value());
+        else if (arg == "--shards")          args.shards = std::stoul(value());
+        else if (arg == "--encoding")        args.encoding = value() == "etf" ? Client::Encoding::ETF : Client::Encoding::JSON;
+        else if (arg == "--compress")        args.compress = true;
+        else if (arg == "--reconnect-every") args.gateway.reconnect_every = std::stoul(value());
+        else if (arg == "--port")            args.gateway.port = std::stoi(value());
+        else if (arg == "--server")          args.server = true;
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void print_gateway_stats(const MockGateway &gateway)
+{
+    const auto stats = gateway.stats();
+    fmt::print("gateway: {} connection(s), {} identify, {} resume, {} invalid session(s), {} reconnect request(s), {} heartbeat(s)\n",
+        stats.connections, stats.identifies, stats.resumes, stats.invalid_sessions, stats.reconnects, stats.heartbeats);
+    fmt::print("gateway: {} dispatch(es), {:.2f} MB sent\n", stats.dispatches, stats.bytes / 1e6);
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv)
+{
+    Arguments args;
+    try {
+        if (!parse(argc, argv, args))
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    } catch (std::exception&) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::signal(SIGINT, [](int){ interrupted = true; });
+    std::signal(SIGTERM, [](int){ interrupted = true; });
+
+    try {
+        auto recording = args.recording.empty() ?
+            MockGateway::generate(args.rate, args.duration) :
+            MockGateway::load(args.recording);
+
+        std::set<std::string> events;
+        for (auto&& event : recording)
+        {
+            events.insert(event.name);
+        }
+        fmt::print("recording: {} event(s) of {} type(s)\n", recording.size(), events.size());
+
+        MockGateway gateway(std::move(recording), args.gateway);
+        fmt::print("mock gateway listening on {}\n", gateway.url());
+
+        if (args.server)
+        {
+            while (!interrupted)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+            print_gateway_stats(gateway);
+            return 0;
+        }
+
+        // the client finds the mock through a fresh discovery cache and never calls the REST API
+        const auto dir = std::filesystem::temp_directory_path() / fmt::format("loadtest-{}", ::getpid());
+        std::filesystem::create_directories(dir);
+        const auto discovery = (dir / "gateway.json").string();
+        {
+            Gateway info;
+            info.url = gateway.url();
+            info.shards = args.shards;
+            info.limit = {1000, 1000, 86400000, 1};
+            GatewayCache(discovery, std::chrono::hours(1)).store(info);
+        }
+
+        Client client("mock-token");
+        client.setShardCount(args.shards);
+        client.setEncoding(args.encoding);
+        client.setTransportCompression(args.compress);
+        client.setDiscoveryCache(discovery);
+
+        auto histogram = std::make_unique<Histogram>();
+        auto &latency = *histogram;
+        const std::string field(MockGateway::TIMESTAMP_FIELD);
+        for (auto&& event : events)
+        {
+            client.on(event, [&latency, &field](const nlohmann::json &data) {
+                if (const auto sent = data.find(field); sent != data.end() && sent->is_number_integer())
+                {
+                    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+                    latency.record(now - std::chrono::nanoseconds(sent->get<std::uint64_t>()));
+                }
+            });
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        std::thread stopper([&]{
+            const auto end = start + args.duration;
+            while (!interrupted && std::chrono::steady_clock::now() < end)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+            client.stop();
+        });
+
+        const auto ret = client.exec();
+        stopper.join();
+
+        const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const auto dispatch = client.dispatchStats();
+        const auto startup = client.startupStats();
+
+        fmt::print("client: {} event(s) handled in {:.2f}s, {:.0f} events/s\n", latency.count(), elapsed, latency.count() / elapsed);
+        fmt::print("client: latency p50={}us p90={}us p99={}us p99.9={}us max={}us\n",
+            latency.percentile(0.5), latency.percentile(0.9), latency.percentile(0.99), latency.percentile(0.999), latency.max());
+        fmt::print("client: queue max_depth={} blocked={} dropped={} coalesced={}\n",
+            dispatch.max_depth, dispatch.blocked, dispatch.dropped, dispatch.coalesced);
+        fmt::print("client: {} shard(s) identified in {}ms, {} resumed\n",
+            startup.identified, startup.identify_time.count(), startup.resumed);
+        print_gateway_stats(gateway);
+
+        std::filesystem::remove_all(dir);
+        return ret;
+    } catch (std::exception &e) {
+        fmt::print("{}\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,593 @@
+#include "mock_gateway.hpp"
+
+#include <utils/etf.hpp>
+
+#include <thread>
+#include <condition_variable>
+#include <fstream>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <cstring>
+
+#include <ixwebsocket/IXWebSocketServer.h>
+#include <ixwebsocket/IXConnectionState.h>
+
+#include <zlib.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using json = nlohmann::json;
+using clock_type = std::chrono::steady_clock;
+
+namespace
+{
+
+// gateway opcodes used by the mock
+enum Opcode : std::uint32_t
+{
+    DISPATCH        = 0,
+    HEARTBEAT       = 1,
+    IDENTIFY        = 2,
+    RESUME          = 6,
+    RECONNECT       = 7,
+    INVALID_SESSION = 9,
+    HELLO           = 10,
+    HEARTBEAT_ACK   = 11,
+};
+
+/**
+ * Asks the kernel for a free port on the loopback interface.
+ */
+static int free_port()
+{
+    const auto fd = ::socket(AF_INET, SOCK_STREAM, 0);
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = ::inet_addr("127.0.0.1");
+    addr.sin_port = 0;
+
+    socklen_t len = sizeof(addr);
+    const auto ok = ::bind(fd, reinterpret_cast<sockaddr*>(&addr), len) == 0 &&
+                    ::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len) == 0;
+    ::close(fd);
+
+    if (!ok)
+    {
+        throw std::runtime_error("no free port for the mock gateway");
+    }
+
+    return ntohs(addr.sin_port);
+}
+
+static std::uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now().time_since_epoch()).count();
+}
+
+} // anonymous namespace
+
+/**
+ * Gateway connection of a client, owns the replay thread and the zlib-stream context.
+ */
+class MockGateway::Connection
+{
+public:
+    Connection(ix::WebSocket &ws, bool etf, bool compress)
+        : ws(ws), etf(etf), compress(compress)
+    {
+        if (this->compress)
+        {
+            std::memset(&this->_deflate, 0, sizeof(this->_deflate));
+            deflateInit(&this->_deflate, Z_DEFAULT_COMPRESSION);
+        }
+    }
+
+    ~Connection()
+    {
+        this->stop();
+
+        if (this->compress)
+        {
+            deflateEnd(&this->_deflate);
+        }
+    }
+
+    ix::WebSocket &ws;
+    const bool etf;
+    const bool compress;
+
+    std::string session_id;
+    std::shared_ptr<Session> session;
+
+    /**
+     * Encodes and sends a payload, returns the amount of bytes sent.
+     */
+    std::size_t send(const json &payload)
+    {
+        return this->send_raw(this->etf ? Utils::Etf::encode(payload) : payload.dump());
+    }
+
+    /**
+     * Sends an already encoded payload, returns the amount of bytes sent.
+     */
+    std::size_t send_raw(const std::string &data)
+    {
+        // frames of the compressed stream must be sent in the order they were deflated
+        std::lock_guard lk{this->_send_mutex};
+
+        if (!this->compress)
+        {
+            const auto info = this->etf ? this->ws.sendBinary(data) : this->ws.sendText(data);
+            return info.success ? info.wireSize : 0;
+        }
+
+        this->_buffer.clear();
+        this->_deflate.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        this->_deflate.avail_in = static_cast<uInt>(data.size());
+        do
+        {
+            const auto offset = this->_buffer.size();
+            this->_buffer.resize(offset + data.size() / 2 + 64);
+            this->_deflate.next_out = reinterpret_cast<Bytef*>(this->_buffer.data() + offset);
+            this->_deflate.avail_out = static_cast<uInt>(this->_buffer.size() - offset);
+            deflate(&this->_deflate, Z_SYNC_FLUSH);
+            this->_buffer.resize(this->_buffer.size() - this->_deflate.avail_out);
+        } while (this->_deflate.avail_out == 0);
+
+        const auto info = this->ws.sendBinary(this->_buffer);
+        return info.success ? info.wireSize : 0;
+    }
+
+    /**
+     * Starts replaying on a new thread, a running replay is stopped first.
+     */
+    template<typename Function>
+    void start(Function &&fn)
+    {
+        this->stop();
+        this->_running = true;
+        this->_thr = std::thread(std::forward<Function>(fn));
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard lk{this->_mutex};
+            this->_running = false;
+        }
+        this->_cv.notify_all();
+
+        if (this->_thr.joinable() && this->_thr.get_id() != std::this_thread::get_id())
+        {
+            this->_thr.join();
+        }
+    }
+
+    /**
+     * Waits until the given time, returns false when the replay was stopped.
+     */
+    bool wait_until(clock_type::time_point tp)
+    {
+        std::unique_lock lk{this->_mutex};
+        return !this->_cv.wait_until(lk, tp, [this]{ return !this->_running; });
+    }
+
+    inline bool running() const
+    {
+        return this->_running;
+    }
+
+private:
+    z_stream _deflate;
+    std::mutex _send_mutex;
+    std::string _buffer;
+
+    std::thread _thr;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::atomic<bool> _running = false;
+};
+
+MockGateway::MockGateway(std::vector<Event> recording, Options options)
+    : _recording(std::move(recording)),
+      _options(options)
+{
+    if (this->_recording.empty())
+    {
+        throw std::runtime_error("the recording is empty");
+    }
+
+    // the data of every event is serialized once without its braces, the send time is spliced in front
+    this->_encoded.reserve(this->_recording.size());
+    for (auto&& event : this->_recording)
+    {
+        const auto data = event.data.is_object() ? event.data.dump() : std::string("{}");
+        this->_encoded.emplace_back(data.size() > 2 ? "," + data.substr(1, data.size() - 2) : std::string());
+    }
+
+    // the next replay starts one average event gap after the last event
+    const auto last = this->_recording.back().offset;
+    this->_span = last + std::max(last / static_cast<std::int64_t>(this->_recording.size()), std::chrono::microseconds(1));
+
+    this->_port = this->_options.port == 0 ? free_port() : this->_options.port;
+    this->_server = std::make_unique<ix::WebSocketServer>(this->_port, "127.0.0.1");
+
+    // the real gateway does not negotiate permessage-deflate
+    this->_server->disablePerMessageDeflate();
+
+    this->_server->setOnClientMessageCallback([this](std::shared_ptr<ix::ConnectionState> state, ix::WebSocket &ws, const ix::WebSocketMessagePtr &msg) {
+        switch (msg->type)
+        {
+            case ix::WebSocketMessageType::Open:
+                this->on_open(state->getId(), ws, msg->openInfo.uri);
+                break;
+            case ix::WebSocketMessageType::Close:
+                this->on_close(state->getId());
+                break;
+            case ix::WebSocketMessageType::Message:
+                this->on_message(state->getId(), msg->str);
+                break;
+            default:
+                break;
+        }
+    });
+
+    const auto res = this->_server->listen();
+    if (!res.first)
+    {
+        throw std::runtime_error("failed to start the mock gateway: " + res.second);
+    }
+
+    this->_server->start();
+}
+
+MockGateway::~MockGateway()
+{
+    // the replays must end before the server closes their sockets
+    decltype(this->_connections) connections;
+    {
+        std::lock_guard lk{this->_mutex};
+        connections.swap(this->_connections);
+    }
+    for (auto&& connection : connections)
+    {
+        connection.second->stop();
+    }
+
+    this->_server->stop();
+}
+
+MockGateway::Stats MockGateway::stats() const
+{
+    Stats stats;
+    stats.connections = this->_stats.connections;
+    stats.identifies = this->_stats.identifies;
+    stats.resumes = this->_stats.resumes;
+    stats.invalid_sessions = this->_stats.invalid_sessions;
+    stats.reconnects = this->_stats.reconnects;
+    stats.heartbeats = this->_stats.heartbeats;
+    stats.dispatches = this->_stats.dispatches;
+    stats.bytes = this->_stats.bytes;
+    return stats;
+}
+
+void MockGateway::on_open(const std::string &id, ix::WebSocket &ws, const std::string &uri)
+{
+    const auto etf = uri.find("encoding=etf") != std::string::npos;
+    const auto compress = uri.find("compress=zlib-stream") != std::string::npos;
+    auto connection = std::make_shared<Connection>(ws, etf, compress);
+
+    {
+        std::lock_guard lk{this->_mutex};
+        this->_connections[id] = connection;
+    }
+    ++this->_stats.connections;
+
+    this->_stats.bytes += connection->send({
+        {"op", HELLO},
+        {"d", {{"heartbeat_interval", this->_options.heartbeat_interval.count()}}},
+        {"s", nullptr},
+        {"t", nullptr},
+    });
+}
+
+void MockGateway::on_close(const std::string &id)
+{
+    std::shared_ptr<Connection> connection;
+    {
+        std::lock_guard lk{this->_mutex};
+        const auto it = this->_connections.find(id);
+        if (it == this->_connections.end())
+        {
+            return;
+        }
+        connection = std::move(it->second);
+        this->_connections.erase(it);
+    }
+
+    connection->stop();
+}
+
+void MockGateway::on_message(const std::string &id, const std::string &data)
+{
+    std::shared_ptr<Connection> connection;
+    {
+        std::lock_guard lk{this->_mutex};
+        const auto it = this->_connections.find(id);
+        if (it == this->_connections.end())
+        {
+            return;
+        }
+        connection = it->second;
+    }
+
+    json payload;
+    try {
+        payload = connection->etf ? Utils::Etf::decode(data) : json::parse(data);
+    } catch (std::exception&) {
+        return;
+    }
+
+    const auto op = payload.value("op", 0u);
+    const auto &d = payload["d"];
+
+    if (op == HEARTBEAT)
+    {
+        ++this->_stats.heartbeats;
+        this->_stats.bytes += connection->send({{"op", HEARTBEAT_ACK}, {"d", nullptr}, {"s", nullptr}, {"t", nullptr}});
+    }
+    else if (op == IDENTIFY)
+    {
+        ++this->_stats.identifies;
+
+        auto session = std::make_shared<Session>();
+        std::string session_id;
+        {
+            std::lock_guard lk{this->_mutex};
+            session_id = "mock-session-" + std::to_string(this->_next_session++);
+            this->_sessions[session_id] = session;
+        }
+        connection->session_id = session_id;
+
+        json ready = {
+            {"v", 6},
+            {"session_id", session_id},
+            {"user", {{"id", "712381898487234612"}, {"username", "misaka"}, {"discriminator", "0001"}, {"avatar", nullptr}, {"bot", true}}},
+            {"guilds", json::array()},
+            {"private_channels", json::array()},
+        };
+        if (d.contains("shard"))
+        {
+            ready["shard"] = d["shard"];
+        }
+
+        this->_stats.bytes += connection->send({{"op", DISPATCH}, {"d", std::move(ready)}, {"s", 1}, {"t", "READY"}});
+        this->start_session(*connection, std::move(session), 0);
+    }
+    else if (op == RESUME)
+    {
+        const auto session_id = d.value("session_id", std::string());
+        const auto seq = d.value("seq", std::uint64_t(0));
+
+        std::shared_ptr<Session> session;
+        {
+            std::lock_guard lk{this->_mutex};
+            if (const auto it = this->_sessions.find(session_id); it != this->_sessions.end())
+            {
+                session = it->second;
+            }
+        }
+
+        // the client can't have received more than was sent
+        if (!session || seq == 0 || seq > session->position + 1)
+        {
+            ++this->_stats.invalid_sessions;
+            this->_stats.bytes += connection->send({{"op", INVALID_SESSION}, {"d", false}, {"s", nullptr}, {"t", nullptr}});
+            return;
+        }
+
+        ++this->_stats.resumes;
+        connection->session_id = session_id;
+
+        // RESUMED repeats the last sequence number, it takes no replay position
+        this->_stats.bytes += connection->send({{"op", DISPATCH}, {"d", json::object()}, {"s", seq}, {"t", "RESUMED"}});
+        this->start_session(*connection, std::move(session), seq - 1);
+    }
+}
+
+void MockGateway::start_session(Connection &connection, std::shared_ptr<Session> session, std::uint64_t position)
+{
+    session->position = position;
+    connection.session = std::move(session);
+    connection.start([this, &connection, position]{
+        this->replay(connection, position);
+    });
+}
+
+void MockGateway::replay(Connection &connection, std::uint64_t position)
+{
+    const auto end = this->_options.loops == 0 ?
+        std::numeric_limits<std::uint64_t>::max() :
+        this->_options.loops * static_cast<std::uint64_t>(this->_recording.size());
+
+    const auto paced = this->_options.speed > 0;
+    const auto start = clock_type::now();
+    const auto base = paced ? this->offset_of(position) : std::chrono::nanoseconds::zero();
+    std::uint32_t sent = 0;
+
+    while (connection.running() && position < end)
+    {
+        if (paced &&
+            !connection.wait_until(start + std::chrono::duration_cast<clock_type::duration>(this->offset_of(position) - base)))
+        {
+            return;
+        }
+
+        this->_stats.bytes += connection.send_raw(this->dispatch(connection, position));
+        ++this->_stats.dispatches;
+        connection.session->position = ++position;
+
+        // the client closes the connection and resumes the session
+        if (this->_options.reconnect_every != 0 && ++sent == this->_options.reconnect_every)
+        {
+            ++this->_stats.reconnects;
+            this->_stats.bytes += connection.send({{"op", RECONNECT}, {"d", nullptr}, {"s", nullptr}, {"t", nullptr}});
+            return;
+        }
+    }
+}
+
+std::string MockGateway::dispatch(const Connection &connection, std::uint64_t position) const
+{
+    const auto index = position % this->_recording.size();
+    const auto &event = this->_recording[index];
+    const auto seq = position + 2;
+
+    if (connection.etf)
+    {
+        auto data = event.data.is_object() ? event.data : json::object();
+        data[std::string(TIMESTAMP_FIELD)] = now_ns();
+        return Utils::Etf::encode({{"op", DISPATCH}, {"d", std::move(data)}, {"s", seq}, {"t", event.name}});
+    }
+
+    std::string out;
+    out.reserve(this->_encoded[index].size() + event.name.size() + 96);
+    out += "{\"op\":0,\"s\":";
+    out += std::to_string(seq);
+    out += ",\"t\":\"";
+    out += event.name;
+    out += "\",\"d\":{\"";
+    out += TIMESTAMP_FIELD;
+    out += "\":";
+    out += std::to_string(now_ns());
+    out += this->_encoded[index];
+    out += "}}";
+    return out;
+}
+
+std::chrono::nanoseconds MockGateway::offset_of(std::uint64_t position) const
+{
+    const auto loop = static_cast<std::int64_t>(position / this->_recording.size());
+    const auto offset = this->_span * loop + this->_recording[position % this->_recording.size()].offset;
+    return std::chrono::nanoseconds(static_cast<std::int64_t>(std::chrono::nanoseconds(offset).count() / this->_options.speed));
+}
+
+std::vector<MockGateway::Event> MockGateway::load(const std::string &path)
+{
+    std::ifstream ifs(path, std::ios::in | std::ios::binary);
+    if (!ifs.is_open())
+    {
+        throw std::runtime_error("failed to open the recording " + path);
+    }
+
+    std::vector<Event> recording;
+    std::chrono::microseconds offset{};
+    std::string line;
+    std::size_t number = 0;
+
+    while (std::getline(ifs, line))
+    {
+        ++number;
+        if (line.empty())
+        {
+            continue;
+        }
+
+        try {
+            auto j = json::parse(line);
+            if (j.contains("op") && j["op"].get<std::uint32_t>() != DISPATCH)
+            {
+                continue;
+            }
+
+            offset = j.contains("ts") ?
+                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::duration<double, std::milli>(j["ts"].get<double>())) :
+                offset + std::chrono::milliseconds(1);
+            recording.push_back({offset, j.at("t").get<std::string>(), std::move(j["d"])});
+        } catch (json::exception &e) {
+            throw std::runtime_error("invalid event in line " + std::to_string(number) + " of " + path + ": " + e.what());
+        }
+    }
+
+    return recording;
+}
+
+std::vector<MockGateway::Event> MockGateway::generate(std::uint32_t rate, std::chrono::seconds duration)
+{
+    rate = std::max<std::uint32_t>(rate, 1);
+
+    std::uint64_t snowflake = 81384788765712384ULL;
+    const auto id = [&]{ return std::to_string(snowflake += 4194304 + 17); };
+
+    const auto guild_id = id();
+    std::vector<std::string> channels, users;
+
+    json guild = {
+        {"id", guild_id}, {"name", "mock guild"}, {"icon", nullptr}, {"owner_id", id()},
+        {"region", "europe"}, {"large", true}, {"joined_at", "2020-06-01T12:34:56.789000+00:00"},
+        {"roles", json::array()}, {"channels", json::array()}, {"members", json::array()},
+    };
+    for (std::uint32_t i = 0; i < 20; ++i)
+    {
+        channels.emplace_back(id());
+        guild["channels"].push_back({
+            {"id", channels.back()}, {"type", 0}, {"guild_id", guild_id}, {"position", i},
+            {"name", "channel-" + std::to_string(i)}, {"nsfw", false}, {"permission_overwrites", json::array()},
+        });
+    }
+    for (std::uint32_t i = 0; i < 200; ++i)
+    {
+        users.emplace_back(id());
+        guild["members"].push_back({
+            {"user", {{"id", users.back()}, {"username", "user" + std::to_string(i)}, {"discriminator", "1337"}, {"avatar", nullptr}}},
+            {"nick", nullptr}, {"roles", json::array()}, {"joined_at", "2020-06-01T12:34:56.789000+00:00"},
+            {"deaf", false}, {"mute", false},
+        });
+    }
+    guild["member_count"] = users.size();
+
+    std::vector<Event> recording;
+    recording.push_back({std::chrono::microseconds(0), "GUILD_CREATE", std::move(guild)});
+
+    // 60% messages, 25% typing, 15% presence updates
+    const auto count = static_cast<std::uint64_t>(rate) * duration.count();
+    const auto gap = std::chrono::microseconds(1000000) / rate;
+    for (std::uint64_t i = 1; i <= count; ++i)
+    {
+        const auto &channel_id = channels[i % channels.size()];
+        const auto &user_id = users[(i * 7) % users.size()];
+        const auto offset = gap * static_cast<std::int64_t>(i);
+
+        switch (i % 20)
+        {
+            case 0: case 1: case 2:
+                recording.push_back({offset, "PRESENCE_UPDATE", {
+                    {"user", {{"id", user_id}}}, {"guild_id", guild_id}, {"status", i % 2 == 0 ? "online" : "idle"},
+                    {"activities", json::array()}, {"client_status", {{"desktop", "online"}}},
+                }});
+                break;
+            case 3: case 4: case 5: case 6: case 7:
+                recording.push_back({offset, "TYPING_START", {
+                    {"channel_id", channel_id}, {"guild_id", guild_id}, {"user_id", user_id}, {"timestamp", 1591014896 + i},
+                }});
+                break;
+            default:
+                recording.push_back({offset, "MESSAGE_CREATE", {
+                    {"id", id()}, {"channel_id", channel_id}, {"guild_id", guild_id},
+                    {"author", {{"id", user_id}, {"username", "user"}, {"discriminator", "1337"}, {"avatar", nullptr}}},
+                    {"content", "message " + std::to_string(i) + " of the mock gateway"},
+                    {"timestamp", "2020-06-01T12:34:56.789000+00:00"}, {"edited_timestamp", nullptr},
+                    {"tts", false}, {"mention_everyone", false}, {"mentions", json::array()}, {"mention_roles", json::array()},
+                    {"attachments", json::array()}, {"embeds", json::array()}, {"pinned", false}, {"type", 0},
+                }});
+                break;
+        }
+    }
+
+    return recording;
+}
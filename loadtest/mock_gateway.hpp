@@ -0,0 +1,151 @@
+#ifndef LOADTEST_MOCK_GATEWAY_HPP
+#define LOADTEST_MOCK_GATEWAY_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+
+namespace ix
+{
+    class WebSocketServer;
+    class WebSocket;
+    class ConnectionState;
+}
+
+/**
+ * Local stand-in for the Discord gateway.
+ *
+ * Speaks HELLO, IDENTIFY, RESUME, HEARTBEAT and HEARTBEAT_ACK and replays a
+ * recording of dispatch events to every identified connection. The encoding
+ * and transport compression are taken from the query of the connection URL,
+ * like the real gateway does.
+ *
+ * Every dispatched event carries the send time (steady clock, nanoseconds) in
+ * its data under TIMESTAMP_FIELD, handlers in the same process measure the
+ * end-to-end latency with it.
+ *
+ * Sequence numbers are derived from the replay position (READY is 1, the n-th
+ * replayed event is n + 2), so a RESUME continues right after the sequence
+ * number the client received last.
+ */
+class MockGateway
+{
+public:
+    // field with the send time which is added to the data of every dispatch
+    static constexpr std::string_view TIMESTAMP_FIELD = "mock_sent_ns";
+
+    /**
+     * Recorded dispatch event.
+     */
+    struct Event
+    {
+        std::chrono::microseconds offset{}; // since the start of the recording
+        std::string name;                   // event name [t]
+        nlohmann::json data;                // event data [d]
+    };
+
+    struct Options
+    {
+        int port = 0;                                   // 0 picks a free port
+        double speed = 1.0;                             // multiple of real time, 0 replays as fast as possible
+        std::uint32_t loops = 1;                        // replays of the recording per session, 0 repeats forever
+        std::chrono::milliseconds heartbeat_interval{41250};
+        std::uint32_t reconnect_every = 0;              // sends RECONNECT after this many dispatches, 0 never
+    };
+
+    struct Stats
+    {
+        std::uint64_t connections = 0;
+        std::uint64_t identifies = 0;
+        std::uint64_t resumes = 0;
+        std::uint64_t invalid_sessions = 0;
+        std::uint64_t reconnects = 0;       // RECONNECT requests sent
+        std::uint64_t heartbeats = 0;
+        std::uint64_t dispatches = 0;
+        std::uint64_t bytes = 0;            // sent on the wire, after compression
+    };
+
+    /**
+     * Starts listening on 127.0.0.1, throws std::runtime_error when the server can't be started.
+     */
+    MockGateway(std::vector<Event> recording, Options options);
+    ~MockGateway();
+
+    MockGateway(const MockGateway&) = delete;
+    MockGateway &operator= (const MockGateway&) = delete;
+
+    /**
+     * Gateway URL to connect to, without query.
+     */
+    inline std::string url() const
+    {
+        return "ws://127.0.0.1:" + std::to_string(this->_port);
+    }
+
+    Stats stats() const;
+
+    /**
+     * Loads a recording with one JSON object {"ts": ms, "t": name, "d": data} per line.
+     * Lines without "ts", for example captured gateway payloads, follow 1ms after the previous one.
+     * Throws std::runtime_error when the file can't be read.
+     */
+    static std::vector<Event> load(const std::string &path);
+
+    /**
+     * Generates traffic of a busy guild: a GUILD_CREATE followed by messages,
+     * typing and presence updates at the given rate.
+     */
+    static std::vector<Event> generate(std::uint32_t rate, std::chrono::seconds duration);
+
+private:
+    class Connection;
+
+    struct Session
+    {
+        std::atomic<std::uint64_t> position = 0;   // replay position of the next event
+    };
+
+    const std::vector<Event> _recording;
+    const Options _options;
+    std::vector<std::string> _encoded;  // JSON fields of the recorded data, without braces
+    std::chrono::microseconds _span{};  // length of one replay of the recording
+    int _port = 0;
+
+    std::unique_ptr<ix::WebSocketServer> _server;
+
+    std::mutex _mutex;
+    std::map<std::string, std::shared_ptr<Connection>> _connections;   // by connection id
+    std::map<std::string, std::shared_ptr<Session>> _sessions;         // by session id
+    std::uint64_t _next_session = 1;
+
+    struct
+    {
+        std::atomic<std::uint64_t> connections = 0;
+        std::atomic<std::uint64_t> identifies = 0;
+        std::atomic<std::uint64_t> resumes = 0;
+        std::atomic<std::uint64_t> invalid_sessions = 0;
+        std::atomic<std::uint64_t> reconnects = 0;
+        std::atomic<std::uint64_t> heartbeats = 0;
+        std::atomic<std::uint64_t> dispatches = 0;
+        std::atomic<std::uint64_t> bytes = 0;
+    } _stats;
+
+    void on_open(const std::string &id, ix::WebSocket &ws, const std::string &uri);
+    void on_close(const std::string &id);
+    void on_message(const std::string &id, const std::string &data);
+
+    void start_session(Connection &connection, std::shared_ptr<Session> session, std::uint64_t position);
+    void replay(Connection &connection, std::uint64_t position);
+    std::string dispatch(const Connection &connection, std::uint64_t position) const;
+    std::chrono::nanoseconds offset_of(std::uint64_t position) const;
+};
+
+#endif // LOADTEST_MOCK_GATEWAY_HPP
@@ -0,0 +1,396 @@
+#include <bandit/bandit.h>
+
+#include <cache.hpp>
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <cstdint>
+
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+using namespace snowhouse;
+using namespace bandit;
+
+using Discord::Cache;
+using Discord::Event;
+using Discord::Snowflake;
+using json = nlohmann::json;
+
+namespace
+{
+
+static constexpr std::uint64_t GUILD = 81384788765712384;
+static constexpr std::uint64_t OTHER_GUILD = 81384788765712385;
+
+static std::string temp_path(const std::string &name)
+{
+    return (std::filesystem::temp_directory_path() / ("discord-cache-" + std::to_string(::getpid()) + "-" + name)).string();
+}
+
+static std::string id(std::uint64_t value)
+{
+    return std::to_string(value);
+}
+
+static json member_json(std::uint64_t user_id, std::vector<std::uint64_t> roles = {})
+{
+    json j = {{"user", {{"id", id(user_id)}, {"username", "user" + id(user_id)}}}, {"roles", json::array()}};
+    for (auto&& role : roles)
+    {
+        j["roles"].emplace_back(id(role));
+    }
+    return j;
+}
+
+/**
+ * GUILD_CREATE payload with channels 1xx, roles 2xx and members 3xx of the guild.
+ */
+static json guild_json(std::uint64_t guild_id, std::size_t channels, std::size_t roles, std::size_t members)
+{
+    const auto base = (guild_id - GUILD) * 1000;
+
+    json j = {{"id", id(guild_id)}, {"name", "guild"}, {"member_count", members},
+              {"channels", json::array()}, {"roles", json::array()}, {"members", json::array()}};
+    for (std::size_t i = 0; i < channels; ++i)
+    {
+        j["channels"].push_back({{"id", id(base + 100 + i)}, {"type", 0}, {"name", "channel" + std::to_string(i)}});
+    }
+    for (std::size_t i = 0; i < roles; ++i)
+    {
+        j["roles"].push_back({{"id", id(base + 200 + i)}, {"name", "role" + std::to_string(i)}, {"position", i}});
+    }
+    for (std::size_t i = 0; i < members; ++i)
+    {
+        j["members"].emplace_back(member_json(base + 300 + i, {base + 200}));
+    }
+    return j;
+}
+
+static std::vector<std::uint64_t> values(const std::vector<Snowflake> &ids)
+{
+    std::vector<std::uint64_t> result;
+    for (auto&& id : ids)
+    {
+        result.emplace_back(id.value());
+    }
+    return result;
+}
+
+} // anonymous namespace
+
+go_bandit([]{
+    describe("Cache", []{
+        it("populates channels, roles, members and users from GUILD_CREATE", [&]{
+            Cache cache;
+            cache.update(Event::GUILD_CREATE, guild_json(GUILD, 3, 2, 4));
+
+            const auto guild = cache.guild(Snowflake(GUILD));
+            AssertThat(guild != nullptr, IsTrue());
+            AssertThat(guild->name, Equals("guild"));
+            AssertThat(guild->member_count, Equals(4));
+            AssertThat(values(guild->channels), Equals(std::vector<std::uint64_t>{100, 101, 102}));
+            AssertThat(values(guild->roles), Equals(std::vector<std::uint64_t>{200, 201}));
+
+            // channels of GUILD_CREATE get the guild id
+            const auto channel = cache.channel(Snowflake(101));
+            AssertThat(channel != nullptr, IsTrue());
+            AssertThat(channel->name, Equals("channel1"));
+            AssertThat(channel->guild_id.value(), Equals(GUILD));
+
+            AssertThat(cache.role(Snowflake(201))->name, Equals("role1"));
+
+            const auto member = cache.member(Snowflake(GUILD), Snowflake(302));
+            AssertThat(member != nullptr, IsTrue());
+            AssertThat(member->guild_id.value(), Equals(GUILD));
+            AssertThat(values(member->roles), Equals(std::vector<std::uint64_t>{200}));
+            AssertThat(cache.user(Snowflake(302))->username, Equals("user302"));
+
+            const auto stats = cache.stats();
+            AssertThat(stats.guilds, Equals(1u));
+            AssertThat(stats.channels, Equals(3u));
+            AssertThat(stats.roles, Equals(2u));
+            AssertThat(stats.members, Equals(4u));
+            AssertThat(stats.users, Equals(4u));
+            AssertThat(stats.memory, IsGreaterThan(0u));
+        });
+
+        it("drops channels and roles missing from a repeated GUILD_CREATE", [&]{
+            Cache cache;
+            cache.update(Event::GUILD_CREATE, guild_json(GUILD, 3, 2, 0));
+            cache.update(Event::GUILD_CREATE, guild_json(GUILD, 1, 1, 0));
+
+            AssertThat(cache.channel(Snowflake(100)) != nullptr, IsTrue());
+            AssertThat(cache.channel(Snowflake(101)) == nullptr, IsTrue());
+            AssertThat(cache.role(Snowflake(201)) == nullptr, IsTrue());
+            AssertThat(cache.stats().channels, Equals(1u));
+        });
+
+        it("applies channel events to the channel and the guild", [&]{
+            Cache cache;
+            cache.update(Event::GUILD_CREATE, guild_json(GUILD, 1, 0, 0));
+
+            cache.update(Event::CHANNEL_CREATE, {{"id", "150"}, {"type", 0}, {"guild_id", id(GUILD)}, {"name", "new"}});
+            AssertThat(cache.channel(Snowflake(150))->name, Equals("new"));
+            AssertThat(values(cache.guild(Snowflake(GUILD))->channels), Equals(std::vector<std::uint64_t>{100, 150}));
+
+            // an update does not add the id twice
+            cache.update(Event::CHANNEL_UPDATE, {{"id", "150"}, {"type", 0}, {"guild_id", id(GUILD)}, {"name", "renamed"}});
+            AssertThat(cache.channel(Snowflake(150))->name, Equals("renamed"));
+            AssertThat(values(cache.guild(Snowflake(GUILD))->channels), Equals(std::vector<std::uint64_t>{100, 150}));
+
+            cache.update(Event::CHANNEL_DELETE, {{"id", "100"}, {"guild_id", id(GUILD)}});
+            AssertThat(cache.channel(Snowflake(100)) == nullptr, IsTrue());
+            AssertThat(values(cache.guild(Snowflake(GUILD))->channels), Equals(std::vector<std::uint64_t>{150}));
+
+            // direct message channels don't belong to a guild
+            cache.update(Event::CHANNEL_CREATE, {{"id", "160"}, {"type", 1}});
+            AssertThat(cache.channel(Snowflake(160)) != nullptr, IsTrue());
+            AssertThat(cache.guild(Snowflake(GUILD))->channels.size(), Equals(1u));
+        });
+
+        it("applies role events to the role and the guild", [&]{
+            Cache cache;
+            cache.update(Event::GUILD_CREATE, guild_json(GUILD, 0, 1, 0));
+
+            cache.update(Event::GUILD_ROLE_CREATE, {{"guild_id", id(GUILD)}, {"role", {{"id", "250"}, {"name", "new"}}}});
+            AssertThat(cache.role(Snowflake(250))->name, Equals("new"));
+            AssertThat(values(cache.guild(Snowflake(GUILD))->roles), Equals(std::vector<std::uint64_t>{200, 250}));
+
+            cache.update(Event::GUILD_ROLE_UPDATE, {{"guild_id", id(GUILD)}, {"role", {{"id", "250"}, {"name", "renamed"}}}});
+            AssertThat(cache.role(Snowflake(250))->name, Equals("renamed"));
+            AssertThat(cache.guild(Snowflake(GUILD))->roles.size(), Equals(2u));
+
+            cache.update(Event::GUILD_ROLE_DELETE, {{"guild_id", id(GUILD)}, {"role_id", "200"}});
+            AssertThat(cache.role(Snowflake(200)) == nullptr, IsTrue());
+            AssertThat(values(cache.guild(Snowflake(GUILD))->roles), Equals(std::vector<std::uint64_t>{250}));
+        });
+
+        it("applies member events to the member and the member count", [&]{
+            Cache cache;
+            cache.update(Event::GUILD_CREATE, guild_json(GUILD, 0, 1, 2));
+
+            auto added = member_json(400);
+            added["guild_id"] = id(GUILD);
+            added["deaf"] = true;
+            cache.update(Event::GUILD_MEMBER_ADD, added);
+            AssertThat(cache.member(Snowflake(GUILD), Snowflake(400)) != nullptr, IsTrue());
+            AssertThat(cache.user(Snowflake(400)) != nullptr, IsTrue());
+            AssertThat(cache.guild(Snowflake(GUILD))->member_count, Equals(3));
+
+            // the update keeps the voice state, which it does not contain
+            auto updated = member_json(400, {200});
+            updated["guild_id"] = id(GUILD);
+            updated["nick"] = "nick";
+            updated["user"]["username"] = "renamed";
+            cache.update(Event::GUILD_MEMBER_UPDATE, updated);
+            const auto member = cache.member(Snowflake(GUILD), Snowflake(400));
+            AssertThat(member->nick, Equals("nick"));
+            AssertThat(member->deaf, IsTrue());
+            AssertThat(values(member->roles), Equals(std::vector<std::uint64_t>{200}));
+            AssertThat(cache.user(Snowflake(400))->username, Equals("renamed"));
+
+            cache.update(Event::GUILD_MEMBER_REMOVE, {{"guild_id", id(GUILD)}, {"user", {{"id", "300"}}}});
+            AssertThat(cache.member(Snowflake(GUILD), Snowflake(300)) == nullptr, IsTrue());
+            AssertThat(cache.guild(Snowflake(GUILD))->member_count, Equals(2));
+
+            cache.update(Event::GUILD_MEMBERS_CHUNK, {{"guild_id", id(GUILD)}, {"members", {member_json(500), member_json(501)}}});
+            AssertThat(cache.member(Snowflake(GUILD), Snowflake(501)) != nullptr, IsTrue());
+            AssertThat(cache.stats().members, Equals(4u));
+        });
+
+        it("keeps the channels and member count on GUILD_UPDATE", [&]{
+            Cache cache;
+            cache.update(Event::GUILD_CREATE, guild_json(GUILD, 2, 1, 3));
+
+            cache.update(Event::GUILD_UPDATE, {{"id", id(GUILD)}, {"name", "renamed"}, {"roles", {{{"id", "200"}, {"name", "renamed role"}}}}});
+
+            const auto guild = cache.guild(Snowflake(GUILD));
+            AssertThat(guild->name, Equals("renamed"));
+            AssertThat(values(guild->channels), Equals(std::vector<std::uint64_t>{100, 101}));
+            AssertThat(guild->member_count, Equals(3));
+            AssertThat(cache.role(Snowflake(200))->name, Equals("renamed role"));
+        });
+
+        it("only marks the guild unavailable on an outage", [&]{
+            Cache cache;
+            cache.update(Event::GUILD_CREATE, guild_json(GUILD, 2, 2, 3));
+
+            cache.update(Event::GUILD_DELETE, {{"id", id(GUILD)}, {"unavailable", true}});
+
+            const auto guild = cache.guild(Snowflake(GUILD));
+            AssertThat(guild != nullptr, IsTrue());
+            AssertThat(guild->unavailable, IsTrue());
+            AssertThat(cache.channel(Snowflake(100)) != nullptr, IsTrue());
+            AssertThat(cache.member(Snowflake(GUILD), Snowflake(300)) != nullptr, IsTrue());
+
+            const auto stats = cache.stats();
+            AssertThat(stats.channels, Equals(2u));
+            AssertThat(stats.roles, Equals(2u));
+            AssertThat(stats.members, Equals(3u));
+        });
+
+        it("removes the guild with its channels, roles and members", [&]{
+            Cache cache;
+            cache.update(Event::GUILD_CREATE, guild_json(GUILD, 2, 2, 3));
+            cache.update(Event::GUILD_CREATE, guild_json(OTHER_GUILD, 1, 1, 2));
+
+            // members removed before are not in the index anymore
+            cache.update(Event::GUILD_MEMBER_REMOVE, {{"guild_id", id(GUILD)}, {"user", {{"id", "301"}}}});
+            cache.update(Event::GUILD_DELETE, {{"id", id(GUILD)}});
+
+            AssertThat(cache.guild(Snowflake(GUILD)) == nullptr, IsTrue());
+            AssertThat(cache.channel(Snowflake(100)) == nullptr, IsTrue());
+            AssertThat(cache.role(Snowflake(201)) == nullptr, IsTrue());
+            AssertThat(cache.member(Snowflake(GUILD), Snowflake(300)) == nullptr, IsTrue());
+            AssertThat(cache.member(Snowflake(GUILD), Snowflake(302)) == nullptr, IsTrue());
+
+            // the other guild is untouched, users are shared between guilds and stay
+            AssertThat(cache.guild(Snowflake(OTHER_GUILD)) != nullptr, IsTrue());
+            AssertThat(cache.member(Snowflake(OTHER_GUILD), Snowflake(1301)) != nullptr, IsTrue());
+            AssertThat(cache.user(Snowflake(300)) != nullptr, IsTrue());
+
+            const auto stats = cache.stats();
+            AssertThat(stats.guilds, Equals(1u));
+            AssertThat(stats.channels, Equals(1u));
+            AssertThat(stats.roles, Equals(1u));
+            AssertThat(stats.members, Equals(2u));
+
+            // a guild joined again starts without the old members
+            cache.update(Event::GUILD_CREATE, guild_json(GUILD, 0, 0, 0));
+            AssertThat(cache.member(Snowflake(GUILD), Snowflake(300)) == nullptr, IsTrue());
+            cache.update(Event::GUILD_DELETE, {{"id", id(GUILD)}});
+            AssertThat(cache.stats().members, Equals(2u));
+        });
+
+        it("counts lookup hits and misses but not event updates", [&]{
+            Cache cache;
+            AssertThat(cache.guild(Snowflake(GUILD)) == nullptr, IsTrue());
+
+            cache.update(Event::GUILD_CREATE, guild_json(GUILD, 1, 1, 1));
+            cache.update(Event::CHANNEL_DELETE, {{"id", "100"}, {"guild_id", id(GUILD)}});
+            AssertThat(cache.stats().hits, Equals(0u));
+            AssertThat(cache.stats().misses, Equals(1u));
+
+            cache.guild(Snowflake(GUILD));
+            cache.role(Snowflake(200));
+            cache.member(Snowflake(GUILD), Snowflake(300));
+            cache.user(Snowflake(300));
+            cache.channel(Snowflake(100));
+            cache.member(Snowflake(GUILD), Snowflake(999));
+
+            const auto stats = cache.stats();
+            AssertThat(stats.hits, Equals(4u));
+            AssertThat(stats.misses, Equals(3u));
+            AssertThat(stats.warm_hits, Equals(0u));
+        });
+
+        it("clears all entities", [&]{
+            Cache cache;
+            cache.update(Event::GUILD_CREATE, guild_json(GUILD, 2, 2, 2));
+            cache.clear();
+
+            const auto stats = cache.stats();
+            AssertThat(stats.guilds + stats.channels + stats.roles + stats.members + stats.users, Equals(0u));
+            AssertThat(cache.member(Snowflake(GUILD), Snowflake(300)) == nullptr, IsTrue());
+        });
+    });
+
+    describe("Cache snapshot", []{
+        const auto path = temp_path("test.snapshot");
+
+        after_each([&]{
+            std::filesystem::remove(path);
+        });
+
+        it("answers lookups from a loaded snapshot", [&]{
+            {
+                Cache cache;
+                cache.update(Event::GUILD_CREATE, guild_json(GUILD, 2, 2, 2));
+                AssertThat(cache.save_snapshot(path), IsTrue());
+            }
+
+            Cache cache;
+            AssertThat(cache.load_snapshot(path), IsTrue());
+            AssertThat(cache.stats().snapshot, Equals(2u + 2u + 2u + 1u)); // users, channels, roles and the guild
+
+            AssertThat(cache.channel(Snowflake(101))->name, Equals("channel1"));
+            AssertThat(cache.guild(Snowflake(GUILD))->name, Equals("guild"));
+            AssertThat(cache.user(Snowflake(300))->username, Equals("user300"));
+
+            // members are not part of the snapshot
+            AssertThat(cache.member(Snowflake(GUILD), Snowflake(300)) == nullptr, IsTrue());
+
+            const auto stats = cache.stats();
+            AssertThat(stats.warm_hits, Equals(3u));
+            AssertThat(stats.channels, Equals(1u));
+
+            // the second lookup is answered from the cache
+            cache.channel(Snowflake(101));
+            AssertThat(cache.stats().warm_hits, Equals(3u));
+        });
+
+        it("never brings back entities removed after loading", [&]{
+            {
+                Cache cache;
+                cache.update(Event::GUILD_CREATE, guild_json(GUILD, 3, 2, 1));
+                cache.update(Event::GUILD_CREATE, guild_json(OTHER_GUILD, 1, 1, 1));
+                AssertThat(cache.save_snapshot(path), IsTrue());
+            }
+
+            Cache cache;
+            AssertThat(cache.load_snapshot(path), IsTrue());
+
+            // removed before their first lookup, only the snapshot knows them
+            cache.update(Event::CHANNEL_DELETE, {{"id", "100"}, {"guild_id", id(GUILD)}});
+            cache.update(Event::GUILD_ROLE_DELETE, {{"guild_id", id(GUILD)}, {"role_id", "201"}});
+            cache.update(Event::GUILD_DELETE, {{"id", id(OTHER_GUILD)}});
+
+            AssertThat(cache.channel(Snowflake(100)) == nullptr, IsTrue());
+            AssertThat(cache.role(Snowflake(201)) == nullptr, IsTrue());
+            AssertThat(cache.guild(Snowflake(OTHER_GUILD)) == nullptr, IsTrue());
+            AssertThat(cache.channel(Snowflake(1100)) == nullptr, IsTrue());
+            AssertThat(cache.role(Snowflake(1200)) == nullptr, IsTrue());
+
+            // the guild was taken from the snapshot and updated
+            AssertThat(values(cache.guild(Snowflake(GUILD))->channels), Equals(std::vector<std::uint64_t>{101, 102}));
+            AssertThat(values(cache.guild(Snowflake(GUILD))->roles), Equals(std::vector<std::uint64_t>{200}));
+            AssertThat(cache.channel(Snowflake(101)) != nullptr, IsTrue());
+
+            // a snapshot saved now does not contain the removed entities either
+            const auto next = temp_path("next.snapshot");
+            AssertThat(cache.save_snapshot(next), IsTrue());
+
+            Cache reloaded;
+            AssertThat(reloaded.load_snapshot(next), IsTrue());
+            AssertThat(reloaded.channel(Snowflake(100)) == nullptr, IsTrue());
+            AssertThat(reloaded.guild(Snowflake(OTHER_GUILD)) == nullptr, IsTrue());
+            AssertThat(reloaded.channel(Snowflake(102)) != nullptr, IsTrue());
+            std::filesystem::remove(next);
+        });
+
+        it("takes entities created again after a removal from the cache", [&]{
+            {
+                Cache cache;
+                cache.update(Event::GUILD_CREATE, guild_json(GUILD, 1, 0, 0));
+                AssertThat(cache.save_snapshot(path), IsTrue());
+            }
+
+            Cache cache;
+            AssertThat(cache.load_snapshot(path), IsTrue());
+            cache.update(Event::CHANNEL_DELETE, {{"id", "100"}});
+            cache.update(Event::CHANNEL_CREATE, {{"id", "100"}, {"type", 0}, {"name", "again"}});
+
+            AssertThat(cache.channel(Snowflake(100))->name, Equals("again"));
+            AssertThat(cache.stats().warm_hits, Equals(0u));
+        });
+
+        it("fails to load a missing snapshot", [&]{
+            Cache cache;
+            AssertThat(cache.load_snapshot(temp_path("missing.snapshot")), IsFalse());
+            AssertThat(cache.stats().snapshot, Equals(0u));
+        });
+    });
+});
@@ -0,0 +1,138 @@
+#include <bandit/bandit.h>
+
+#include <command_queue.hpp>
+
+#include <nlohmann/json.hpp>
+
+using namespace snowhouse;
+using namespace bandit;
+
+using Discord::Client;
+using Discord::CommandQueue;
+using json = nlohmann::json;
+
+namespace
+{
+
+using time_point = CommandQueue::clock::time_point;
+
+static CommandQueue::Command command(Client::GatewayOpcode op, json data = json::object())
+{
+    return {op, std::move(data), true};
+}
+
+/**
+ * Queues and sends as many commands as the queue allows at the given time.
+ */
+static std::size_t send(CommandQueue &queue, std::size_t count, time_point now)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        queue.push(command(Client::GatewayOpcode::REQUEST_GUILD_MEMBERS, {{"nonce", std::to_string(i)}}));
+    }
+
+    std::size_t sent = 0;
+    while (queue.pop(now))
+    {
+        ++sent;
+    }
+    return sent;
+}
+
+} // anonymous namespace
+
+go_bandit([]{
+    describe("CommandQueue", []{
+        const auto start = time_point() + std::chrono::hours(1);
+
+        it("holds back commands beyond the queue limit until the window slides", [&]{
+            CommandQueue queue;
+
+            AssertThat(send(queue, 116, start), Equals(CommandQueue::LIMIT - CommandQueue::RESERVED));
+            AssertThat(queue.size(), Equals(1u));
+            AssertThat(queue.next(), Equals(start + CommandQueue::WINDOW));
+
+            AssertThat(queue.pop(start + CommandQueue::WINDOW - std::chrono::milliseconds(1)).has_value(), IsFalse());
+            AssertThat(queue.pop(start + CommandQueue::WINDOW).has_value(), IsTrue());
+            AssertThat(queue.empty(), IsTrue());
+        });
+
+        it("sends commands as soon as the oldest send leaves the window", [&]{
+            CommandQueue queue;
+
+            // spread over the window, the first send expires first
+            for (std::size_t i = 0; i < CommandQueue::LIMIT - CommandQueue::RESERVED; ++i)
+            {
+                AssertThat(send(queue, 1, start + std::chrono::milliseconds(i)), Equals(1u));
+            }
+
+            AssertThat(send(queue, 2, start + std::chrono::seconds(1)), Equals(0u));
+            AssertThat(queue.next(), Equals(start + CommandQueue::WINDOW));
+            AssertThat(send(queue, 0, start + CommandQueue::WINDOW), Equals(1u));
+            AssertThat(queue.next(), Equals(start + CommandQueue::WINDOW + std::chrono::milliseconds(1)));
+            AssertThat(send(queue, 0, start + CommandQueue::WINDOW + std::chrono::milliseconds(1)), Equals(1u));
+        });
+
+        it("leaves slots for heartbeats and IDENTIFY at the queue limit", [&]{
+            CommandQueue queue;
+
+            AssertThat(send(queue, 200, start), Equals(CommandQueue::LIMIT - CommandQueue::RESERVED));
+
+            for (std::size_t i = 0; i < CommandQueue::RESERVED; ++i)
+            {
+                AssertThat(queue.acquire_priority(start), IsTrue());
+            }
+
+            // beyond the gateway limit
+            AssertThat(queue.acquire_priority(start), IsFalse());
+        });
+
+        it("replaces a queued presence update by the latest one", [&]{
+            CommandQueue queue;
+
+            AssertThat(queue.push(command(Client::GatewayOpcode::PRESENCE_UPDATE, {{"status", "idle"}})), IsTrue());
+            AssertThat(queue.push(command(Client::GatewayOpcode::REQUEST_GUILD_MEMBERS)), IsTrue());
+            AssertThat(queue.push(command(Client::GatewayOpcode::PRESENCE_UPDATE, {{"status", "dnd"}})), IsFalse());
+            AssertThat(queue.push(command(Client::GatewayOpcode::PRESENCE_UPDATE, {{"status", "online"}})), IsFalse());
+            AssertThat(queue.size(), Equals(2u));
+
+            // the latest presence takes the place of the first
+            auto first = queue.pop(start);
+            AssertThat(first->op, Equals(Client::GatewayOpcode::PRESENCE_UPDATE));
+            AssertThat(first->data["status"].get<std::string>(), Equals("online"));
+            AssertThat(queue.pop(start)->op, Equals(Client::GatewayOpcode::REQUEST_GUILD_MEMBERS));
+        });
+
+        it("replaces queued voice state updates of the same guild only", [&]{
+            CommandQueue queue;
+
+            AssertThat(queue.push(command(Client::GatewayOpcode::VOICE_STATE_UPDATE, {{"guild_id", "1"}, {"channel_id", "10"}})), IsTrue());
+            AssertThat(queue.push(command(Client::GatewayOpcode::VOICE_STATE_UPDATE, {{"guild_id", "2"}, {"channel_id", "20"}})), IsTrue());
+            AssertThat(queue.push(command(Client::GatewayOpcode::VOICE_STATE_UPDATE, {{"guild_id", "1"}, {"channel_id", nullptr}})), IsFalse());
+            AssertThat(queue.size(), Equals(2u));
+
+            AssertThat(queue.pop(start)->data["channel_id"].is_null(), IsTrue());
+            AssertThat(queue.pop(start)->data["guild_id"].get<std::string>(), Equals("2"));
+        });
+
+        it("never replaces other commands", [&]{
+            CommandQueue queue;
+
+            AssertThat(queue.push(command(Client::GatewayOpcode::REQUEST_GUILD_MEMBERS, {{"nonce", "1"}})), IsTrue());
+            AssertThat(queue.push(command(Client::GatewayOpcode::REQUEST_GUILD_MEMBERS, {{"nonce", "1"}})), IsTrue());
+            AssertThat(queue.size(), Equals(2u));
+        });
+
+        it("starts a new window on reconnect and keeps the queued commands", [&]{
+            CommandQueue queue;
+
+            AssertThat(send(queue, 130, start), Equals(CommandQueue::LIMIT - CommandQueue::RESERVED));
+            AssertThat(queue.size(), Equals(15u));
+
+            queue.reset();
+            AssertThat(queue.size(), Equals(15u));
+            AssertThat(queue.next(), Equals(time_point()));
+            AssertThat(send(queue, 0, start), Equals(15u));
+        });
+    });
+});
@@ -0,0 +1,135 @@
+#ifndef TESTS_CORPUS_HPP
+#define TESTS_CORPUS_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+
+namespace Corpus
+{
+    /**
+     * Generates a GUILD_CREATE gateway payload shaped like the ones Discord sends.
+     */
+    inline std::string guild_create(std::uint32_t members, std::uint32_t channels = 100, std::uint32_t roles = 50)
+    {
+        using json = nlohmann::json;
+
+        std::uint64_t snowflake = 81384788765712384ULL;
+        const auto id = [&]{ return std::to_string(snowflake += 4194304 + 17); };
+        const auto guild_id = id();
+
+        json d;
+        d["id"] = guild_id;
+        d["name"] = "御坂ーお姉さま benchmark guild";
+        d["icon"] = "a_1269e74af4df7417b13759eae50c83dc";
+        d["owner_id"] = id();
+        d["region"] = "europe";
+        d["member_count"] = members;
+        d["large"] = members > 250;
+        d["joined_at"] = "2020-06-01T12:34:56.789000+00:00";
+
+        for (std::uint32_t i = 0; i < roles; ++i)
+        {
+            d["roles"].push_back({
+                {"id", id()}, {"name", "role " + std::to_string(i)}, {"color", 3447003 + i},
+                {"hoist", i % 5 == 0}, {"position", i}, {"permissions", 104324673},
+                {"managed", false}, {"mentionable", i % 2 == 0},
+            });
+        }
+
+        for (std::uint32_t i = 0; i < channels; ++i)
+        {
+            d["channels"].push_back({
+                {"id", id()}, {"type", i % 10 == 0 ? 4 : (i % 7 == 0 ? 2 : 0)}, {"guild_id", guild_id},
+                {"position", i}, {"name", "channel-" + std::to_string(i)},
+                {"topic", "the topic of this channel with \"escapes\" and unicode ✨"},
+                {"nsfw", false}, {"last_message_id", id()}, {"rate_limit_per_user", 0},
+                {"permission_overwrites", json::array({{{"id", id()}, {"type", "role"}, {"allow", 1024}, {"deny", 0}}})},
+            });
+        }
+
+        for (std::uint32_t i = 0; i < members; ++i)
+        {
+            const auto user_id = id();
+            d["members"].push_back({
+                {"user", {{"id", user_id}, {"username", "user" + std::to_string(i)}, {"discriminator", "1337"},
+                          {"avatar", "8342729096ea3675442027381ff50dfe"}, {"bot", false}}},
+                {"nick", i % 3 == 0 ? json("nick " + std::to_string(i)) : json(nullptr)},
+                {"roles", json::array({d["roles"][i % roles]["id"]})},
+                {"joined_at", "2020-06-01T12:34:56.789000+00:00"}, {"deaf", false}, {"mute", false},
+            });
+            d["presences"].push_back({
+                {"user", {{"id", user_id}}}, {"status", i % 2 == 0 ? "online" : "idle"},
+                {"client_status", {{"desktop", "online"}}}, {"activities", json::array()},
+            });
+        }
+
+        return json{{"op", 0}, {"s", 2}, {"t", "GUILD_CREATE"}, {"d", std::move(d)}}.dump();
+    }
+
+    /**
+     * Generates a MESSAGE_CREATE gateway payload with an embed.
+     */
+    inline std::string message_create()
+    {
+        using json = nlohmann::json;
+
+        json d = {
+            {"id", "712381898487234612"}, {"channel_id", "712381898487234615"}, {"guild_id", "712381898487234600"},
+            {"author", {{"id", "81384788765712384"}, {"username", "misaka"}, {"discriminator", "1337"},
+                        {"avatar", "8342729096ea3675442027381ff50dfe"}, {"bot", false}}},
+            {"member", {{"roles", json::array({"712381898487234601", "712381898487234602"})}, {"nick", nullptr},
+                        {"joined_at", "2020-06-01T12:34:56.789000+00:00"}, {"deaf", false}, {"mute", false}}},
+            {"content", "a message with some text, a <@81384788765712384> mention and unicode ✨"},
+            {"timestamp", "2020-06-01T12:34:56.789000+00:00"}, {"edited_timestamp", nullptr},
+            {"tts", false}, {"mention_everyone", false}, {"mentions", json::array()}, {"mention_roles", json::array()},
+            {"attachments", json::array()}, {"pinned", false}, {"type", 0}, {"nonce", "712381898443423744"},
+            {"embeds", json::array({{{"title", "embed title"}, {"description", "embed description"}, {"type", "rich"}}})},
+        };
+
+        return json{{"op", 0}, {"s", 42}, {"t", "MESSAGE_CREATE"}, {"d", std::move(d)}}.dump();
+    }
+
+    /**
+     * Generates a PRESENCE_UPDATE gateway payload with an activity.
+     */
+    inline std::string presence_update()
+    {
+        using json = nlohmann::json;
+
+        json d = {
+            {"user", {{"id", "81384788765712384"}}}, {"guild_id", "712381898487234600"}, {"status", "online"},
+            {"roles", json::array({"712381898487234601"})}, {"client_status", {{"desktop", "online"}, {"mobile", "idle"}}},
+            {"activities", json::array({{{"name", "a game"}, {"type", 0}, {"created_at", 1591014896789}}})},
+        };
+
+        return json{{"op", 0}, {"s", 43}, {"t", "PRESENCE_UPDATE"}, {"d", std::move(d)}}.dump();
+    }
+
+    /**
+     * Loads recorded gateway payloads, one file per payload.
+     */
+    inline std::vector<std::string> load(const std::vector<std::string> &paths)
+    {
+        std::vector<std::string> payloads;
+
+        for (auto&& path : paths)
+        {
+            std::ifstream ifs(path, std::ios_base::in | std::ios_base::binary);
+            if (ifs.is_open())
+            {
+                std::stringstream ss;
+                ss << ifs.rdbuf();
+                payloads.emplace_back(ss.str());
+            }
+        }
+
+        return payloads;
+    }
+}
+
+#endif // TESTS_CORPUS_HPP
@@ -0,0 +1,144 @@
+#include <bandit/bandit.h>
+
+#include <envelope.hpp>
+#include <json_decoder.hpp>
+#include <utils/etf.hpp>
+
+#include <string>
+#include <memory>
+
+#include <nlohmann/json.hpp>
+
+using namespace snowhouse;
+using namespace bandit;
+
+using Discord::Client;
+using Discord::Envelope;
+using json = nlohmann::json;
+
+namespace
+{
+
+static Envelope scan(std::string_view frame)
+{
+    return Envelope::scan(frame, Client::Encoding::JSON);
+}
+
+static json data_of(const Envelope &envelope)
+{
+    static const auto decoder = Discord::JsonDecoder::create(Client::JsonBackend::NLOHMANN);
+    return envelope.data(*decoder);
+}
+
+} // anonymous namespace
+
+go_bandit([]{
+    describe("Envelope JSON scan", []{
+        it("scans the envelope fields", [&]{
+            const auto envelope = scan(R"({"t":"MESSAGE_CREATE","s":42,"op":0,"d":{"content":"hi"}})");
+            AssertThat(envelope.valid, IsTrue());
+            AssertThat(envelope.op == Client::GatewayOpcode::DISPATCH, IsTrue());
+            AssertThat(envelope.s, Equals(42u));
+            AssertThat(std::string(envelope.t), Equals("MESSAGE_CREATE"));
+            AssertThat(std::string(envelope.d), Equals(R"({"content":"hi"})"));
+        });
+
+        it("finds the fields in any order and with whitespace", [&]{
+            const auto envelope = scan(" {\n \"d\" : {\"a\":[1,2]} ,\t\"op\" : 0 , \"s\" : 7 , \"t\" : \"READY\" }\n");
+            AssertThat(envelope.valid, IsTrue());
+            AssertThat(envelope.s, Equals(7u));
+            AssertThat(std::string(envelope.t), Equals("READY"));
+            AssertThat(data_of(envelope), Equals(json({{"a", {1, 2}}})));
+        });
+
+        it("skips escaped quotes and backslash runs in strings", [&]{
+            const auto frame = R"({"d":{"content":"say \"hi\"","path":"C:\\","odd":"\\\"","run":"\\\\\\\\"},"op":0,"s":1,"t":"MESSAGE_CREATE"})";
+            const auto envelope = scan(frame);
+            AssertThat(envelope.valid, IsTrue());
+            AssertThat(std::string(envelope.t), Equals("MESSAGE_CREATE"));
+
+            const auto data = data_of(envelope);
+            AssertThat(data["content"].get<std::string>(), Equals("say \"hi\""));
+            AssertThat(data["path"].get<std::string>(), Equals("C:\\"));
+            AssertThat(data["odd"].get<std::string>(), Equals("\\\""));
+            AssertThat(data["run"].get<std::string>(), Equals("\\\\\\\\"));
+        });
+
+        it("ignores brackets inside strings", [&]{
+            const auto envelope = scan(R"({"op":0,"d":{"content":"}]{[ \"}\" ]","list":["]","}"]},"t":"MESSAGE_CREATE","s":3})");
+            AssertThat(envelope.valid, IsTrue());
+            AssertThat(envelope.s, Equals(3u));
+            AssertThat(std::string(envelope.t), Equals("MESSAGE_CREATE"));
+            AssertThat(data_of(envelope)["list"], Equals(json({"]", "}"})));
+        });
+
+        it("accepts null sequence and event names", [&]{
+            const auto envelope = scan(R"({"op":11,"s":null,"t":null,"d":null})");
+            AssertThat(envelope.valid, IsTrue());
+            AssertThat(envelope.op == Client::GatewayOpcode::HEARTBEAT_ACK, IsTrue());
+            AssertThat(envelope.s, Equals(0u));
+            AssertThat(envelope.t.empty(), IsTrue());
+            AssertThat(data_of(envelope).is_null(), IsTrue());
+        });
+
+        it("rejects a frame without op", [&]{
+            AssertThat(scan(R"({"s":1,"t":"READY","d":{}})").valid, IsFalse());
+            AssertThat(scan(R"({})").valid, IsFalse());
+        });
+
+        it("rejects empty and invalid values", [&]{
+            AssertThat(scan(R"({"op":,"d":{}})").valid, IsFalse());
+            AssertThat(scan(R"({"op":0,"s":})").valid, IsFalse());
+            AssertThat(scan(R"({"op":0,"d":})").valid, IsFalse());
+            AssertThat(scan(R"({"op":0,"unknown":,"d":{}})").valid, IsFalse());
+            AssertThat(scan(R"({"op":"0"})").valid, IsFalse());
+            AssertThat(scan(R"({"op":0,"s":-1})").valid, IsFalse());
+            AssertThat(scan(R"({"op":0,"t":READY})").valid, IsFalse());
+        });
+
+        it("rejects truncated frames", [&]{
+            const std::string frame = R"({"op":0,"s":12,"t":"GUILD_CREATE","d":{"name":"a \"quoted\" name","roles":[{"id":"1"}]}})";
+            AssertThat(scan(frame).valid, IsTrue());
+
+            for (std::size_t size = 0; size < frame.size(); ++size)
+            {
+                AssertThat(scan(std::string_view(frame).substr(0, size)).valid, IsFalse());
+            }
+        });
+    });
+
+    describe("Envelope ETF scan", []{
+        it("scans the envelope of an encoded payload", [&]{
+            const json data = {{"content", "hi"}, {"id", std::uint64_t(81384788765712384)}};
+            const auto frame = Utils::Etf::encode({{"op", 0}, {"s", 300}, {"t", "MESSAGE_CREATE"}, {"d", data}});
+
+            const auto envelope = Envelope::scan(frame, Client::Encoding::ETF);
+            AssertThat(envelope.valid, IsTrue());
+            AssertThat(envelope.op == Client::GatewayOpcode::DISPATCH, IsTrue());
+            AssertThat(envelope.s, Equals(300u));
+            AssertThat(std::string(envelope.t), Equals("MESSAGE_CREATE"));
+            AssertThat(data_of(envelope), Equals(data));
+        });
+
+        it("maps nil to no sequence and event name", [&]{
+            const auto frame = Utils::Etf::encode({{"op", 10}, {"s", nullptr}, {"t", nullptr}, {"d", {{"heartbeat_interval", 41250}}}});
+
+            const auto envelope = Envelope::scan(frame, Client::Encoding::ETF);
+            AssertThat(envelope.valid, IsTrue());
+            AssertThat(envelope.op == Client::GatewayOpcode::HELLO, IsTrue());
+            AssertThat(envelope.s, Equals(0u));
+            AssertThat(envelope.t.empty(), IsTrue());
+            AssertThat(data_of(envelope)["heartbeat_interval"].get<int>(), Equals(41250));
+        });
+
+        it("rejects payloads without op and truncated payloads", [&]{
+            AssertThat(Envelope::scan(Utils::Etf::encode({{"s", 1}, {"d", nullptr}}), Client::Encoding::ETF).valid, IsFalse());
+
+            const auto frame = Utils::Etf::encode({{"op", 0}, {"s", 1}, {"t", "READY"}, {"d", {{"v", 9}}}});
+            for (std::size_t size = 0; size < frame.size(); ++size)
+            {
+                AssertThat(Envelope::scan(std::string_view(frame).substr(0, size), Client::Encoding::ETF).valid, IsFalse());
+            }
+        });
+    });
+});
@@ -0,0 +1,136 @@
+#include <bandit/bandit.h>
+
+#include <utils/etf.hpp>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+
+#include <zlib.h>
+
+using namespace snowhouse;
+using namespace bandit;
+
+using json = nlohmann::json;
+
+namespace
+{
+
+static json round_trip(const json &value)
+{
+    return Utils::Etf::decode(Utils::Etf::encode(value));
+}
+
+/**
+ * Versioned term from raw bytes.
+ */
+static std::string term(std::initializer_list<std::uint8_t> bytes)
+{
+    return std::string(bytes.begin(), bytes.end());
+}
+
+/**
+ * Wraps an encoded term into a zlib compressed term.
+ */
+static std::string compress_term(const std::string &encoded)
+{
+    // the compressed data does not contain the version
+    const auto plain = encoded.substr(1);
+
+    uLongf size = compressBound(plain.size());
+    std::string deflated(size, '\0');
+    compress(reinterpret_cast<Bytef*>(deflated.data()), &size, reinterpret_cast<const Bytef*>(plain.data()), plain.size());
+    deflated.resize(size);
+
+    const auto length = static_cast<std::uint32_t>(plain.size());
+    return term({131, 80,
+        static_cast<std::uint8_t>(length >> 24), static_cast<std::uint8_t>(length >> 16),
+        static_cast<std::uint8_t>(length >> 8), static_cast<std::uint8_t>(length)}) + deflated;
+}
+
+} // anonymous namespace
+
+go_bandit([]{
+    describe("Etf", []{
+        it("round trips maps and lists", [&]{
+            const json value = {
+                {"op", 0},
+                {"t", "MESSAGE_CREATE"},
+                {"d", {
+                    {"content", "hello"},
+                    {"mentions", json::array({"a", "b"})},
+                    {"embeds", json::array()},
+                    {"nested", {{"list", {1, 2, 3}}}},
+                }},
+            };
+            AssertThat(round_trip(value), Equals(value));
+        });
+
+        it("round trips nil, true and false", [&]{
+            AssertThat(round_trip(nullptr).is_null(), IsTrue());
+            AssertThat(round_trip(true), Equals(json(true)));
+            AssertThat(round_trip(false), Equals(json(false)));
+        });
+
+        it("round trips floats", [&]{
+            AssertThat(round_trip(3.25), Equals(json(3.25)));
+            AssertThat(round_trip(-0.1), Equals(json(-0.1)));
+        });
+
+        it("round trips integers and big integers", [&]{
+            AssertThat(round_trip(7), Equals(json(7)));
+            AssertThat(round_trip(-7), Equals(json(-7)));
+            AssertThat(round_trip(70000), Equals(json(70000)));
+
+            // snowflakes exceed 32 bits
+            AssertThat(round_trip(std::uint64_t(81384788765712384)), Equals(json(std::uint64_t(81384788765712384))));
+            AssertThat(round_trip(std::uint64_t(0xFFFFFFFFFFFFFFFF)), Equals(json(std::uint64_t(0xFFFFFFFFFFFFFFFF))));
+            AssertThat(round_trip(std::int64_t(-1099511627776)), Equals(json(std::int64_t(-1099511627776))));
+        });
+
+        it("rejects big integers beyond 64 bits", [&]{
+            // SMALL_BIG_EXT with 9 digits
+            AssertThrows(Utils::Etf::error, Utils::Etf::decode(term({131, 110, 9, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1})));
+
+            // LARGE_BIG_EXT with 9 digits
+            AssertThrows(Utils::Etf::error, Utils::Etf::decode(term({131, 111, 0, 0, 0, 9, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1})));
+
+            // negative magnitude beyond INT64_MIN
+            AssertThrows(Utils::Etf::error, Utils::Etf::decode(term({131, 110, 8, 1, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF})));
+        });
+
+        it("decodes compressed terms", [&]{
+            json value = {{"d", {{"guilds", json::array()}}}};
+            for (int i = 0; i < 100; ++i)
+            {
+                value["d"]["guilds"].push_back({{"id", std::uint64_t(81384788765712384) + i}, {"unavailable", true}});
+            }
+
+            AssertThat(Utils::Etf::decode(compress_term(Utils::Etf::encode(value))), Equals(value));
+        });
+
+        it("rejects compressed terms of an implausible size", [&]{
+            AssertThrows(Utils::Etf::error, Utils::Etf::decode(term({131, 80, 0xFF, 0xFF, 0xFF, 0xFF})));
+
+            auto compressed = compress_term(Utils::Etf::encode({{"a", 1}}));
+            compressed[2] = static_cast<char>(0x10);
+            AssertThrows(Utils::Etf::error, Utils::Etf::decode(compressed));
+        });
+
+        it("rejects truncated input", [&]{
+            const auto encoded = Utils::Etf::encode({
+                {"s", 42},
+                {"t", "READY"},
+                {"d", {{"session_id", "abc"}, {"user", {{"id", std::uint64_t(81384788765712384)}}}}},
+                {"f", 1.5},
+            });
+
+            for (std::size_t size = 0; size < encoded.size(); ++size)
+            {
+                AssertThrows(Utils::Etf::error, Utils::Etf::decode(std::string_view(encoded).substr(0, size)));
+            }
+        });
+    });
+});
@@ -0,0 +1,352 @@
+#include <bandit/bandit.h>
+
+#include <executor.hpp>
+
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <future>
+
+using namespace snowhouse;
+using namespace bandit;
+
+using Discord::Executor;
+
+namespace
+{
+
+/**
+ * Waits until the condition holds, returns false after a timeout.
+ */
+static bool wait_until(const std::function<bool()> &condition)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!condition())
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+/**
+ * Occupies the worker of a single threaded executor until it is opened,
+ * tasks posted meanwhile stay pending.
+ */
+class Gate
+{
+public:
+    explicit Gate(Executor &executor)
+    {
+        executor.post(GATE_KEY, [this]{
+            this->_started = true;
+            this->_open.get_future().wait();
+        });
+        wait_until([this]{ return this->_started.load(); });
+    }
+
+    ~Gate()
+    {
+        this->open();
+    }
+
+    void open()
+    {
+        if (!this->_opened)
+        {
+            this->_opened = true;
+            this->_open.set_value();
+        }
+    }
+
+private:
+    static constexpr std::uint64_t GATE_KEY = 0xFFFFFFFF;
+
+    std::atomic<bool> _started = false;
+    std::promise<void> _open;
+    bool _opened = false;
+};
+
+} // anonymous namespace
+
+go_bandit([]{
+    describe("Executor", []{
+        it("runs tasks of a key in posting order across batches", [&]{
+            static constexpr std::size_t KEYS = 8;
+            static constexpr std::size_t TASKS = 1000;
+
+            std::vector<std::vector<std::size_t>> order(KEYS);
+            {
+                Executor executor(4);
+                for (std::size_t i = 0; i < TASKS; ++i)
+                {
+                    for (std::size_t key = 0; key < KEYS; ++key)
+                    {
+                        executor.post(key, [&order, key, i]{
+                            order[key].emplace_back(i);
+                        });
+                    }
+                }
+                executor.stop();
+            }
+
+            for (auto&& tasks : order)
+            {
+                AssertThat(tasks.size(), Equals(TASKS));
+                for (std::size_t i = 0; i < tasks.size(); ++i)
+                {
+                    AssertThat(tasks[i], Equals(i));
+                }
+            }
+        });
+
+        it("never runs tasks of a key concurrently", [&]{
+            std::atomic<int> running = 0;
+            std::atomic<bool> overlapped = false;
+
+            Executor executor(4);
+            for (std::size_t i = 0; i < 2000; ++i)
+            {
+                executor.post(42, [&]{
+                    if (running.fetch_add(1) != 0)
+                    {
+                        overlapped = true;
+                    }
+                    std::this_thread::yield();
+                    running.fetch_sub(1);
+                });
+            }
+            executor.stop();
+
+            AssertThat(overlapped.load(), IsFalse());
+            AssertThat(executor.stats().executed, Equals(2000u));
+        });
+
+        it("runs tasks of different keys in parallel", [&]{
+            std::atomic<int> arrived = 0;
+            std::atomic<int> met = 0;
+
+            // each task waits for the other one, which only works when they run at the same time
+            const auto task = [&]{
+                arrived.fetch_add(1);
+                if (wait_until([&]{ return arrived.load() == 2; }))
+                {
+                    met.fetch_add(1);
+                }
+            };
+
+            Executor executor(2);
+            executor.post(1, task);
+            executor.post(2, task);
+            executor.stop();
+
+            AssertThat(met.load(), Equals(2));
+        });
+
+        it("runs the pending tasks on stop", [&]{
+            std::atomic<std::size_t> executed = 0;
+
+            Executor executor(2);
+            for (std::size_t i = 0; i < 5000; ++i)
+            {
+                executor.post(i % 7, [&]{
+                    executed.fetch_add(1);
+                });
+            }
+            executor.stop();
+
+            AssertThat(executed.load(), Equals(5000u));
+            AssertThat(executor.stats().depth, Equals(0u));
+        });
+
+        it("discards tasks posted after stop", [&]{
+            std::atomic<bool> ran = false;
+
+            Executor executor(1);
+            executor.stop();
+            executor.post(1, [&]{ ran = true; });
+
+            AssertThat(ran.load(), IsFalse());
+            AssertThat(executor.stats().depth, Equals(0u));
+        });
+    });
+
+    describe("Executor policies", []{
+        it("drops the oldest droppable task when full", [&]{
+            std::vector<int> ran;
+
+            Executor executor(1);
+            executor.set_capacity(4);
+            {
+                Gate gate(executor);
+
+                for (int i = 1; i <= 5; ++i)
+                {
+                    executor.post(i, [&ran, i]{ ran.emplace_back(i); }, Executor::Policy::DROP_OLDEST);
+                }
+                AssertThat(executor.stats().depth, Equals(4u));
+                AssertThat(executor.stats().dropped, Equals(1u));
+            }
+            executor.stop();
+
+            AssertThat(ran, Equals(std::vector<int>{2, 3, 4, 5}));
+            AssertThat(executor.stats().depth, Equals(0u));
+        });
+
+        it("keeps blocking tasks and drops the new one instead", [&]{
+            std::vector<int> ran;
+
+            Executor executor(1);
+            executor.set_capacity(2);
+            {
+                Gate gate(executor);
+
+                executor.post(1, [&]{ ran.emplace_back(1); }, Executor::Policy::BLOCK);
+                executor.post(1, [&]{ ran.emplace_back(2); }, Executor::Policy::BLOCK);
+                executor.post(1, [&]{ ran.emplace_back(3); }, Executor::Policy::DROP_OLDEST);
+                AssertThat(executor.stats().dropped, Equals(1u));
+            }
+            executor.stop();
+
+            AssertThat(ran, Equals(std::vector<int>{1, 2}));
+            AssertThat(executor.stats().depth, Equals(0u));
+        });
+
+        it("runs only the latest pending task per coalescing key", [&]{
+            std::vector<int> ran;
+            const auto post = [&](Executor &executor, std::uint64_t id, int value) {
+                executor.post(7, [&ran, value]{ ran.emplace_back(value); }, Executor::Policy::COALESCE, {1, id});
+            };
+
+            Executor executor(1);
+            {
+                Gate gate(executor);
+
+                post(executor, 42, 1);
+                post(executor, 43, 10);
+                post(executor, 42, 2);
+                post(executor, 42, 3);
+                AssertThat(executor.stats().depth, Equals(2u));
+                AssertThat(executor.stats().coalesced, Equals(2u));
+            }
+            executor.stop();
+
+            // the latest task takes the place of the newest post
+            AssertThat(ran, Equals(std::vector<int>{10, 3}));
+            AssertThat(executor.stats().depth, Equals(0u));
+        });
+
+        it("runs one task of concurrent posts with the same coalescing key", [&]{
+            static constexpr int THREADS = 4;
+            static constexpr int POSTS = 500;
+
+            std::atomic<int> ran = 0;
+
+            Executor executor(1);
+            {
+                Gate gate(executor);
+
+                std::vector<std::thread> posters;
+                for (int t = 0; t < THREADS; ++t)
+                {
+                    posters.emplace_back([&]{
+                        for (int i = 0; i < POSTS; ++i)
+                        {
+                            executor.post(7, [&]{ ++ran; }, Executor::Policy::COALESCE, {1, 42});
+                        }
+                    });
+                }
+                for (auto&& poster : posters)
+                {
+                    poster.join();
+                }
+
+                AssertThat(executor.stats().depth, Equals(1u));
+                AssertThat(executor.stats().coalesced, Equals(std::uint64_t(THREADS * POSTS - 1)));
+            }
+            executor.stop();
+
+            AssertThat(ran.load(), Equals(1));
+            AssertThat(executor.stats().depth, Equals(0u));
+        });
+
+        it("supersedes a pending task when full without dropping another one", [&]{
+            std::vector<int> ran;
+
+            Executor executor(1);
+            executor.set_capacity(2);
+            {
+                Gate gate(executor);
+
+                executor.post(1, [&]{ ran.emplace_back(1); }, Executor::Policy::DROP_OLDEST);
+                executor.post(2, [&]{ ran.emplace_back(2); }, Executor::Policy::COALESCE, {1, 42});
+                executor.post(2, [&]{ ran.emplace_back(3); }, Executor::Policy::COALESCE, {1, 42});
+                AssertThat(executor.stats().dropped, Equals(0u));
+                AssertThat(executor.stats().depth, Equals(2u));
+            }
+            executor.stop();
+
+            AssertThat(ran, Equals(std::vector<int>{1, 3}));
+        });
+
+        it("makes blocking posts wait for space", [&]{
+            std::atomic<int> ran = 0;
+
+            Executor executor(1);
+            executor.set_capacity(1);
+
+            std::future<bool> waited;
+            {
+                Gate gate(executor);
+
+                executor.post(1, [&]{ ++ran; });
+                waited = std::async(std::launch::async, [&]{
+                    return executor.post(1, [&]{ ++ran; });
+                });
+
+                AssertThat(wait_until([&]{ return executor.stats().blocked == 1; }), IsTrue());
+                AssertThat(waited.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout, IsTrue());
+            }
+
+            // the pending task starts and frees the space
+            AssertThat(waited.get(), IsTrue());
+            executor.stop();
+
+            AssertThat(ran.load(), Equals(2));
+            AssertThat(executor.stats().depth, Equals(0u));
+        });
+
+        it("releases blocked posts on stop", [&]{
+            std::atomic<int> ran = 0;
+
+            Executor executor(1);
+            executor.set_capacity(1);
+
+            Gate gate(executor);
+            executor.post(1, [&]{ ++ran; });
+            auto waited = std::async(std::launch::async, [&]{
+                return executor.post(1, [&]{ ++ran; });
+            });
+            AssertThat(wait_until([&]{ return executor.stats().blocked == 1; }), IsTrue());
+
+            // stop waits for the gate, the blocked post returns before
+            auto stopped = std::async(std::launch::async, [&]{
+                executor.stop();
+            });
+            AssertThat(waited.wait_for(std::chrono::seconds(10)) == std::future_status::ready, IsTrue());
+            AssertThat(waited.get(), IsTrue());
+
+            gate.open();
+            stopped.get();
+
+            // the blocked task was discarded
+            AssertThat(ran.load(), Equals(1));
+            AssertThat(executor.stats().depth, Equals(0u));
+        });
+    });
+});
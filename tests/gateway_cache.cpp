@@ -0,0 +1,223 @@
+#include <bandit/bandit.h>
+
+#include <gateway_cache.hpp>
+
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <chrono>
+
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+using namespace snowhouse;
+using namespace bandit;
+
+using Discord::Gateway;
+using Discord::GatewayCache;
+using json = nlohmann::json;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+using milliseconds = std::chrono::milliseconds;
+
+// slack for the time passing between writing the file and the call under test
+static constexpr auto SLACK = milliseconds(5000);
+
+static constexpr auto DAY = std::chrono::duration_cast<milliseconds>(std::chrono::hours(24));
+
+static std::string temp_path(const std::string &name)
+{
+    return (std::filesystem::temp_directory_path() / ("discord-gateway-" + std::to_string(::getpid()) + "-" + name)).string();
+}
+
+static std::string read_file(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string &path, const std::string &data)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+static std::int64_t unix_ms(std::chrono::system_clock::duration from_now)
+{
+    return std::chrono::duration_cast<milliseconds>((std::chrono::system_clock::now() + from_now).time_since_epoch()).count();
+}
+
+/**
+ * Writes a cache file whose session start limit window ends at now + reset_in.
+ */
+static void write_cache(const std::string &path, std::uint32_t total, std::uint32_t remaining,
+                        std::chrono::system_clock::duration reset_in, std::uint32_t borrowed)
+{
+    write_file(path, json({
+        {"version", 1},
+        {"url", "wss://gateway.discord.gg"},
+        {"shards", 4},
+        {"session_start_limit", {
+            {"total", total},
+            {"remaining", remaining},
+            {"max_concurrency", 1},
+            {"reset_at", unix_ms(reset_in)},
+            {"borrowed", borrowed},
+        }},
+        {"fetched", unix_ms(0s)},
+    }).dump());
+}
+
+static bool around(milliseconds value, milliseconds expected)
+{
+    return value <= expected && value > expected - SLACK;
+}
+
+} // anonymous namespace
+
+go_bandit([]{
+    describe("GatewayCache", []{
+        const auto path = temp_path("gateway.json");
+
+        after_each([&]{
+            std::filesystem::remove(path);
+        });
+
+        it("round trips a stored response through the file", [&]{
+            Gateway gateway;
+            gateway.url = "wss://gateway.discord.gg";
+            gateway.shards = 16;
+            gateway.limit = {1000, 990, 3600000, 16};
+
+            GatewayCache(path, 1h).store(gateway);
+
+            GatewayCache cache(path, 1h);
+            const auto loaded = cache.load();
+            AssertThat(loaded.has_value(), IsTrue());
+            AssertThat(loaded->url, Equals(gateway.url));
+            AssertThat(loaded->shards, Equals(16u));
+            AssertThat(loaded->limit.total, Equals(1000u));
+            AssertThat(loaded->limit.remaining, Equals(990u));
+            AssertThat(loaded->limit.max_concurrency, Equals(16u));
+            AssertThat(around(milliseconds(loaded->limit.reset_after), 1h), IsTrue());
+            AssertThat(cache.fresh(), IsTrue());
+
+            AssertThat(GatewayCache(path, 0s).fresh(), IsFalse());
+        });
+
+        it("keeps the response in memory without a path", [&]{
+            Gateway gateway;
+            gateway.url = "wss://gateway.discord.gg";
+            gateway.shards = 1;
+            gateway.limit = {1000, 1000, 1000, 1};
+
+            GatewayCache cache("", 1h);
+            AssertThat(cache.load().has_value(), IsFalse());
+            cache.store(gateway);
+            AssertThat(cache.load()->url, Equals(gateway.url));
+        });
+
+        it("ignores missing, invalid and other version files", [&]{
+            AssertThat(GatewayCache(path, 1h).load().has_value(), IsFalse());
+
+            write_file(path, "{\"version\":1");
+            AssertThat(GatewayCache(path, 1h).load().has_value(), IsFalse());
+
+            write_file(path, R"({"version":1,"url":"wss://gateway.discord.gg","shards":1})");
+            AssertThat(GatewayCache(path, 1h).load().has_value(), IsFalse());
+
+            write_cache(path, 1000, 1000, 1h, 0);
+            auto j = json::parse(read_file(path));
+            j["version"] = 2;
+            write_file(path, j.dump());
+            AssertThat(GatewayCache(path, 1h).load().has_value(), IsFalse());
+        });
+
+        it("takes identifies from the budget and persists it", [&]{
+            write_cache(path, 1000, 2, 1h, 0);
+            {
+                GatewayCache cache(path, 1h);
+                AssertThat(cache.load().has_value(), IsTrue());
+                AssertThat(cache.consume_identify(), Equals(0ms));
+            }
+
+            GatewayCache cache(path, 1h);
+            AssertThat(cache.load()->limit.remaining, Equals(1u));
+            AssertThat(cache.consume_identify(), Equals(0ms));
+            AssertThat(cache.load()->limit.remaining, Equals(0u));
+        });
+
+        it("delays identifies into the following windows when exhausted", [&]{
+            write_cache(path, 2, 0, 1h, 0);
+
+            GatewayCache cache(path, 1h);
+            AssertThat(cache.load().has_value(), IsTrue());
+
+            // the next window takes two identifies, the ones after wait for the window after it
+            AssertThat(around(cache.consume_identify(), 1h), IsTrue());
+            AssertThat(around(cache.consume_identify(), 1h), IsTrue());
+            AssertThat(around(cache.consume_identify(), 1h + DAY), IsTrue());
+            AssertThat(around(cache.consume_identify(), 1h + DAY), IsTrue());
+            AssertThat(around(cache.consume_identify(), 1h + 2 * DAY), IsTrue());
+
+            // the borrowed identifies are persisted
+            AssertThat(json::parse(read_file(path))["session_start_limit"]["borrowed"].get<int>(), Equals(5));
+        });
+
+        it("reduces the budget of the next window by the borrowed identifies", [&]{
+            write_cache(path, 2, 0, -1h, 3);
+
+            GatewayCache cache(path, 1h);
+            const auto loaded = cache.load();
+            AssertThat(loaded->limit.remaining, Equals(0u));
+            AssertThat(around(milliseconds(loaded->limit.reset_after), DAY - 1h), IsTrue());
+
+            // one identify is still borrowed from the window after, a second one fits into it
+            AssertThat(around(cache.consume_identify(), DAY - 1h), IsTrue());
+            AssertThat(around(cache.consume_identify(), 2 * DAY - 1h), IsTrue());
+        });
+
+        it("starts with the budget left by borrowed identifies after several windows passed", [&]{
+            // the identifies borrowed into the window that passed are gone
+            write_cache(path, 2, 0, -25h, 2);
+            AssertThat(GatewayCache(path, 1h).load()->limit.remaining, Equals(2u));
+
+            // the ones borrowed beyond it still count for the current window
+            write_cache(path, 2, 0, -25h, 3);
+            GatewayCache cache(path, 1h);
+            const auto loaded = cache.load();
+            AssertThat(loaded->limit.remaining, Equals(1u));
+            AssertThat(around(milliseconds(loaded->limit.reset_after), DAY - 1h), IsTrue());
+            AssertThat(cache.consume_identify(), Equals(0ms));
+            AssertThat(json::parse(read_file(path))["session_start_limit"]["borrowed"].get<int>(), Equals(0));
+
+            // two windows passed, each took two
+            write_cache(path, 2, 0, -49h, 4);
+            AssertThat(GatewayCache(path, 1h).load()->limit.remaining, Equals(2u));
+            write_cache(path, 2, 0, -49h, 9);
+            AssertThat(GatewayCache(path, 1h).load()->limit.remaining, Equals(0u));
+        });
+
+        it("replaces the tracked budget with a stored response", [&]{
+            write_cache(path, 2, 0, 1h, 4);
+
+            GatewayCache cache(path, 1h);
+            AssertThat(cache.load().has_value(), IsTrue());
+
+            Gateway gateway;
+            gateway.url = "wss://gateway.discord.gg";
+            gateway.shards = 4;
+            gateway.limit = {2, 1, 600000, 1};
+            cache.store(gateway);
+
+            AssertThat(cache.consume_identify(), Equals(0ms));
+            AssertThat(around(cache.consume_identify(), 10min), IsTrue());
+            AssertThat(json::parse(read_file(path))["session_start_limit"]["borrowed"].get<int>(), Equals(1));
+        });
+    });
+});
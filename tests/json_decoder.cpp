@@ -0,0 +1,133 @@
+#include <bandit/bandit.h>
+
+#include <json_decoder.hpp>
+
+#include "corpus.hpp"
+
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+using namespace snowhouse;
+using namespace bandit;
+
+using json = nlohmann::json;
+
+namespace
+{
+
+/**
+ * Whether both trees are equal including the value types, json::operator==
+ * treats signed and unsigned numbers of the same value as equal.
+ */
+static bool same_tree(const json &a, const json &b)
+{
+    if (a.type() != b.type() || a.size() != b.size())
+    {
+        return false;
+    }
+
+    if (a.is_object())
+    {
+        for (auto it = a.begin(); it != a.end(); ++it)
+        {
+            const auto other = b.find(it.key());
+            if (other == b.end() || !same_tree(*it, *other))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    if (a.is_array())
+    {
+        for (std::size_t i = 0; i < a.size(); ++i)
+        {
+            if (!same_tree(a[i], b[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    return a == b;
+}
+
+static std::vector<std::string> corpus()
+{
+    return {
+        Corpus::guild_create(1000),
+        Corpus::message_create(),
+        Corpus::presence_update(),
+        R"({"op":0,"s":1234567890123,"t":"TEST","d":{"zero":0,"negative":-42,"min":-9223372036854775808,
+            "max_signed":9223372036854775807,"max":18446744073709551615,"float":1.5,"exp":1e3,
+            "text":"escaped \"quotes\" é and 😀","null":null,"flags":[true,false]}})",
+    };
+}
+
+} // anonymous namespace
+
+go_bandit([]{
+    describe("JsonDecoder", []{
+        it("decodes the same tree with every backend", [&]{
+            auto reference = Discord::JsonDecoder::create(Discord::Client::JsonBackend::NLOHMANN);
+
+            for (auto backend : {Discord::Client::JsonBackend::NLOHMANN, Discord::Client::JsonBackend::SIMDJSON})
+            {
+                if (!Discord::JsonDecoder::available(backend))
+                {
+                    continue;
+                }
+
+                auto decoder = Discord::JsonDecoder::create(backend);
+                for (auto&& payload : corpus())
+                {
+                    AssertThat(same_tree(decoder->decode(payload), reference->decode(payload)), IsTrue());
+                }
+            }
+        });
+
+        it("keeps non-negative integers unsigned", [&]{
+            for (auto backend : {Discord::Client::JsonBackend::NLOHMANN, Discord::Client::JsonBackend::SIMDJSON})
+            {
+                if (!Discord::JsonDecoder::available(backend))
+                {
+                    continue;
+                }
+
+                const auto j = Discord::JsonDecoder::create(backend)->decode(R"({"a":1234567890123,"b":-1})");
+                AssertThat(j["a"].is_number_unsigned(), IsTrue());
+                AssertThat(j["b"].is_number_unsigned(), IsFalse());
+                AssertThat(j["b"].get<std::int64_t>(), Equals(-1));
+            }
+        });
+
+        it("keeps the last value of duplicate keys", [&]{
+            for (auto backend : {Discord::Client::JsonBackend::NLOHMANN, Discord::Client::JsonBackend::SIMDJSON})
+            {
+                if (!Discord::JsonDecoder::available(backend))
+                {
+                    continue;
+                }
+
+                const auto j = Discord::JsonDecoder::create(backend)->decode(R"({"a":1,"b":{"c":"x","c":"y"},"a":2})");
+                AssertThat(j.size(), Equals(2u));
+                AssertThat(j["a"].get<int>(), Equals(2));
+                AssertThat(j["b"], Equals(json({{"c", "y"}})));
+            }
+        });
+
+        it("throws on invalid input", [&]{
+            for (auto backend : {Discord::Client::JsonBackend::NLOHMANN, Discord::Client::JsonBackend::SIMDJSON})
+            {
+                if (Discord::JsonDecoder::available(backend))
+                {
+                    AssertThrows(Discord::JsonDecoder::error, Discord::JsonDecoder::create(backend)->decode(R"({"a":)"));
+                }
+            }
+        });
+    });
+});
@@ -0,0 +1,190 @@
+#include <bandit/bandit.h>
+
+#include <metrics.hpp>
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <set>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+using namespace snowhouse;
+using namespace bandit;
+
+using Discord::Event;
+using Discord::Metrics;
+using Histogram = Discord::Metrics::Histogram;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+static std::set<std::string> lines_of(const std::string &text)
+{
+    std::set<std::string> lines;
+    std::istringstream in(text);
+    for (std::string line; std::getline(in, line);)
+    {
+        lines.insert(line);
+    }
+    return lines;
+}
+
+} // anonymous namespace
+
+go_bandit([]{
+    describe("Metrics::Histogram", []{
+        it("keeps values below 16 in buckets of their own", [&]{
+            for (std::uint64_t ns = 0; ns < 16; ++ns)
+            {
+                AssertThat(Histogram::bucket_of(ns), Equals(ns));
+                AssertThat(Histogram::upper_bound(ns), Equals(ns));
+            }
+        });
+
+        it("splits every power of two into 8 sub-buckets", [&]{
+            AssertThat(Histogram::bucket_of(16), Equals(16u));
+            AssertThat(Histogram::bucket_of(17), Equals(16u));
+            AssertThat(Histogram::bucket_of(18), Equals(17u));
+            AssertThat(Histogram::bucket_of(31), Equals(23u));
+            AssertThat(Histogram::bucket_of(32), Equals(24u));
+            AssertThat(Histogram::upper_bound(16), Equals(17u));
+            AssertThat(Histogram::upper_bound(24), Equals(35u));
+
+            AssertThat(Histogram::bucket_of(UINT64_MAX), Equals(Histogram::BUCKETS - 1));
+            AssertThat(Histogram::upper_bound(Histogram::BUCKETS - 1), Equals(UINT64_MAX));
+        });
+
+        it("has adjacent buckets within 12.5% of their values", [&]{
+            std::uint64_t lower = 0;
+            for (std::size_t bucket = 0; bucket < Histogram::BUCKETS; ++bucket)
+            {
+                const auto upper = Histogram::upper_bound(bucket);
+                AssertThat(Histogram::bucket_of(lower), Equals(bucket));
+                AssertThat(Histogram::bucket_of(upper), Equals(bucket));
+                AssertThat(static_cast<double>(upper - lower), IsLessThanOrEqualTo(lower * 0.125));
+
+                lower = upper + 1;
+            }
+        });
+
+        it("takes percentiles from the bucket bounds capped by the maximum", [&]{
+            Histogram histogram;
+            AssertThat(histogram.snapshot().percentile(0.5), Equals(0u));
+
+            for (int i = 0; i < 90; ++i)
+            {
+                histogram.record(100ns);
+            }
+            for (int i = 0; i < 10; ++i)
+            {
+                histogram.record(10000ns);
+            }
+            histogram.record(-5ns);
+
+            const auto snapshot = histogram.snapshot();
+            AssertThat(snapshot.count, Equals(101u));
+            AssertThat(snapshot.sum, Equals(90u * 100 + 10u * 10000));
+            AssertThat(snapshot.max, Equals(10000u));
+
+            AssertThat(snapshot.percentile(0), Equals(0u));
+            AssertThat(snapshot.percentile(0.5), Equals(Histogram::upper_bound(Histogram::bucket_of(100))));
+            AssertThat(snapshot.percentile(0.9), Equals(Histogram::upper_bound(Histogram::bucket_of(100))));
+            AssertThat(snapshot.percentile(0.95), Equals(10000u));
+            AssertThat(snapshot.percentile(1), Equals(10000u));
+        });
+
+        it("sums the samples of more threads than stripes", [&]{
+            Histogram histogram;
+            Metrics::Counter counter;
+
+            std::vector<std::thread> threads;
+            for (std::size_t t = 0; t < 2 * Metrics::STRIPES; ++t)
+            {
+                threads.emplace_back([&, t]{
+                    for (int i = 0; i < 1000; ++i)
+                    {
+                        histogram.record(static_cast<std::uint64_t>(t + 1));
+                        counter.add();
+                    }
+                });
+            }
+            for (auto&& thread : threads)
+            {
+                thread.join();
+            }
+
+            const auto snapshot = histogram.snapshot();
+            AssertThat(snapshot.count, Equals(2 * Metrics::STRIPES * 1000));
+            AssertThat(snapshot.max, Equals(2 * Metrics::STRIPES));
+            AssertThat(snapshot.buckets[1], Equals(1000u));
+            AssertThat(counter.value(), Equals(2 * Metrics::STRIPES * 1000));
+        });
+    });
+
+    describe("Metrics", []{
+        it("counts frames by opcode and dispatches by event", [&]{
+            Metrics metrics;
+            metrics.record_frame(0, Event::MESSAGE_CREATE);
+            metrics.record_frame(0, Event::MESSAGE_CREATE);
+            metrics.record_frame(11, Event::UNKNOWN);
+            metrics.record_frame(42, Event::UNKNOWN);
+            metrics.record_frame(0xFFFF, Event::UNKNOWN);
+
+            AssertThat(metrics.frames(0), Equals(2u));
+            AssertThat(metrics.frames(11), Equals(1u));
+            AssertThat(metrics.frames(Metrics::OPCODES), Equals(2u));
+            AssertThat(metrics.frames(42), Equals(2u));
+            AssertThat(metrics.events(Event::MESSAGE_CREATE), Equals(2u));
+            AssertThat(metrics.events(Event::UNKNOWN), Equals(0u));
+        });
+
+        it("exports counters and summaries in the Prometheus format", [&]{
+            Metrics metrics;
+            metrics.record_frame(0, Event::MESSAGE_CREATE);
+            metrics.record_frame(42, Event::UNKNOWN);
+            metrics.record_heartbeat(2ms);
+            metrics.record_handler(Event::READY, 1500us);
+
+            const auto lines = lines_of(metrics.prometheus());
+            AssertThat(lines.count("# TYPE discord_gateway_frames_total counter"), Equals(1u));
+            AssertThat(lines.count("discord_gateway_frames_total{opcode=\"INVALID\"} 1"), Equals(1u));
+            AssertThat(lines.count("discord_gateway_events_total{event=\"MESSAGE_CREATE\"} 1"), Equals(1u));
+
+            // a single sample is every quantile
+            AssertThat(lines.count("# TYPE discord_gateway_heartbeat_rtt_seconds summary"), Equals(1u));
+            for (auto&& quantile : {"0.5", "0.9", "0.99", "0.999"})
+            {
+                AssertThat(lines.count(std::string("discord_gateway_heartbeat_rtt_seconds{quantile=\"") + quantile + "\"} 0.002"), Equals(1u));
+                AssertThat(lines.count(std::string("discord_handler_seconds{event=\"READY\",quantile=\"") + quantile + "\"} 0.0015"), Equals(1u));
+            }
+            AssertThat(lines.count("discord_gateway_heartbeat_rtt_seconds_sum 0.002"), Equals(1u));
+            AssertThat(lines.count("discord_gateway_heartbeat_rtt_seconds_count 1"), Equals(1u));
+            AssertThat(lines.count("discord_handler_seconds_sum{event=\"READY\"} 0.0015"), Equals(1u));
+            AssertThat(lines.count("discord_handler_seconds_count{event=\"READY\"} 1"), Equals(1u));
+
+            // summaries without samples are exported empty, handlers which never ran not at all
+            AssertThat(lines.count("discord_gateway_parse_seconds{quantile=\"0.5\"} 0"), Equals(1u));
+            AssertThat(lines.count("discord_gateway_parse_seconds_count 0"), Equals(1u));
+            AssertThat(lines.count("discord_handler_seconds_count{event=\"MESSAGE_CREATE\"} 0"), Equals(0u));
+        });
+
+        it("escapes the route labels of REST requests", [&]{
+            Metrics metrics;
+            metrics.record_rest("GET /a\"b\\c\nd", 1ms);
+            metrics.record_rest("GET /channels/:major", 1ms);
+            metrics.record_rest("GET /channels/:major", 3ms);
+
+            const auto latency = metrics.rest_latency();
+            AssertThat(latency.size(), Equals(2u));
+            AssertThat(latency.at("GET /channels/:major").count, Equals(2u));
+
+            const auto lines = lines_of(metrics.prometheus());
+            AssertThat(lines.count("discord_rest_request_seconds_count{route=\"GET /a\\\"b\\\\c\\nd\"} 1"), Equals(1u));
+            AssertThat(lines.count("discord_rest_request_seconds_count{route=\"GET /channels/:major\"} 2"), Equals(1u));
+            AssertThat(lines.count("discord_rest_request_seconds{route=\"GET /channels/:major\",quantile=\"0.999\"} 0.003"), Equals(1u));
+        });
+    });
+});
@@ -0,0 +1,194 @@
+#ifndef TESTS_MOCK_HTTP_SERVER_HPP
+#define TESTS_MOCK_HTTP_SERVER_HPP
+
+#include <string>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+#include <cstdlib>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+/**
+ * Minimal keep-alive HTTP/1.1 server on 127.0.0.1 for tests.
+ * Every connection is served on its own thread by the given handler.
+ */
+class MockHttpServer
+{
+public:
+    struct Request
+    {
+        std::string method;
+        std::string path;
+        std::map<std::string, std::string> headers;
+        std::string body;
+    };
+
+    struct Response
+    {
+        int status = 200;
+        std::map<std::string, std::string> headers;
+        std::string body;
+    };
+
+    using Handler = std::function<Response(const Request&)>;
+
+    MockHttpServer(Handler handler)
+        : _handler(std::move(handler))
+    {
+        this->_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+
+        int yes = 1;
+        ::setsockopt(this->_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = ::inet_addr("127.0.0.1");
+        addr.sin_port = 0;
+
+        socklen_t len = sizeof(addr);
+        if (::bind(this->_fd, reinterpret_cast<sockaddr*>(&addr), len) != 0 ||
+            ::listen(this->_fd, 16) != 0 ||
+            ::getsockname(this->_fd, reinterpret_cast<sockaddr*>(&addr), &len) != 0)
+        {
+            ::close(this->_fd);
+            throw std::runtime_error("failed to start the mock HTTP server");
+        }
+
+        this->_port = ntohs(addr.sin_port);
+        this->_thr = std::thread(&MockHttpServer::accept, this);
+    }
+
+    ~MockHttpServer()
+    {
+        this->_running = false;
+        ::shutdown(this->_fd, SHUT_RDWR);
+        ::close(this->_fd);
+        this->_thr.join();
+
+        std::lock_guard lk{this->_mutex};
+        for (auto&& client : this->_clients)
+        {
+            ::shutdown(client.first, SHUT_RDWR);
+        }
+        for (auto&& client : this->_clients)
+        {
+            client.second.join();
+            ::close(client.first);
+        }
+    }
+
+    inline std::string url() const
+    {
+        return "http://127.0.0.1:" + std::to_string(this->_port);
+    }
+
+    /**
+     * Amount of accepted connections.
+     */
+    inline std::size_t connections() const
+    {
+        return this->_connections;
+    }
+
+private:
+    Handler _handler;
+    int _fd = -1;
+    int _port = 0;
+    std::atomic<bool> _running = true;
+    std::atomic<std::size_t> _connections = 0;
+    std::thread _thr;
+    std::mutex _mutex;
+    std::vector<std::pair<int, std::thread>> _clients;
+
+    void accept()
+    {
+        while (this->_running)
+        {
+            const auto fd = ::accept(this->_fd, nullptr, nullptr);
+            if (fd < 0)
+            {
+                return;
+            }
+
+            ++this->_connections;
+
+            std::lock_guard lk{this->_mutex};
+            this->_clients.emplace_back(fd, std::thread(&MockHttpServer::serve, this, fd));
+        }
+    }
+
+    void serve(int fd)
+    {
+        std::string buffer;
+        char tmp[4096];
+
+        for (;;)
+        {
+            std::size_t head_end;
+            while ((head_end = buffer.find("\r\n\r\n")) == std::string::npos)
+            {
+                const auto size = ::recv(fd, tmp, sizeof(tmp), 0);
+                if (size <= 0)
+                {
+                    return;
+                }
+                buffer.append(tmp, static_cast<std::size_t>(size));
+            }
+
+            Request req;
+            const auto line_end = buffer.find("\r\n");
+            const auto line = buffer.substr(0, line_end);
+            const auto sp1 = line.find(' ');
+            const auto sp2 = line.find(' ', sp1 + 1);
+            req.method = line.substr(0, sp1);
+            req.path = line.substr(sp1 + 1, sp2 - sp1 - 1);
+
+            std::size_t pos = line_end + 2;
+            while (pos < head_end)
+            {
+                const auto end = buffer.find("\r\n", pos);
+                const auto header = buffer.substr(pos, end - pos);
+                const auto colon = header.find(':');
+                req.headers[header.substr(0, colon)] = header.substr(header.find_first_not_of(' ', colon + 1));
+                pos = end + 2;
+            }
+
+            const auto length = std::strtoull(req.headers["Content-Length"].c_str(), nullptr, 10);
+            while (buffer.size() < head_end + 4 + length)
+            {
+                const auto size = ::recv(fd, tmp, sizeof(tmp), 0);
+                if (size <= 0)
+                {
+                    return;
+                }
+                buffer.append(tmp, static_cast<std::size_t>(size));
+            }
+            req.body = buffer.substr(head_end + 4, length);
+            buffer.erase(0, head_end + 4 + length);
+
+            const auto res = this->_handler(req);
+
+            std::string out = "HTTP/1.1 " + std::to_string(res.status) + " Mock\r\n";
+            for (auto&& header : res.headers)
+            {
+                out += header.first + ": " + header.second + "\r\n";
+            }
+            out += "Content-Length: " + std::to_string(res.body.size()) + "\r\n\r\n" + res.body;
+
+            if (::send(fd, out.data(), out.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(out.size()))
+            {
+                return;
+            }
+        }
+    }
+};
+
+#endif // TESTS_MOCK_HTTP_SERVER_HPP
@@ -0,0 +1,108 @@
+#include <bandit/bandit.h>
+
+#include <payload_writer.hpp>
+#include <utils/etf.hpp>
+
+#include <string>
+#include <cstdint>
+#include <limits>
+
+#include <nlohmann/json.hpp>
+
+using namespace snowhouse;
+using namespace bandit;
+
+using Discord::Client;
+using Discord::PayloadWriter;
+using json = nlohmann::json;
+
+namespace
+{
+
+// sequence numbers around the boundaries of the encodings
+static constexpr std::int32_t SEQUENCES[] = {-1, 0, 255, 256, std::numeric_limits<std::int32_t>::max()};
+
+static json decode(Client::Encoding encoding, const std::string &frame)
+{
+    return encoding == Client::Encoding::ETF ? Utils::Etf::decode(frame) : json::parse(frame);
+}
+
+static json payload(Client::GatewayOpcode op, const json &data)
+{
+    return {{"op", static_cast<std::uint32_t>(op)}, {"d", data}};
+}
+
+} // anonymous namespace
+
+go_bandit([]{
+    for (auto encoding : {Client::Encoding::JSON, Client::Encoding::ETF})
+    {
+        describe(encoding == Client::Encoding::JSON ? "PayloadWriter with JSON" : "PayloadWriter with ETF", [=]{
+            const json identify = {
+                {"token", "token"},
+                {"intents", 513},
+                {"properties", {{"os", "linux"}, {"browser", "discord"}, {"device", "discord"}}},
+                {"shard", {1, 4}},
+            };
+
+            it("writes heartbeats with the sequence number or null", [&]{
+                PayloadWriter writer(encoding);
+                for (auto seq : SEQUENCES)
+                {
+                    const auto expected = payload(Client::GatewayOpcode::HEARTBEAT, seq < 0 ? json() : json(seq));
+                    AssertThat(decode(encoding, writer.heartbeat(seq)), Equals(expected));
+                }
+            });
+
+            it("writes the prepared identify", [&]{
+                PayloadWriter writer(encoding);
+                writer.prepare(identify, "token");
+
+                // other frames don't touch it
+                writer.heartbeat(1);
+                AssertThat(decode(encoding, writer.identify()), Equals(payload(Client::GatewayOpcode::IDENTIFY, identify)));
+            });
+
+            it("completes resumes from the prepared prefix", [&]{
+                PayloadWriter writer(encoding);
+                writer.prepare(identify, "to\"k\\en");
+
+                for (auto seq : SEQUENCES)
+                {
+                    if (seq < 0)
+                    {
+                        continue;
+                    }
+
+                    const auto session_id = "session\n\x01\"" + std::to_string(seq);
+                    const auto expected = payload(Client::GatewayOpcode::RESUME, {
+                        {"token", "to\"k\\en"},
+                        {"session_id", session_id},
+                        {"seq", seq},
+                    });
+                    AssertThat(decode(encoding, writer.resume(session_id, seq)), Equals(expected));
+                }
+            });
+
+            it("writes other commands", [&]{
+                const json data = {{"guild_id", "41771983423143937"}, {"query", ""}, {"limit", 0}, {"presences", false}};
+
+                PayloadWriter writer(encoding);
+                AssertThat(decode(encoding, writer.write(Client::GatewayOpcode::REQUEST_GUILD_MEMBERS, data)),
+                    Equals(payload(Client::GatewayOpcode::REQUEST_GUILD_MEMBERS, data)));
+            });
+
+            it("does not grow the buffer for heartbeats", [&]{
+                PayloadWriter writer(encoding);
+                writer.heartbeat(std::numeric_limits<std::int32_t>::max());
+                const auto capacity = writer.capacity();
+
+                for (std::int32_t seq = -1; seq < 100000; ++seq)
+                {
+                    writer.heartbeat(seq);
+                }
+                AssertThat(writer.capacity(), Equals(capacity));
+            });
+        });
+    }
+});
@@ -0,0 +1,109 @@
+/**
+ * Plugin loaded by the plugin host tests, built against plugin_api.h only.
+ * The name, API version and load result are chosen at build time.
+ */
+
+#include <plugin_api.h>
+
+#include "test_plugin.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <sched.h>
+
+#ifndef TEST_PLUGIN_NAME
+#define TEST_PLUGIN_NAME "test"
+#endif
+
+#ifndef TEST_PLUGIN_API_VERSION
+#define TEST_PLUGIN_API_VERSION DISCORD_PLUGIN_API_VERSION
+#endif
+
+#ifndef TEST_PLUGIN_LOAD_RESULT
+#define TEST_PLUGIN_LOAD_RESULT 0
+#endif
+
+typedef struct test_state
+{
+    const discord_host *host;
+    test_plugin_probe *probe; /* of the latest event */
+} test_state;
+
+static int load(const discord_host *host, void **state)
+{
+    if (TEST_PLUGIN_LOAD_RESULT != 0)
+    {
+        return TEST_PLUGIN_LOAD_RESULT;
+    }
+
+    test_state *s = calloc(1, sizeof(test_state));
+    if (!s)
+    {
+        return 1;
+    }
+
+    s->host = host;
+    *state = s;
+    return 0;
+}
+
+static void unload(void *state)
+{
+    test_state *s = state;
+
+    test_plugin_probe *probe = __atomic_load_n(&s->probe, __ATOMIC_ACQUIRE);
+    if (probe)
+    {
+        __atomic_add_fetch(&probe->running_at_unload, __atomic_load_n(&probe->running, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&probe->unloads, 1, __ATOMIC_SEQ_CST);
+    }
+
+    free(s);
+}
+
+static void on_event(void *state, const char *event, size_t event_size, const discord_value *data)
+{
+    test_state *s = state;
+    const discord_host *host = s->host;
+    (void) event;
+    (void) event_size;
+
+    uint64_t address;
+    if (!host->get_uint(host->member(data, "probe", 5), &address))
+    {
+        return;
+    }
+
+    test_plugin_probe *probe = (test_plugin_probe*) (uintptr_t) address;
+    __atomic_store_n(&s->probe, probe, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&probe->running, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&probe->calls, 1, __ATOMIC_SEQ_CST);
+
+    int block = 0;
+    if (host->get_bool(host->member(data, "block", 5), &block) && block)
+    {
+        while (!__atomic_load_n(&probe->release, __ATOMIC_SEQ_CST))
+        {
+            sched_yield();
+        }
+    }
+
+    __atomic_sub_fetch(&probe->running, 1, __ATOMIC_SEQ_CST);
+}
+
+static const char *const events[] = {"MESSAGE_CREATE", NULL};
+
+static const discord_plugin plugin = {
+    TEST_PLUGIN_API_VERSION,
+    TEST_PLUGIN_NAME,
+    "1.0",
+    events,
+    &load,
+    &unload,
+    &on_event,
+};
+
+const discord_plugin *DISCORD_PLUGIN_ENTRY(void)
+{
+    return &plugin;
+}
@@ -0,0 +1,17 @@
+#ifndef TESTS_TEST_PLUGIN_H
+#define TESTS_TEST_PLUGIN_H
+
+/**
+ * Counters the test plugin reports to, events carry the address of a probe
+ * as their "probe" member. All fields are accessed atomically.
+ */
+typedef struct test_plugin_probe
+{
+    int calls;              /* events received */
+    int running;            /* callbacks currently running */
+    int release;            /* callbacks of events with "block":true wait until it is set */
+    int unloads;            /* unload callbacks of instances which received an event */
+    int running_at_unload;  /* callbacks which were still running during an unload callback */
+} test_plugin_probe;
+
+#endif /* TESTS_TEST_PLUGIN_H */
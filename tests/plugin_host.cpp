@@ -0,0 +1,206 @@
+#include <bandit/bandit.h>
+
+#include <plugin_host.hpp>
+
+#include "plugin/test_plugin.h"
+
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <future>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+
+using namespace snowhouse;
+using namespace bandit;
+
+using Discord::PluginHost;
+using Discord::Event;
+using json = nlohmann::json;
+
+namespace
+{
+
+/**
+ * Waits until the condition holds, returns false after a timeout.
+ */
+static bool wait_until(const std::function<bool()> &condition)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!condition())
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+static int counter(int &field)
+{
+    return std::atomic_ref<int>(field).load();
+}
+
+static json event_data(test_plugin_probe &probe, bool block = false)
+{
+    return {{"probe", reinterpret_cast<std::uintptr_t>(&probe)}, {"block", block}};
+}
+
+} // anonymous namespace
+
+go_bandit([]{
+    describe("PluginHost", []{
+        it("passes the handled events to a loaded plugin", [&]{
+            test_plugin_probe probe{};
+            PluginHost host;
+
+            AssertThat(host.load(TEST_PLUGIN), IsTrue());
+            AssertThat(host.wants(Event::MESSAGE_CREATE), IsTrue());
+            AssertThat(host.wants(Event::GUILD_CREATE), IsFalse());
+
+            host.dispatch(Event::MESSAGE_CREATE, "MESSAGE_CREATE", event_data(probe));
+            host.dispatch(Event::GUILD_CREATE, "GUILD_CREATE", event_data(probe));
+            AssertThat(counter(probe.calls), Equals(1));
+
+            const auto stats = host.stats();
+            AssertThat(stats.size(), Equals(1u));
+            AssertThat(stats[0].name, Equals("test"));
+            AssertThat(stats[0].version, Equals("1.0"));
+            AssertThat(stats[0].path, Equals(TEST_PLUGIN));
+            AssertThat(stats[0].calls, Equals(1u));
+
+            AssertThat(host.unload("test"), IsTrue());
+            AssertThat(counter(probe.unloads), Equals(1));
+            AssertThat(host.wants(Event::MESSAGE_CREATE), IsFalse());
+            AssertThat(host.stats().empty(), IsTrue());
+        });
+
+        it("rejects a second plugin with the same name", [&]{
+            test_plugin_probe probe{};
+            PluginHost host;
+
+            AssertThat(host.load(TEST_PLUGIN), IsTrue());
+            AssertThat(host.load(TEST_PLUGIN), IsFalse());
+            AssertThat(host.load(TEST_PLUGIN_COPY), IsFalse());
+            AssertThat(host.stats().size(), Equals(1u));
+
+            // the rejected ones neither receive events nor count as subscribers
+            host.dispatch(Event::MESSAGE_CREATE, "MESSAGE_CREATE", event_data(probe));
+            AssertThat(counter(probe.calls), Equals(1));
+
+            AssertThat(host.unload("test"), IsTrue());
+            AssertThat(host.wants(Event::MESSAGE_CREATE), IsFalse());
+
+            // the name is free again
+            AssertThat(host.load(TEST_PLUGIN_COPY), IsTrue());
+            AssertThat(host.stats()[0].path, Equals(TEST_PLUGIN_COPY));
+        });
+
+        it("rejects a plugin whose load callback fails", [&]{
+            PluginHost host;
+
+            AssertThat(host.load(TEST_PLUGIN_FAILING), IsFalse());
+            AssertThat(host.stats().empty(), IsTrue());
+            AssertThat(host.wants(Event::MESSAGE_CREATE), IsFalse());
+            AssertThat(host.unload("test"), IsFalse());
+        });
+
+        it("rejects a plugin built for another API version", [&]{
+            PluginHost host;
+
+            AssertThat(host.load(TEST_PLUGIN_VERSION), IsFalse());
+            AssertThat(host.stats().empty(), IsTrue());
+            AssertThat(host.wants(Event::MESSAGE_CREATE), IsFalse());
+        });
+
+        it("rejects files which are not plugins", [&]{
+            PluginHost host;
+
+            AssertThat(host.load("/nonexistent/plugin.so"), IsFalse());
+            AssertThat(host.stats().empty(), IsTrue());
+        });
+
+        it("fails to unload or reload unknown plugins", [&]{
+            PluginHost host;
+
+            AssertThat(host.unload("unknown"), IsFalse());
+            AssertThat(host.reload("unknown"), IsFalse());
+        });
+
+        it("waits in unload for running callbacks", [&]{
+            test_plugin_probe probe{};
+            PluginHost host;
+            AssertThat(host.load(TEST_PLUGIN), IsTrue());
+
+            auto dispatched = std::async(std::launch::async, [&]{
+                host.dispatch(Event::MESSAGE_CREATE, "MESSAGE_CREATE", event_data(probe, true));
+            });
+            AssertThat(wait_until([&]{ return counter(probe.running) == 1; }), IsTrue());
+
+            auto unloaded = std::async(std::launch::async, [&]{
+                return host.unload("test");
+            });
+
+            // removed right away, the shared object stays open for the running callback
+            AssertThat(wait_until([&]{ return !host.wants(Event::MESSAGE_CREATE); }), IsTrue());
+            AssertThat(unloaded.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout, IsTrue());
+            AssertThat(counter(probe.unloads), Equals(0));
+
+            std::atomic_ref<int>(probe.release).store(1);
+            dispatched.get();
+            AssertThat(unloaded.get(), IsTrue());
+
+            AssertThat(counter(probe.unloads), Equals(1));
+            AssertThat(counter(probe.running_at_unload), Equals(0));
+        });
+
+        it("reloads while events are dispatched", [&]{
+            static constexpr int THREADS = 4;
+            static constexpr int RELOADS = 20;
+
+            test_plugin_probe probe{};
+            PluginHost host;
+            AssertThat(host.load(TEST_PLUGIN), IsTrue());
+
+            std::atomic<bool> stop = false;
+            std::vector<std::thread> dispatchers;
+            for (int i = 0; i < THREADS; ++i)
+            {
+                dispatchers.emplace_back([&]{
+                    const auto data = event_data(probe);
+                    while (!stop.load())
+                    {
+                        host.dispatch(Event::MESSAGE_CREATE, "MESSAGE_CREATE", data);
+                    }
+                });
+            }
+
+            for (int i = 0; i < RELOADS; ++i)
+            {
+                // every instance receives events before it is replaced
+                const auto calls = counter(probe.calls);
+                AssertThat(wait_until([&]{ return counter(probe.calls) > calls; }), IsTrue());
+                AssertThat(host.reload("test"), IsTrue());
+            }
+
+            stop = true;
+            for (auto&& thr : dispatchers)
+            {
+                thr.join();
+            }
+
+            AssertThat(host.stats().size(), Equals(1u));
+            AssertThat(host.wants(Event::MESSAGE_CREATE), IsTrue());
+
+            AssertThat(host.unload("test"), IsTrue());
+            AssertThat(counter(probe.unloads), Equals(RELOADS + 1));
+            AssertThat(counter(probe.running_at_unload), Equals(0));
+            AssertThat(counter(probe.running), Equals(0));
+        });
+    });
+});
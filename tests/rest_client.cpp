@@ -0,0 +1,242 @@
+#include <bandit/bandit.h>
+
+#include <rest_client.hpp>
+#include <scheduler.hpp>
+
+#include "mock_http_server.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <map>
+#include <vector>
+#include <future>
+
+using namespace snowhouse;
+using namespace bandit;
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+/**
+ * Rate limited mock API, each channel has a bucket of LIMIT requests per WINDOW.
+ * Requests beyond the limit are answered with 429.
+ */
+struct RateLimitedApi
+{
+    static constexpr int LIMIT = 5;
+    static constexpr auto WINDOW = std::chrono::milliseconds(250);
+
+    struct Window
+    {
+        clock_type::time_point start;
+        int count = 0;
+    };
+
+    std::mutex mutex;
+    std::map<std::string, Window> windows;
+    std::map<std::string, std::vector<clock_type::time_point>> accepted; // arrival times per channel
+    int ok = 0;
+    int limited = 0;
+
+    MockHttpServer::Response handle(const MockHttpServer::Request &req)
+    {
+        std::lock_guard lk{this->mutex};
+
+        // /api/channels/{id}/messages
+        const auto major = req.path.substr(0, req.path.find('/', sizeof("/api/channels/") - 1));
+        auto &window = this->windows[major];
+
+        const auto now = clock_type::now();
+        if (window.count == 0 || now - window.start >= WINDOW)
+        {
+            window.start = now;
+            window.count = 0;
+        }
+
+        const auto reset_after = std::chrono::duration<double>(window.start + WINDOW - now).count();
+
+        MockHttpServer::Response res;
+        res.headers["X-RateLimit-Bucket"] = "abcd1234";
+        res.headers["X-RateLimit-Limit"] = std::to_string(LIMIT);
+        res.headers["X-RateLimit-Reset-After"] = std::to_string(reset_after);
+
+        if (window.count >= LIMIT)
+        {
+            ++this->limited;
+            res.status = 429;
+            res.headers["X-RateLimit-Remaining"] = "0";
+            res.headers["Retry-After"] = std::to_string(reset_after);
+            res.body = "{\"message\": \"You are being rate limited.\", \"global\": false}";
+            return res;
+        }
+
+        ++window.count;
+        ++this->ok;
+        this->accepted[major].emplace_back(now);
+        res.headers["X-RateLimit-Remaining"] = std::to_string(LIMIT - window.count);
+        res.body = req.body;
+        return res;
+    }
+
+    /**
+     * Whether the requests of the channel came in full windows of LIMIT requests, each one
+     * arriving at least WINDOW after the first request of the previous window.
+     */
+    bool kept_limit(const std::string &major)
+    {
+        std::lock_guard lk{this->mutex};
+
+        const auto &times = this->accepted[major];
+        for (std::size_t i = LIMIT; i < times.size(); ++i)
+        {
+            if (times[i] - times[(i / LIMIT - 1) * LIMIT] < WINDOW)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+} // anonymous namespace
+
+go_bandit([]{
+    describe("RestClient", []{
+        it("reuses keep-alive connections", [&]{
+            MockHttpServer server([](const MockHttpServer::Request &req) {
+                MockHttpServer::Response res;
+                res.body = req.headers.at("Authorization");
+                return res;
+            });
+
+            Discord::Scheduler scheduler;
+            Discord::RestClient rest(scheduler, server.url() + "/api", "token", 1);
+
+            for (int i = 0; i < 10; ++i)
+            {
+                const auto res = rest.request("GET", "/gateway/bot").get();
+                AssertThat(res.status, Equals(200));
+                AssertThat(res.body, Equals("Bot token"));
+            }
+
+            AssertThat(rest.connects(), Equals(1u));
+            AssertThat(server.connections(), Equals(1u));
+        });
+
+        it("sustains the bucket limit without being rate limited", [&]{
+            RateLimitedApi api;
+            MockHttpServer server([&](const MockHttpServer::Request &req) {
+                return api.handle(req);
+            });
+
+            Discord::Scheduler scheduler;
+            Discord::RestClient rest(scheduler, server.url() + "/api", "token", 4);
+
+            constexpr int REQUESTS = 40;
+            std::vector<std::future<Discord::RestClient::Response>> responses;
+
+            const auto start = clock_type::now();
+            for (int i = 0; i < REQUESTS; ++i)
+            {
+                responses.emplace_back(rest.request("POST", "/channels/1234/messages", "{}"));
+            }
+            for (auto&& res : responses)
+            {
+                AssertThat(res.get().status, Equals(200));
+            }
+            const auto elapsed = clock_type::now() - start;
+
+            AssertThat(api.limited, Equals(0));
+            AssertThat(rest.rateLimited(), Equals(0u));
+            AssertThat(api.kept_limit("/api/channels/1234"), IsTrue());
+
+            // 40 requests fill 8 windows, the last one is not waited for
+            const auto ideal = RateLimitedApi::WINDOW * (REQUESTS / RateLimitedApi::LIMIT - 1);
+            AssertThat(elapsed, IsGreaterThanOrEqualTo(ideal));
+        });
+
+        it("limits buckets of different channels independently", [&]{
+            RateLimitedApi api;
+            MockHttpServer server([&](const MockHttpServer::Request &req) {
+                return api.handle(req);
+            });
+
+            Discord::Scheduler scheduler;
+            Discord::RestClient rest(scheduler, server.url() + "/api", "token", 4);
+
+            constexpr int REQUESTS = 20;
+            std::vector<std::future<Discord::RestClient::Response>> responses;
+
+            for (int i = 0; i < REQUESTS; ++i)
+            {
+                responses.emplace_back(rest.request("POST", "/channels/1/messages", "{}"));
+                responses.emplace_back(rest.request("POST", "/channels/2/messages", "{}"));
+            }
+            for (auto&& res : responses)
+            {
+                AssertThat(res.get().status, Equals(200));
+            }
+
+            AssertThat(api.limited, Equals(0));
+            AssertThat(api.kept_limit("/api/channels/1"), IsTrue());
+            AssertThat(api.kept_limit("/api/channels/2"), IsTrue());
+
+            // a shared bucket would hold back the first window of one channel until the other one reset
+            const auto &first = api.accepted["/api/channels/1"];
+            const auto &second = api.accepted["/api/channels/2"];
+            AssertThat(first.size(), Equals(std::size_t(REQUESTS)));
+            AssertThat(second.size(), Equals(std::size_t(REQUESTS)));
+            AssertThat(first[RateLimitedApi::LIMIT - 1] < second[RateLimitedApi::LIMIT], IsTrue());
+            AssertThat(second[RateLimitedApi::LIMIT - 1] < first[RateLimitedApi::LIMIT], IsTrue());
+        });
+
+        it("retries requests which were rate limited", [&]{
+            std::atomic<int> calls = 0;
+            MockHttpServer server([&](const MockHttpServer::Request&) {
+                MockHttpServer::Response res;
+                if (calls++ == 0)
+                {
+                    res.status = 429;
+                    res.headers["Retry-After"] = "0.1";
+                    res.headers["X-RateLimit-Global"] = "true";
+                }
+                return res;
+            });
+
+            Discord::Scheduler scheduler;
+            Discord::RestClient rest(scheduler, server.url() + "/api", "token", 1);
+
+            const auto res = rest.request("POST", "/channels/1/messages", "{}").get();
+            AssertThat(res.status, Equals(200));
+            AssertThat(calls.load(), Equals(2));
+            AssertThat(rest.rateLimited(), Equals(1u));
+        });
+
+        it("enforces the global limit", [&]{
+            MockHttpServer server([](const MockHttpServer::Request&) {
+                return MockHttpServer::Response{};
+            });
+
+            Discord::Scheduler scheduler;
+            Discord::RestClient rest(scheduler, server.url() + "/api", "token", 4);
+            rest.setGlobalLimit(20);
+
+            std::vector<std::future<Discord::RestClient::Response>> responses;
+
+            const auto start = clock_type::now();
+            for (int i = 0; i < 30; ++i)
+            {
+                responses.emplace_back(rest.request("GET", "/channels/" + std::to_string(i)));
+            }
+            for (auto&& res : responses)
+            {
+                AssertThat(res.get().status, Equals(200));
+            }
+
+            // the last 10 requests have to wait for the next second
+            AssertThat(clock_type::now() - start, IsGreaterThanOrEqualTo(std::chrono::seconds(1)));
+        });
+    });
+});
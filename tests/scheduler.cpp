@@ -0,0 +1,170 @@
+#include <bandit/bandit.h>
+
+#include <scheduler.hpp>
+
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <future>
+
+using namespace snowhouse;
+using namespace bandit;
+
+using Discord::Scheduler;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+/**
+ * Waits until the condition holds, returns false after a timeout.
+ */
+static bool wait_until(const std::function<bool()> &condition)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!condition())
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+go_bandit([]{
+    describe("Scheduler", []{
+        it("runs one-shot timers in order of their due time", [&]{
+            std::mutex mutex;
+            std::vector<int> ran;
+            const auto record = [&](int value) {
+                return [&, value]{
+                    std::lock_guard lk{mutex};
+                    ran.emplace_back(value);
+                };
+            };
+
+            Scheduler scheduler;
+            const auto now = Scheduler::clock::now();
+            scheduler.schedule(50ms, record(5));
+            scheduler.schedule(10ms, record(1));
+            scheduler.schedule_at(now + 30ms, record(3));
+            scheduler.schedule(40ms, record(4));
+            scheduler.schedule_at(now + 20ms, record(2));
+
+            AssertThat(wait_until([&]{ std::lock_guard lk{mutex}; return ran.size() == 5; }), IsTrue());
+            AssertThat(ran, Equals(std::vector<int>{1, 2, 3, 4, 5}));
+        });
+
+        it("runs an earlier timer scheduled while waiting for a later one", [&]{
+            std::atomic<int> first = 0;
+            std::atomic<int> order = 0;
+
+            Scheduler scheduler;
+            scheduler.schedule(10s, [&]{ order.fetch_add(1); });
+            scheduler.schedule(1ms, [&]{ first = order.fetch_add(1) + 1; });
+
+            AssertThat(wait_until([&]{ return first.load() != 0; }), IsTrue());
+            AssertThat(first.load(), Equals(1));
+        });
+
+        it("reschedules a periodic timer after a slow run without catching up", [&]{
+            static constexpr auto INTERVAL = 10ms;
+
+            std::mutex mutex;
+            std::vector<Scheduler::clock::time_point> starts;
+            Scheduler::clock::time_point slow_end;
+
+            Scheduler scheduler;
+            scheduler.schedule_every(INTERVAL, [&]{
+                std::lock_guard lk{mutex};
+                starts.emplace_back(Scheduler::clock::now());
+                if (starts.size() == 1)
+                {
+                    // several intervals pass during the first run
+                    std::this_thread::sleep_for(5 * INTERVAL);
+                    slow_end = Scheduler::clock::now();
+                }
+            });
+
+            AssertThat(wait_until([&]{ std::lock_guard lk{mutex}; return starts.size() >= 3; }), IsTrue());
+            scheduler.stop();
+
+            // the missed runs are not replayed back to back, the next due time is one interval after the late run
+            AssertThat(starts[1] >= slow_end, IsTrue());
+            AssertThat(starts[2] >= slow_end + INTERVAL, IsTrue());
+        });
+
+        it("blocks cancel until the running task finished", [&]{
+            std::promise<void> started;
+            std::atomic<bool> finished = false;
+            std::atomic<int> runs = 0;
+
+            Scheduler scheduler;
+            const auto id = scheduler.schedule_every(1ms, [&]{
+                if (runs.fetch_add(1) == 0)
+                {
+                    started.set_value();
+                    std::this_thread::sleep_for(100ms);
+                    finished = true;
+                }
+            });
+
+            started.get_future().wait();
+            AssertThat(scheduler.cancel(id), IsTrue());
+            AssertThat(finished.load(), IsTrue());
+
+            // the cancelled timer is not rescheduled
+            std::this_thread::sleep_for(20ms);
+            AssertThat(runs.load(), Equals(1));
+            AssertThat(scheduler.cancel(id), IsFalse());
+        });
+
+        it("allows cancel from a task on the scheduler thread", [&]{
+            std::atomic<int> runs = 0;
+            std::atomic<bool> other_ran = false;
+            std::promise<bool> cancelled;
+
+            Scheduler scheduler;
+            const auto other = scheduler.schedule(5s, [&]{ other_ran = true; });
+
+            // the task learns its own id once schedule_every returned
+            std::promise<Scheduler::TimerId> id_promise;
+            auto id_future = id_promise.get_future().share();
+            const auto id = scheduler.schedule_every(1ms, [&, id_future]{
+                if (runs.fetch_add(1) == 2)
+                {
+                    // cancels itself and another timer without deadlocking
+                    scheduler.cancel(other);
+                    cancelled.set_value(scheduler.cancel(id_future.get()));
+                }
+            });
+            id_promise.set_value(id);
+
+            auto result = cancelled.get_future();
+            AssertThat(result.wait_for(10s) == std::future_status::ready, IsTrue());
+            AssertThat(result.get(), IsTrue());
+
+            std::this_thread::sleep_for(80ms);
+            AssertThat(runs.load(), Equals(3));
+            AssertThat(other_ran.load(), IsFalse());
+        });
+
+        it("discards pending timers on stop", [&]{
+            std::atomic<bool> ran = false;
+
+            Scheduler scheduler;
+            scheduler.schedule(20ms, [&]{ ran = true; });
+            scheduler.stop();
+
+            std::this_thread::sleep_for(40ms);
+            AssertThat(ran.load(), IsFalse());
+        });
+    });
+});
@@ -0,0 +1,160 @@
+#include <bandit/bandit.h>
+
+#include <session_store.hpp>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+using namespace snowhouse;
+using namespace bandit;
+
+using Discord::Session;
+using Discord::SessionStore;
+using json = nlohmann::json;
+
+namespace
+{
+
+static std::string temp_path(const std::string &name)
+{
+    return (std::filesystem::temp_directory_path() / ("discord-sessions-" + std::to_string(::getpid()) + "-" + name)).string();
+}
+
+static std::string read_file(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string &path, const std::string &data)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+static bool all_empty(const std::vector<Session> &sessions)
+{
+    for (auto&& session : sessions)
+    {
+        if (session)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+go_bandit([]{
+    describe("SessionStore", []{
+        const auto path = temp_path("sessions.json");
+
+        after_each([&]{
+            std::filesystem::remove(path);
+        });
+
+        it("round trips the sessions of all shards", [&]{
+            const std::vector<Session> sessions = {{"abc", 42}, {}, {"def", 0}};
+
+            SessionStore store(path);
+            AssertThat(store.save(3, sessions), IsTrue());
+
+            const auto loaded = SessionStore(path).load(3);
+            AssertThat(loaded.size(), Equals(3u));
+            AssertThat(loaded[0] == sessions[0], IsTrue());
+            AssertThat(static_cast<bool>(loaded[1]), IsFalse());
+            AssertThat(loaded[2] == sessions[2], IsTrue());
+        });
+
+        it("returns empty sessions without a file", [&]{
+            const auto loaded = SessionStore(path).load(2);
+            AssertThat(loaded.size(), Equals(2u));
+            AssertThat(all_empty(loaded), IsTrue());
+        });
+
+        it("drops the sessions when the shard count changed", [&]{
+            AssertThat(SessionStore(path).save(2, {{"abc", 1}, {"def", 2}}), IsTrue());
+
+            const auto loaded = SessionStore(path).load(4);
+            AssertThat(loaded.size(), Equals(4u));
+            AssertThat(all_empty(loaded), IsTrue());
+        });
+
+        it("ignores files of another version", [&]{
+            write_file(path, json({{"version", 2}, {"shard_count", 1},
+                {"sessions", {{{"shard", 0}, {"session_id", "abc"}, {"seq", 1}}}}}).dump());
+
+            const auto loaded = SessionStore(path).load(1);
+            AssertThat(loaded.size(), Equals(1u));
+            AssertThat(all_empty(loaded), IsTrue());
+        });
+
+        it("ignores corrupt files", [&]{
+            for (auto&& data : {
+                std::string("not json"),
+                std::string(R"({"version":1,"shard_count":1,"sessions":[{"shard":0,"session_id":"abc")"),
+                std::string(R"({"version":1,"shard_count":1})"),
+                std::string(R"({"version":1,"shard_count":1,"sessions":[{"shard":0,"session_id":"abc","seq":"1"}]})"),
+                std::string(R"({"version":1,"shard_count":1,"sessions":[{"shard":0,"seq":1}]})"),
+                std::string(),
+            })
+            {
+                write_file(path, data);
+
+                const auto loaded = SessionStore(path).load(1);
+                AssertThat(loaded.size(), Equals(1u));
+                AssertThat(all_empty(loaded), IsTrue());
+            }
+        });
+
+        it("ignores sessions of shards beyond the shard count", [&]{
+            write_file(path, json({{"version", 1}, {"shard_count", 1},
+                {"sessions", {{{"shard", 0}, {"session_id", "abc"}, {"seq", 1}}, {{"shard", 5}, {"session_id", "def"}, {"seq", 2}}}}}).dump());
+
+            const auto loaded = SessionStore(path).load(1);
+            AssertThat(loaded.size(), Equals(1u));
+            AssertThat(loaded[0].id, Equals("abc"));
+        });
+
+        it("skips writing unchanged sessions", [&]{
+            SessionStore store(path);
+            AssertThat(store.save(1, {{"abc", 1}}), IsTrue());
+
+            // a skipped save leaves the file as it is
+            std::filesystem::remove(path);
+            AssertThat(store.save(1, {{"abc", 1}}), IsTrue());
+            AssertThat(std::filesystem::exists(path), IsFalse());
+
+            AssertThat(store.save(1, {{"abc", 2}}), IsTrue());
+            AssertThat(SessionStore(path).load(1)[0].seq, Equals(2));
+        });
+
+        it("writes the file readable by the owner only", [&]{
+            // replaced by a new file, the mode of the old one does not matter
+            write_file(path, "{}");
+            ::chmod(path.c_str(), 0644);
+
+            AssertThat(SessionStore(path).save(1, {{"abc", 1}}), IsTrue());
+
+            struct stat st;
+            AssertThat(::stat(path.c_str(), &st), Equals(0));
+            AssertThat(st.st_mode & 0777, Equals(0600u));
+            AssertThat(std::filesystem::exists(path + ".tmp"), IsFalse());
+            AssertThat(json::parse(read_file(path))["version"].get<int>(), Equals(1));
+        });
+
+        it("fails when the file can't be written", [&]{
+            SessionStore store(temp_path("missing") + "/sessions.json");
+            AssertThat(store.save(1, {{"abc", 1}}), IsFalse());
+        });
+    });
+});
@@ -0,0 +1,325 @@
+#include <bandit/bandit.h>
+
+#include <snapshot.hpp>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <stdexcept>
+#include <cstring>
+
+#include <unistd.h>
+
+using namespace snowhouse;
+using namespace bandit;
+
+using Discord::Snapshot;
+using Discord::Snowflake;
+
+namespace
+{
+
+// offsets of the header fields, see snapshot.cpp
+static constexpr std::size_t VERSION_OFFSET = 8;
+static constexpr std::size_t BYTE_ORDER_OFFSET = 12;
+static constexpr std::size_t SECTIONS_OFFSET = 24;
+
+static std::string temp_path(const std::string &name)
+{
+    return (std::filesystem::temp_directory_path() / ("discord-snapshot-" + std::to_string(::getpid()) + "-" + name)).string();
+}
+
+static std::string read_file(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string &path, const std::string &data)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+template<typename T>
+static void patch(std::string &data, std::size_t offset, T value)
+{
+    std::memcpy(data.data() + offset, &value, sizeof(value));
+}
+
+template<typename Entity>
+static Entity round_trip(const Entity &entity)
+{
+    std::string record;
+    Snapshot::encode(record, entity);
+
+    Entity decoded;
+    if (!Snapshot::decode(record, decoded))
+    {
+        throw std::runtime_error("failed to decode the record");
+    }
+    return decoded;
+}
+
+static Discord::User user(std::uint64_t id, const std::string &name)
+{
+    Discord::User user;
+    user.id = Snowflake(id);
+    user.username = name;
+    user.discriminator = "0042";
+    user.avatar = "a_1234";
+    user.bot = true;
+    user.locale = "en-US";
+    user.flags = Discord::UserFlag::HOUSE_BRAVERY | Discord::UserFlag::EARLY_SUPPORTER;
+    user.premium_type = Discord::PremiumType::NITRO;
+    user.public_flags = Discord::UserFlag::VERIFIED_BOT;
+    return user;
+}
+
+/**
+ * Writes a snapshot with a few users and returns its contents.
+ */
+static std::string build(const std::string &path, const std::vector<std::uint64_t> &ids)
+{
+    Snapshot::Builder builder(path);
+    for (auto&& id : ids)
+    {
+        std::string record;
+        Snapshot::encode(record, user(id, "user" + std::to_string(id)));
+        builder.add(Snapshot::Kind::USER, Snowflake(id), record);
+    }
+
+    if (!builder.commit())
+    {
+        throw std::runtime_error("failed to write the snapshot");
+    }
+    return read_file(path);
+}
+
+} // anonymous namespace
+
+go_bandit([]{
+    describe("Snapshot", []{
+        const auto path = temp_path("test.snapshot");
+
+        after_each([&]{
+            std::filesystem::remove(path);
+        });
+
+        it("round trips guilds", [&]{
+            Discord::Guild guild;
+            guild.id = Snowflake(81384788765712384);
+            guild.name = "Discord API";
+            guild.icon = "icon";
+            guild.owner_id = Snowflake(53908232506183680);
+            guild.region = "us-east";
+            guild.system_channel_id = Snowflake(81384788765712385);
+            guild.member_count = 12345;
+            guild.large = true;
+            guild.roles = {Snowflake(1), Snowflake(2)};
+            guild.channels = {Snowflake(3)};
+
+            const auto decoded = round_trip(guild);
+            AssertThat(decoded.id.value(), Equals(guild.id.value()));
+            AssertThat(decoded.name, Equals(guild.name));
+            AssertThat(decoded.icon, Equals(guild.icon));
+            AssertThat(decoded.owner_id.value(), Equals(guild.owner_id.value()));
+            AssertThat(decoded.region, Equals(guild.region));
+            AssertThat(decoded.system_channel_id.value(), Equals(guild.system_channel_id.value()));
+            AssertThat(decoded.member_count, Equals(guild.member_count));
+            AssertThat(decoded.large, IsTrue());
+            AssertThat(decoded.unavailable, IsFalse());
+            AssertThat(decoded.roles.size(), Equals(2u));
+            AssertThat(decoded.roles[1].value(), Equals(2u));
+            AssertThat(decoded.channels.size(), Equals(1u));
+            AssertThat(decoded.channels[0].value(), Equals(3u));
+        });
+
+        it("round trips channels", [&]{
+            Discord::Channel channel;
+            channel.id = Snowflake(41771983423143937);
+            channel.type = Discord::ChannelType::GROUP_DM;
+            channel.guild_id = Snowflake(41771983423143936);
+            channel.position = 6;
+            channel.overwrites.push_back({Snowflake(7), "role", 1024, 2048});
+            channel.name = "general";
+            channel.topic = "24/7 chat about how to gank Mike #2";
+            channel.nsfw = true;
+            channel.last_message_id = Snowflake(155117677105512449);
+            channel.rate_limit = 2;
+            channel.recipients = {user(82198898841029460, "test"), user(82198898841029461, "other")};
+            channel.icon = "icon";
+            channel.owner_id = Snowflake(82198898841029460);
+            channel.parent_id = Snowflake(399942396007890945);
+            channel.last_pin_timestamp = "2020-01-01T00:00:00.000000+00:00";
+
+            const auto decoded = round_trip(channel);
+            AssertThat(decoded.id.value(), Equals(channel.id.value()));
+            AssertThat(decoded.type == Discord::ChannelType::GROUP_DM, IsTrue());
+            AssertThat(decoded.guild_id.value(), Equals(channel.guild_id.value()));
+            AssertThat(decoded.position, Equals(6));
+            AssertThat(decoded.overwrites.size(), Equals(1u));
+            AssertThat(decoded.overwrites[0].id.value(), Equals(7u));
+            AssertThat(decoded.overwrites[0].type, Equals("role"));
+            AssertThat(decoded.overwrites[0].allow, Equals(1024));
+            AssertThat(decoded.overwrites[0].deny, Equals(2048));
+            AssertThat(decoded.name, Equals(channel.name));
+            AssertThat(decoded.topic, Equals(channel.topic));
+            AssertThat(decoded.nsfw, IsTrue());
+            AssertThat(decoded.last_message_id.value(), Equals(channel.last_message_id.value()));
+            AssertThat(decoded.bitrate, Equals(-1));
+            AssertThat(decoded.rate_limit, Equals(2));
+            AssertThat(decoded.recipients.size(), Equals(2u));
+            AssertThat(decoded.recipients[1].username, Equals("other"));
+            AssertThat(decoded.icon, Equals(channel.icon));
+            AssertThat(decoded.owner_id.value(), Equals(channel.owner_id.value()));
+            AssertThat(decoded.app_id.value(), Equals(0u));
+            AssertThat(decoded.parent_id.value(), Equals(channel.parent_id.value()));
+            AssertThat(decoded.last_pin_timestamp, Equals(channel.last_pin_timestamp));
+        });
+
+        it("round trips roles", [&]{
+            Discord::Role role;
+            role.id = Snowflake(41771983423143936);
+            role.name = "WE DEM BOYZZ!!!!!!";
+            role.color = 3447003;
+            role.hoist = true;
+            role.position = 1;
+            role.permissions = 66321471;
+            role.mentionable = true;
+
+            const auto decoded = round_trip(role);
+            AssertThat(decoded.id.value(), Equals(role.id.value()));
+            AssertThat(decoded.name, Equals(role.name));
+            AssertThat(decoded.color, Equals(role.color));
+            AssertThat(decoded.hoist, IsTrue());
+            AssertThat(decoded.position, Equals(1));
+            AssertThat(decoded.permissions, Equals(role.permissions));
+            AssertThat(decoded.managed, IsFalse());
+            AssertThat(decoded.mentionable, IsTrue());
+        });
+
+        it("round trips users", [&]{
+            const auto original = user(80351110224678912, "Nelly");
+
+            const auto decoded = round_trip(original);
+            AssertThat(decoded.id.value(), Equals(original.id.value()));
+            AssertThat(decoded.username, Equals(original.username));
+            AssertThat(decoded.discriminator, Equals(original.discriminator));
+            AssertThat(decoded.avatar, Equals(original.avatar));
+            AssertThat(decoded.bot, IsTrue());
+            AssertThat(decoded.system, IsFalse());
+            AssertThat(decoded.locale, Equals(original.locale));
+            AssertThat(decoded.flags == original.flags, IsTrue());
+            AssertThat(decoded.premium_type == Discord::PremiumType::NITRO, IsTrue());
+            AssertThat(decoded.public_flags == Discord::UserFlag::VERIFIED_BOT, IsTrue());
+        });
+
+        it("rejects truncated records", [&]{
+            std::string record;
+            Snapshot::encode(record, user(80351110224678912, "Nelly"));
+
+            for (std::size_t size = 0; size < record.size(); ++size)
+            {
+                Discord::User decoded;
+                AssertThat(Snapshot::decode(std::string_view(record).substr(0, size), decoded), IsFalse());
+            }
+        });
+
+        it("finds records by id", [&]{
+            build(path, {30, 10, 20});
+
+            const Snapshot snapshot(path);
+            AssertThat(snapshot.size(Snapshot::Kind::USER), Equals(3u));
+            AssertThat(snapshot.size(Snapshot::Kind::GUILD), Equals(0u));
+
+            Discord::User found;
+            AssertThat(Snapshot::decode(snapshot.find(Snapshot::Kind::USER, Snowflake(20)), found), IsTrue());
+            AssertThat(found.username, Equals("user20"));
+
+            std::vector<std::uint64_t> ids;
+            snapshot.for_each(Snapshot::Kind::USER, [&](Snowflake id, std::string_view) {
+                ids.emplace_back(id.value());
+            });
+            AssertThat(ids, Equals(std::vector<std::uint64_t>{10, 20, 30}));
+        });
+
+        it("finds nothing for missing ids", [&]{
+            build(path, {10, 20, 30});
+
+            const Snapshot snapshot(path);
+            AssertThat(snapshot.find(Snapshot::Kind::USER, Snowflake(5)).empty(), IsTrue());
+            AssertThat(snapshot.find(Snapshot::Kind::USER, Snowflake(15)).empty(), IsTrue());
+            AssertThat(snapshot.find(Snapshot::Kind::USER, Snowflake(35)).empty(), IsTrue());
+            AssertThat(snapshot.find(Snapshot::Kind::GUILD, Snowflake(10)).empty(), IsTrue());
+        });
+
+        it("rejects files with a wrong magic", [&]{
+            auto data = build(path, {10});
+            data[0] = 'X';
+            write_file(path, data);
+
+            AssertThrows(std::runtime_error, Snapshot(path));
+        });
+
+        it("rejects other versions", [&]{
+            auto data = build(path, {10});
+            patch<std::uint32_t>(data, VERSION_OFFSET, Snapshot::VERSION + 1);
+            write_file(path, data);
+
+            AssertThrows(std::runtime_error, Snapshot(path));
+        });
+
+        it("rejects another byte order", [&]{
+            auto data = build(path, {10});
+            patch<std::uint32_t>(data, BYTE_ORDER_OFFSET, 0x04030201);
+            write_file(path, data);
+
+            AssertThrows(std::runtime_error, Snapshot(path));
+        });
+
+        it("rejects truncated files", [&]{
+            const auto data = build(path, {10, 20, 30});
+
+            // the user index is at the end of the file
+            write_file(path, data.substr(0, data.size() - 1));
+            AssertThrows(std::runtime_error, Snapshot(path));
+
+            write_file(path, data.substr(0, 16));
+            AssertThrows(std::runtime_error, Snapshot(path));
+        });
+
+        it("rejects an index beyond the end of the file", [&]{
+            auto data = build(path, {10});
+
+            const auto user_section = SECTIONS_OFFSET + 16 * static_cast<std::size_t>(Snapshot::Kind::USER);
+            patch<std::uint64_t>(data, user_section, data.size() + 8);
+            write_file(path, data);
+            AssertThrows(std::runtime_error, Snapshot(path));
+
+            patch<std::uint64_t>(data, user_section + 8, std::uint64_t(1) << 62);
+            write_file(path, data);
+            AssertThrows(std::runtime_error, Snapshot(path));
+        });
+
+        it("skips records beyond the end of the file", [&]{
+            auto data = build(path, {10, 20});
+
+            // index entries are (id, offset, size), a size which overflows offset + size
+            const auto index = data.size() - 2 * 24;
+            patch<std::uint64_t>(data, index + 16, ~std::uint64_t(0));
+            write_file(path, data);
+
+            const Snapshot snapshot(path);
+            AssertThat(snapshot.find(Snapshot::Kind::USER, Snowflake(10)).empty(), IsTrue());
+
+            std::vector<std::uint64_t> ids;
+            snapshot.for_each(Snapshot::Kind::USER, [&](Snowflake id, std::string_view) {
+                ids.emplace_back(id.value());
+            });
+            AssertThat(ids, Equals(std::vector<std::uint64_t>{20}));
+        });
+    });
+});
@@ -0,0 +1,91 @@
+#include <bandit/bandit.h>
+
+#include <snowflake.hpp>
+
+#include <string>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+#include <fmt/format.h>
+
+using namespace snowhouse;
+using namespace bandit;
+
+using Discord::Snowflake;
+using json = nlohmann::json;
+
+namespace
+{
+
+// example of the Discord documentation
+static constexpr std::uint64_t KNOWN_ID = 175928847299117063;
+
+} // anonymous namespace
+
+go_bandit([]{
+    describe("Snowflake", []{
+        it("parses decimal ids", [&]{
+            AssertThat(Snowflake::parse("175928847299117063").value(), Equals(KNOWN_ID));
+            AssertThat(Snowflake::parse("0").value(), Equals(0u));
+            AssertThat(Snowflake::parse("18446744073709551615").value(), Equals(UINT64_MAX));
+            AssertThat(Snowflake::parse("00000000000000000042").value(), Equals(42u));
+        });
+
+        it("returns an empty snowflake on overflow", [&]{
+            AssertThat(static_cast<bool>(Snowflake::parse("18446744073709551616")), IsFalse());
+            AssertThat(static_cast<bool>(Snowflake::parse("99999999999999999999")), IsFalse());
+            AssertThat(static_cast<bool>(Snowflake::parse("100000000000000000000")), IsFalse());
+        });
+
+        it("returns an empty snowflake on invalid input", [&]{
+            AssertThat(static_cast<bool>(Snowflake::parse("")), IsFalse());
+            AssertThat(static_cast<bool>(Snowflake::parse("12a4")), IsFalse());
+            AssertThat(static_cast<bool>(Snowflake::parse("-1")), IsFalse());
+            AssertThat(static_cast<bool>(Snowflake::parse("+1")), IsFalse());
+            AssertThat(static_cast<bool>(Snowflake::parse(" 1")), IsFalse());
+            AssertThat(static_cast<bool>(Snowflake::parse("1.0")), IsFalse());
+        });
+
+        it("parses at compile time", [&]{
+            static_assert(Snowflake::parse("175928847299117063").value() == KNOWN_ID);
+            static_assert(!Snowflake::parse("18446744073709551616"));
+        });
+
+        it("extracts the fields of an id", [&]{
+            const Snowflake id(KNOWN_ID);
+            AssertThat(id.timestamp(), Equals(1462015105796u));
+            AssertThat(id.worker(), Equals(1u));
+            AssertThat(id.process(), Equals(0u));
+            AssertThat(id.sequence(), Equals(7u));
+
+            const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(id.time().time_since_epoch()).count();
+            AssertThat(ms, Equals(1462015105796));
+        });
+
+        it("formats the decimal representation", [&]{
+            AssertThat(Snowflake(KNOWN_ID).str(), Equals("175928847299117063"));
+            AssertThat(Snowflake().str(), Equals("0"));
+            AssertThat(Snowflake(UINT64_MAX).str(), Equals("18446744073709551615"));
+
+            AssertThat(fmt::format("{}", Snowflake(KNOWN_ID)), Equals("175928847299117063"));
+            AssertThat(fmt::format("<{}>", Snowflake(9)), Equals("<9>"));
+            AssertThat(fmt::format("{}", Snowflake(UINT64_MAX)), Equals("18446744073709551615"));
+        });
+
+        it("converts to and from json", [&]{
+            AssertThat(json(Snowflake(KNOWN_ID)), Equals(json("175928847299117063")));
+
+            // JSON sends strings, ETF integers
+            AssertThat(json("175928847299117063").get<Snowflake>().value(), Equals(KNOWN_ID));
+            AssertThat(json(KNOWN_ID).get<Snowflake>().value(), Equals(KNOWN_ID));
+            AssertThat(json(std::int64_t(42)).get<Snowflake>().value(), Equals(42u));
+
+            AssertThat(static_cast<bool>(json(nullptr).get<Snowflake>()), IsFalse());
+            AssertThat(static_cast<bool>(json("invalid").get<Snowflake>()), IsFalse());
+            AssertThat(static_cast<bool>(json(1.5).get<Snowflake>()), IsFalse());
+
+            const auto round_trip = json(Snowflake(UINT64_MAX)).get<Snowflake>();
+            AssertThat(round_trip.value(), Equals(UINT64_MAX));
+        });
+    });
+});
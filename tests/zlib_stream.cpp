@@ -0,0 +1,160 @@
+#include <bandit/bandit.h>
+
+#include <utils/zlib_stream.hpp>
+
+#include <string>
+#include <string_view>
+#include <random>
+#include <cstring>
+
+#include <zlib.h>
+
+using namespace snowhouse;
+using namespace bandit;
+
+namespace
+{
+
+/**
+ * Compresses messages like the gateway, one deflate stream per connection
+ * and every message ends with a Z_SYNC_FLUSH.
+ */
+class Deflater
+{
+public:
+    Deflater()
+    {
+        std::memset(&this->_zs, 0, sizeof(this->_zs));
+        deflateInit(&this->_zs, Z_DEFAULT_COMPRESSION);
+    }
+
+    ~Deflater()
+    {
+        deflateEnd(&this->_zs);
+    }
+
+    std::string message(std::string_view data)
+    {
+        std::string out(deflateBound(&this->_zs, data.size()) + 64, '\0');
+
+        this->_zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        this->_zs.avail_in = static_cast<uInt>(data.size());
+        this->_zs.next_out = reinterpret_cast<Bytef*>(out.data());
+        this->_zs.avail_out = static_cast<uInt>(out.size());
+        deflate(&this->_zs, Z_SYNC_FLUSH);
+
+        out.resize(out.size() - this->_zs.avail_out);
+        return out;
+    }
+
+private:
+    z_stream _zs;
+};
+
+static std::string random_text(std::size_t size)
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> chars('!', '~');
+
+    std::string text(size, '\0');
+    for (auto&& c : text)
+    {
+        c = static_cast<char>(chars(rng));
+    }
+    return text;
+}
+
+} // anonymous namespace
+
+go_bandit([]{
+    describe("ZlibStream", []{
+        it("inflates consecutive messages of a connection", [&]{
+            Deflater deflater;
+            Utils::ZlibStream stream;
+
+            for (auto&& message : {R"({"op":10,"d":{"heartbeat_interval":41250}})", R"({"op":11})", R"({"op":0,"t":"READY"})"})
+            {
+                AssertThat(stream.feed(deflater.message(message)), IsTrue());
+                AssertThat(std::string(stream.output()), Equals(message));
+            }
+
+            AssertThat(stream.stats().messages, Equals(3u));
+        });
+
+        it("buffers a message split across frames until the flush suffix", [&]{
+            Deflater deflater;
+            Utils::ZlibStream stream;
+
+            const auto text = random_text(10000);
+            const auto compressed = deflater.message(text);
+            const auto third = compressed.size() / 3;
+
+            AssertThat(stream.feed(std::string_view(compressed).substr(0, third)), IsFalse());
+            AssertThat(stream.feed(std::string_view(compressed).substr(third, third)), IsFalse());
+            AssertThat(stream.error(), IsFalse());
+            AssertThat(stream.feed(std::string_view(compressed).substr(2 * third)), IsTrue());
+            AssertThat(std::string(stream.output()), Equals(text));
+        });
+
+        it("grows the output for messages larger than the initial buffer", [&]{
+            Deflater deflater;
+            Utils::ZlibStream stream;
+
+            const auto text = random_text(300 * 1024);
+            AssertThat(stream.feed(deflater.message(text)), IsTrue());
+            AssertThat(stream.output().size(), Equals(text.size()));
+            AssertThat(std::string(stream.output()), Equals(text));
+
+            // the grown buffer is reused for smaller messages
+            AssertThat(stream.feed(deflater.message("small")), IsTrue());
+            AssertThat(std::string(stream.output()), Equals("small"));
+        });
+
+        it("starts over after reset for a new connection", [&]{
+            Utils::ZlibStream stream;
+            {
+                Deflater first;
+                AssertThat(stream.feed(first.message("first connection")), IsTrue());
+            }
+
+            // the new deflate stream starts with a zlib header again
+            stream.reset();
+            Deflater second;
+            AssertThat(stream.feed(second.message("second connection")), IsTrue());
+            AssertThat(std::string(stream.output()), Equals("second connection"));
+            AssertThat(stream.stats().messages, Equals(2u));
+        });
+
+        it("drops a partial message on reset", [&]{
+            Utils::ZlibStream stream;
+            {
+                Deflater first;
+                const auto compressed = first.message(random_text(1000));
+                AssertThat(stream.feed(std::string_view(compressed).substr(0, 10)), IsFalse());
+            }
+
+            stream.reset();
+            Deflater second;
+            AssertThat(stream.feed(second.message("hello")), IsTrue());
+            AssertThat(std::string(stream.output()), Equals("hello"));
+        });
+
+        it("fails on corrupt input until reset", [&]{
+            Utils::ZlibStream stream;
+
+            const std::string garbage = std::string("not a zlib stream") + std::string("\x00\x00\xFF\xFF", 4);
+            AssertThat(stream.feed(garbage), IsFalse());
+            AssertThat(stream.error(), IsTrue());
+            AssertThat(stream.output().empty(), IsTrue());
+
+            Deflater deflater;
+            AssertThat(stream.feed(deflater.message("valid")), IsFalse());
+
+            stream.reset();
+            AssertThat(stream.error(), IsFalse());
+            Deflater fresh;
+            AssertThat(stream.feed(fresh.message("valid")), IsTrue());
+            AssertThat(std::string(stream.output()), Equals("valid"));
+        });
+    });
+});